@@ -0,0 +1,354 @@
+//microbenchmarks of the Grid.cpp hot paths, results are printed as JSON.
+//usage: gol_bench [--quick] [--filter <substring>] [--repetitions <n>] [--out <file>]
+
+#include"Grid.h"
+#include"GridInternal.h"
+#include"FieldOutputs.h"
+#include"SoftwareRenderer.h"
+#include"Census.h"
+#include"Timer.h"
+
+#include<vector>
+#include<string>
+#include<cstring>
+#include<fstream>
+#include<iostream>
+#include<algorithm>
+#include<functional>
+#include<thread>
+#include<random>
+
+struct BenchConfig {
+    uint32_t width, height;
+    double density;
+    uint32_t threads;
+};
+
+struct BenchResult {
+    std::string name;
+    BenchConfig config;
+    bool edgeCellsOptimization;
+    uint64_t items;
+    char const *unit;
+    uint32_t repetitions;
+    double medianNs, minNs; //per item
+    PerfSample perf; //hardware counters of the measured generations, if available
+    uint64_t perfItems;
+};
+
+struct BenchOptions {
+    bool quick = false;
+    std::string filter{};
+    uint32_t repetitions = 15;
+    std::string out{};
+};
+
+static std::vector<uint32_t> randomRows(uint32_t const width, uint32_t const height, double const density, uint32_t const seed) {
+    auto const rowLength = misc::intDivCeil(width, cellsBatchLength);
+    std::vector<uint32_t> rows(rowLength * height);
+    std::mt19937 rng{ seed };
+    std::bernoulli_distribution alive{ density };
+    for(uint32_t y = 0; y < height; y++) {
+        for(uint32_t x = 0; x < width; x++) {
+            if(alive(rng)) rows[y * rowLength + x / cellsBatchLength] |= 1u << (x % cellsBatchLength);
+        }
+    }
+    return rows;
+}
+
+//runs `setup` and `run` `repetitions` times after a warmup, `run` processes `result.items` items
+//and returns the number of nanoseconds it took
+static void measureTimed(
+    BenchResult &result, uint32_t const repetitions,
+    std::function<void()> const &setup, std::function<uint64_t()> const &run
+) {
+    std::vector<double> samples{};
+    for(uint32_t i = 0; i <= repetitions; i++) {
+        setup();
+        auto const elapsed = double(run());
+        if(i != 0) samples.push_back(elapsed / misc::max<uint64_t>(result.items, 1));
+    }
+    std::sort(samples.begin(), samples.end());
+    result.repetitions = repetitions;
+    result.medianNs = samples[samples.size() / 2];
+    result.minNs = samples.front();
+}
+
+static void measure(
+    BenchResult &result, uint32_t const repetitions,
+    std::function<void()> const &setup, std::function<void()> const &run
+) {
+    measureTimed(result, repetitions, setup, [&run]() -> uint64_t {
+        Timer<std::chrono::nanoseconds> t{};
+        run();
+        return t.elapsedTime();
+    });
+}
+
+static volatile uint32_t sink; //keeps results of the measured code alive
+
+class Bench {
+    BenchOptions const &options;
+    std::vector<BenchResult> results;
+public:
+    Bench(BenchOptions const &options_) : options{ options_ }, results{} {}
+
+    std::vector<BenchResult> const &getResults() const { return results; }
+
+    bool enabled(char const *const name) const {
+        return options.filter.empty() || std::string{ name }.find(options.filter) != std::string::npos;
+    }
+
+    BenchResult &add(char const *const name, BenchConfig const &config, bool const edgeOpt, uint64_t const items, char const *const unit) {
+        results.push_back(BenchResult{ name, config, edgeOpt, items, unit, 0, 0, 0, PerfSample{}, 0 });
+        return results.back();
+    }
+
+    //benchmarks of the kernel on a standalone grid, independent of thread count
+    void kernels(BenchConfig const &config) {
+        Field::FieldPimpl grid{ int32_t(config.width), int32_t(config.height) };
+        auto const rows = randomRows(config.width, config.height, config.density, 1);
+        std::copy(rows.begin(), rows.end(), &grid.getCellsActual_int(0));
+        grid.fixField();
+
+        auto const gridLength = int32_t(grid.gridLength());
+        auto const buffer = grid.getBuffer(Field::FieldPimpl::bufCur) + grid.bufferPaddingLength();
+        auto const edgeOpt = grid.edgeCellsOptimization;
+
+        if(enabled("newGenerationBatched")) {
+            auto &r = add("newGenerationBatched", config, edgeOpt, gridLength, "batch");
+            measure(r, options.repetitions, []{}, [&]() {
+                auto remainder = calcRemainder(grid, 0);
+                uint32_t acc = 0;
+                for(int32_t i = 0; i < gridLength; i++) acc ^= newGenerationBatched(remainder, buffer + i, grid.rowLength, remainder);
+                sink = acc;
+            });
+        }
+        if(enabled("calcRemainder")) {
+            auto &r = add("calcRemainder", config, edgeOpt, gridLength, "call");
+            measure(r, options.repetitions, []{}, [&]() {
+                uint32_t acc = 0;
+                for(int32_t i = 0; i < gridLength; i++) acc += calcRemainder(grid, i).cellsCols;
+                sink = acc;
+            });
+        }
+        if(enabled("fixField")) {
+            auto &r = add("fixField", config, edgeOpt, 1, "call");
+            measure(r, options.repetitions, []{}, [&]() { grid.fixField(); });
+        }
+        if(enabled("edgeCells")) {
+            auto &r = add("edgeCells", config, edgeOpt, grid.height, "row");
+            measure(r, options.repetitions, []{}, [&]() {
+                uint32_t acc = 0;
+                updateEdgeCells(grid, 0, grid.height, [&](uint32_t const row, bool const isLast, FieldCell const cell) {
+                    acc += row * cell + isLast;
+                });
+                sink = acc;
+            });
+        }
+    }
+
+    //benchmarks through the public interface of Field
+    void field(BenchConfig const &config) {
+        Field field{
+            config.width, config.height, config.threads,
+            []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); },
+            []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); }
+        };
+        field.setUndoBudget(0);
+        field.setPerfCountersEnabled(true);
+        auto const rows = randomRows(config.width, config.height, config.density, 2);
+        field.stampPattern(rows.data(), vec2i(config.width, config.height), vec2i(0), true);
+        field.startCurGeneration();
+        auto const finish = [&field]() { while(!field.tryFinishGeneration()) {} };
+        finish();
+
+        auto const edgeOpt = field.width_actual() - field.width() >= 2;
+        std::mt19937 rng{ 3 };
+        auto const randomCells = [&](uint32_t const count) {
+            std::vector<Cell> cells(count);
+            for(auto &cell : cells) cell = Cell{ FieldCell(rng() & 1), int32_t(rng() % field.size()) };
+            return cells;
+        };
+
+        if(enabled("generation")) {
+            auto &r = add("generation", config, edgeOpt, field.size(), "cell");
+            measure(r, options.repetitions, []{}, [&]() {
+                field.startNewGeneration();
+                finish();
+                r.perf.add(field.generationStats().perf);
+                r.perfItems += field.size();
+            });
+        }
+        for(uint32_t const count : { 64u, 4096u }) {
+            if(enabled("setCells")) {
+                auto const cells = randomCells(count);
+                auto &r = add("setCells", config, edgeOpt, count, "cell");
+                measure(r, options.repetitions, 
+                    [&]() { field.startNewGeneration(); finish(); },
+                    [&]() { field.setCells(cells.data(), cells.size()); }
+                );
+                field.startNewGeneration();
+                finish();
+            }
+            if(enabled("repair")) {
+                //only the successful tryFinishGeneration() call is measured, it repairs batches
+                //around the cells modified while the generation was computed
+                auto const cells = randomCells(count);
+                auto &r = add("repair", config, edgeOpt, count, "cell");
+                measureTimed(r, options.repetitions, 
+                    [&]() { 
+                        field.startNewGeneration(); 
+                        field.setCells(cells.data(), cells.size()); 
+                    },
+                    [&]() -> uint64_t { 
+                        while(true) {
+                            Timer<std::chrono::nanoseconds> t{};
+                            if(field.tryFinishGeneration()) return t.elapsedTime();
+                        }
+                    }
+                );
+            }
+        }
+        if(enabled("resize")) {
+            //grows the field by a few unaligned columns and rows and shrinks it back, cells are moved by a part of a batch
+            auto &r = add("resize", config, edgeOpt, field.size(), "cell");
+            auto isGrown = false;
+            measure(r, options.repetitions, []{}, [&]() {
+                if(isGrown) field.resize(config.width, config.height, vec2i(-17, -3));
+                else field.resize(config.width + 40, config.height + 6, vec2i(17, 3));
+                isGrown = !isGrown;
+            });
+            if(isGrown) field.resize(config.width, config.height, vec2i(-17, -3));
+            finish();
+        }
+    }
+
+    //1080p frames of the field drawn on the CPU, zoomed out so that cells are a few pixels wide
+    void render(BenchConfig const &config) {
+        if(!enabled("render")) return;
+        Field field{
+            config.width, config.height, 1,
+            []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); },
+            []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); }
+        };
+        field.setUndoBudget(0);
+        auto const rows = randomRows(config.width, config.height, config.density, 4);
+        field.stampPattern(rows.data(), vec2i(config.width, config.height), vec2i(0), true);
+
+        SoftwareRenderer renderer{ config.threads };
+        auto const frameSize = vec2i(1920, 1080);
+        std::vector<uint32_t> pixels(size_t(frameSize.x) * frameSize.y);
+        for(uint32_t const samples : { 1u, 3u }) {
+            RenderView const view{ vec2d(config.width * 0.5, config.height * 0.5), config.height * 0.5, 0.17, 0, vec2d(0), samples };
+            auto &r = add(samples == 1 ? "render" : "render3x3", config, field.width_actual() - field.width() >= 2, uint64_t(frameSize.x) * frameSize.y, "pixel");
+            measure(r, options.repetitions, []{}, [&]() {
+                renderer.render(field, view, frameSize, pixels.data());
+                sink = pixels[pixels.size() / 2];
+            });
+        }
+    }
+
+    //objects of a random soup found and counted by shape, items are cells of the field
+    void census(BenchConfig const &config) {
+        if(!enabled("census")) return;
+        auto const rows = randomRows(config.width, config.height, config.density, 5);
+        Census census{ config.threads };
+        auto &r = add("census", config, false, uint64_t(config.width) * config.height, "cell");
+        measure(r, options.repetitions, []{}, [&]() {
+            census.run(rows.data(), config.width, config.height, misc::intDivCeil(config.width, cellsBatchLength));
+            sink = census.objectsCount();
+        });
+    }
+
+    void run() {
+        std::vector<uint32_t> const widths = options.quick 
+            ? std::vector<uint32_t>{ 256, 250 } 
+            : std::vector<uint32_t>{ 1024, 1000, 1025, 4096 }; //aligned (no edge cells optimization), unaligned, just above a multiple of 32
+        std::vector<uint32_t> const heights = options.quick ? std::vector<uint32_t>{ 64 } : std::vector<uint32_t>{ 256, 1024 };
+        std::vector<double> const densities{ 0.1, 0.5 };
+
+        std::vector<uint32_t> threads{ 1 };
+        auto const hardwareThreads = misc::max(1u, std::thread::hardware_concurrency());
+        for(uint32_t t = 2; t <= hardwareThreads && !options.quick; t *= 2) threads.push_back(t);
+        if(hardwareThreads > 1 && threads.back() != hardwareThreads) threads.push_back(hardwareThreads);
+
+        for(auto const width : widths) for(auto const height : heights) for(auto const density : densities) {
+            kernels(BenchConfig{ width, height, density, 1 });
+            for(auto const t : threads) field(BenchConfig{ width, height, density, t });
+            //rendering doesn't depend on the cells much, one field size is enough
+            if(width == widths.front() && height == heights.back() && density == densities.back()) {
+                for(auto const t : threads) render(BenchConfig{ width, height, density, t });
+            }
+        }
+        //a census is taken of whole fields, 10^8 cells is the size of the largest ones
+        auto const censusSize = options.quick ? 1024u : 10000u;
+        for(auto const t : threads) census(BenchConfig{ censusSize, censusSize, 0.1, t });
+    }
+};
+
+static void writeJson(std::ostream &out, std::vector<BenchResult> const &results) {
+    out << "{\n  \"hardware_concurrency\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "  \"benchmarks\": [\n";
+    for(size_t i = 0; i < results.size(); i++) {
+        auto const &r = results[i];
+        out << "    {\"name\": \"" << r.name << "\""
+            << ", \"width\": " << r.config.width
+            << ", \"height\": " << r.config.height
+            << ", \"density\": " << r.config.density
+            << ", \"threads\": " << r.config.threads
+            << ", \"edge_cells_optimization\": " << (r.edgeCellsOptimization ? "true" : "false")
+            << ", \"items\": " << r.items
+            << ", \"unit\": \"" << r.unit << "\""
+            << ", \"repetitions\": " << r.repetitions
+            << ", \"median_ns\": " << r.medianNs
+            << ", \"min_ns\": " << r.minNs
+            << ", \"perf\": ";
+        if(!r.perf.valid) out << "null";
+        else {
+            auto const items = double(misc::max<uint64_t>(r.perfItems, 1));
+            out << "{\"ipc\": " << r.perf.ipc()
+                << ", \"cycles_per_item\": " << r.perf.cycles / items
+                << ", \"instructions_per_item\": " << r.perf.instructions / items;
+            if(r.perf.hasCacheCounters) {
+                out << ", \"cache_references_per_item\": " << r.perf.cacheReferences / items
+                    << ", \"cache_misses_per_item\": " << r.perf.cacheMisses / items
+                    << ", \"memory_bytes_per_second\": " << r.perf.memoryBytesPerSecond();
+            }
+            out << "}";
+        }
+        out << "}" << (i + 1 == results.size() ? "" : ",") << '\n';
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char **argv) {
+    BenchOptions options{};
+    for(int i = 1; i < argc; i++) {
+        auto const arg = std::string{ argv[i] };
+        auto const hasValue = i + 1 < argc;
+        if(arg == "--quick") options.quick = true;
+        else if(arg == "--filter" && hasValue) options.filter = argv[++i];
+        else if(arg == "--repetitions" && hasValue) options.repetitions = misc::max(1, std::atoi(argv[++i]));
+        else if(arg == "--out" && hasValue) options.out = argv[++i];
+        else {
+            std::cerr << "usage: gol_bench [--quick] [--filter <substring>] [--repetitions <n>] [--out <file>]\n";
+            return 1;
+        }
+    }
+
+    //Field reports its own timings to std::cout, they would break the JSON
+    auto const stdoutBuffer = std::cout.rdbuf(nullptr);
+    std::ostream stdoutStream{ stdoutBuffer };
+
+    Bench bench{ options };
+    bench.run();
+
+    if(options.out.empty()) writeJson(stdoutStream, bench.getResults());
+    else {
+        std::ofstream file{ options.out };
+        writeJson(file, bench.getResults());
+    }
+    std::cout.rdbuf(stdoutBuffer);
+    return 0;
+}
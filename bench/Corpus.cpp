@@ -0,0 +1,312 @@
+//macro benchmark: runs the bundled corpus of patterns for a fixed number of generations
+//and prints generations/s, cells/s and peak RSS of every run as one table.
+//Ensemble runs advance random soups until they settle, for at most that many generations, and also print settled soups/s.
+//usage: gol_corpus [--quick] [--filter <substring>] [--generations <n>] [--corpus <dir>] [--csv <file>] [--trace <file>]
+
+#include"Grid.h"
+#include"Ensemble.h"
+#include"FieldOutputs.h"
+#include"PackedPattern.h"
+#include"Timer.h"
+#include"Trace.h"
+
+#include<vector>
+#include<string>
+#include<cstdio>
+#include<fstream>
+#include<sstream>
+#include<iostream>
+#include<functional>
+#include<thread>
+#include<random>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include<sys/resource.h>
+#endif
+
+#ifndef GOL_CORPUS_DIR
+    #define GOL_CORPUS_DIR "bench/corpus"
+#endif
+
+struct CorpusOptions {
+    bool quick = false;
+    std::string filter{};
+    uint64_t generations = 0; //0 - default for the mode
+    std::string corpusDir = GOL_CORPUS_DIR;
+    std::string csv{};
+    std::string trace{}; //Chrome trace of the last spans of the run
+};
+
+struct CorpusResult {
+    std::string workload;
+    std::string engine;
+    uint32_t width, height;
+    uint32_t threads;
+    uint64_t generations;
+    double seconds;
+    uint64_t population; //after the last generation
+    uint64_t peakRssKiB; //0 if unknown
+    uint64_t settledSoups; //of ensemble runs, 0 for others
+};
+
+//Linux allows resetting the peak so that it is measured per run,
+//elsewhere it is the peak of the whole process so far
+static void resetPeakRss() {
+#ifdef __linux__
+    if(auto const file = std::fopen("/proc/self/clear_refs", "w")) {
+        std::fputs("5", file);
+        std::fclose(file);
+    }
+#endif
+}
+
+static uint64_t peakRssKiB() {
+#ifdef __linux__
+    std::ifstream status{ "/proc/self/status" };
+    std::string line;
+    while(std::getline(status, line)) {
+        unsigned long long kib;
+        if(std::sscanf(line.c_str(), "VmHWM: %llu kB", &kib) == 1) return kib;
+    }
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage{};
+    if(getrusage(RUSAGE_SELF, &usage) == 0) {
+    #ifdef __APPLE__
+        return uint64_t(usage.ru_maxrss) / 1024; //bytes
+    #else
+        return uint64_t(usage.ru_maxrss);
+    #endif
+    }
+#endif
+    return 0;
+}
+
+static bool loadPattern(std::string const &path, PackedPattern &pattern) {
+    std::ifstream file{ path };
+    if(!file) return false;
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return PackedPattern::fromRle(contents.str().c_str(), pattern);
+}
+
+//fills the field before the first generation
+using Populate = std::function<void(Field &field)>;
+
+struct Workload {
+    std::string name;
+    Populate populate;
+    double soupDensity; //> 0 if the workload is a random soup, it is then also run on the ensemble
+};
+
+static Populate centered(PackedPattern const &pattern) {
+    return [pattern](Field &field) {
+        auto const offset = vec2i(
+            int32_t(field.width() - pattern.width()) / 2,
+            int32_t(field.height() - pattern.height()) / 2
+        );
+        field.pasteRegion(pattern, offset);
+    };
+}
+
+static Populate tiled(PackedPattern const &pattern, vec2i const step) {
+    return [pattern, step](Field &field) {
+        for(int32_t y = 0; y + step.y <= int32_t(field.height()); y += step.y)
+        for(int32_t x = 0; x + step.x <= int32_t(field.width()); x += step.x) {
+            field.pasteRegion(pattern, vec2i(x, y));
+        }
+    };
+}
+
+static Populate scattered(PackedPattern const &pattern, uint32_t const count, uint32_t const seed) {
+    return [pattern, count, seed](Field &field) {
+        std::mt19937 rng{ seed };
+        for(uint32_t i = 0; i < count; i++) {
+            field.pasteRegion(pattern, vec2i(int32_t(rng() % field.width()), int32_t(rng() % field.height())));
+        }
+    };
+}
+
+static Populate soup(double const density, uint32_t const seed) {
+    return [density, seed](Field &field) {
+        std::mt19937 rng{ seed };
+        std::bernoulli_distribution alive{ density };
+        PackedPattern pattern{ field.width(), field.height() };
+        for(uint32_t y = 0; y < field.height(); y++)
+        for(uint32_t x = 0; x < field.width(); x++) {
+            if(alive(rng)) pattern.setCellAt(x, y, true);
+        }
+        field.pasteRegion(pattern, vec2i(0), true);
+    };
+}
+
+class Corpus {
+    CorpusOptions const &options;
+    std::vector<Workload> workloads;
+    std::vector<CorpusResult> results;
+public:
+    Corpus(CorpusOptions const &options_) : options{ options_ }, workloads{}, results{} {}
+
+    std::vector<CorpusResult> const &getResults() const { return results; }
+
+    bool load() {
+        auto const load = [this](char const *const name, PackedPattern &pattern) {
+            auto const path = options.corpusDir + '/' + name + ".rle";
+            if(loadPattern(path, pattern)) return true;
+            std::cerr << "can't load " << path << '\n';
+            return false;
+        };
+        PackedPattern rPentomino{ 0, 0 }, acorn{ 0, 0 }, gun{ 0, 0 }, switchEngine{ 0, 0 };
+        if(!load("r-pentomino", rPentomino) || !load("acorn", acorn)
+            || !load("gosper-gun", gun) || !load("switch-engine", switchEngine)) return false;
+        auto const glider = PackedPattern::fromString(".o.\n..o\nooo");
+
+        workloads = {
+            Workload{ "r-pentomino", centered(rPentomino), 0 },
+            Workload{ "acorn", centered(acorn), 0 },
+            Workload{ "gosper-guns", tiled(gun, vec2i(64, 48)), 0 },
+            Workload{ "switch-engine", centered(switchEngine), 0 },
+            Workload{ "soup-50", soup(0.5, 1), 0.5 },
+            Workload{ "soup-10", soup(0.1, 2), 0.1 },
+            Workload{ "sparse-gliders", scattered(glider, 16, 3), 0 },
+        };
+        return true;
+    }
+
+    void run() {
+        std::vector<vec2i> const sizes = options.quick
+            ? std::vector<vec2i>{ vec2i(256, 256), vec2i(250, 250) }
+            : std::vector<vec2i>{ vec2i(512, 512), vec2i(1000, 1000), vec2i(2048, 2048) };
+        auto const generations = options.generations != 0 ? options.generations : (options.quick ? 50 : 500);
+
+        std::vector<uint32_t> threads{ 1 };
+        auto const hardwareThreads = misc::max(1u, std::thread::hardware_concurrency());
+        for(uint32_t t = 2; t <= hardwareThreads && !options.quick; t *= 2) threads.push_back(t);
+        if(hardwareThreads > 1 && threads.back() != hardwareThreads) threads.push_back(hardwareThreads);
+
+        for(auto const &workload : workloads) {
+            if(!options.filter.empty() && workload.name.find(options.filter) == std::string::npos) continue;
+            for(auto const size : sizes) for(auto const t : threads) {
+                runField(workload, size, t, generations);
+                if(workload.soupDensity > 0) runEnsemble(workload, size, t, generations);
+            }
+        }
+    }
+private:
+    void runField(Workload const &workload, vec2i const size, uint32_t const threads, uint64_t const generations) {
+        resetPeakRss();
+        Field field{
+            uint32_t(size.x), uint32_t(size.y), threads,
+            []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); },
+            []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); }
+        };
+        field.setUndoBudget(0);
+        workload.populate(field);
+        auto const finish = [&field]() { while(!field.tryFinishGeneration()) {} };
+        field.startCurGeneration();
+        finish();
+
+        Timer<std::chrono::microseconds> t{};
+        for(uint64_t i = 1; i < generations; i++) {
+            field.startNewGeneration();
+            finish();
+        }
+        auto const seconds = t.elapsedTime() / 1e6;
+
+        results.push_back(CorpusResult{
+            workload.name, "packed", uint32_t(size.x), uint32_t(size.y), threads,
+            generations, seconds, field.generationStats().population, peakRssKiB(), 0
+        });
+    }
+
+    //the same number of cells as independent 32x32 toroidal soups, run until they settle.
+    //Soups that don't settle in `generations` count for the time but not for soups/s
+    void runEnsemble(Workload const &workload, vec2i const size, uint32_t const threads, uint64_t const maxGenerations) {
+        auto const soupsCount = uint32_t(size.x) * uint32_t(size.y) / (Ensemble::maxWidth * Ensemble::maxWidth);
+        if(soupsCount == 0) return;
+        resetPeakRss();
+        Ensemble ensemble{ Ensemble::maxWidth, Ensemble::maxWidth, soupsCount, threads };
+        ensemble.randomize(1, workload.soupDensity);
+
+        Timer<std::chrono::microseconds> t{};
+        auto const generations = ensemble.runUntilSettled(maxGenerations);
+        auto const seconds = t.elapsedTime() / 1e6;
+
+        uint64_t population = 0;
+        for(uint32_t i = 0; i < soupsCount; i++) population += ensemble.population(i);
+        results.push_back(CorpusResult{
+            workload.name, "ensemble-32x32", uint32_t(size.x), uint32_t(size.y), threads,
+            generations, seconds, population, peakRssKiB(), ensemble.settledCount()
+        });
+    }
+};
+
+static void writeTable(std::ostream &out, std::vector<CorpusResult> const &results) {
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-16s %-15s %11s %7s %6s %10s %12s %12s %10s %10s\n",
+        "workload", "engine", "size", "threads", "gens", "gens/s", "Mcells/s", "population", "peak MiB", "soups/s");
+    out << line;
+    for(auto const &r : results) {
+        auto const cells = double(r.width) * r.height * r.generations;
+        char size[32], soups[32] = "-";
+        std::snprintf(size, sizeof(size), "%ux%u", r.width, r.height);
+        if(r.engine != "packed") std::snprintf(soups, sizeof(soups), "%.1f", r.settledSoups / r.seconds);
+        std::snprintf(line, sizeof(line), "%-16s %-15s %11s %7u %6llu %10.1f %12.1f %12llu %10.1f %10s\n",
+            r.workload.c_str(), r.engine.c_str(), size, r.threads, (unsigned long long) r.generations,
+            r.generations / r.seconds, cells / r.seconds / 1e6, (unsigned long long) r.population, r.peakRssKiB / 1024.0, soups);
+        out << line;
+    }
+}
+
+static void writeCsv(std::ostream &out, std::vector<CorpusResult> const &results) {
+    out << "workload,engine,width,height,threads,generations,seconds,generations_per_second,cells_per_second,population,peak_rss_kib,soups_per_second\n";
+    for(auto const &r : results) {
+        auto const cells = double(r.width) * r.height * r.generations;
+        out << r.workload << ',' << r.engine << ',' << r.width << ',' << r.height << ',' << r.threads << ','
+            << r.generations << ',' << r.seconds << ',' << r.generations / r.seconds << ',' << cells / r.seconds << ','
+            << r.population << ',' << r.peakRssKiB << ',' << r.settledSoups / r.seconds << '\n';
+    }
+}
+
+int main(int argc, char **argv) {
+    CorpusOptions options{};
+    for(int i = 1; i < argc; i++) {
+        auto const arg = std::string{ argv[i] };
+        auto const hasValue = i + 1 < argc;
+        if(arg == "--quick") options.quick = true;
+        else if(arg == "--filter" && hasValue) options.filter = argv[++i];
+        else if(arg == "--generations" && hasValue) options.generations = misc::max(1ll, std::atoll(argv[++i]));
+        else if(arg == "--corpus" && hasValue) options.corpusDir = argv[++i];
+        else if(arg == "--csv" && hasValue) options.csv = argv[++i];
+        else if(arg == "--trace" && hasValue) options.trace = argv[++i];
+        else {
+            std::cerr << "usage: gol_corpus [--quick] [--filter <substring>] [--generations <n>] [--corpus <dir>] [--csv <file>] [--trace <file>]\n";
+            return 1;
+        }
+    }
+
+    //Field reports its own timings to std::cout, they would break the table
+    auto const stdoutBuffer = std::cout.rdbuf(nullptr);
+    std::ostream stdoutStream{ stdoutBuffer };
+
+    if(!options.trace.empty()) {
+        trace::setEnabled(true);
+        trace::setThreadName("main");
+    }
+
+    Corpus corpus{ options };
+    if(!corpus.load()) return 1;
+    corpus.run();
+
+    writeTable(stdoutStream, corpus.getResults());
+    if(!options.csv.empty()) {
+        std::ofstream file{ options.csv };
+        writeCsv(file, corpus.getResults());
+    }
+    if(!options.trace.empty()) {
+        std::ofstream file{ options.trace };
+        trace::writeChromeJson(file);
+    }
+    std::cout.rdbuf(stdoutBuffer);
+    return 0;
+}
@@ -18,16 +18,42 @@ uniform vec2 mousePos, zoomPoint;
 uniform uint is2ndBuffer;
 uniform uint bufferOffset_bytes;
 
+//fields larger than a buffer are streamed as tiles around the view (see TileStreaming.h)
+//or as densities of blocks when zoomed out
+uniform uint isTiled;
+uniform uint tileBatches;
+uniform int tileRows;
+uniform int tilesX;
+uniform uint isDensity;
+uniform int densityBlockSize;
+uniform ivec2 densityStart, densitySize, densityLevelSize;
+
 layout(std430, binding = 1) buffer Grid1
 {
-    uint grid[200];
+    uint grid[];
 } packedGrid1;
 
 layout(std430, binding = 2) buffer Grid2
 {
-    uint grid[200];
+    uint grid[];
 } packedGrid2;
 
+layout(std430, binding = 3) buffer Tiles
+{
+    uint tiles[];
+} tilePool;
+
+//slot + 1 of every tile, 0 if it is not in the pool
+layout(std430, binding = 4) buffer PageTable
+{
+    uint entries[];
+} pageTable;
+
+layout(std430, binding = 5) buffer Densities
+{
+    float densities[];
+} densityBlocks;
+
 uint cellAt(const uint index) {
     const uint row = index / gridWidth;
     const uint col = index % gridWidth;
@@ -42,6 +68,23 @@ uint cellAt(const uint index) {
     return ((packedGrid1.grid[arrIndex]) >> arrShift) & 1;
 }
 
+uint tiledCellAt(const ivec2 cell) {
+    const int tileColumns = int(tileBatches) * 32;
+    const uint entry = pageTable.entries[(cell.y / tileRows) * tilesX + cell.x / tileColumns];
+    if(entry == 0) return 0;
+
+    const uint batch = (entry - 1) * tileBatches * uint(tileRows)
+        + uint(cell.y % tileRows) * tileBatches + uint(cell.x % tileColumns) / 32;
+    return (tilePool.tiles[batch] >> (cell.x % 32)) & 1;
+}
+
+float densityAt(const ivec2 cell) {
+    //blocks of the level and the start of the window are in [0; densityLevelSize), % of negative numbers is undefined
+    const ivec2 windowBlock = (cell / densityBlockSize - densityStart + densityLevelSize) % densityLevelSize;
+    if(windowBlock.x >= densitySize.x || windowBlock.y >= densitySize.y) return 0;
+    return densityBlocks.densities[windowBlock.y * densitySize.x + windowBlock.x];
+}
+
 layout(origin_upper_left) in vec4 gl_FragCoord;
 out vec4 color;
 
@@ -75,12 +118,14 @@ vec3 colorForCoords(const vec2 screenCoords) {
     const int cellX = cellInt.x;
     const int cellY = cellInt.y;
 
+    if(isDensity != 0) return mix(bkgColor, cellColor, densityAt(cellInt));
+
     const uint index = cellX + gridWidth * cellY;
 
     float edgeMask = 0;
     if (cellX == 0 || cellX == gridWidth - 1 || cellY == 0 || cellY == gridHeight - 1) edgeMask = .5;
 
-    const uint mask = cellAt(index);
+    const uint mask = isTiled != 0 ? tiledCellAt(cellInt) : cellAt(index);
 
     const bool isCell = mask == 1;
     const bool isNothing = mask == 0;
@@ -0,0 +1,414 @@
+#include"Census.h"
+#include"Grid.h"
+#include"Misc.h"
+#include"Timer.h"
+
+#include<cassert>
+#include<algorithm>
+#include<unordered_map>
+#include<limits>
+
+#include<nmmintrin.h>
+
+struct Census::Run {
+    uint32_t row;
+    uint32_t startColumn, endColumn; //inclusive
+};
+
+enum CensusPhase : int { countRuns, extractRuns, censusObjects };
+
+struct Census::CensusData {
+    Census& census;
+    uint32_t startRow, endRow;
+    uint32_t startObject, endObject;
+    int phase;
+    std::unordered_map<uint64_t, CensusEntry> entries;
+
+    CensusData(Census& census_) :
+        census{ census_ },
+        startRow{ 0 }, endRow{ 0 },
+        startObject{ 0 }, endObject{ 0 },
+        phase{ countRuns },
+        entries{}
+    {}
+
+    void run();
+    void countRowsRuns();
+    void extractRowsRuns();
+    void censusRangeObjects();
+};
+
+static uint64_t mix64(uint64_t z) { //splitmix64 finalizer
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static uint64_t cellHash(int32_t const x, int32_t const y) {
+    //offset so that cell (0, 0) doesn't hash to 0
+    return mix64(((uint64_t(uint32_t(x)) << 32) | uint32_t(y)) + 0x9e3779b97f4a7c15ull);
+}
+
+//order independent hash of the cells in each of the 8 orientations,
+//the smallest one is the same for all orientations of the shape.
+//`forEachCell` calls its argument with every cell relative to the bounding box of size `w` x `h`
+template<class ForEachCell>
+static uint64_t canonicalShapeHash(int32_t const w, int32_t const h, ForEachCell&& forEachCell) {
+    uint64_t sums[8]{};
+    forEachCell([&](int32_t const x, int32_t const y) {
+        auto const rx = w - 1 - x, ry = h - 1 - y;
+        sums[0] += cellHash(x, y);
+        sums[1] += cellHash(rx, y);
+        sums[2] += cellHash(x, ry);
+        sums[3] += cellHash(rx, ry);
+        sums[4] += cellHash(y, x);
+        sums[5] += cellHash(ry, x);
+        sums[6] += cellHash(y, rx);
+        sums[7] += cellHash(ry, rx);
+    });
+
+    auto const dims = cellHash(w, h), dimsTransposed = cellHash(h, w);
+    auto hash = std::numeric_limits<uint64_t>::max();
+    for(int i = 0; i < 8; i++) {
+        hash = misc::min(hash, mix64(sums[i] ^ (i < 4 ? dims : dimsTransposed)));
+    }
+    return hash;
+}
+
+uint64_t Census::shapeHashOf(char const *const pattern) {
+    std::vector<vec2i> cells{};
+    vec2i min{ std::numeric_limits<int32_t>::max() }, max{ std::numeric_limits<int32_t>::min() };
+    int32_t x = 0, y = 0;
+    for(auto c = pattern; *c != '\0'; c++) {
+        if(*c == '\n') { x = 0; y++; continue; }
+        if(*c == 'o' || *c == '*') {
+            cells.push_back(vec2i(x, y));
+            min = vec2i(misc::min(min.x, x), misc::min(min.y, y));
+            max = vec2i(misc::max(max.x, x), misc::max(max.y, y));
+        }
+        x++;
+    }
+    if(cells.empty()) return 0;
+
+    return canonicalShapeHash(max.x - min.x + 1, max.y - min.y + 1, [&](auto&& cell) {
+        for(auto const c : cells) cell(c.x - min.x, c.y - min.y);
+    });
+}
+
+static char const *knownShapeName(uint64_t const hash) {
+    struct KnownShape { uint64_t hash; char const *name; };
+    static std::vector<KnownShape> const shapes = []() {
+        std::pair<char const*, char const*> const patterns[] = {
+            { "block", "oo\noo" },
+            { "blinker", "ooo" },
+            { "beehive", ".oo.\no..o\n.oo." },
+            { "loaf", ".oo.\no..o\n.o.o\n..o." },
+            { "boat", "oo.\no.o\n.o." },
+            { "ship", "oo.\no.o\n.oo" },
+            { "tub", ".o.\no.o\n.o." },
+            { "pond", ".oo.\no..o\no..o\n.oo." },
+            { "glider", ".o.\n..o\nooo" },
+            { "glider", "o.o\n.oo\n.o." },
+        };
+        std::vector<KnownShape> result{};
+        for(auto const& p : patterns) result.push_back({ Census::shapeHashOf(p.second), p.first });
+        return result;
+    }();
+
+    for(auto const& shape : shapes) if(shape.hash == hash) return shape.name;
+    return nullptr;
+}
+
+Census::Census(uint32_t const numberOfTasks_) :
+    width{ 0 }, height{ 0 }, rowLength{ 0 },
+    cells{ nullptr },
+    rowRunsStart{}, runs{}, parent{},
+    objectRunsStart{}, objectRuns{},
+    objects{ 0 },
+    numberOfTasks{ misc::max<uint32_t>(1, numberOfTasks_) },
+    tasks{ new std::unique_ptr<Task<CensusData>>[numberOfTasks] },
+    census{},
+    lastMilliseconds{ 0 }
+{
+    for(uint32_t i = 0; i < numberOfTasks; i++) {
+        tasks.get()[i] = std::unique_ptr<Task<CensusData>>(new Task<CensusData>{
+            [](CensusData& data) { data.run(); },
+            *this
+        });
+    }
+}
+
+Census::~Census() = default;
+
+uint32_t Census::find(uint32_t *const parent, uint32_t index) {
+    while(parent[index] != index) {
+        parent[index] = parent[parent[index]]; //path halving, keeps parent[i] <= i
+        index = parent[index];
+    }
+    return index;
+}
+
+void Census::unite(uint32_t *const parent, uint32_t const a, uint32_t const b) {
+    auto const rootA = find(parent, a), rootB = find(parent, b);
+    if(rootA < rootB) parent[rootB] = rootA;
+    else if(rootB < rootA) parent[rootA] = rootB;
+}
+
+//connects runs of two vertically adjacent rows, runs of each row are sorted by column
+void Census::uniteRows(
+    uint32_t *const parent, Run const *const runs, uint32_t const width,
+    uint32_t const upperStart, uint32_t const upperEnd,
+    uint32_t const lowerStart, uint32_t const lowerEnd
+) {
+    if(upperStart == upperEnd || lowerStart == lowerEnd) return;
+
+    auto upper = upperStart, lower = lowerStart;
+    while(upper < upperEnd && lower < lowerEnd) {
+        auto const& u = runs[upper];
+        auto const& l = runs[lower];
+        //diagonal neighbours count, so runs touch if they overlap after extending by 1
+        if(u.startColumn <= l.endColumn + 1 && l.startColumn <= u.endColumn + 1) unite(parent, upper, lower);
+        if(u.endColumn < l.endColumn) upper++;
+        else lower++;
+    }
+
+    //diagonal neighbours across the left/right edge
+    if(runs[upperEnd - 1].endColumn == width - 1 && runs[lowerStart].startColumn == 0) unite(parent, upperEnd - 1, lowerStart);
+    if(runs[lowerEnd - 1].endColumn == width - 1 && runs[upperStart].startColumn == 0) unite(parent, lowerEnd - 1, upperStart);
+}
+
+void Census::CensusData::run() {
+    if(phase == countRuns) countRowsRuns();
+    else if(phase == extractRuns) extractRowsRuns();
+    else censusRangeObjects();
+}
+
+void Census::CensusData::countRowsRuns() {
+    auto& c = census;
+    auto const batches = misc::intDivCeil(c.width, 32);
+    auto const lastBatchMask = c.width % 32 == 0 ? ~0u : ((1u << (c.width % 32)) - 1);
+
+    for(uint32_t row = startRow; row < endRow; row++) {
+        auto const rowCells = c.cells + row * c.rowLength;
+        uint32_t count = 0;
+        uint32_t carry = 0;
+        for(uint32_t i = 0; i < batches; i++) {
+            auto const batch = rowCells[i] & (i + 1 == batches ? lastBatchMask : ~0u);
+            auto const starts = batch & ~((batch << 1) | carry);
+            count += _mm_popcnt_u32(starts);
+            carry = batch >> 31;
+        }
+        c.rowRunsStart[row + 1] = count;
+    }
+}
+
+void Census::CensusData::extractRowsRuns() {
+    auto& c = census;
+    auto const batches = misc::intDivCeil(c.width, 32);
+    auto const lastBatchMask = c.width % 32 == 0 ? ~0u : ((1u << (c.width % 32)) - 1);
+    auto const runs = c.runs.data();
+    auto const parent = c.parent.data();
+
+    for(uint32_t row = startRow; row < endRow; row++) {
+        auto const rowCells = c.cells + row * c.rowLength;
+        auto const batchAt = [&](uint32_t const i) -> uint32_t {
+            if(i >= batches) return 0;
+            return rowCells[i] & (i + 1 == batches ? lastBatchMask : ~0u);
+        };
+
+        auto const rowStart = c.rowRunsStart[row], rowEnd = c.rowRunsStart[row + 1];
+        auto out = rowStart;
+        uint32_t runStart = 0;
+        uint32_t carry = 0;
+        auto batch = batchAt(0);
+        for(uint32_t i = 0; i < batches; i++) {
+            auto const nextBatch = batchAt(i + 1);
+            auto const starts = batch & ~((batch << 1) | carry);
+            auto const ends = batch & ~((batch >> 1) | (nextBatch << 31));
+            carry = batch >> 31;
+
+            auto events = starts | ends;
+            while(events != 0) {
+                auto const bit = events & (~events + 1);
+                auto const column = i * 32 + __builtin_ctz(events);
+                if(starts & bit) runStart = column;
+                if(ends & bit) {
+                    runs[out] = Run{ row, runStart, column };
+                    parent[out] = out;
+                    out++;
+                }
+                events ^= bit;
+            }
+            batch = nextBatch;
+        }
+        assert(out == rowEnd);
+
+        //the row wraps around
+        if(rowEnd - rowStart >= 2 && runs[rowStart].startColumn == 0 && runs[rowEnd - 1].endColumn == c.width - 1) {
+            unite(parent, rowStart, rowEnd - 1);
+        }
+        if(row != startRow) {
+            uniteRows(parent, runs, c.width, c.rowRunsStart[row - 1], rowStart, rowStart, rowEnd);
+        }
+    }
+}
+
+void Census::CensusData::censusRangeObjects() {
+    auto& c = census;
+    auto const w = int32_t(c.width), h = int32_t(c.height);
+    entries.clear();
+
+    for(uint32_t object = startObject; object < endObject; object++) {
+        auto const first = c.objectRunsStart[object], last = c.objectRunsStart[object + 1];
+
+        //objects crossing the field edges are unwrapped around their first run.
+        //Shapes are exact for objects smaller than half of the field in both dimensions
+        auto const& reference = c.runs[c.objectRuns[first]];
+        auto const unwrap = [&](Run const& run, int32_t& y, int32_t& x) {
+            y = int32_t(run.row) - int32_t(reference.row);
+            if(y > h / 2) y -= h;
+            x = int32_t(run.startColumn) - int32_t(reference.startColumn);
+            if(x > w / 2) x -= w;
+            else if(x < -(w / 2)) x += w;
+        };
+
+        vec2i min{ std::numeric_limits<int32_t>::max() }, max{ std::numeric_limits<int32_t>::min() };
+        uint32_t population = 0;
+        for(auto i = first; i < last; i++) {
+            auto const& run = c.runs[c.objectRuns[i]];
+            int32_t y, x;
+            unwrap(run, y, x);
+            auto const length = int32_t(run.endColumn - run.startColumn) + 1;
+            min = vec2i(misc::min(min.x, x), misc::min(min.y, y));
+            max = vec2i(misc::max(max.x, x + length - 1), misc::max(max.y, y));
+            population += length;
+        }
+
+        auto const objW = max.x - min.x + 1, objH = max.y - min.y + 1;
+        auto const hash = canonicalShapeHash(objW, objH, [&](auto&& cell) {
+            for(auto i = first; i < last; i++) {
+                auto const& run = c.runs[c.objectRuns[i]];
+                int32_t y, x;
+                unwrap(run, y, x);
+                auto const length = int32_t(run.endColumn - run.startColumn) + 1;
+                for(int32_t j = 0; j < length; j++) cell(x + j - min.x, y - min.y);
+            }
+        });
+
+        auto const entry = entries.find(hash);
+        if(entry != entries.end()) entry->second.count++;
+        else entries.emplace(hash, CensusEntry{
+            hash, population, vec2i(misc::min(objW, objH), misc::max(objW, objH)), 1, nullptr
+        });
+    }
+}
+
+void Census::runPhase(int const phase) {
+    for(uint32_t i = 0; i < numberOfTasks; i++) tasks.get()[i]->data.phase = phase;
+    for(uint32_t i = 0; i < numberOfTasks; i++) tasks.get()[i]->start();
+    for(uint32_t i = 0; i < numberOfTasks; i++) tasks.get()[i]->waitForResult();
+}
+
+void Census::unionBandBoundaries() {
+    auto const parent_ = parent.data();
+    for(uint32_t i = 0; i < numberOfTasks; i++) {
+        auto const row = tasks.get()[i]->data.startRow;
+        if(row == tasks.get()[i]->data.endRow) continue;
+        //first row of the field is connected to the last one
+        if(row == 0 && height < 2) continue;
+        auto const prevRow = row == 0 ? height - 1 : row - 1;
+        uniteRows(
+            parent_, runs.data(), width,
+            rowRunsStart[prevRow], rowRunsStart[prevRow + 1],
+            rowRunsStart[row], rowRunsStart[row + 1]
+        );
+    }
+}
+
+void Census::labelObjects() {
+    auto const runsCount = uint32_t(runs.size());
+
+    //parent[i] <= i, so when run `i` is reached its parent is already replaced by the label of the root.
+    //parent is reused to store labels
+    objects = 0;
+    for(uint32_t i = 0; i < runsCount; i++) {
+        parent[i] = parent[i] == i ? objects++ : parent[parent[i]];
+    }
+
+    //counting sort of runs by object, runs of each object stay sorted by row
+    objectRunsStart.assign(objects + 1, 0);
+    for(uint32_t i = 0; i < runsCount; i++) objectRunsStart[parent[i] + 1]++;
+    for(uint32_t i = 0; i < objects; i++) objectRunsStart[i + 1] += objectRunsStart[i];
+    objectRuns.resize(runsCount);
+    for(uint32_t i = 0; i < runsCount; i++) objectRuns[objectRunsStart[parent[i]]++] = i;
+    for(uint32_t i = objects; i > 0; i--) objectRunsStart[i] = objectRunsStart[i - 1];
+    objectRunsStart[0] = 0;
+}
+
+void Census::mergeEntries() {
+    std::unordered_map<uint64_t, CensusEntry> merged{};
+    for(uint32_t i = 0; i < numberOfTasks; i++) {
+        for(auto const& e : tasks.get()[i]->data.entries) {
+            auto const entry = merged.find(e.first);
+            if(entry != merged.end()) entry->second.count += e.second.count;
+            else merged.emplace(e.first, e.second);
+        }
+    }
+
+    census.clear();
+    census.reserve(merged.size());
+    for(auto& e : merged) {
+        e.second.name = knownShapeName(e.first);
+        census.push_back(e.second);
+    }
+    std::sort(census.begin(), census.end(), [](CensusEntry const& a, CensusEntry const& b) {
+        if(a.count != b.count) return a.count > b.count;
+        if(a.population != b.population) return a.population < b.population;
+        return a.shapeHash < b.shapeHash;
+    });
+}
+
+void Census::run(Field const &field) {
+    run(field.rawData(), field.width(), field.height(), field.width_actual() / 32);
+}
+
+void Census::run(uint32_t const *const cells_, uint32_t const width_, uint32_t const height_, uint32_t const rowLength_) {
+    assert(width_ >= 1 && height_ >= 1 && rowLength_ * 32 >= width_);
+    Timer<> t{};
+
+    cells = cells_;
+    width = width_;
+    height = height_;
+    rowLength = rowLength_;
+
+    uint32_t rowsBefore = 0;
+    for(uint32_t i = 0; i < numberOfTasks; i++) {
+        auto const rows = (height - rowsBefore) / (numberOfTasks - i);
+        tasks.get()[i]->data.startRow = rowsBefore;
+        tasks.get()[i]->data.endRow = rowsBefore + rows;
+        rowsBefore += rows;
+    }
+
+    rowRunsStart.assign(height + 1, 0);
+    runPhase(countRuns);
+    for(uint32_t row = 0; row < height; row++) rowRunsStart[row + 1] += rowRunsStart[row];
+
+    runs.resize(rowRunsStart[height]);
+    parent.resize(rowRunsStart[height]);
+    runPhase(extractRuns);
+    unionBandBoundaries();
+
+    labelObjects();
+
+    uint32_t objectsBefore = 0;
+    for(uint32_t i = 0; i < numberOfTasks; i++) {
+        auto const count = (objects - objectsBefore) / (numberOfTasks - i);
+        tasks.get()[i]->data.startObject = objectsBefore;
+        tasks.get()[i]->data.endObject = objectsBefore + count;
+        objectsBefore += count;
+    }
+    runPhase(censusObjects);
+    mergeEntries();
+
+    lastMilliseconds = t.elapsedTime() / 1000.0;
+}
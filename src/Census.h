@@ -0,0 +1,74 @@
+#pragma once
+
+#include<stdint.h>
+#include<memory>
+#include<vector>
+#include"Task.h"
+#include"Vector.h"
+
+class Field;
+
+//splits a toroidal packed field into objects (8-connected groups of alive cells)
+//and counts objects of the same shape together.
+//Objects are identified up to rotations and reflections
+struct CensusEntry {
+    uint64_t shapeHash; //same for all orientations of the shape
+    uint32_t population;
+    vec2i size; //bounding box, width <= height
+    uint64_t count;
+    char const *name; //nullptr if the shape is not a known common object
+};
+
+class Census final {
+public:
+    struct CensusData;
+    struct Run;
+private:
+    uint32_t width, height, rowLength;
+    uint32_t const *cells;
+
+    std::vector<uint32_t> rowRunsStart; //[height + 1], runs of row `r` are [rowRunsStart[r], rowRunsStart[r+1])
+    std::vector<Run> runs;
+    std::vector<uint32_t> parent; //union-find forest over runs, parent[i] <= i
+    std::vector<uint32_t> objectRunsStart; //[objectsCount + 1]
+    std::vector<uint32_t> objectRuns; //runs sorted by object
+    uint32_t objects;
+
+    const uint32_t numberOfTasks;
+    std::unique_ptr<std::unique_ptr<Task<CensusData>>[/*numberOfTasks*/]> tasks;
+
+    std::vector<CensusEntry> census;
+    double lastMilliseconds;
+public:
+    Census(uint32_t const numberOfTasks_ = 1);
+    ~Census();
+
+    Census(Census const&) = delete;
+    Census& operator=(Census const&) = delete;
+public:
+    //field must not be updating during the call
+    void run(Field const &field);
+    //`cells` is `height` rows of `rowLength` batches, bits past `width` in each row are ignored
+    void run(uint32_t const *const cells_, uint32_t const width_, uint32_t const height_, uint32_t const rowLength_);
+
+    uint32_t objectsCount() const { return objects; }
+    //distinct shapes of the last run, most common first
+    std::vector<CensusEntry> const &entries() const { return census; }
+    double milliseconds() const { return lastMilliseconds; }
+
+    //hash of the shape given as rows of 'o'/'*' (alive) and '.' (dead) separated by '\n'
+    static uint64_t shapeHashOf(char const *const pattern);
+private:
+    void runPhase(int const phase);
+    void unionBandBoundaries();
+    void labelObjects();
+    void mergeEntries();
+
+    static uint32_t find(uint32_t *const parent, uint32_t index);
+    static void unite(uint32_t *const parent, uint32_t const a, uint32_t const b);
+    static void uniteRows(
+        uint32_t *const parent, Run const *const runs, uint32_t const width,
+        uint32_t const upperStart, uint32_t const upperEnd,
+        uint32_t const lowerStart, uint32_t const lowerEnd
+    );
+};
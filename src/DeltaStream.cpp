@@ -0,0 +1,378 @@
+#include"DeltaStream.h"
+#include"Misc.h"
+
+#include<cassert>
+#include<chrono>
+#include<cstdlib>
+#include<cstring>
+
+using namespace deltaStream;
+
+static void appendBytes(std::vector<uint8_t> &out, void const *const data, size_t const size) {
+    auto const bytes = static_cast<uint8_t const*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+static void appendVarint(std::vector<uint8_t> &out, uint32_t value) {
+    while(value >= 0x80) {
+        out.push_back(uint8_t(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+}
+
+static bool readVarint(uint8_t const *&data, uint8_t const *const end, uint32_t &value) {
+    value = 0;
+    for(uint32_t shift = 0; shift < 35 && data != end; shift += 7) {
+        auto const byte = *data++;
+        value |= uint32_t(byte & 0x7f) << shift;
+        if((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+//false if the connection is closed or broken, or a part doesn't arrive within `timeoutMs`
+static bool receiveExactly(net::SocketHandle const socket, void *const data, size_t const size, int32_t const timeoutMs) {
+    auto const bytes = static_cast<uint8_t*>(data);
+    size_t received = 0;
+    while(received < size) {
+        if(!net::waitReadable(socket, timeoutMs)) return false;
+        auto const count = net::receive(socket, bytes + received, size - received);
+        if(count <= 0) return false;
+        received += size_t(count);
+    }
+    return true;
+}
+
+struct DeltaStreamServer::Subscriber {
+    net::SocketHandle socket;
+    std::thread thread;
+    std::atomic_bool isFinished;
+
+    ViewportInfo info;
+    bool isNewViewport;
+    std::vector<uint32_t> current; //cells of the viewport being sent
+    std::vector<uint32_t> sent; //cells of the viewport the subscriber has
+    std::vector<uint8_t> message; //reused for every message
+
+    explicit Subscriber(net::SocketHandle const socket_) :
+        socket{ socket_ }, thread{}, isFinished{ false },
+        info{}, isNewViewport{ false },
+        current{}, sent{}, message{}
+    {}
+};
+
+DeltaStreamServer::DeltaStreamServer(uint32_t const width_, uint32_t const height_, uint32_t const rowLength_, uint32_t const maxSubscribers_) :
+    width{ width_ }, height{ height_ }, rowLength{ rowLength_ },
+    maxSubscribers{ misc::max<uint32_t>(1, maxSubscribers_) },
+    mutex{},
+    publishedCondition{},
+    latest(size_t(rowLength_) * height_, 0),
+    latestGeneration{ 0 }, publications{ 0 },
+    isStopped{ true },
+    listener{ net::invalidSocket },
+    thread{},
+    subscribers{},
+    activeSubscribers{ 0 },
+    messages{ 0 }, sentBytes{ 0 }, skipped{ 0 }
+{
+    assert(rowLength * 32 >= width);
+}
+
+DeltaStreamServer::~DeltaStreamServer() {
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        isStopped.store(true);
+    }
+    publishedCondition.notify_all();
+    if(thread.joinable()) thread.join();
+    net::close(listener);
+}
+
+bool DeltaStreamServer::start(uint16_t const port) {
+    if(thread.joinable()) return false;
+    listener = net::listenLocal(port);
+    if(listener == net::invalidSocket) return false;
+    isStopped.store(false);
+    thread = std::thread{ &DeltaStreamServer::acceptSubscribers, this };
+    return true;
+}
+
+uint16_t DeltaStreamServer::port() const {
+    return listener == net::invalidSocket ? 0 : net::localPort(listener);
+}
+
+void DeltaStreamServer::publish(uint32_t const *const cells, uint64_t const generation) {
+    auto const lastBatchMask = width % 32 == 0 ? ~0u : (1u << (width % 32)) - 1;
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        for(uint32_t row = 0; row < height; row++) {
+            auto const start = size_t(row) * rowLength;
+            std::memcpy(latest.data() + start, cells + start, rowLength * sizeof(uint32_t));
+            latest[start + rowLength - 1] &= lastBatchMask;
+        }
+        latestGeneration = generation;
+        publications++;
+    }
+    publishedCondition.notify_all();
+}
+
+void DeltaStreamServer::acceptSubscribers() {
+    while(!isStopped.load()) {
+        for(size_t i = 0; i < subscribers.size();) {
+            auto &subscriber = *subscribers[i];
+            if(!subscriber.isFinished.load()) {
+                i++;
+                continue;
+            }
+            subscriber.thread.join();
+            net::close(subscriber.socket);
+            subscribers.erase(subscribers.begin() + i);
+        }
+
+        auto const client = net::accept(listener, 100);
+        if(client == net::invalidSocket) continue;
+        if(subscribers.size() >= maxSubscribers) {
+            net::close(client);
+            continue;
+        }
+        subscribers.emplace_back(new Subscriber{ client });
+        activeSubscribers.fetch_add(1, std::memory_order_relaxed);
+        auto &subscriber = *subscribers.back();
+        subscriber.thread = std::thread{ &DeltaStreamServer::serve, this, std::ref(subscriber) };
+    }
+
+    //subscribers blocked on slow connections are woken up
+    for(auto const &subscriber : subscribers) net::shutdown(subscriber->socket);
+    for(auto const &subscriber : subscribers) {
+        subscriber->thread.join();
+        net::close(subscriber->socket);
+    }
+    subscribers.clear();
+}
+
+bool DeltaStreamServer::readRequest(Subscriber &subscriber) {
+    SubscribeRequest request{};
+    if(!receiveExactly(subscriber.socket, &request, sizeof(request), 1000) || request.magic != magic) return false;
+
+    auto const viewport = request.viewport;
+    auto const isWhole = viewport.width == 0 || viewport.height == 0;
+    auto const startX = isWhole ? 0 : misc::min(viewport.x, width - 1);
+    auto const startY = isWhole ? 0 : misc::min(viewport.y, height - 1);
+    auto const endX = isWhole ? width : uint32_t(misc::min<uint64_t>(uint64_t(startX) + viewport.width, width));
+    auto const endY = isWhole ? height : uint32_t(misc::min<uint64_t>(uint64_t(startY) + viewport.height, height));
+
+    auto &info = subscriber.info;
+    info.fieldWidth = width;
+    info.fieldHeight = height;
+    info.firstBatch = startX / 32;
+    info.firstRow = startY;
+    info.batchesCount = misc::intDivCeil(endX, 32) - info.firstBatch;
+    info.rowsCount = endY - startY;
+    auto const viewportLength = size_t(info.batchesCount) * info.rowsCount;
+    subscriber.current.resize(viewportLength);
+    subscriber.sent.resize(viewportLength);
+    subscriber.isNewViewport = true;
+    return true;
+}
+
+void DeltaStreamServer::serve(Subscriber &subscriber) {
+    uint64_t sentPublication = 0;
+    auto isOpen = readRequest(subscriber);
+    while(isOpen && !isStopped.load()) {
+        //a closed connection is readable too, then readRequest() fails
+        if(net::waitReadable(subscriber.socket, 0) && !readRequest(subscriber)) break;
+
+        uint64_t generation = 0;
+        {
+            std::unique_lock<std::mutex> lock{ mutex };
+            auto const isReady = [&]() {
+                return publications != 0 && (publications != sentPublication || subscriber.isNewViewport);
+            };
+            //wakes up from time to time to read new requests
+            publishedCondition.wait_for(lock, std::chrono::milliseconds(50), [&]() { return isStopped.load() || isReady(); });
+            if(isStopped.load() || !isReady()) continue;
+
+            if(sentPublication != 0 && publications > sentPublication + 1) {
+                skipped.fetch_add(publications - sentPublication - 1, std::memory_order_relaxed);
+            }
+            sentPublication = publications;
+            generation = latestGeneration;
+            auto const &info = subscriber.info;
+            for(uint32_t row = 0; row < info.rowsCount; row++) {
+                std::memcpy(
+                    subscriber.current.data() + size_t(row) * info.batchesCount,
+                    latest.data() + size_t(info.firstRow + row) * rowLength + info.firstBatch,
+                    info.batchesCount * sizeof(uint32_t)
+                );
+            }
+        }
+
+        auto &message = subscriber.message;
+        auto const &current = subscriber.current, &sent = subscriber.sent;
+        auto const keyframeBytes = uint32_t(current.size() * sizeof(uint32_t));
+        uint64_t messagesCount = 1;
+        message.clear();
+
+        auto isKeyframe = subscriber.isNewViewport;
+        if(subscriber.isNewViewport) {
+            MessageHeader const header{ MessageKind::viewport, uint32_t(sizeof(ViewportInfo)), generation };
+            appendBytes(message, &header, sizeof(header));
+            appendBytes(message, &subscriber.info, sizeof(ViewportInfo));
+            subscriber.isNewViewport = false;
+            messagesCount++;
+        }
+        if(!isKeyframe) {
+            MessageHeader header{ MessageKind::delta, 0, generation };
+            appendBytes(message, &header, sizeof(header));
+            uint32_t unchanged = 0;
+            for(size_t i = 0; i < current.size();) {
+                if(current[i] == sent[i]) {
+                    unchanged++;
+                    i++;
+                    continue;
+                }
+                auto end = i + 1;
+                while(end < current.size() && current[end] != sent[end]) end++;
+                appendVarint(message, unchanged);
+                appendVarint(message, uint32_t(end - i));
+                appendBytes(message, current.data() + i, (end - i) * sizeof(uint32_t));
+                unchanged = 0;
+                i = end;
+            }
+            header.payloadBytes = uint32_t(message.size() - sizeof(header));
+            //runs would take more space than the cells
+            if(header.payloadBytes >= keyframeBytes) {
+                message.clear();
+                isKeyframe = true;
+            }
+            else std::memcpy(message.data(), &header, sizeof(header));
+        }
+        if(isKeyframe) {
+            MessageHeader const header{ MessageKind::keyframe, keyframeBytes, generation };
+            appendBytes(message, &header, sizeof(header));
+            appendBytes(message, current.data(), keyframeBytes);
+        }
+
+        if(!net::sendAll(subscriber.socket, message.data(), message.size())) break;
+        messages.fetch_add(messagesCount, std::memory_order_relaxed);
+        sentBytes.fetch_add(message.size(), std::memory_order_relaxed);
+        std::swap(subscriber.current, subscriber.sent);
+    }
+    activeSubscribers.fetch_sub(1, std::memory_order_relaxed);
+    subscriber.isFinished.store(true);
+}
+
+DeltaStreamClient::DeltaStreamClient() :
+    socket{ net::invalidSocket },
+    info{},
+    current{},
+    payload{},
+    isViewportKnown{ false }, hasKeyframe{ false },
+    currentGeneration{ 0 },
+    received{ 0 }, receivedBytes{ 0 }, skippedGenerations{ 0 }
+{}
+
+DeltaStreamClient::~DeltaStreamClient() {
+    disconnect();
+}
+
+void DeltaStreamClient::disconnect() {
+    net::close(socket);
+    socket = net::invalidSocket;
+}
+
+bool DeltaStreamClient::connect(uint16_t const port, Viewport const viewport) {
+    if(isConnected()) return false;
+    socket = net::connectLocal(port);
+    if(socket == net::invalidSocket) return false;
+    return subscribe(viewport);
+}
+
+bool DeltaStreamClient::subscribe(Viewport const viewport) {
+    SubscribeRequest const request{ magic, viewport };
+    if(!isConnected()) return false;
+    if(!net::sendAll(socket, &request, sizeof(request))) {
+        disconnect();
+        return false;
+    }
+    return true;
+}
+
+bool DeltaStreamClient::receive(int32_t const timeoutMs) {
+    if(!isConnected() || !net::waitReadable(socket, timeoutMs)) return false;
+
+    MessageHeader header{};
+    auto const maxPayloadBytes = misc::max(sizeof(ViewportInfo), current.size() * sizeof(uint32_t));
+    auto isValid = receiveExactly(socket, &header, sizeof(header), 1000) && header.payloadBytes <= maxPayloadBytes;
+    if(isValid) {
+        payload.resize(header.payloadBytes);
+        isValid = receiveExactly(socket, payload.data(), payload.size(), 1000);
+    }
+
+    auto const hadCells = hasKeyframe;
+    if(isValid) switch(header.kind) {
+        case MessageKind::viewport: {
+            isValid = payload.size() == sizeof(ViewportInfo);
+            if(!isValid) break;
+            std::memcpy(&info, payload.data(), sizeof(info));
+            isValid = info.firstBatch + uint64_t(info.batchesCount) <= misc::intDivCeil(info.fieldWidth, 32)
+                && info.firstRow + uint64_t(info.rowsCount) <= info.fieldHeight;
+            if(!isValid) break;
+            current.assign(size_t(info.batchesCount) * info.rowsCount, 0);
+            isViewportKnown = true;
+            hasKeyframe = false;
+        } break;
+        case MessageKind::keyframe: {
+            isValid = isViewportKnown && payload.size() == current.size() * sizeof(uint32_t);
+            if(!isValid) break;
+            std::memcpy(current.data(), payload.data(), payload.size());
+            hasKeyframe = true;
+        } break;
+        case MessageKind::delta: {
+            isValid = hasKeyframe;
+            auto data = static_cast<uint8_t const*>(payload.data());
+            auto const end = data + payload.size();
+            size_t position = 0;
+            while(isValid && data != end) {
+                uint32_t unchanged, count;
+                isValid = readVarint(data, end, unchanged) && readVarint(data, end, count)
+                    && position + unchanged + count <= current.size()
+                    && size_t(end - data) >= count * sizeof(uint32_t);
+                if(!isValid) break;
+                position += unchanged;
+                std::memcpy(current.data() + position, data, count * sizeof(uint32_t));
+                position += count;
+                data += count * sizeof(uint32_t);
+            }
+        } break;
+        default: isValid = false;
+    }
+    if(!isValid) {
+        disconnect();
+        hasKeyframe = false;
+        return false;
+    }
+
+    if(header.kind != MessageKind::viewport) {
+        if(hadCells && header.generation > currentGeneration + 1) skippedGenerations += header.generation - currentGeneration - 1;
+        currentGeneration = header.generation;
+    }
+    received++;
+    receivedBytes += sizeof(header) + header.payloadBytes;
+    return true;
+}
+
+bool DeltaStreamClient::cellAt(uint32_t const x, uint32_t const y) const {
+    assert(hasKeyframe && x / 32 >= info.firstBatch && x / 32 < info.firstBatch + info.batchesCount);
+    assert(y >= info.firstRow && y < info.firstRow + info.rowsCount);
+    auto const batch = current[size_t(y - info.firstRow) * info.batchesCount + x / 32 - info.firstBatch];
+    return (batch >> (x % 32)) & 1;
+}
+
+uint16_t streamPortFromEnvironment() {
+    auto const value = std::getenv("GOL_STREAM_PORT");
+    if(value == nullptr) return 0;
+    auto const port = std::atoi(value);
+    return port > 0 && port < 65536 ? uint16_t(port) : 0;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include<stdint.h>
+#include<atomic>
+#include<condition_variable>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include<vector>
+#include"Socket.h"
+
+//stream of generations over TCP on 127.0.0.1. A subscriber sends a SubscribeRequest for a viewport
+//of the field at any time, the server answers with a `viewport` message, a keyframe of the cells in it,
+//then one `delta` message per generation with the batches that changed since the previous message.
+//A subscriber that reads slower than generations are published gets the latest one, skipping the rest.
+//Everything is little-endian. Cells are packed as in the field: column `x` is bit `x % 32` of batch `x / 32`,
+//a viewport is `rowsCount` rows of `batchesCount` batches starting at batch `firstBatch` of row `firstRow`,
+//bits past the field width are 0
+namespace deltaStream {
+    static constexpr uint32_t magic = 0x534c4f47; //"GOLS"
+
+    //in cells, width or height 0 is the whole field. Rounded to whole batches and clamped to the field
+    struct Viewport {
+        uint32_t x, y, width, height;
+    };
+
+    struct SubscribeRequest {
+        uint32_t magic;
+        Viewport viewport;
+    };
+
+    enum class MessageKind : uint32_t {
+        viewport, //payload is ViewportInfo
+        keyframe, //payload is every batch of the viewport
+        delta //payload is runs of changed batches: varint unchanged batches before the run, varint run length, its batches
+    };
+
+    struct MessageHeader {
+        MessageKind kind;
+        uint32_t payloadBytes;
+        uint64_t generation;
+    };
+
+    struct ViewportInfo {
+        uint32_t fieldWidth, fieldHeight;
+        uint32_t firstBatch, firstRow;
+        uint32_t batchesCount, rowsCount;
+    };
+}
+
+class DeltaStreamServer final {
+    struct Subscriber;
+
+    uint32_t width, height, rowLength;
+    uint32_t maxSubscribers;
+
+    std::mutex mutex;
+    std::condition_variable publishedCondition;
+    std::vector<uint32_t> latest; //guarded by `mutex`, bits past the width are 0
+    uint64_t latestGeneration, publications; //guarded by `mutex`
+
+    std::atomic_bool isStopped;
+    net::SocketHandle listener;
+    std::thread thread;
+    std::vector<std::unique_ptr<Subscriber>> subscribers; //only used by the accepting thread
+
+    std::atomic<uint32_t> activeSubscribers;
+    std::atomic<uint64_t> messages, sentBytes, skipped;
+public:
+    DeltaStreamServer(uint32_t const width_, uint32_t const height_, uint32_t const rowLength_, uint32_t const maxSubscribers_ = 16);
+    ~DeltaStreamServer();
+
+    DeltaStreamServer(DeltaStreamServer const&) = delete;
+    DeltaStreamServer& operator=(DeltaStreamServer const&) = delete;
+
+    //returns false if the port can't be used
+    bool start(uint16_t const port);
+    uint16_t port() const;
+
+    //from one thread only. Copies `cells`, subscribers are sent it from their own threads
+    void publish(uint32_t const *const cells, uint64_t const generation);
+
+    uint32_t subscribersCount() const { return activeSubscribers.load(std::memory_order_relaxed); }
+    uint64_t messagesCount() const { return messages.load(std::memory_order_relaxed); }
+    uint64_t bytesCount() const { return sentBytes.load(std::memory_order_relaxed); }
+    //publications that subscribers didn't get because they were still sending an earlier one
+    uint64_t skippedCount() const { return skipped.load(std::memory_order_relaxed); }
+private:
+    void acceptSubscribers();
+    void serve(Subscriber &subscriber);
+    bool readRequest(Subscriber &subscriber);
+};
+
+//subscriber keeping its own copy of the cells of its viewport
+class DeltaStreamClient final {
+    net::SocketHandle socket;
+    deltaStream::ViewportInfo info;
+    std::vector<uint32_t> current;
+    std::vector<uint8_t> payload; //reused by receive()
+    bool isViewportKnown, hasKeyframe;
+    uint64_t currentGeneration;
+    uint64_t received, receivedBytes, skippedGenerations;
+public:
+    DeltaStreamClient();
+    ~DeltaStreamClient();
+
+    DeltaStreamClient(DeltaStreamClient const&) = delete;
+    DeltaStreamClient& operator=(DeltaStreamClient const&) = delete;
+
+    //false if there is no server on `port`
+    bool connect(uint16_t const port, deltaStream::Viewport const viewport);
+    //asks for another viewport, cells are unavailable until its keyframe is received
+    bool subscribe(deltaStream::Viewport const viewport);
+    //waits up to `timeoutMs` for a message and applies it. False on timeout or if the connection is closed or broken
+    bool receive(int32_t const timeoutMs);
+
+    bool isConnected() const { return socket != net::invalidSocket; }
+    //true once the keyframe of the current viewport is received
+    bool isSynchronized() const { return hasKeyframe; }
+    deltaStream::ViewportInfo const &viewport() const { return info; }
+    std::vector<uint32_t> const &cells() const { return current; }
+    //cell of the field at (`x`, `y`), which must be inside the viewport
+    bool cellAt(uint32_t const x, uint32_t const y) const;
+    uint64_t generation() const { return currentGeneration; }
+
+    uint64_t messagesCount() const { return received; }
+    uint64_t bytesCount() const { return receivedBytes; }
+    //generations between consecutive messages that were not received
+    uint64_t skippedCount() const { return skippedGenerations; }
+private:
+    void disconnect();
+};
+
+//port of the stream from the GOL_STREAM_PORT environment variable, 0 if it is not set
+uint16_t streamPortFromEnvironment();
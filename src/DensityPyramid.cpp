@@ -0,0 +1,144 @@
+#include"DensityPyramid.h"
+#include"Misc.h"
+
+#include<algorithm>
+#include<cmath>
+#include<nmmintrin.h>
+
+static constexpr uint32_t batchLength = 32;
+static constexpr uint32_t blocksInBatch = batchLength >> DensityPyramid::minLevel;
+static constexpr uint32_t groupRows = 1u << DensityPyramid::minLevel;
+
+DensityPyramid::DensityPyramid(uint32_t const width_, uint32_t const height_, uint32_t const rowLength_) :
+    width{ width_ }, height{ height_ }, rowLength{ rowLength_ },
+    levels{},
+    dirtyGroups{},
+    dirtyBlocks{}
+{
+    for(uint32_t level = minLevel;; level++) {
+        auto const size = levelSize(level);
+        levels.push_back(std::vector<uint32_t>(size_t(size.x) * size.y, 0));
+        if(size.x == 1 && size.y == 1) break;
+    }
+}
+
+vec2i DensityPyramid::levelSize(uint32_t const level) const {
+    auto const side = uint64_t(1) << level;
+    return vec2i(int32_t((width + side - 1) / side), int32_t((height + side - 1) / side));
+}
+
+uint32_t DensityPyramid::aliveCells(uint32_t const level, int32_t const blockX, int32_t const blockY) const {
+    return levels[level - minLevel][size_t(blockY) * levelSize(level).x + blockX];
+}
+
+uint32_t DensityPyramid::blockArea(uint32_t const level, int32_t const blockX, int32_t const blockY) const {
+    auto const side = uint64_t(1) << level;
+    auto const blockWidth = misc::min<uint64_t>(side, width - blockX * side);
+    auto const blockHeight = misc::min<uint64_t>(side, height - blockY * side);
+    return uint32_t(blockWidth * blockHeight);
+}
+
+uint32_t DensityPyramid::levelFor(double const cellsPerPixel) const {
+    if(!(cellsPerPixel >= double(1u << minLevel))) return minLevel;
+    return misc::min(maxLevel(), uint32_t(std::floor(std::log2(cellsPerPixel))));
+}
+
+void DensityPyramid::countGroup(uint32_t const *const cells, uint32_t const group) {
+    auto const blockY = group / rowLength, batch = group % rowLength;
+    auto const lastMask = width % batchLength == 0 ? ~0u : ((1u << (width % batchLength)) - 1);
+    auto const mask = batch == rowLength - 1 ? lastMask : ~0u;
+
+    uint32_t counts[blocksInBatch]{};
+    auto const endRow = misc::min(blockY * groupRows + groupRows, height);
+    for(auto row = blockY * groupRows; row < endRow; row++) {
+        auto const batchCells = cells[row * rowLength + batch] & mask;
+        for(uint32_t i = 0; i < blocksInBatch; i++) {
+            counts[i] += _mm_popcnt_u32((batchCells >> (i * groupRows)) & ((1u << groupRows) - 1));
+        }
+    }
+
+    auto const levelWidth = uint32_t(levelSize(minLevel).x);
+    auto &blocks = levels[0];
+    for(uint32_t i = 0; i < blocksInBatch; i++) {
+        auto const blockX = batch * blocksInBatch + i;
+        if(blockX < levelWidth) blocks[blockY * levelWidth + blockX] = counts[i];
+    }
+}
+
+uint32_t DensityPyramid::sumChildren(uint32_t const level, int32_t const blockX, int32_t const blockY) const {
+    auto const childSize = levelSize(level - 1);
+    auto const &children = levels[level - 1 - minLevel];
+    uint32_t sum = 0;
+    for(auto y = blockY * 2; y < misc::min(blockY * 2 + 2, childSize.y); y++) {
+        for(auto x = blockX * 2; x < misc::min(blockX * 2 + 2, childSize.x); x++) {
+            sum += children[size_t(y) * childSize.x + x];
+        }
+    }
+    return sum;
+}
+
+void DensityPyramid::rebuild(uint32_t const *const cells) {
+    auto const groups = misc::intDivCeil(height, groupRows) * rowLength;
+    for(uint32_t group = 0; group < groups; group++) countGroup(cells, group);
+
+    for(auto level = minLevel + 1; level <= maxLevel(); level++) {
+        auto const size = levelSize(level);
+        auto &blocks = levels[level - minLevel];
+        for(int32_t y = 0; y < size.y; y++) for(int32_t x = 0; x < size.x; x++) {
+            blocks[size_t(y) * size.x + x] = sumChildren(level, x, y);
+        }
+    }
+}
+
+void DensityPyramid::update(uint32_t const *const cells, uint32_t const *const batches, size_t const count) {
+    if(count == 0) return;
+
+    dirtyGroups.clear();
+    for(size_t i = 0; i < count; i++) {
+        auto const row = batches[i] / rowLength, batch = batches[i] % rowLength;
+        dirtyGroups.push_back(row / groupRows * rowLength + batch);
+    }
+    std::sort(dirtyGroups.begin(), dirtyGroups.end());
+    dirtyGroups.erase(std::unique(dirtyGroups.begin(), dirtyGroups.end()), dirtyGroups.end());
+
+    //blocks of the level above the counted one, then of every next level
+    dirtyBlocks.clear();
+    auto const firstSize = levelSize(minLevel);
+    for(auto const group : dirtyGroups) {
+        countGroup(cells, group);
+        auto const blockY = group / rowLength, batch = group % rowLength;
+        for(uint32_t i = 0; i < blocksInBatch; i += 2) {
+            auto const blockX = batch * blocksInBatch + i;
+            if(blockX < uint32_t(firstSize.x)) dirtyBlocks.push_back(blockY / 2 * misc::intDivCeil(firstSize.x, 2) + blockX / 2);
+        }
+    }
+
+    auto &parents = dirtyGroups; //counted groups are not needed anymore
+    for(auto level = minLevel + 1; level <= maxLevel(); level++) {
+        std::sort(dirtyBlocks.begin(), dirtyBlocks.end());
+        dirtyBlocks.erase(std::unique(dirtyBlocks.begin(), dirtyBlocks.end()), dirtyBlocks.end());
+
+        auto const size = levelSize(level);
+        auto const parentsWidth = misc::intDivCeil(size.x, 2);
+        auto &blocks = levels[level - minLevel];
+        parents.clear();
+        for(auto const block : dirtyBlocks) {
+            auto const x = int32_t(block % size.x), y = int32_t(block / size.x);
+            blocks[block] = sumChildren(level, x, y);
+            parents.push_back(uint32_t(y / 2) * parentsWidth + uint32_t(x / 2));
+        }
+        std::swap(dirtyBlocks, parents);
+    }
+}
+
+void DensityPyramid::readDensity(uint32_t const level, vec2i const start, vec2i const size, float *const out) const {
+    auto const blocksSize = levelSize(level);
+    auto const &blocks = levels[level - minLevel];
+    for(int32_t y = 0; y < size.y; y++) {
+        auto const blockY = misc::mod(start.y + y, blocksSize.y);
+        for(int32_t x = 0; x < size.x; x++) {
+            auto const blockX = misc::mod(start.x + x, blocksSize.x);
+            out[size_t(y) * size.x + x] = float(blocks[size_t(blockY) * blocksSize.x + blockX]) / blockArea(level, blockX, blockY);
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include<stdint.h>
+#include<stddef.h>
+#include<vector>
+#include"Vector.h"
+
+//alive cells counted in square blocks of 2^level cells for every level from minLevel
+//up to the level with a single block, computed from cells packed the same way as rows of the field.
+//Blocks at the right and bottom edges are cut by the field size.
+//A view of any zoom is then read in O(pixels) from the level with blocks closest to the pixel size
+class DensityPyramid final {
+public:
+    static constexpr uint32_t minLevel = 3; //blocks of 8x8 cells, a batch has 4 of them in a row
+private:
+    uint32_t width, height, rowLength;
+    std::vector<std::vector<uint32_t>> levels; //[level - minLevel], alive cells per block, rows of blocks
+
+    //reused by update()
+    std::vector<uint32_t> dirtyGroups; //8 rows of a batch: (row / 8) * rowLength + batch
+    std::vector<uint32_t> dirtyBlocks;
+public:
+    DensityPyramid(uint32_t const width_, uint32_t const height_, uint32_t const rowLength_);
+
+    uint32_t maxLevel() const { return minLevel + uint32_t(levels.size()) - 1; }
+    //blocks in a row and rows of blocks of `level`
+    vec2i levelSize(uint32_t const level) const;
+    uint32_t aliveCells(uint32_t const level, int32_t const blockX, int32_t const blockY) const;
+    //cells of the block inside of the field
+    uint32_t blockArea(uint32_t const level, int32_t const blockX, int32_t const blockY) const;
+    //level with blocks of at most `cellsPerPixel` cells across, clamped to [minLevel; maxLevel()]
+    uint32_t levelFor(double const cellsPerPixel) const;
+
+    //counts every block of `cells`, `rowLength` batches in a row
+    void rebuild(uint32_t const *const cells);
+    //counts blocks that contain batches at `batches` again, they can be in any order and repeat
+    void update(uint32_t const *const cells, uint32_t const *const batches, size_t const count);
+
+    //densities in [0; 1] of `size.x` x `size.y` blocks of `level` starting at block `start`,
+    //wrapping around the field edges, row by row into `out`
+    void readDensity(uint32_t const level, vec2i const start, vec2i const size, float *const out) const;
+private:
+    void countGroup(uint32_t const *const cells, uint32_t const group);
+    uint32_t sumChildren(uint32_t const level, int32_t const blockX, int32_t const blockY) const;
+};
@@ -0,0 +1,111 @@
+#include"EditJournal.h"
+
+#include<algorithm>
+
+EditJournal::EditJournal(size_t const budgetBytes_) :
+    entries{},
+    appliedEntries{ 0 },
+    entriesBytes{ 0 },
+    budgetBytes{ budgetBytes_ },
+    pending{},
+    strokeDepth{ 0 }
+{}
+
+size_t EditJournal::entryBytes(Entry const &entry) {
+    return entry.size() * sizeof(BatchDelta);
+}
+
+void EditJournal::record(uint32_t const index_actual_int, uint32_t const before, uint32_t const after) {
+    if(budgetBytes == 0) return; //history is disabled
+    pending.push_back(BatchDelta{ index_actual_int, before, after });
+}
+
+void EditJournal::commit() {
+    if(strokeDepth != 0 || pending.empty()) return;
+
+    //a batch edited several times keeps for each edited cell its value before the first edit and after the last edit of it.
+    //Generations computed between edits of a stroke change the other cells, which must not differ in the delta
+    std::stable_sort(pending.begin(), pending.end(), [](BatchDelta const &a, BatchDelta const &b) {
+        return a.index_actual_int < b.index_actual_int;
+    });
+    size_t count = 0;
+    for(size_t i = 0; i < pending.size(); count++) {
+        auto delta = pending[i];
+        auto edited = delta.before ^ delta.after;
+        for(i++; i < pending.size() && pending[i].index_actual_int == delta.index_actual_int; i++) {
+            auto const &next = pending[i];
+            auto const changed = next.before ^ next.after;
+            delta.before = (delta.before & edited) | (next.before & ~edited);
+            delta.after = (delta.after & ~changed) | (next.after & changed);
+            edited |= changed;
+        }
+        delta.before = (delta.before & edited) | (delta.after & ~edited);
+        pending[count] = delta;
+    }
+    pending.resize(count);
+    pending.erase(std::remove_if(pending.begin(), pending.end(), [](BatchDelta const &d) {
+        return d.before == d.after;
+    }), pending.end());
+
+    if(!pending.empty()) {
+        //new edit discards everything that could be redone
+        while(entries.size() > appliedEntries) {
+            entriesBytes -= entryBytes(entries.back());
+            entries.pop_back();
+        }
+        entriesBytes += entryBytes(pending);
+        entries.push_back(std::move(pending));
+        appliedEntries = entries.size();
+        trimToBudget();
+    }
+    pending = Entry{};
+}
+
+void EditJournal::beginStroke() {
+    strokeDepth++;
+}
+
+void EditJournal::endStroke() {
+    if(strokeDepth == 0) return;
+    strokeDepth--;
+    commit();
+}
+
+EditJournal::Entry const *EditJournal::undo() {
+    if(!canUndo()) return nullptr;
+    appliedEntries--;
+    return &entries[appliedEntries];
+}
+
+EditJournal::Entry const *EditJournal::redo() {
+    if(!canRedo()) return nullptr;
+    appliedEntries++;
+    return &entries[appliedEntries - 1];
+}
+
+void EditJournal::setBudget(size_t const bytes) {
+    budgetBytes = bytes;
+    trimToBudget();
+}
+
+void EditJournal::clear() {
+    entries.clear();
+    appliedEntries = 0;
+    entriesBytes = 0;
+    pending.clear();
+}
+
+void EditJournal::trimToBudget() {
+    //oldest undo entries go first, then the furthest redo ones
+    while(entriesBytes > budgetBytes && !entries.empty()) {
+        if(appliedEntries != 0) {
+            entriesBytes -= entryBytes(entries.front());
+            entries.pop_front();
+            appliedEntries--;
+        }
+        else {
+            entriesBytes -= entryBytes(entries.back());
+            entries.pop_back();
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include<stdint.h>
+#include<stddef.h>
+#include<vector>
+#include<deque>
+
+struct BatchDelta {
+    uint32_t index_actual_int;
+    uint32_t before, after;
+};
+
+//history of field edits as batch deltas. Edits made between beginStroke() and endStroke()
+//are one entry, other edits are an entry each. Oldest entries are dropped when
+//the history takes more than `budgetBytes`, nothing is recorded if it is 0
+class EditJournal final {
+public:
+    using Entry = std::vector<BatchDelta>; //sorted by index, one delta per batch
+private:
+    std::deque<Entry> entries;
+    size_t appliedEntries; //entries after it can be redone
+    size_t entriesBytes;
+    size_t budgetBytes;
+
+    Entry pending;
+    uint32_t strokeDepth;
+public:
+    EditJournal(size_t const budgetBytes_ = 64u << 20);
+
+    void record(uint32_t const index_actual_int, uint32_t const before, uint32_t const after);
+    //finishes the pending entry unless a stroke is in progress
+    void commit();
+
+    void beginStroke();
+    void endStroke();
+
+    //entry to revert/reapply, nullptr if there is none
+    Entry const *undo();
+    Entry const *redo();
+
+    bool canUndo() const { return appliedEntries != 0; }
+    bool canRedo() const { return appliedEntries != entries.size(); }
+
+    void setBudget(size_t const bytes);
+    size_t bytes() const { return entriesBytes; }
+    void clear();
+private:
+    static size_t entryBytes(Entry const &entry);
+    void trimToBudget();
+};
@@ -0,0 +1,245 @@
+#include"Ensemble.h"
+#include"Misc.h"
+#include"Timer.h"
+
+#include<cassert>
+#include<algorithm>
+#include<new>
+
+struct Ensemble::EnsembleData {
+    Ensemble& ensemble;
+    uint32_t startGroup;
+    uint32_t endGroup;
+    uint32_t generations;
+    bool checkSettled;
+
+    EnsembleData(Ensemble& ensemble_, uint32_t const startGroup_, uint32_t const endGroup_) :
+        ensemble{ ensemble_ },
+        startGroup{ startGroup_ },
+        endGroup{ endGroup_ },
+        generations{ 0 },
+        checkSettled{ false }
+    {}
+
+    void run();
+};
+
+//computes one generation of 4 soups in place. Every lane is an independent soup,
+//neighbours are counted with bit-sliced adders over the whole row at once
+static void stepGroup(__m128i *const rows, uint32_t const height, uint32_t const width, __m128i const mask) {
+    auto const shiftL = _mm_cvtsi32_si128(1), shiftR = _mm_cvtsi32_si128(int(width - 1));
+    //rotations inside of `width` bits, column `x` is bit `x`
+    auto const west = [&](__m128i const v) -> __m128i { //cell at x gets x-1
+        return _mm_and_si128(_mm_or_si128(_mm_sll_epi32(v, shiftL), _mm_srl_epi32(v, shiftR)), mask);
+    };
+    auto const east = [&](__m128i const v) -> __m128i { //cell at x gets x+1
+        return _mm_and_si128(_mm_or_si128(_mm_srl_epi32(v, shiftL), _mm_sll_epi32(v, shiftR)), mask);
+    };
+    struct Sum2 { __m128i ones, twos; };
+    auto const fullAdd = [](__m128i const a, __m128i const b, __m128i const c) -> Sum2 {
+        auto const ab = _mm_xor_si128(a, b);
+        return {
+            _mm_xor_si128(ab, c),
+            _mm_or_si128(_mm_and_si128(a, b), _mm_and_si128(c, ab))
+        };
+    };
+    auto const rowSum3 = [&](__m128i const v) -> Sum2 { return fullAdd(west(v), v, east(v)); };
+
+    auto const first = rows[0];
+    auto top = rowSum3(rows[height - 1]);
+    auto cur = rows[0];
+    auto curSum = rowSum3(cur);
+
+    for(uint32_t row = 0; row < height; row++) {
+        auto const bot = row + 1 < height ? rows[row + 1] : first;
+        auto const botSum = rowSum3(bot);
+
+        //neighbours = top(3) + bot(3) + west + east
+        auto const w = west(cur), e = east(cur);
+        auto const sides = _mm_xor_si128(w, e);
+        auto const sidesTwos = _mm_and_si128(w, e);
+
+        auto const ones = fullAdd(top.ones, botSum.ones, sides);
+        auto const twos = fullAdd(top.twos, botSum.twos, sidesTwos);
+        //total = ones.ones + 2 * (ones.twos + twos.ones) + 4 * twos.twos
+        auto const twosIsOne = _mm_andnot_si128(twos.twos, _mm_xor_si128(ones.twos, twos.ones));
+        auto const next = _mm_and_si128(twosIsOne, _mm_or_si128(ones.ones, cur));
+
+        rows[row] = next;
+
+        top = curSum;
+        cur = bot;
+        curSum = botSum;
+    }
+}
+
+void Ensemble::EnsembleData::run() {
+    auto& e = ensemble;
+    auto const height = e.soupHeight;
+    auto const mask = _mm_set1_epi32(int(e.rowMask()));
+
+    for(uint32_t group = startGroup; group < endGroup; group++) {
+        auto *const rows = e.rows + group * height;
+        auto *const prev = e.prevRows + group * height;
+        auto *const prev2 = e.prevRows2 + group * height;
+
+        for(uint32_t i = 0; i < generations; i++) {
+            if(checkSettled && i + 2 >= generations) {
+                std::copy(prev, prev + height, prev2);
+                std::copy(rows, rows + height, prev);
+            }
+            stepGroup(rows, height, e.soupWidth, mask);
+        }
+
+        if(checkSettled && generations >= 2) {
+            auto different = _mm_setzero_si128();
+            for(uint32_t row = 0; row < height; row++) {
+                different = _mm_or_si128(different, _mm_xor_si128(rows[row], prev2[row]));
+            }
+            auto const sameLanes = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(different, _mm_setzero_si128())));
+            for(uint32_t lane = 0; lane < soupsPerGroup; lane++) {
+                auto const soup = group * soupsPerGroup + lane;
+                if(soup >= e.soupsCount) break;
+                auto& settled = e.settledAt[soup];
+                if(settled == 0 && ((sameLanes >> lane) & 1)) settled = e.currentGeneration + generations;
+            }
+        }
+    }
+}
+
+Ensemble::Ensemble(uint32_t const soupWidth_, uint32_t const soupHeight_, uint32_t const soupsCount_, uint32_t const numberOfTasks_) :
+    soupWidth{ soupWidth_ },
+    soupHeight{ soupHeight_ },
+    soupsCount{ soupsCount_ },
+    groupsCount{ misc::intDivCeil(soupsCount_, soupsPerGroup) },
+    rows{ static_cast<__m128i*>(_mm_malloc(size_t(groupsCount) * soupHeight_ * 3 * sizeof(__m128i), alignof(__m128i))) },
+    prevRows{ rows + size_t(groupsCount) * soupHeight_ },
+    prevRows2{ prevRows + size_t(groupsCount) * soupHeight_ },
+    settledAt(soupsCount_, 0),
+    currentGeneration{ 0 },
+    numberOfTasks{ misc::max<uint32_t>(1, misc::min(numberOfTasks_, groupsCount)) },
+    tasks{ new std::unique_ptr<Task<EnsembleData>>[numberOfTasks] },
+    lastSoupGenerationsPerSecond{ 0 }
+{
+    assert(soupWidth >= 1 && soupWidth <= maxWidth);
+    assert(soupHeight >= 1);
+    if(rows == nullptr) throw std::bad_alloc{};
+    std::fill(rows, rows + size_t(groupsCount) * soupHeight * 3, _mm_setzero_si128());
+
+    uint32_t groupsBefore = 0;
+    for(uint32_t i = 0; i < numberOfTasks; i++) {
+        auto const groups = (groupsCount - groupsBefore) / (numberOfTasks - i);
+        tasks.get()[i] = std::unique_ptr<Task<EnsembleData>>(new Task<EnsembleData>{
+            [](EnsembleData& data) { data.run(); },
+            *this, groupsBefore, groupsBefore + groups
+        });
+        groupsBefore += groups;
+    }
+}
+
+Ensemble::~Ensemble() {
+    _mm_free(rows);
+}
+
+uint32_t Ensemble::rowMask() const {
+    return soupWidth == 32 ? ~0u : ((1u << soupWidth) - 1);
+}
+
+void Ensemble::randomize(uint64_t const seed, double const density) {
+    uint64_t state = seed;
+    auto const next = [&state]() -> uint64_t { //splitmix64
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    };
+
+    auto *const words = reinterpret_cast<uint32_t*>(rows);
+    for(uint32_t soup = 0; soup < soupsCount; soup++) {
+        auto const group = soup / soupsPerGroup, lane = soup % soupsPerGroup;
+        for(uint32_t row = 0; row < soupHeight; row++) {
+            uint32_t bits = 0;
+            if(density == 0.5) bits = uint32_t(next());
+            else for(uint32_t col = 0; col < soupWidth; col++) {
+                bits |= uint32_t((next() >> 11) * 0x1p-53 < density) << col;
+            }
+            words[(group * soupHeight + row) * soupsPerGroup + lane] = bits & rowMask();
+        }
+        settledAt[soup] = 0;
+    }
+}
+
+void Ensemble::setSoup(uint32_t const soup, uint32_t const *const soupRows) {
+    auto *const words = reinterpret_cast<uint32_t*>(rows);
+    auto const group = soup / soupsPerGroup, lane = soup % soupsPerGroup;
+    for(uint32_t row = 0; row < soupHeight; row++) {
+        words[(group * soupHeight + row) * soupsPerGroup + lane] = soupRows[row] & rowMask();
+    }
+    settledAt[soup] = 0;
+}
+
+void Ensemble::getSoup(uint32_t const soup, uint32_t *const soupRows_out) const {
+    auto const *const words = reinterpret_cast<uint32_t const*>(rows);
+    auto const group = soup / soupsPerGroup, lane = soup % soupsPerGroup;
+    for(uint32_t row = 0; row < soupHeight; row++) {
+        soupRows_out[row] = words[(group * soupHeight + row) * soupsPerGroup + lane];
+    }
+}
+
+FieldCell Ensemble::cellAt(uint32_t const soup, int32_t const column, int32_t const row) const {
+    auto const *const words = reinterpret_cast<uint32_t const*>(rows);
+    auto const group = soup / soupsPerGroup, lane = soup % soupsPerGroup;
+    auto const col_n = misc::mod(column, soupWidth), row_n = misc::mod(row, soupHeight);
+    return (words[(group * soupHeight + row_n) * soupsPerGroup + lane] >> col_n) & 1;
+}
+
+uint32_t Ensemble::population(uint32_t const soup) const {
+    auto const *const words = reinterpret_cast<uint32_t const*>(rows);
+    auto const group = soup / soupsPerGroup, lane = soup % soupsPerGroup;
+    uint32_t count = 0;
+    for(uint32_t row = 0; row < soupHeight; row++) {
+        count += _mm_popcnt_u32(words[(group * soupHeight + row) * soupsPerGroup + lane]);
+    }
+    return count;
+}
+
+void Ensemble::runTasks(uint32_t const generations) {
+    for(uint32_t i = 0; i < numberOfTasks; i++) tasks.get()[i]->data.generations = generations;
+    for(uint32_t i = 0; i < numberOfTasks; i++) tasks.get()[i]->start();
+    for(uint32_t i = 0; i < numberOfTasks; i++) tasks.get()[i]->waitForResult();
+    currentGeneration += generations;
+}
+
+void Ensemble::step(uint32_t const generations) {
+    Timer<> t{};
+    for(uint32_t i = 0; i < numberOfTasks; i++) tasks.get()[i]->data.checkSettled = false;
+    runTasks(generations);
+
+    auto const seconds = misc::max<uint64_t>(t.elapsedTime(), 1) / 1'000'000.0;
+    lastSoupGenerationsPerSecond = double(soupsCount) * generations / seconds;
+}
+
+uint64_t Ensemble::runUntilSettled(uint64_t const maxGenerations, uint32_t const checkInterval) {
+    assert(checkInterval >= 2);
+    Timer<> t{};
+    for(uint32_t i = 0; i < numberOfTasks; i++) tasks.get()[i]->data.checkSettled = true;
+
+    uint64_t generations = 0;
+    while(generations < maxGenerations && settledCount() != soupsCount) {
+        auto const count = uint32_t(misc::min<uint64_t>(checkInterval, maxGenerations - generations));
+        runTasks(count);
+        generations += count;
+    }
+
+    auto const seconds = misc::max<uint64_t>(t.elapsedTime(), 1) / 1'000'000.0;
+    lastSoupGenerationsPerSecond = double(soupsCount) * generations / seconds;
+    return generations;
+}
+
+uint64_t Ensemble::soupSettledAt(uint32_t const soup) const {
+    return settledAt[soup];
+}
+
+uint32_t Ensemble::settledCount() const {
+    return uint32_t(std::count_if(settledAt.begin(), settledAt.end(), [](uint64_t const gen) { return gen != 0; }));
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include<stdint.h>
+#include<memory>
+#include<vector>
+#include<atomic>
+#include"Task.h"
+#include"Grid.h"
+
+#include<nmmintrin.h>
+
+//many independent small toroidal fields (soups) advanced in lockstep.
+//soups are packed 4 per SSE register: every row of a soup is one 32-bit word,
+//and lane `i` of the row vectors of group `g` belongs to soup `g * 4 + i`,
+//so one pass of the kernel over a group computes one generation of 4 soups
+class Ensemble final {
+public:
+    static constexpr uint32_t maxWidth = 32;
+    static constexpr uint32_t soupsPerGroup = 4;
+
+    struct EnsembleData;
+private:
+    uint32_t const soupWidth;
+    uint32_t const soupHeight;
+    uint32_t const soupsCount;
+    uint32_t const groupsCount;
+
+    //[group][row] for the current and two previous generations,
+    //previous ones are kept to detect still lifes and period 2 oscillators.
+    //All three are in one aligned allocation owned by `rows`
+    __m128i *rows, *prevRows, *prevRows2;
+    std::vector<uint64_t> settledAt; //0 if not settled yet
+    uint64_t currentGeneration;
+
+    const uint32_t numberOfTasks;
+    std::unique_ptr<std::unique_ptr<Task<EnsembleData>>[/*numberOfTasks*/]> tasks;
+
+    double lastSoupGenerationsPerSecond;
+public:
+    Ensemble(uint32_t const soupWidth_, uint32_t const soupHeight_, uint32_t const soupsCount_, uint32_t const numberOfTasks_ = 1);
+    ~Ensemble();
+
+    Ensemble(Ensemble const&) = delete;
+    Ensemble& operator=(Ensemble const&) = delete;
+public:
+    void randomize(uint64_t const seed, double const density = 0.5);
+    void setSoup(uint32_t const soup, uint32_t const *const soupRows);
+    void getSoup(uint32_t const soup, uint32_t *const soupRows_out) const;
+
+    FieldCell cellAt(uint32_t const soup, int32_t const column, int32_t const row) const;
+    uint32_t population(uint32_t const soup) const;
+
+    //advances every soup by `generations`
+    void step(uint32_t const generations = 1);
+    //advances until every soup is settled (still life or period 2) or `maxGenerations` passed,
+    //returns number of generations simulated
+    uint64_t runUntilSettled(uint64_t const maxGenerations, uint32_t const checkInterval = 16);
+
+    //last generation of the runUntilSettled() check interval in which the soup was found periodic
+    //with period 1 or 2, up to `checkInterval` generations after it became periodic. 0 if it wasn't found
+    uint64_t soupSettledAt(uint32_t const soup) const;
+    uint32_t settledCount() const;
+
+    uint64_t generation() const { return currentGeneration; }
+    uint32_t width() const { return soupWidth; }
+    uint32_t height() const { return soupHeight; }
+    uint32_t size() const { return soupsCount; }
+
+    //soups * generations per second of the last step()/runUntilSettled() call
+    double soupGenerationsPerSecond() const { return lastSoupGenerationsPerSecond; }
+private:
+    uint32_t rowMask() const;
+    void runTasks(uint32_t const generations);
+};
@@ -0,0 +1,232 @@
+#pragma once
+
+#include"Grid.h"
+#include"Misc.h"
+
+#include<algorithm>
+#include<atomic>
+#include<limits>
+#include<vector>
+
+//outputs that don't need a window, for tools and headless runs
+
+struct NullFieldOutput final : public FieldOutput {
+    void write(FieldModification fm) override {}
+
+    std::unique_ptr<FieldOutput> batched() const override {
+        return std::unique_ptr<FieldOutput>(new NullFieldOutput());
+    }
+};
+
+//destination of staged field writes, e.g. GPU buffers. Has two buffers that take turns being the next one
+struct FieldSink {
+    //writes `fm` to buffer `bufferIndex`, 0 or 1
+    virtual void transfer(uint32_t const bufferIndex, FieldModification fm) = 0;
+    //writes `count` disjoint ranges sorted by start to buffer `bufferIndex` at once
+    virtual void transferRanges(uint32_t const bufferIndex, FieldModification const *const ranges, size_t const count) {
+        for(size_t i = 0; i < count; i++) transfer(bufferIndex, ranges[i]);
+    }
+    //called by FieldStaging::publish() once buffer `currentIndex` became the current one, also if nothing
+    //was transferred to it. `current` and `previous` are the staged copies of the new and the old current buffer
+    virtual void published(uint32_t const currentIndex, std::vector<uint32_t> const &current, std::vector<uint32_t> const &previous) {}
+    //both buffers are now `gridLength` batches of dead cells, see Field::resize().
+    //Sinks of fields that are never resized can ignore it
+    virtual void resized(uint32_t const gridLength) {}
+    virtual ~FieldSink() = default;
+};
+
+//copies of both buffers of the sink. Generation tasks write their bands into the next one
+//without locks and without touching the sink, publish() then sends the ranges changed during
+//the generation in one transfer. Writes to the current buffer (edits) are sent immediately.
+//Buffer 0 is the next one before the first publish()
+class FieldStaging final {
+public:
+    //unchanged batches between two marked ranges that are transferred anyway instead of starting a new range
+    static constexpr uint32_t mergeGap = 4;
+    //ranges marked during a generation are preallocated, the ones past it are merged into a single span
+    static constexpr uint32_t maxMarkedRanges = 4096;
+    //ranges in one transfer, the closest ones are merged until they fit
+    static constexpr uint32_t maxTransferRanges = 256;
+private:
+    FieldSink &sink;
+    std::vector<uint32_t> buffers[2];
+    uint32_t nextIndex;
+    //batches of the next buffer written since the last publish()
+    std::vector<FieldModification> marked; //[maxMarkedRanges], only start and size
+    std::atomic<uint32_t> markedCount;
+    std::atomic<uint32_t> overflowStart, overflowEnd;
+    std::vector<FieldModification> transferred; //reused by publish()
+
+    void mergeCloseRanges(uint32_t const gap) {
+        size_t count = 0;
+        for(auto const range : transferred) {
+            if(count != 0) {
+                auto &last = transferred[count - 1];
+                if(range.startIndex_int <= last.startIndex_int + last.size_int + gap) {
+                    last.size_int = misc::max(last.size_int, range.startIndex_int + range.size_int - last.startIndex_int);
+                    continue;
+                }
+            }
+            transferred[count++] = range;
+        }
+        transferred.resize(count);
+    }
+public:
+    FieldStaging(FieldSink &sink_, size_t const gridLength) :
+        sink{ sink_ },
+        buffers{ std::vector<uint32_t>(gridLength, 0), std::vector<uint32_t>(gridLength, 0) },
+        nextIndex{ 0 },
+        marked(maxMarkedRanges),
+        markedCount{ 0 },
+        overflowStart{ std::numeric_limits<uint32_t>::max() },
+        overflowEnd{ 0 },
+        transferred{}
+    {
+        transferred.reserve(maxMarkedRanges + 1);
+    }
+
+    FieldStaging(FieldStaging const&) = delete;
+    FieldStaging& operator=(FieldStaging const&) = delete;
+
+    uint32_t currentIndex() const { return nextIndex ^ 1; }
+    //staged copy of buffer `index`, the next one is written by generation tasks
+    std::vector<uint32_t> const &buffer(uint32_t const index) const { return buffers[index]; }
+
+    void writeCurrent(FieldModification const fm) {
+        std::copy(fm.data, fm.data + fm.size_int, buffers[currentIndex()].begin() + fm.startIndex_int);
+        sink.transfer(currentIndex(), fm);
+    }
+
+    //bands are disjoint, so tasks write them at the same time. Written batches must be marked
+    void writeNext(FieldModification const fm) {
+        std::copy(fm.data, fm.data + fm.size_int, buffers[nextIndex].begin() + fm.startIndex_int);
+    }
+
+    void markNext(uint32_t const start, uint32_t const end) {
+        auto const index = markedCount.fetch_add(1, std::memory_order_relaxed);
+        if(index < maxMarkedRanges) {
+            marked[index] = FieldModification{ start, end - start, nullptr };
+            return;
+        }
+        auto curStart = overflowStart.load(std::memory_order_relaxed);
+        while(start < curStart && !overflowStart.compare_exchange_weak(curStart, start, std::memory_order_relaxed)) {}
+        auto curEnd = overflowEnd.load(std::memory_order_relaxed);
+        while(end > curEnd && !overflowEnd.compare_exchange_weak(curEnd, end, std::memory_order_relaxed)) {}
+    }
+
+    //must not be called while the next buffer is written
+    void publish() {
+        auto const count = misc::min(markedCount.exchange(0, std::memory_order_relaxed), maxMarkedRanges);
+        auto const start = overflowStart.exchange(std::numeric_limits<uint32_t>::max(), std::memory_order_relaxed);
+        auto const end = overflowEnd.exchange(0, std::memory_order_relaxed);
+        transferred.assign(marked.begin(), marked.begin() + count);
+        if(start < end) transferred.push_back(FieldModification{ start, end - start, nullptr });
+
+        std::sort(transferred.begin(), transferred.end(), [](FieldModification const a, FieldModification const b) {
+            return a.startIndex_int < b.startIndex_int;
+        });
+        mergeCloseRanges(mergeGap);
+        for(auto gap = mergeGap * 2; transferred.size() > maxTransferRanges; gap *= 2) mergeCloseRanges(gap);
+
+        auto const &next = buffers[nextIndex];
+        for(auto &range : transferred) range.data = &next[range.startIndex_int];
+        if(!transferred.empty()) sink.transferRanges(nextIndex, transferred.data(), transferred.size());
+        nextIndex ^= 1;
+        sink.published(currentIndex(), buffers[currentIndex()], buffers[nextIndex]);
+    }
+
+    //must not be called while the next buffer is written. Everything not published is dropped
+    void resize(uint32_t const gridLength) {
+        for(auto &buffer : buffers) buffer.assign(gridLength, 0);
+        markedCount.store(0, std::memory_order_relaxed);
+        overflowStart.store(std::numeric_limits<uint32_t>::max(), std::memory_order_relaxed);
+        overflowEnd.store(0, std::memory_order_relaxed);
+        sink.resized(gridLength);
+    }
+};
+
+//output to a staging, the buffer output publishes it when the field starts a new generation
+class StagedFieldOutput final : public FieldOutput {
+    FieldStaging &staging;
+    bool isBuffer; //writes the next generation instead of the current one
+    bool isBatch; //marks written batches once per range of close writes instead of on every write
+    uint32_t start, end; //range of close batches written through this output and not marked yet
+public:
+    StagedFieldOutput(FieldStaging &staging_, bool const isBuffer_, bool const isBatch_ = false) :
+        staging{ staging_ }, isBuffer{ isBuffer_ }, isBatch{ isBatch_ },
+        start{ std::numeric_limits<uint32_t>::max() }, end{ 0 }
+    {}
+
+    StagedFieldOutput(StagedFieldOutput const&) = delete;
+    StagedFieldOutput& operator=(StagedFieldOutput const&) = delete;
+
+    void write(FieldModification fm) override {
+        if(!isBuffer) {
+            staging.writeCurrent(fm);
+            return;
+        }
+        staging.writeNext(fm);
+        auto const fmEnd = fm.startIndex_int + fm.size_int;
+        if(!isBatch) staging.markNext(fm.startIndex_int, fmEnd);
+        else if(start < end && fm.startIndex_int >= start && fm.startIndex_int <= end + FieldStaging::mergeGap) {
+            end = misc::max(end, fmEnd);
+        }
+        else {
+            finishBatch();
+            start = fm.startIndex_int;
+            end = fmEnd;
+        }
+    }
+
+    std::unique_ptr<FieldOutput> batched() const override {
+        return std::unique_ptr<FieldOutput>(new StagedFieldOutput(staging, isBuffer, true));
+    }
+
+    void finishBatch() override {
+        if(start < end) staging.markNext(start, end);
+        start = std::numeric_limits<uint32_t>::max();
+        end = 0;
+    }
+
+    void publish() override {
+        if(isBuffer) staging.publish();
+    }
+
+    void resized(uint32_t const width, uint32_t const height, uint32_t const rowLength) override {
+        if(isBuffer) staging.resize(height * rowLength);
+    }
+
+    ~StagedFieldOutput() override {
+        finishBatch();
+    }
+};
+
+//keeps both buffers in memory, for tools and headless runs
+struct MemoryFieldSink final : public FieldSink {
+    std::vector<uint32_t> buffers[2];
+    uint64_t transfers, transferredBatches;
+
+    explicit MemoryFieldSink(size_t const gridLength) :
+        buffers{ std::vector<uint32_t>(gridLength, 0), std::vector<uint32_t>(gridLength, 0) },
+        transfers{ 0 }, transferredBatches{ 0 }
+    {}
+
+    void transfer(uint32_t const bufferIndex, FieldModification fm) override {
+        std::copy(fm.data, fm.data + fm.size_int, buffers[bufferIndex].begin() + fm.startIndex_int);
+        transfers++;
+        transferredBatches += fm.size_int;
+    }
+
+    void transferRanges(uint32_t const bufferIndex, FieldModification const *const ranges, size_t const count) override {
+        for(size_t i = 0; i < count; i++) {
+            auto const fm = ranges[i];
+            std::copy(fm.data, fm.data + fm.size_int, buffers[bufferIndex].begin() + fm.startIndex_int);
+            transferredBatches += fm.size_int;
+        }
+        transfers++;
+    }
+
+    void resized(uint32_t const gridLength) override {
+        for(auto &buffer : buffers) buffer.assign(gridLength, 0);
+    }
+};
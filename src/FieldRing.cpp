@@ -0,0 +1,225 @@
+#include"FieldRing.h"
+#include"Misc.h"
+
+#include<cassert>
+#include<cstdlib>
+#include<cstring>
+#include<new>
+
+using namespace fieldRing;
+
+//unchanged batches between two changed ones that are sent anyway instead of starting a new range
+static constexpr uint32_t mergeGap = 4;
+
+static uint64_t alignToCacheLine(uint64_t const size) { return (size + 63) / 64 * 64; }
+
+FieldRingPublisher::FieldRingPublisher(uint32_t const width_, uint32_t const height_, uint32_t const rowLength_, FieldRingOptions const options_) :
+    name{},
+    mapping{},
+    header{ nullptr },
+    width{ width_ }, height{ height_ }, rowLength{ rowLength_ },
+    options{ options_ },
+    previous(size_t(rowLength_) * height_, 0),
+    masked(size_t(rowLength_) * height_, 0),
+    ranges{},
+    sequence{ 0 },
+    publishedWords{ 0 }, keyframes{ 0 }
+{
+    assert(rowLength * 32 >= width);
+    options.slotsCount = misc::max<uint32_t>(2, options.slotsCount);
+    options.keyframeInterval = misc::max<uint32_t>(1, options.keyframeInterval);
+}
+
+FieldRingPublisher::~FieldRingPublisher() {
+    if(header == nullptr) return;
+    shm::close(mapping);
+    shm::remove(name.c_str());
+}
+
+shm::CreateResult FieldRingPublisher::start(std::string name_) {
+    if(header != nullptr) return shm::CreateResult::failed;
+    auto const gridLength = uint64_t(rowLength) * height;
+    auto const slotsOffset = alignToCacheLine(sizeof(Header));
+    auto const slotBytes = alignToCacheLine(sizeof(Slot) + gridLength * sizeof(uint32_t));
+    auto const result = shm::create(name_.c_str(), size_t(slotsOffset + slotBytes * options.slotsCount), mapping);
+    if(result != shm::CreateResult::created) return result;
+    name = std::move(name_);
+
+    auto const base = static_cast<char*>(mapping.data);
+    for(uint32_t i = 0; i < options.slotsCount; i++) {
+        auto const slot = new(base + slotsOffset + slotBytes * i) Slot{};
+        slot->sequence.store(0, std::memory_order_relaxed);
+    }
+    header = new(base) Header{};
+    header->magic = magic;
+    header->version = version;
+    header->width = width;
+    header->height = height;
+    header->rowLength = rowLength;
+    header->slotsCount = options.slotsCount;
+    header->slotBytes = slotBytes;
+    header->slotsOffset = slotsOffset;
+    header->published.store(0, std::memory_order_release);
+    return shm::CreateResult::created;
+}
+
+void FieldRingPublisher::publish(uint32_t const *const cells, uint64_t const generation) {
+    if(header == nullptr) return;
+    sequence++;
+
+    auto const lastBatchMask = width % 32 == 0 ? ~0u : (1u << (width % 32)) - 1;
+    for(uint32_t row = 0; row < height; row++) {
+        auto const start = size_t(row) * rowLength;
+        std::memcpy(masked.data() + start, cells + start, rowLength * sizeof(uint32_t));
+        masked[start + rowLength - 1] &= lastBatchMask;
+    }
+
+    auto const gridLength = uint32_t(masked.size());
+    auto isKeyframe = !options.isRanges || (sequence - 1) % options.keyframeInterval == 0;
+    uint32_t rangesWords = 0;
+    if(!isKeyframe) {
+        ranges.clear();
+        for(uint32_t i = 0; i < gridLength; i++) {
+            if(masked[i] == previous[i]) continue;
+            auto const rangesCount = ranges.size() / 2;
+            if(rangesCount != 0 && i - (ranges[ranges.size() - 2] + ranges.back()) <= mergeGap) {
+                ranges.back() = i + 1 - ranges[ranges.size() - 2];
+            }
+            else {
+                ranges.push_back(i);
+                ranges.push_back(1);
+            }
+        }
+        rangesWords = uint32_t(ranges.size());
+        for(size_t i = 1; i < ranges.size(); i += 2) rangesWords += ranges[i];
+        //ranges would take more space than the cells
+        if(rangesWords >= gridLength) isKeyframe = true;
+    }
+
+    auto const base = static_cast<char*>(mapping.data);
+    auto &slot = *reinterpret_cast<Slot*>(base + header->slotsOffset + header->slotBytes * (sequence % options.slotsCount));
+    auto const payload = reinterpret_cast<uint32_t*>(&slot + 1);
+
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.generation = generation;
+    if(isKeyframe) {
+        slot.kind = SlotKind::keyframe;
+        slot.rangesCount = 0;
+        slot.wordsCount = gridLength;
+        std::memcpy(payload, masked.data(), gridLength * sizeof(uint32_t));
+        keyframes++;
+    }
+    else {
+        slot.kind = SlotKind::ranges;
+        slot.rangesCount = uint32_t(ranges.size() / 2);
+        slot.wordsCount = rangesWords;
+        std::memcpy(payload, ranges.data(), ranges.size() * sizeof(uint32_t));
+        auto out = payload + ranges.size();
+        for(size_t i = 0; i < ranges.size(); i += 2) {
+            std::memcpy(out, masked.data() + ranges[i], ranges[i + 1] * sizeof(uint32_t));
+            out += ranges[i + 1];
+        }
+    }
+    slot.sequence.store(sequence, std::memory_order_release);
+    header->published.store(sequence, std::memory_order_release);
+
+    publishedWords += slot.wordsCount;
+    std::swap(previous, masked);
+}
+
+FieldRingReader::FieldRingReader() :
+    mapping{},
+    header{ nullptr },
+    current{},
+    sequence{ 0 }, lastApplied{ 0 },
+    currentGeneration{ 0 },
+    missed{ 0 }, overwritten{ 0 }
+{}
+
+FieldRingReader::~FieldRingReader() {
+    shm::close(mapping);
+}
+
+bool FieldRingReader::open(std::string const &name) {
+    if(header != nullptr) return false;
+    if(!shm::open(name.c_str(), mapping)) return false;
+    auto const ringHeader = static_cast<Header const*>(mapping.data);
+    auto const isValid = mapping.size >= sizeof(Header)
+        && ringHeader->magic == magic && ringHeader->version == version
+        && ringHeader->slotsCount != 0
+        && ringHeader->slotBytes >= sizeof(Slot) + uint64_t(ringHeader->rowLength) * ringHeader->height * sizeof(uint32_t)
+        && mapping.size >= ringHeader->slotsOffset + ringHeader->slotBytes * ringHeader->slotsCount;
+    if(!isValid) {
+        shm::close(mapping);
+        return false;
+    }
+    header = ringHeader;
+    current.assign(size_t(header->rowLength) * header->height, 0);
+    return true;
+}
+
+Slot const &FieldRingReader::slotAt(uint64_t const publicationSequence) const {
+    auto const base = static_cast<char const*>(mapping.data);
+    return *reinterpret_cast<Slot const*>(base + header->slotsOffset + header->slotBytes * (publicationSequence % header->slotsCount));
+}
+
+bool FieldRingReader::apply(uint64_t const publicationSequence) {
+    auto const gridLength = uint32_t(current.size());
+    uint64_t generation = 0;
+    auto const isRead = read(publicationSequence, [&](Slot const &slot, uint32_t const *const payload) {
+        generation = slot.generation;
+        if(slot.kind == SlotKind::keyframe) {
+            std::memcpy(current.data(), payload, gridLength * sizeof(uint32_t));
+            return;
+        }
+        //the slot can be overwritten while it is read, so nothing in it is trusted
+        auto const rangesCount = misc::min(slot.rangesCount, gridLength / 2);
+        auto cells = payload + size_t(rangesCount) * 2;
+        for(uint32_t i = 0; i < rangesCount; i++) {
+            auto const start = payload[i * 2], count = payload[i * 2 + 1];
+            if(start > gridLength || count > gridLength - start || cells + count > payload + gridLength) return;
+            std::memcpy(current.data() + start, cells, count * sizeof(uint32_t));
+            cells += count;
+        }
+    });
+    if(!isRead) {
+        overwritten++;
+        sequence = 0;
+        return false;
+    }
+    sequence = lastApplied = publicationSequence;
+    currentGeneration = generation;
+    return true;
+}
+
+uint32_t FieldRingReader::update() {
+    if(header == nullptr) return 0;
+    auto const latest = latestSequence();
+    if(latest == 0 || latest == sequence) return 0;
+    auto const slotsCount = header->slotsCount;
+
+    //the next publication may be overwritten already
+    if(sequence != 0 && latest - sequence >= slotsCount) sequence = 0;
+
+    uint32_t applied = 0;
+    if(sequence == 0) {
+        for(auto s = latest; s != 0 && latest - s < slotsCount; s--) {
+            auto isKeyframe = false;
+            if(!read(s, [&](Slot const &slot, uint32_t const*) { isKeyframe = slot.kind == SlotKind::keyframe; }) || !isKeyframe) continue;
+            auto const previous = lastApplied;
+            if(!apply(s)) return 0;
+            if(previous != 0 && s > previous + 1) missed += s - previous - 1;
+            applied++;
+            break;
+        }
+        if(sequence == 0) return 0; //no keyframe in the ring yet
+    }
+    while(sequence != 0 && sequence < latest && apply(sequence + 1)) applied++;
+    return applied;
+}
+
+std::string fieldRingNameFromEnvironment() {
+    auto const value = std::getenv("GOL_SHM_NAME");
+    return value == nullptr ? std::string{} : std::string{ value };
+}
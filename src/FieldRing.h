@@ -0,0 +1,136 @@
+#pragma once
+
+#include<stdint.h>
+#include<stddef.h>
+#include<atomic>
+#include<string>
+#include<vector>
+#include"SharedMemory.h"
+
+//ring of published generations in shared memory, for consumer processes on the same machine.
+//The publisher never waits for readers: each slot is guarded like a seqlock, a reader checks
+//the slot's sequence after reading it in place and retries from a keyframe if it was overwritten.
+//A publication is the whole packed field (keyframe) or the ranges of batches that changed since
+//the previous publication. Cells are packed as in the field: `height` rows of `rowLength` batches,
+//column `x` is bit `x % 32` of batch `x / 32`, bits past the width are 0
+namespace fieldRing {
+    static constexpr uint32_t magic = 0x524c4f47; //"GOLR"
+    static constexpr uint32_t version = 1;
+
+    struct Header {
+        uint32_t magic, version;
+        uint32_t width, height, rowLength;
+        uint32_t slotsCount;
+        uint64_t slotBytes; //distance between slots, they start at `slotsOffset`
+        uint64_t slotsOffset;
+        std::atomic<uint64_t> published; //sequence of the last publication, 0 before the first one
+    };
+
+    enum class SlotKind : uint32_t { keyframe, ranges };
+
+    struct Slot {
+        std::atomic<uint64_t> sequence; //0 while the slot is written, publication `s` is in slot `s % slotsCount`
+        uint64_t generation;
+        SlotKind kind;
+        uint32_t rangesCount; //of a ranges slot: `rangesCount` pairs of start batch and count, then their batches
+        uint32_t wordsCount; //of the payload after this header
+        uint32_t padding;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "atomics are shared between processes");
+}
+
+struct FieldRingOptions {
+    uint32_t slotsCount = 16;
+    uint32_t keyframeInterval = 16; //publications between keyframes, also sent when the ranges would be larger
+    bool isRanges = true; //false sends every publication as a keyframe
+};
+
+class FieldRingPublisher final {
+    std::string name;
+    shm::Mapping mapping;
+    fieldRing::Header *header;
+    uint32_t width, height, rowLength;
+    FieldRingOptions options;
+
+    std::vector<uint32_t> previous; //cells of the last publication
+    //reused by publish()
+    std::vector<uint32_t> masked;
+    std::vector<uint32_t> ranges;
+    uint64_t sequence;
+    uint64_t publishedWords, keyframes;
+public:
+    FieldRingPublisher(uint32_t const width_, uint32_t const height_, uint32_t const rowLength_, FieldRingOptions const options_ = {});
+    ~FieldRingPublisher();
+
+    FieldRingPublisher(FieldRingPublisher const&) = delete;
+    FieldRingPublisher& operator=(FieldRingPublisher const&) = delete;
+
+    //creates shared memory `name_`, nameInUse if it already exists
+    shm::CreateResult start(std::string name_);
+    //publishes `cells`, bits past the width are ignored
+    void publish(uint32_t const *const cells, uint64_t const generation);
+
+    uint64_t publications() const { return sequence; }
+    uint64_t keyframesCount() const { return keyframes; }
+    //payload written by all publications
+    uint64_t publishedBytes() const { return publishedWords * sizeof(uint32_t); }
+};
+
+//follows the ring of another process, keeping its own copy of the latest generation it read
+class FieldRingReader final {
+    shm::Mapping mapping;
+    fieldRing::Header const *header;
+
+    std::vector<uint32_t> current;
+    uint64_t sequence; //of the publication `current` is at, 0 if not synchronized
+    uint64_t lastApplied; //kept while not synchronized, to count the missed publications
+    uint64_t currentGeneration;
+    uint64_t missed, overwritten;
+public:
+    FieldRingReader();
+    ~FieldRingReader();
+
+    FieldRingReader(FieldRingReader const&) = delete;
+    FieldRingReader& operator=(FieldRingReader const&) = delete;
+
+    //false if there is no ring `name` or it has another layout
+    bool open(std::string const &name);
+
+    uint32_t width() const { return header->width; }
+    uint32_t height() const { return header->height; }
+    uint32_t rowLength() const { return header->rowLength; }
+    uint64_t latestSequence() const { return header->published.load(std::memory_order_acquire); }
+
+    //calls `view(slot, payload)` with publication `publicationSequence` in place, without copying.
+    //Returns false if it is not in the ring anymore or was overwritten while viewed,
+    //the view must then discard what it read
+    template<class View>
+    bool read(uint64_t const publicationSequence, View &&view) const {
+        if(publicationSequence == 0) return false;
+        auto const &slot = slotAt(publicationSequence);
+        if(slot.sequence.load(std::memory_order_acquire) != publicationSequence) return false;
+        view(slot, reinterpret_cast<uint32_t const*>(&slot + 1));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.sequence.load(std::memory_order_relaxed) == publicationSequence;
+    }
+
+    //applies publications up to the latest one, returns how many were applied.
+    //If the reader fell behind the ring, it continues from the newest keyframe
+    uint32_t update();
+
+    std::vector<uint32_t> const &cells() const { return current; }
+    bool isSynchronized() const { return sequence != 0; }
+    uint64_t generation() const { return currentGeneration; }
+    uint64_t currentSequence() const { return sequence; }
+    //publications skipped because the reader fell behind
+    uint64_t missedCount() const { return missed; }
+    //publications overwritten while they were read
+    uint64_t overwrittenCount() const { return overwritten; }
+private:
+    fieldRing::Slot const &slotAt(uint64_t const publicationSequence) const;
+    bool apply(uint64_t const publicationSequence);
+};
+
+//name of the ring from the GOL_SHM_NAME environment variable, empty if it is not set
+std::string fieldRingNameFromEnvironment();
@@ -0,0 +1,359 @@
+#include"FrameExport.h"
+#include"Misc.h"
+
+#include<cassert>
+#include<cstdio>
+#include<cstring>
+
+#include<emmintrin.h>
+
+struct FrameExporter::Frame {
+    enum class State : uint8_t { free, filling, pending, drawing, encoded };
+    State state = State::free;
+    uint64_t sequence = 0, generation = 0;
+    uint32_t rowLength = 0;
+    std::vector<uint32_t> cells;
+    //reused by the thread that draws the frame
+    std::vector<uint8_t> grey; //size.x * size.y pixels
+    std::vector<uint8_t> line; //one row of cells or filtered rows of a png
+    std::vector<uint16_t> counts; //alive cells of each column under a row of pixels
+    std::vector<uint8_t> bytes; //encoded frame
+};
+
+//grey levels of alive and dead cells in fs.shader
+static constexpr uint8_t aliveGrey = 30, deadGrey = 225;
+
+//8 cells of a byte as 8 bytes, `alive` and `dead` values
+static std::vector<uint64_t> cellsAsBytes(uint8_t const alive, uint8_t const dead) {
+    std::vector<uint64_t> table(256);
+    for(uint32_t cells = 0; cells < 256; cells++) {
+        uint64_t bytes = 0;
+        for(uint32_t i = 0; i < 8; i++) bytes |= uint64_t((cells >> i) & 1 ? alive : dead) << (i * 8);
+        table[cells] = bytes;
+    }
+    return table;
+}
+
+//`rowLength` batches of a packed row as bytes
+static void expandRow(uint64_t const *const table, uint32_t const *const cells, uint32_t const rowLength, uint8_t *const out) {
+    for(uint32_t i = 0; i < rowLength; i++) {
+        for(uint32_t j = 0; j < 4; j++) std::memcpy(out + i * 32 + j * 8, &table[(cells[i] >> (j * 8)) & 0xff], 8);
+    }
+}
+
+static void appendBigEndian(std::vector<uint8_t> &bytes, uint32_t const value) {
+    for(int i = 3; i >= 0; i--) bytes.push_back(uint8_t(value >> (i * 8)));
+}
+
+static uint32_t crc32(uint8_t const *const data, size_t const size) {
+    static auto const table = []() {
+        std::vector<uint32_t> table(256);
+        for(uint32_t i = 0; i < 256; i++) {
+            auto c = i;
+            for(int k = 0; k < 8; k++) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return table;
+    }();
+    auto crc = ~0u;
+    for(size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void appendPngChunk(std::vector<uint8_t> &bytes, char const *const type, uint8_t const *const data, size_t const size) {
+    appendBigEndian(bytes, uint32_t(size));
+    auto const start = bytes.size();
+    bytes.insert(bytes.end(), type, type + 4);
+    bytes.insert(bytes.end(), data, data + size);
+    appendBigEndian(bytes, crc32(bytes.data() + start, bytes.size() - start));
+}
+
+FrameExporter::FrameExporter(uint32_t const width_, uint32_t const height_, ExportOptions options_) :
+    width{ width_ }, height{ height_ },
+    options{ std::move(options_) },
+    size{ 0 },
+    lock{}, changed{},
+    frames{},
+    nextSequence{ 0 }, nextWritten{ 0 },
+    written{ 0 }, dropped{ 0 },
+    isStopped{ false }, isFailed{ false },
+    stream{}, workers{}, writer{}
+{
+    options.pixelsPerCell = misc::max<uint32_t>(1, options.pixelsPerCell);
+    options.cellsPerPixel = misc::min<uint32_t>(misc::max<uint32_t>(1, options.cellsPerPixel), 65535); //column counts are 16 bit
+    assert(options.pixelsPerCell == 1 || options.cellsPerPixel == 1);
+    options.threads = misc::max<uint32_t>(1, options.threads);
+    options.queueLength = misc::max<uint32_t>(1, options.queueLength);
+    options.framesPerSecond = misc::max<uint32_t>(1, options.framesPerSecond);
+
+    size = options.cellsPerPixel > 1
+        ? vec2i(int32_t(misc::intDivCeil(width, options.cellsPerPixel)), int32_t(misc::intDivCeil(height, options.cellsPerPixel)))
+        : vec2i(int32_t(width * options.pixelsPerCell), int32_t(height * options.pixelsPerCell));
+    for(uint32_t i = 0; i < options.queueLength; i++) {
+        frames.push_back(std::unique_ptr<Frame>(new Frame()));
+        frames.back()->grey.resize(size_t(size.x) * size.y);
+    }
+}
+
+FrameExporter::~FrameExporter() {
+    if(!writer.joinable()) return;
+    finish();
+    {
+        std::lock_guard<std::mutex> lk{ lock };
+        isStopped = true;
+        changed.notify_all();
+    }
+    for(auto &worker : workers) worker.join();
+    writer.join();
+}
+
+bool FrameExporter::start() {
+    if(writer.joinable()) return false;
+    if(options.format == ExportFormat::y4m) {
+        stream.open(options.path, std::ios::binary);
+        if(!stream) return false;
+        //grey frames, chroma planes are neutral
+        stream << "YUV4MPEG2 W" << size.x << " H" << size.y << " F" << options.framesPerSecond << ":1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n";
+    }
+    for(uint32_t i = 0; i < options.threads; i++) workers.emplace_back(&FrameExporter::work, this);
+    writer = std::thread{ &FrameExporter::writeFrames, this };
+    return true;
+}
+
+bool FrameExporter::submit(uint32_t const *const cells, uint32_t const rowLength, uint64_t const generation) {
+    assert(writer.joinable());
+    Frame *frame = nullptr;
+    auto const findFree = [&]() {
+        for(auto &f : frames) if(f->state == Frame::State::free) {
+            frame = f.get();
+            return true;
+        }
+        return false;
+    };
+
+    std::unique_lock<std::mutex> lk{ lock };
+    if(options.dropWhenFull) {
+        if(!findFree()) {
+            dropped++;
+            return false;
+        }
+    }
+    else changed.wait(lk, findFree);
+    frame->state = Frame::State::filling;
+    lk.unlock();
+
+    frame->generation = generation;
+    frame->rowLength = rowLength;
+    frame->cells.resize(size_t(rowLength) * height);
+    std::memcpy(frame->cells.data(), cells, frame->cells.size() * sizeof(uint32_t));
+
+    lk.lock();
+    frame->state = Frame::State::pending;
+    frame->sequence = nextSequence++;
+    changed.notify_all();
+    return true;
+}
+
+void FrameExporter::finish() {
+    std::unique_lock<std::mutex> lk{ lock };
+    changed.wait(lk, [this]() { return nextWritten == nextSequence; });
+}
+
+bool FrameExporter::ok() {
+    std::lock_guard<std::mutex> lk{ lock };
+    return !isFailed;
+}
+
+uint64_t FrameExporter::framesWritten() {
+    std::lock_guard<std::mutex> lk{ lock };
+    return written;
+}
+
+uint64_t FrameExporter::framesDropped() {
+    std::lock_guard<std::mutex> lk{ lock };
+    return dropped;
+}
+
+void FrameExporter::work() {
+    std::unique_lock<std::mutex> lk{ lock };
+    while(true) {
+        Frame *frame = nullptr;
+        changed.wait(lk, [&]() {
+            for(auto &f : frames) if(f->state == Frame::State::pending) {
+                frame = f.get();
+                return true;
+            }
+            return isStopped;
+        });
+        if(frame == nullptr) return;
+        frame->state = Frame::State::drawing;
+        lk.unlock();
+
+        drawFrame(*frame);
+        encodeFrame(*frame);
+
+        lk.lock();
+        frame->state = Frame::State::encoded;
+        changed.notify_all();
+    }
+}
+
+void FrameExporter::writeFrames() {
+    std::unique_lock<std::mutex> lk{ lock };
+    while(true) {
+        Frame *frame = nullptr;
+        changed.wait(lk, [&]() {
+            for(auto &f : frames) if(f->state == Frame::State::encoded && f->sequence == nextWritten) {
+                frame = f.get();
+                return true;
+            }
+            return isStopped;
+        });
+        if(frame == nullptr) return;
+        auto const isSkipped = isFailed;
+        lk.unlock();
+
+        auto isWritten = true;
+        if(!isSkipped) {
+            if(options.format == ExportFormat::y4m) {
+                stream.write(reinterpret_cast<char const*>(frame->bytes.data()), std::streamsize(frame->bytes.size()));
+                stream.flush();
+                isWritten = bool(stream);
+            }
+            else {
+                char name[32];
+                std::snprintf(name, sizeof(name), "_%08llu.%s", (unsigned long long)frame->generation, options.format == ExportFormat::png ? "png" : "ppm");
+                std::ofstream file{ options.path + name, std::ios::binary };
+                file.write(reinterpret_cast<char const*>(frame->bytes.data()), std::streamsize(frame->bytes.size()));
+                isWritten = bool(file);
+            }
+        }
+
+        lk.lock();
+        if(!isWritten) isFailed = true;
+        else if(!isSkipped) written++;
+        frame->state = Frame::State::free;
+        nextWritten++;
+        changed.notify_all();
+    }
+}
+
+void FrameExporter::drawFrame(Frame &frame) const {
+    static auto const pixelsTable = cellsAsBytes(aliveGrey, deadGrey);
+    static auto const countsTable = cellsAsBytes(1, 0);
+    auto const pixels = frame.grey.data();
+    auto const rowLength = frame.rowLength;
+    frame.line.resize(size_t(rowLength) * 32);
+    auto const line = frame.line.data();
+
+    if(options.cellsPerPixel > 1) {
+        auto const n = options.cellsPerPixel;
+        frame.counts.resize(size_t(rowLength) * 32);
+        auto const counts = frame.counts.data();
+        for(int32_t py = 0; py < size.y; py++) {
+            //alive cells of each column in the rows of the pixel, then in the columns of each pixel
+            std::fill(frame.counts.begin(), frame.counts.end(), 0);
+            auto const endRow = misc::min(uint32_t(py + 1) * n, height);
+            for(auto row = uint32_t(py) * n; row < endRow; row++) {
+                expandRow(countsTable.data(), frame.cells.data() + size_t(row) * rowLength, rowLength, line);
+                for(uint32_t x = 0; x < rowLength * 32; x += 16) {
+                    auto const bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(line + x));
+                    auto const low = reinterpret_cast<__m128i*>(counts + x), high = reinterpret_cast<__m128i*>(counts + x + 8);
+                    _mm_storeu_si128(low, _mm_add_epi16(_mm_loadu_si128(low), _mm_unpacklo_epi8(bytes, _mm_setzero_si128())));
+                    _mm_storeu_si128(high, _mm_add_epi16(_mm_loadu_si128(high), _mm_unpackhi_epi8(bytes, _mm_setzero_si128())));
+                }
+            }
+            auto const rows = endRow - uint32_t(py) * n;
+            auto const fullScale = float(deadGrey - aliveGrey) / float(n * rows);
+            for(int32_t px = 0; px < size.x; px++) {
+                auto const startColumn = uint32_t(px) * n, endColumn = misc::min(startColumn + n, width);
+                uint32_t count = 0;
+                for(auto x = startColumn; x < endColumn; x++) count += counts[x];
+                //only the last pixel of a row can be narrower
+                auto const scale = endColumn - startColumn == n ? fullScale : float(deadGrey - aliveGrey) / float((endColumn - startColumn) * rows);
+                pixels[size_t(py) * size.x + px] = uint8_t(deadGrey - uint32_t(float(count) * scale + 0.5f));
+            }
+        }
+        return;
+    }
+
+    auto const scale = options.pixelsPerCell;
+    for(uint32_t row = 0; row < height; row++) {
+        expandRow(pixelsTable.data(), frame.cells.data() + size_t(row) * rowLength, rowLength, line);
+        auto const first = pixels + size_t(row) * scale * size.x;
+        if(scale == 1) std::memcpy(first, line, width);
+        else {
+            for(uint32_t x = 0; x < width; x++) std::memset(first + x * scale, line[x], scale);
+            for(uint32_t i = 1; i < scale; i++) std::memcpy(first + size_t(i) * size.x, first, size.x);
+        }
+    }
+}
+
+void FrameExporter::encodeFrame(Frame &frame) const {
+    auto &bytes = frame.bytes;
+    bytes.clear();
+    auto const pixels = frame.grey.data();
+    auto const pixelsCount = size_t(size.x) * size.y;
+
+    switch(options.format) {
+        case ExportFormat::ppm: {
+            char header[64];
+            auto const length = std::snprintf(header, sizeof(header), "P6\n%d %d\n255\n", size.x, size.y);
+            bytes.insert(bytes.end(), header, header + length);
+            bytes.resize(bytes.size() + pixelsCount * 3);
+            auto out = bytes.data() + length;
+            for(size_t i = 0; i < pixelsCount; i++, out += 3) out[0] = out[1] = out[2] = pixels[i];
+        }
+        break; case ExportFormat::png: {
+            static uint8_t const signature[]{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+            bytes.insert(bytes.end(), signature, signature + sizeof(signature));
+            uint8_t header[13]{};
+            for(int i = 0; i < 4; i++) {
+                header[i] = uint8_t(uint32_t(size.x) >> ((3 - i) * 8));
+                header[4 + i] = uint8_t(uint32_t(size.y) >> ((3 - i) * 8));
+            }
+            header[8] = 8; //bits per sample, color type 0 is grey
+            appendPngChunk(bytes, "IHDR", header, sizeof(header));
+
+            //rows with filter 0, in a zlib stream of stored deflate blocks
+            auto &filtered = frame.line;
+            filtered.clear();
+            for(int32_t y = 0; y < size.y; y++) {
+                filtered.push_back(0);
+                filtered.insert(filtered.end(), pixels + size_t(y) * size.x, pixels + size_t(y + 1) * size.x);
+            }
+            auto const dataStart = bytes.size();
+            appendBigEndian(bytes, 0); //length, filled below
+            bytes.insert(bytes.end(), { 'I', 'D', 'A', 'T', 0x78, 0x01 });
+            uint32_t a = 1, b = 0;
+            size_t offset = 0;
+            do {
+                auto const blockSize = misc::min<size_t>(filtered.size() - offset, 65535);
+                auto const isLast = offset + blockSize == filtered.size();
+                bytes.insert(bytes.end(), {
+                    uint8_t(isLast), uint8_t(blockSize), uint8_t(blockSize >> 8), uint8_t(~blockSize), uint8_t(~blockSize >> 8)
+                });
+                bytes.insert(bytes.end(), filtered.begin() + offset, filtered.begin() + offset + blockSize);
+                for(size_t i = offset; i < offset + blockSize; i++) {
+                    a = (a + filtered[i]) % 65521;
+                    b = (b + a) % 65521;
+                }
+                offset += blockSize;
+            } while(offset < filtered.size());
+            appendBigEndian(bytes, (b << 16) | a);
+            auto const chunkLength = uint32_t(bytes.size() - dataStart - 8);
+            for(int i = 0; i < 4; i++) bytes[dataStart + i] = uint8_t(chunkLength >> ((3 - i) * 8));
+            appendBigEndian(bytes, crc32(bytes.data() + dataStart + 4, bytes.size() - dataStart - 4));
+
+            appendPngChunk(bytes, "IEND", nullptr, 0);
+        }
+        break; case ExportFormat::y4m: {
+            static char const header[] = "FRAME\n";
+            bytes.insert(bytes.end(), header, header + sizeof(header) - 1);
+            bytes.insert(bytes.end(), pixels, pixels + pixelsCount);
+            auto const chromaSize = size_t(misc::intDivCeil(uint32_t(size.x), 2)) * misc::intDivCeil(uint32_t(size.y), 2);
+            bytes.resize(bytes.size() + chromaSize * 2, 128);
+        }
+        break;
+    }
+}
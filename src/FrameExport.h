@@ -0,0 +1,79 @@
+#pragma once
+
+#include<stdint.h>
+#include<condition_variable>
+#include<fstream>
+#include<memory>
+#include<mutex>
+#include<string>
+#include<thread>
+#include<vector>
+#include"Vector.h"
+
+enum class ExportFormat : uint8_t {
+    ppm, //<path>_<generation>.ppm for every frame
+    png, //<path>_<generation>.png, stored without compression
+    y4m  //one raw video stream at <path>
+};
+
+struct ExportOptions {
+    ExportFormat format = ExportFormat::y4m;
+    std::string path{};
+    //a cell is `pixelsPerCell` x `pixelsPerCell` pixels, or a pixel is `cellsPerPixel` x `cellsPerPixel` cells
+    //shaded by how many of them are alive. At most one of them is greater than 1
+    uint32_t pixelsPerCell = 1;
+    uint32_t cellsPerPixel = 1;
+    uint32_t threads = 1; //render and encode frames, one more thread writes them in order
+    uint32_t queueLength = 8; //frames submitted but not written yet
+    bool dropWhenFull = false; //submit() skips a frame instead of waiting for a free one
+    uint32_t framesPerSecond = 30; //of the y4m stream
+};
+
+//writes frames of the field drawn from packed cells, with the colors of fs.shader.
+//submit() only copies the cells into a preallocated frame of a bounded queue,
+//so the simulation waits only if the queue is full; frames are drawn, encoded and written by other threads
+class FrameExporter final {
+    struct Frame;
+
+    uint32_t width, height;
+    ExportOptions options;
+    vec2i size;
+
+    std::mutex lock;
+    std::condition_variable changed; //any frame changed its state or the exporter is stopped
+    std::vector<std::unique_ptr<Frame>> frames;
+    uint64_t nextSequence, nextWritten; //sequence of the next submitted frame and of the next one to write
+    uint64_t written, dropped;
+    bool isStopped, isFailed;
+
+    std::ofstream stream; //y4m only
+    std::vector<std::thread> workers;
+    std::thread writer;
+public:
+    FrameExporter(uint32_t const width_, uint32_t const height_, ExportOptions options_);
+    //writes every submitted frame first
+    ~FrameExporter();
+
+    FrameExporter(FrameExporter const&) = delete;
+    FrameExporter& operator=(FrameExporter const&) = delete;
+
+    //returns false if the stream can't be opened
+    bool start();
+
+    //`cells` is `height` rows of `rowLength` batches, bits past the width are ignored.
+    //Returns false if the frame was dropped
+    bool submit(uint32_t const *const cells, uint32_t const rowLength, uint64_t const generation);
+    //waits until every submitted frame is written
+    void finish();
+
+    vec2i frameSize() const { return size; }
+    //false if a write failed, frames after it are still encoded but not written
+    bool ok();
+    uint64_t framesWritten();
+    uint64_t framesDropped();
+private:
+    void work();
+    void writeFrames();
+    void drawFrame(Frame &frame) const;
+    void encodeFrame(Frame &frame) const;
+};
@@ -1,185 +1,108 @@
-#include"glew.h"
-#include<GLFW/glfw3.h>
-
 #include"Misc.h"
 #include"Grid.h"
+#include"GridInternal.h"
 #include<vector>
 
 #include<cassert> 
 
 #include"Timer.h"
 #include"AutoTimer.h"
-#include"MedianCounter.h"
+#include"LatencyHistogram.h"
+#include"Trace.h"
+#include"PerfCounters.h"
 
 #include<nmmintrin.h> 
 
 #include<algorithm>
-
-using Cells = uint32_t;
-static constexpr auto cellsBatchSize = 4;
-static constexpr auto cellsBatchLength = 32;
-
-struct Field::FieldPimpl {
-    using index_t = int32_t;
-
-    using BufferType = bool;
-    static constexpr BufferType bufCur = false;
-    static constexpr BufferType bufNext = true;
-
-    Cells* buffer;
-
-    int32_t width;
-    int32_t height;
-    int32_t rowLength;
-    bool edgeCellsOptimization;
-    bool buffersSwapped;
-
-
-public:
-    FieldPimpl(const int32_t gridWidth, const int32_t gridHeight) {
-        width = gridWidth;
-        height = gridHeight;
-        rowLength = misc::intDivCeil(width, cellsBatchLength);
-        edgeCellsOptimization = rowLength * cellsBatchLength - width >= 2; 
-
-        auto const bufferLen = bufferLength();
-        auto const paddingLen = bufferPaddingLength();
-        buffer = new Cells[bufferLen*2]{};
-        buffersSwapped = false;
-    }
-    ~FieldPimpl() = default;
-
-    void fixField(BufferType const type = bufCur) {
-        auto const paddingLen = bufferPaddingLength();
-        auto const gridLen = gridLength();
-        auto const buffer = getBuffer(type) + paddingLen;
-        auto const rowSize = rowLength * cellsBatchSize;
-
-        auto const firstEmptyRowCellBatch = width / cellsBatchLength;
-        auto const firstEmptyRowCellInBatch = width % cellsBatchLength;
-
-        //order is important as if there can be only one row,
-        //in which case this algorithm *should* still work:
-        //side neightbours algorithm requires one extra row ahead, which 
-        //we get as the end padding IS the next row. then we fix 
-        //the side neightbours for start and end padding and copy 
-        //start padding (not from -1 but from 0, as -1 can be outside the grid)
-
-        auto const startPaddingRow = buffer - rowLength;
-        auto const endPaddingRow = buffer + gridLen;
-
-        //copy end padding row
-        std::memcpy(endPaddingRow, buffer, rowSize);
-
-        //copy left/right neighbours to other side
-        if(edgeCellsOptimization) {
-            for(int32_t row = 0; row != height; row++) {
-                auto const rowOffset = row * rowLength;
-
-                auto &cells = *(buffer + rowOffset + firstEmptyRowCellBatch);
-
-                auto const firstCell = *(buffer + rowOffset) & 1;
-                auto const lastCell = (*(buffer + rowOffset + rowLength + rowLength-1) >> (firstEmptyRowCellInBatch-1)) & 1;
-
-                cells = (cells & ~(~0 << (firstEmptyRowCellInBatch)))
-                    | (firstCell << firstEmptyRowCellInBatch)
-                    | (lastCell << (cellsBatchLength-1));
-            }
-
-            //copy recalculated neighbours to padding.
-            *(startPaddingRow-1) = *(buffer + gridLen - rowLength - 1);
-            *(endPaddingRow + rowLength - 1) = *(buffer + rowLength - 1);
-        }
-
-        //copy start padding row
-        std::memcpy(startPaddingRow, buffer + gridLen - rowLength, rowSize);
+#include<cstring>
+#include<limits>
+
+//ranges of batches changed by a generation task, coalesced so that each one is written to the output at once
+struct DirtyRanges {
+    struct Range { uint32_t start, end; };
+    //unchanged batches between two changed ones that are written anyway instead of starting a new range
+    static constexpr uint32_t mergeGap = 4;
+    //ranges are preallocated so that tasks don't allocate, the last one grows to cover the rest
+    static constexpr size_t maxRanges = 256;
+
+    std::vector<Range> ranges;
+    std::vector<Range> unsorted; //reused by finish()
+    bool isSorted = true;
+
+    DirtyRanges() {
+        ranges.reserve(maxRanges);
+        unsorted.reserve(maxRanges);
     }
 
-    void swapBuffers() { buffersSwapped = !buffersSwapped; }
-
-    void fill(FieldCell const cell, BufferType const type = bufCur) {
-        auto grid = getBuffer(type);
-        const auto val = ~0u * cell;
-        std::fill(&grid[0], &grid[0] + bufferLength(), val);
+    void clear() {
+        ranges.clear();
+        isSorted = true;
     }
 
-    uint8_t cellAt_grid(int32_t const index, BufferType const type = bufCur) const {
-        auto grid = getBuffer(type);
-        const auto row = misc::intDivFloor(index, width);
-        const auto col = misc::mod(index, width);
-
-        const auto col_int = col / cellsBatchLength;
-        const auto shift = col % cellsBatchLength;
-
-        return (grid[bufferPaddingLength() + row * rowLength + col_int] >> shift) & 0b1;
-    }
-
-    void setCellAt(int32_t const index, FieldCell const cell, BufferType const type = bufCur) {
-        auto grid = getBuffer(type);
-
-        const auto row = misc::intDivFloor(index, int32_t(width));
-        const auto col = misc::mod(index, width);
-
-        const auto col_int = col / cellsBatchLength;
-        const auto shift = col % cellsBatchLength;
-
-        auto& cur{ grid[bufferPaddingLength() + row * rowLength + col_int] };
-
-        cur = (cur & ~(0b1u << shift)) | (static_cast<uint32_t>(cell) << shift);
-    }
-
-    uint32_t& getCellsActual_int(int32_t const index_actual_int, BufferType const type = bufCur) const {
-        return getBuffer(type)[index_actual_int + bufferPaddingLength()];
+    void add(uint32_t const start, uint32_t const end) {
+        if(!ranges.empty()) {
+            auto &last = ranges.back();
+            if(start >= last.start && start <= last.end + mergeGap) {
+                last.end = misc::max(last.end, end);
+                return;
+            }
+            if(start < last.start) isSorted = false;
+            if(ranges.size() == maxRanges) {
+                last.start = misc::min(last.start, start);
+                last.end = misc::max(last.end, end);
+                return;
+            }
+        }
+        ranges.push_back(Range{ start, end });
     }
 
-    uint32_t cellI2BatchI(const uint32_t index) const {
-        const auto row = misc::intDivFloor(index, width);
-        const auto col = misc::mod(index, width);
-
-        const auto col_int = col / cellsBatchLength;
-
-        return row * rowLength + col_int;
+    //bit `i` of `mask` is set if batch `base + i` changed
+    void addMask(uint32_t const base, uint32_t mask) {
+        while(mask != 0) {
+            auto const start = uint32_t(__builtin_ctz(mask));
+            auto const rest = mask >> start;
+            auto const length = rest == ~0u ? cellsBatchLength : uint32_t(__builtin_ctz(~rest));
+            add(base + start, base + start + length);
+            if(start + length == cellsBatchLength) break;
+            mask &= ~0u << (start + length);
+        }
     }
 
-    Cells *getBuffer(BufferType const type) const {
-        auto const offset = (type == bufNext) ^ buffersSwapped ? bufferLength() : 0;
-        return buffer + offset;
-    }
-    uint32_t gridLength() const {
-        return height * rowLength;
-    }
-    uint32_t bufferPaddingLength() const {
-        return rowLength + 1/*
-            extra row before/after the grid repeating the opposite row 
-            and 1 cell on each side for the first/last cell's neighbour,
-            padding after can be 1 shorter but not when width % batchSize, 
-            so it is +1 always for consistency
-        */;
-    }
-    uint32_t bufferLength() const {
-        return gridLength() + 2*bufferPaddingLength();
+    //sorts and merges ranges added out of order
+    void finish() {
+        if(isSorted) return;
+        std::sort(ranges.begin(), ranges.end(), [](Range const a, Range const b) { return a.start < b.start; });
+        std::swap(ranges, unsorted);
+        clear();
+        for(auto const range : unsorted) add(range.start, range.end);
     }
 };
 
 struct Field::GridData {
 private: static const uint32_t samples = 100;
 public:
-    UMedianCounter gridUpdate{ samples }, bufferSend{ samples };
+    LatencyHistogram gridUpdate, bufferSend;
     uint32_t task__iteration;
     uint32_t task__index;
+    std::string traceName;
+    bool isTraceNamed;
 
     std::unique_ptr<FieldPimpl>& grid;
     std::atomic_bool& interrupt_flag;
+    std::atomic_bool& perfCountersEnabled;
+    std::unique_ptr<PerfCounters> perfCounters; //opened by the task thread on first use
     uint32_t startBatch;
     uint32_t endBatch;
     std::unique_ptr<FieldOutput> const buffer_output;
+    std::unique_ptr<FieldOutput> const output_batch; //reused for every generation
+
+    GenerationStats stats; //of batches in [startBatch; endBatch)
+    std::vector<uint32_t> columnCells;
+    DirtyRanges dirtyRanges; //batches that differ from the previous contents of the next buffer
+    bool isOutputStale; //the last run was interrupted after changing batches that weren't written
 
     void generationUpdated() {
         task__iteration++;
-        if (task__iteration % (samples + task__index) == 0)
-            std::cout << "grid task " << task__index << ": "
-            << gridUpdate.median() << ' '
-            << bufferSend.median() << std::endl;
     }
 
 public:
@@ -187,136 +110,142 @@ public:
         uint32_t index_,
         std::unique_ptr<FieldPimpl>& grid_,
         std::atomic_bool& interrupt_flag_,
+        std::atomic_bool& perfCountersEnabled_,
         uint32_t startBatch_,
         uint32_t endBatch_,
         std::unique_ptr<FieldOutput> &&output_
     ) :
         task__iteration{ 0 },
         task__index(index_),
+        traceName{ "grid task " + std::to_string(index_) },
+        isTraceNamed{ false },
         grid(grid_),
         interrupt_flag(interrupt_flag_),
+        perfCountersEnabled(perfCountersEnabled_),
+        perfCounters{},
         startBatch(startBatch_),
         endBatch  (endBatch_),
-        buffer_output{ std::move(output_) }
+        buffer_output{ std::move(output_) },
+        output_batch{ buffer_output->batched() },
+        stats{},
+        columnCells(grid_->rowLength),
+        dirtyRanges{},
+        isOutputStale{ false }
     {}
 };
 
-struct Remainder {
-    uint16_t cellsCols;
-    uint8_t curCell;
-};
-//computes new generation for 32 cells:
-//one from previous remainder and 31 cells at *base.
-//also computes remainder for next iteration (for the cast cell of *base)
-static uint32_t newGenerationBatched(
-    Remainder const previousRemainder,
-    Cells *base,
-    int32_t const rowLength,
-    Remainder &currentRemainder_out
-) {
-    // [0, 16] [1, 17] ... [15, 31], where for cells x, y: [x, y] means 0b000y'000x
-    auto const unpackCellsAs4Bits = [](const uint32_t number) -> __m128i {
-        auto const cellPosForByteMask = _mm_setr_epi8(
-            1, 2, 4, 8, 16, 32, 64, 128u,
-            1, 2, 4, 8, 16, 32, 64, 128u
-        );
-
-        auto const numberReg = _mm_cvtsi32_si128(number);
-        auto const numberDupBytes = _mm_unpacklo_epi8(numberReg, numberReg);
-
-        auto const numQuadrupleLowBytes = _mm_shufflelo_epi16(numberDupBytes, 0b01'01'00'00);
-        auto const numberLowHalf = _mm_shuffle_epi32(numQuadrupleLowBytes, 0b01'01'00'00); 
-        auto const isLowCell = _mm_cmpeq_epi8(_mm_and_si128(numberLowHalf, cellPosForByteMask), cellPosForByteMask);
-
-        auto const numQuadrupleHighBytes = _mm_shufflelo_epi16(numberDupBytes, 0b11'11'10'10);
-        auto const numberHighHalf = _mm_shuffle_epi32(numQuadrupleHighBytes, 0b01'01'00'00); 
-        auto const isHighCell = _mm_cmpeq_epi8(_mm_and_si128(numberHighHalf, cellPosForByteMask), cellPosForByteMask);
-
-        return _mm_sub_epi8(_mm_and_si128(isHighCell, _mm_set1_epi8(0b0001'0000)), isLowCell)/*
-            low is either:
-                true (-1), then  high&16 - -1  =>  high&16 | 1
-                false (0), then  high&16 -  0  =>  high&16
-            which is eqivalent of  high&16 | low&1
-        */;
-    };
-
-    auto const topBatch = unpackCellsAs4Bits(*(base - rowLength));
-    auto const curBatch = unpackCellsAs4Bits(*base);
-    auto const botBatch = unpackCellsAs4Bits(*(base + rowLength));
+static constexpr uint32_t hashKey1 = 0x9e3779b9u, hashKey2 = 0x7f4a7c15u, hashKey2Offset = 0x165667b1u;
+static constexpr uint32_t mixMultiplier1 = 0x85ebca6bu, mixMultiplier2 = 0xc2b2ae35u;
 
-    auto const verticalSum = _mm_add_epi8(topBatch, _mm_add_epi8(curBatch, botBatch));
+//murmur3 32-bit finalizer
+static uint32_t mixBits(uint32_t bits) {
+    bits ^= bits >> 16;
+    bits *= mixMultiplier1;
+    bits ^= bits >> 13;
+    bits *= mixMultiplier2;
+    return bits ^ (bits >> 16);
+}
 
-    currentRemainder_out.curCell = (_mm_extract_epi16(curBatch, 7) >> 12); //_epi8 is sse 4.1
-    currentRemainder_out.cellsCols = (_mm_extract_epi16(verticalSum, 7) >> 4) & 0b1111'00001111;
+//mixBits() of 4 lanes
+static __m128i mixBits4(__m128i bits) {
+    bits = _mm_xor_si128(bits, _mm_srli_epi32(bits, 16));
+    bits = _mm_mullo_epi32(bits, _mm_set1_epi32(int(mixMultiplier1)));
+    bits = _mm_xor_si128(bits, _mm_srli_epi32(bits, 13));
+    bits = _mm_mullo_epi32(bits, _mm_set1_epi32(int(mixMultiplier2)));
+    return _mm_xor_si128(bits, _mm_srli_epi32(bits, 16));
+}
 
-    auto const first16Mask = _mm_set1_epi8(0b00001111u); //unnecessary if _slli_epi8 existed
-    auto const curRowCentered_carry = _mm_slli_epi16(_mm_and_si128(curBatch, first16Mask), 4);
-    auto const verticalSum_carry = _mm_slli_epi16(_mm_and_si128(verticalSum, first16Mask), 4);
+//hash of a batch at its position. Hashes of all batches are summed,
+//so bands can be combined in any order and single batches can be replaced.
+//The high half mixes the cells keyed by the index, the low half mixes the high half keyed by the index again
+static uint64_t hashCells(uint32_t const cells, int32_t const index_actual_int) {
+    auto const index = uint32_t(index_actual_int);
+    auto const high = mixBits(cells ^ (index * hashKey1));
+    auto const low = mixBits(high ^ (index * hashKey2 + hashKey2Offset));
+    return (uint64_t(high) << 32) | low;
+}
 
-    //using _or instead of _add because .curCell is in lower 4 bits and carry is in higher 4
-    auto const curRowCentered = _mm_or_si128(
-        _mm_alignr_epi8(curBatch, curRowCentered_carry, 15), 
-        _mm_cvtsi32_si128(previousRemainder.curCell)
-    );
-    auto const cells3by3 = _mm_add_epi8(
-        _mm_add_epi8(
-            _mm_add_epi8(
-                _mm_alignr_epi8(verticalSum, verticalSum_carry, 14),
-                _mm_alignr_epi8(verticalSum, verticalSum_carry, 15)
-            ),
-            verticalSum // ~ alignr(..., 16)
-        ),
-        _mm_cvtsi32_si128(previousRemainder.cellsCols + (previousRemainder.cellsCols >> 8))
+//hashCells() and popcount of 4 consecutive batches starting at `index_actual_int`
+static void addCellsStats4(
+    __m128i const cells, int32_t const index_actual_int, 
+    __m128i &hash_inout, __m128i &population_inout
+) {
+    auto const index = _mm_add_epi32(_mm_set1_epi32(index_actual_int), _mm_setr_epi32(0, 1, 2, 3));
+    auto const high = mixBits4(_mm_xor_si128(cells, _mm_mullo_epi32(index, _mm_set1_epi32(int(hashKey1)))));
+    auto const low = mixBits4(_mm_xor_si128(high, _mm_add_epi32(
+        _mm_mullo_epi32(index, _mm_set1_epi32(int(hashKey2))), 
+        _mm_set1_epi32(int(hashKey2Offset))
+    )));
+    hash_inout = _mm_add_epi64(hash_inout, _mm_add_epi64(_mm_unpacklo_epi32(low, high), _mm_unpackhi_epi32(low, high)));
+
+    auto const nibbleCounts = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    auto const lowNibbles = _mm_set1_epi8(0x0f);
+    auto const counts = _mm_add_epi8(
+        _mm_shuffle_epi8(nibbleCounts, _mm_and_si128(cells, lowNibbles)),
+        _mm_shuffle_epi8(nibbleCounts, _mm_and_si128(_mm_srli_epi16(cells, 4), lowNibbles))
     );
+    population_inout = _mm_add_epi64(population_inout, _mm_sad_epu8(counts, _mm_setzero_si128()));
+}
 
-    auto const cellsNeighboursAlive = _mm_sub_epi8(cells3by3, curRowCentered);
-    auto const cells = _mm_or_si128(cellsNeighboursAlive, curRowCentered);
-    static_assert(
-        (2 | 1) == 3 && (3 | 1) == 3 && (3 | 0) == 3 && true,
-        R"(must be true:
-            1, 2) (2 or 3 cells) | (alive cell) == 3
-            3) (3 cells) | (dead  cell) == 3
-            4) other combitations != 3
-        )"
-    );
+static GenerationStats emptyStats() {
+    GenerationStats stats{};
+    stats.boundsMin = vec2i(std::numeric_limits<int32_t>::max());
+    stats.boundsMax = vec2i(std::numeric_limits<int32_t>::min());
+    return stats;
+}
 
-    auto const mask_lower = _mm_set1_epi8(0b1111u);
-    auto const three = _mm_set1_epi8(3u);
-
-    uint32_t const lower16 = _mm_movemask_epi8(_mm_cmpeq_epi8(
-        _mm_and_si128(mask_lower, cells),
-        three
-    ));
-    uint32_t const higher16 = _mm_movemask_epi8(_mm_cmpeq_epi8(
-        _mm_andnot_si128(mask_lower, cells),
-        _mm_slli_epi16(three, 4)
-    ));
-
-    return lower16 | (higher16 << 16);
-}
-
-static Remainder calcRemainder(Field::FieldPimpl const &grid, int32_t const batchIndex) {
-    auto const buffer = grid.getBuffer(Field::FieldPimpl::bufCur);
-    auto const base = buffer + grid.bufferPaddingLength() + batchIndex -  1;
-    auto const top  = *(base - grid.rowLength);
-    auto const prev = *(base);
-    auto const next = *(base + grid.rowLength);
-    auto const at = [](uint32_t const value, int const offset) {
-        return (value >> offset) & 1;
-    };
+//cells must not contain padding
+static void addCellsBounds(GenerationStats &stats, uint32_t const cells, int32_t const column_int, int32_t const row) {
+    if(cells == 0) return;
+    auto const firstCol = column_int * cellsBatchLength + __builtin_ctz(cells);
+    auto const lastCol = column_int * cellsBatchLength + (cellsBatchLength - 1 - __builtin_clz(cells));
+    stats.boundsMin = vec2i(misc::min(stats.boundsMin.x, firstCol), misc::min(stats.boundsMin.y, row));
+    stats.boundsMax = vec2i(misc::max(stats.boundsMax.x, lastCol), misc::max(stats.boundsMax.y, row));
+}
 
-    return {
-        uint16_t(
-            (at(top, 30) + at(prev, 30) + at(next, 30))
-            + ((at(top, 31) + at(prev, 31) + at(next, 31)) << 8)
-        ),
-        (bool) at(prev, 31)
-    };
+static void combineStats(GenerationStats &stats, GenerationStats const &other) {
+    stats.hash += other.hash;
+    stats.population += other.population;
+    stats.boundsMin = vec2i(misc::min(stats.boundsMin.x, other.boundsMin.x), misc::min(stats.boundsMin.y, other.boundsMin.y));
+    stats.boundsMax = vec2i(misc::max(stats.boundsMax.x, other.boundsMax.x), misc::max(stats.boundsMax.y, other.boundsMax.y));
+    stats.perf.add(other.perf);
+}
+
+//bounds of the alive cells of the next buffer, scanned again
+static void rescanBounds(GenerationStats &stats, Field::FieldPimpl const &grid) {
+    stats.boundsMin = emptyStats().boundsMin;
+    stats.boundsMax = emptyStats().boundsMax;
+    auto const rowLen = int32_t(grid.rowLength);
+    for(int32_t index = 0; index < int32_t(grid.gridLength()); index++) {
+        auto const cells = grid.maskedCells(grid.getCellsActual_int(index, Field::FieldPimpl::bufNext), index);
+        addCellsBounds(stats, cells, index % rowLen, index / rowLen);
+    }
 }
 
+//batch at `index_actual_int` was changed from `oldCells` to `newCells`, both with padding bits.
+//Bounds are not updated, alive cells extend them with addCellsBounds() and removed ones can shrink them
+static void replaceCellsStats(
+    GenerationStats &stats, Field::FieldPimpl const &grid, 
+    uint32_t const oldCells, uint32_t const newCells, int32_t const index_actual_int
+) {
+    auto const oldCells_m = grid.maskedCells(oldCells, index_actual_int);
+    auto const newCells_m = grid.maskedCells(newCells, index_actual_int);
+    stats.hash += hashCells(newCells_m, index_actual_int) - hashCells(oldCells_m, index_actual_int);
+    stats.population += int64_t(_mm_popcnt_u32(newCells_m)) - _mm_popcnt_u32(oldCells_m);
+}
 
 static void threadUpdateGrid(Field::GridData& data) {
     Timer<> t{};
+    if(!data.isTraceNamed && trace::isEnabled()) {
+        trace::setThreadName(data.traceName.c_str());
+        data.isTraceNamed = true;
+    }
+    auto const isPerfCounted = data.perfCountersEnabled.load();
+    if(isPerfCounted) {
+        //counters measure the thread that opens them
+        if(!data.perfCounters) data.perfCounters.reset(new PerfCounters());
+        data.perfCounters->start();
+    }
     auto& grid = *data.grid.get();
     int32_t const width_grid = static_cast<int32_t>(grid.width);
     int32_t const width_int = static_cast<int32_t>(grid.rowLength);
@@ -334,6 +263,83 @@ static void threadUpdateGrid(Field::GridData& data) {
     auto const buffer = grid.getBuffer(Field::FieldPimpl::bufCur) + grid.bufferPaddingLength();
     auto const rowLen = grid.rowLength;
 
+    //stats are accumulated right after a chunk of batches is written, while it is still in cache
+    auto const bufferNext = grid.getBuffer(Field::FieldPimpl::bufNext) + grid.bufferPaddingLength();
+    auto const lastBatchMask = grid.lastBatchMask();
+    //without edge cells optimization the first and last cells in a row are wrong until fixed below,
+    //and bounds can't be shrunk after that
+    auto const firstBoundsMask = grid.edgeCellsOptimization ? ~0u : ~1u;
+    auto const lastBoundsMask = grid.edgeCellsOptimization ? lastBatchMask 
+        : lastBatchMask & ~(1u << ((grid.width - 1) % cellsBatchLength));
+    auto stats = emptyStats();
+    auto& columnCells = data.columnCells; //all rows of the band ORed together
+    std::fill(columnCells.begin(), columnCells.end(), 0u);
+    int32_t row = startBatch / rowLen;
+    int32_t rowEnd = (row + 1) * rowLen;
+    int32_t firstRow = -1, lastRow = -1;
+
+    auto const accumulateStats = [&](int32_t index, int32_t const endIndex) {
+        while(index < endIndex) {
+            auto const rowStart = rowEnd - rowLen;
+            auto const segmentEnd = misc::min(endIndex, rowEnd);
+            uint32_t rowCells = 0;
+            auto const addCells = [&](int32_t const index, uint32_t const cells, uint32_t const boundsCells) {
+                stats.hash += hashCells(cells, index);
+                stats.population += _mm_popcnt_u32(cells);
+                columnCells[index - rowStart] |= boundsCells;
+                rowCells |= boundsCells;
+            };
+
+            auto const isRowEnd = segmentEnd == rowEnd;
+            if(index == rowStart && !(isRowEnd && rowLen == 1)) {
+                addCells(index, bufferNext[index], bufferNext[index] & firstBoundsMask);
+                index++;
+            }
+            auto const plainEnd = segmentEnd - isRowEnd;
+            {
+                auto hash = _mm_setzero_si128(), population = _mm_setzero_si128(), rowCells4 = _mm_setzero_si128();
+                for(; index + 4 <= plainEnd; index += 4) {
+                    auto const cells = _mm_loadu_si128(reinterpret_cast<__m128i const*>(bufferNext + index));
+                    addCellsStats4(cells, index, hash, population);
+
+                    auto *const column = reinterpret_cast<__m128i*>(&columnCells[index - rowStart]);
+                    _mm_storeu_si128(column, _mm_or_si128(_mm_loadu_si128(column), cells));
+                    rowCells4 = _mm_or_si128(rowCells4, cells);
+                }
+                stats.hash += uint64_t(_mm_cvtsi128_si64(hash)) + uint64_t(_mm_extract_epi64(hash, 1));
+                stats.population += uint64_t(_mm_cvtsi128_si64(population)) + uint64_t(_mm_extract_epi64(population, 1));
+                rowCells4 = _mm_or_si128(rowCells4, _mm_srli_si128(rowCells4, 8));
+                rowCells |= uint32_t(_mm_cvtsi128_si32(_mm_or_si128(rowCells4, _mm_srli_si128(rowCells4, 4))));
+            }
+            for(; index < plainEnd; index++) {
+                addCells(index, bufferNext[index], bufferNext[index]);
+            }
+            if(isRowEnd) {
+                auto const cells = bufferNext[index] & lastBatchMask;
+                addCells(index, cells, cells & lastBoundsMask & (rowLen == 1 ? firstBoundsMask : ~0u));
+                index++;
+
+                row++;
+                rowEnd += rowLen;
+            }
+
+            if(rowCells != 0) {
+                if(firstRow == -1) firstRow = row - isRowEnd;
+                lastRow = row - isRowEnd;
+            }
+        }
+    };
+    auto statsIndex = startBatch;
+    data.stats = emptyStats();
+
+    //the next buffer holds the generation before the current one, and so does the output.
+    //Only batches that differ from it are written
+    auto &dirty = data.dirtyRanges;
+    dirty.clear();
+    auto const isOutputStale = data.isOutputStale;
+    data.isOutputStale = true; //until the output is written
+    TraceSpan sweepSpan{ "kernel sweep" };
+
     if (i < endBatch + 1) {
         auto const newGen = newGenerationBatched(previousRemainder, buffer + i, rowLen, previousRemainder/*out param*/);
 
@@ -343,14 +349,20 @@ static void threadUpdateGrid(Field::GridData& data) {
     }
 
     for (auto const j_count = 32; (i + j_count) < endBatch + 1;) {
+        uint32_t changed = 0;
         for (uint32_t j = 0; j < j_count; ++j, ++i) {
             auto const newGen = newGenerationBatched(previousRemainder, buffer + i, rowLen, previousRemainder/*out param*/);
 
             newGenWindow = (newGenWindow >> 32) | (uint64_t(newGen) << 31);
-            grid.getCellsActual_int(i - 1, Field::FieldPimpl::bufNext) = uint32_t(newGenWindow);
+            auto const cells = uint32_t(newGenWindow);
+            changed |= uint32_t(bufferNext[i - 1] != cells) << j;
+            bufferNext[i - 1] = cells;
 
             //_mm_stream_si32((int*)&grid.getCellsActual_int<Field::FieldPimpl::buffer>(i_batch - 1), (int)uint32_t(newGenWindow));
         }
+        dirty.addMask(i - 1 - j_count, changed);
+        accumulateStats(statsIndex, i - 1);
+        statsIndex = i - 1;
 
         if (data.interrupt_flag.load()) return;
     }
@@ -359,115 +371,75 @@ static void threadUpdateGrid(Field::GridData& data) {
         auto const newGen = newGenerationBatched(previousRemainder, buffer + i, rowLen, previousRemainder/*out param*/);
 
         newGenWindow = (newGenWindow >> 32) | (uint64_t(newGen) << 31);
-        grid.getCellsActual_int(i - 1, Field::FieldPimpl::bufNext) = uint32_t(newGenWindow);
+        auto const cells = uint32_t(newGenWindow);
+        if(bufferNext[i - 1] != cells) dirty.add(i - 1, i);
+        bufferNext[i - 1] = cells;
     }
+    accumulateStats(statsIndex, i - 1);
 
     if (data.interrupt_flag.load()) return;
 
+    if(firstRow != -1) {
+        auto const firstCol = std::find_if(columnCells.begin(), columnCells.end(), [](uint32_t const cells) { return cells != 0; });
+        auto const lastCol = std::find_if(columnCells.rbegin(), columnCells.rend(), [](uint32_t const cells) { return cells != 0; });
+        addCellsBounds(stats, *firstCol & (~*firstCol + 1), int32_t(firstCol - columnCells.begin()), firstRow);
+        addCellsBounds(stats, 1u << (cellsBatchLength - 1 - __builtin_clz(*lastCol)), int32_t(columnCells.rend() - lastCol - 1), lastRow);
+    }
+    sweepSpan.end();
 
     if (grid.edgeCellsOptimization == false) {
-        auto const setBufferCellAt = [&grid](uint32_t index, FieldCell cell) -> void { grid.setCellAt(index, cell, Field::FieldPimpl::bufNext); };
+        TraceSpan span{ "edge fixup" };
+        //first and last cells of rows that cross band boundary are fixed by the band that owns their batch
+        auto const lastCellShift = (width_grid - 1) % cellsBatchLength;
+        auto const setBufferCellAt = [&](uint32_t const rowIndex, bool const isLastCell, FieldCell const cell) -> void {
+            auto const index_actual_int = int32_t(rowIndex * rowLen + (isLastCell ? rowLen - 1 : 0));
+            if(index_actual_int < startBatch || index_actual_int >= endBatch) return;
+
+            auto const shift = isLastCell ? lastCellShift : 0;
+            auto const mask = (isLastCell || rowLen == 1) ? lastBatchMask : ~0u;
+            auto &cells = bufferNext[index_actual_int];
+            auto const oldCells = cells & mask;
+            auto const kernelCells = cells;
+            cells = (cells & ~(1u << shift)) | (uint32_t(cell) << shift);
+            auto const newCells = cells & mask;
+            if(cells != kernelCells) dirty.add(index_actual_int, index_actual_int + 1);
+
+            stats.hash += hashCells(newCells, index_actual_int) - hashCells(oldCells, index_actual_int);
+            stats.population += int64_t(_mm_popcnt_u32(newCells)) - _mm_popcnt_u32(oldCells);
+            if(cell) addCellsBounds(stats, 1u << shift, isLastCell ? rowLen - 1 : 0, rowIndex);
+        };
 
         auto const fullWidth = grid.rowLength * cellsBatchLength;
         uint32_t const height = grid.height;
-        int32_t  const lastElement = width_grid - 1;
 
         const uint32_t startRow = startIndex / fullWidth;
         const uint32_t endRow = misc::min<uint32_t>(misc::intDivCeil(endIndex + 1, fullWidth), height);
 
-        const auto isCell = [&grid](int32_t index) -> uint8_t {
-            return grid.cellAt_grid(index);
-        };
-        const auto cellAt = [&grid](int32_t index) -> FieldCell {
-            return grid.cellAt_grid(index);
-        };
-
-        {
-            const int32_t row = startRow * width_grid;
-
-            uint8_t //top/cur/bot + first/second/last
-                tf = isCell(row + -width_grid),
-                ts = isCell(row + -width_grid + 1),
-                tl = isCell(row + -width_grid + lastElement),
-                cf = isCell(row + 0),
-                cs = isCell(row + 1),
-                cl = isCell(row + lastElement);
-
-            for (uint32_t rowIndex = startRow; rowIndex < endRow; rowIndex++) {
-                const int32_t row = rowIndex * width_grid;
-
-                uint8_t
-                    bf = isCell(row + width_grid),
-                    bs = isCell(row + width_grid + 1),
-                    bl = isCell(row + width_grid + lastElement);
-                //first element
-                {
-                    const int index = row;
-                    const auto curCell = cellAt(index);
-                    const unsigned char    topRowNeighbours = tf + ts + tl;
-                    const unsigned char bottomRowNeighbours = bf + bs + bl;
-                    const unsigned char aliveNeighbours = topRowNeighbours + cl + cs + bottomRowNeighbours;
-
-                    setBufferCellAt(index, fieldCell::nextGeneration(curCell, aliveNeighbours));
-                }
-
-                tf = cf;
-                ts = cs;
-                tl = cl;
-                cf = bf;
-                cs = bs;
-                cl = bl;
-            }
-        }
+        updateEdgeCells(grid, startRow, endRow, setBufferCellAt);
         if (data.interrupt_flag.load()) return;
+    }
 
-        {
-            const int32_t row = startRow * width_grid;
-
-            uint8_t //top/cur/bot + first/last/pre-last
-                tf = isCell(row + -width_grid),
-                tl = isCell(row + -width_grid + lastElement),
-                tp = isCell(row + -width_grid + lastElement - 1),
-                cf = isCell(row + 0),
-                cl = isCell(row + lastElement),
-                cp = isCell(row + lastElement - 1);
-
-            for (uint32_t rowIndex = startRow; rowIndex < endRow; rowIndex++) {
-                const int32_t row = rowIndex * width_grid;
-
-                uint8_t
-                    bf = isCell(row + width_grid),
-                    bp = isCell(row + width_grid + lastElement - 1),
-                    bl = isCell(row + width_grid + lastElement);
-
-                { //last element
-                    const int index = row + lastElement;
-                    const auto curCell = cellAt(index);
-                    const uint8_t    topRowNeighbours = tp + tl + tf;
-                    const uint8_t bottomRowNeighbours = bp + bl + bf;
-                    const uint8_t     aliveNeighbours = topRowNeighbours + cp + cf + bottomRowNeighbours;
-
-                    setBufferCellAt(index, fieldCell::nextGeneration(curCell, aliveNeighbours));
-                }
+    data.stats = stats;
+    data.gridUpdate.record(t.elapsedNanoseconds());
 
-                tf = cf;
-                tp = cp;
-                tl = cl;
-                cf = bf;
-                cp = bp;
-                cl = bl;
+    Timer<> t2{};
+    {
+        TraceSpan span{ "output write" };
+        if(isOutputStale) {
+            dirty.clear();
+            dirty.add(startBatch, endBatch);
+        }
+        dirty.finish();
+        if(!dirty.ranges.empty()) {
+            for(auto const range : dirty.ranges) {
+                data.output_batch->write(FieldModification{ range.start, range.end - range.start, &grid.getCellsActual_int(range.start, Field::FieldPimpl::bufNext) });
             }
+            data.output_batch->finishBatch();
         }
-        if (data.interrupt_flag.load()) return;
+        data.isOutputStale = false;
     }
-
-    data.gridUpdate.add(t.elapsedTime());
-
-    Timer<> t2{};
-     
-    data.buffer_output->write(FieldModification{ data.startBatch, data.endBatch - data.startBatch, &grid.getCellsActual_int(startBatch, Field::FieldPimpl::bufNext) });
-
-    data.bufferSend.add(t2.elapsedTime());
+    data.bufferSend.record(t2.elapsedNanoseconds());
+    if(isPerfCounted) data.stats.perf = data.perfCounters->stop();
 
     const uint32_t j = 1 << (data.task__iteration % (((grid.width-1) % 32) + 1));
     const uint32_t zero = 0;
@@ -493,6 +465,63 @@ uint32_t* Field::rawData() const {
     return &this->gridPimpl->getCellsActual_int(0);
 }
 
+void Field::printTaskTimings(std::ostream &out) const {
+    for(uint32_t i = 0; i < numberOfTasks; i++) {
+        auto const &data = gridTasks.get()[i]->data;
+        out << data.traceName << ": update p50=" << data.gridUpdate.p50() / 1000.0 << "us, p99=" << data.gridUpdate.p99() / 1000.0
+            << "us, send p50=" << data.bufferSend.p50() / 1000.0 << "us, p99=" << data.bufferSend.p99() / 1000.0 << "us" << std::endl;
+    }
+}
+
+//first batch of band `band` of `bandsCount`, the next band starts where it ends.
+//Outputs don't make bands wait for each other, so they get equal work
+static uint32_t bandStart(uint64_t const gridLength, uint32_t const band, uint32_t const bandsCount) {
+    return uint32_t(gridLength * band / bandsCount);
+}
+
+//copies the cells of `from` to `to` moved by `offset`, cells of `to` that are not covered are left as they are.
+//Rows of `to` are written a batch at a time from a window of two batches of `from`
+static void copyMoved(Field::FieldPimpl const &from, Field::FieldPimpl &to, vec2i const offset) {
+    auto const firstColumn = misc::max(0, offset.x), endColumn = misc::min(to.width, from.width + offset.x);
+    auto const firstRow = misc::max(0, offset.y), endRow = misc::min(to.height, from.height + offset.y);
+    if(firstColumn >= endColumn || firstRow >= endRow) return;
+
+    auto const firstBatch = firstColumn / cellsBatchLength, endBatch = int32_t(misc::intDivCeil(endColumn, cellsBatchLength));
+    auto const firstMask = ~0u << (firstColumn % cellsBatchLength);
+    auto const lastMask = endColumn % cellsBatchLength == 0 ? ~0u : ((1u << (endColumn % cellsBatchLength)) - 1);
+    //batch `b` of `to` is cells [shift; shift + 32) of batches `b + batchOffset` and the one after it of `from`.
+    //Padding bits of `from` only reach the masked part of the last batch
+    auto const batchOffset = misc::intDivFloor(-offset.x, cellsBatchLength);
+    auto const shift = uint32_t(misc::mod(-offset.x, cellsBatchLength));
+    auto const sourceBatch = [&](Cells const *const row, int32_t const batch) -> uint64_t {
+        return batch >= 0 && batch < from.rowLength ? row[batch] : 0;
+    };
+
+    auto const movedBatch = [&](Cells const *const row, int32_t const batch) {
+        auto const first = batch + batchOffset;
+        auto window = sourceBatch(row, first);
+        if(shift != 0) window |= sourceBatch(row, first + 1) << cellsBatchLength;
+        return uint32_t(window >> shift);
+    };
+
+    for(auto row = firstRow; row < endRow; row++) {
+        auto const source = &from.getCellsActual_int((row - offset.y) * from.rowLength);
+        auto const destination = &to.getCellsActual_int(row * to.rowLength);
+        destination[firstBatch] = movedBatch(source, firstBatch) & firstMask;
+        if(firstBatch == endBatch - 1) {
+            destination[firstBatch] &= lastMask;
+            continue;
+        }
+        //batches between the first and the last one have only cells of `from` in their window
+        auto const middle = source + firstBatch + 1 + batchOffset;
+        auto const middleCount = size_t(endBatch - firstBatch - 2);
+        if(shift == 0) std::memcpy(destination + firstBatch + 1, middle, middleCount * cellsBatchSize);
+        else for(size_t i = 0; i < middleCount; i++) {
+            destination[firstBatch + 1 + i] = uint32_t(((uint64_t(middle[i + 1]) << cellsBatchLength) | middle[i]) >> shift);
+        }
+        destination[endBatch - 1] = movedBatch(source, endBatch - 1) & lastMask;
+    }
+}
 
 Field::Field(
     const uint32_t gridWidth, const uint32_t gridHeight, const size_t numberOfTasks_,
@@ -503,41 +532,37 @@ Field::Field(
     isStopped{ false },
     current_output{ current_outputs() },
     buffer_output{ buffer_outputs() },
+    repair_output{ buffer_output->batched() },
     numberOfTasks(numberOfTasks_),
     gridTasks{ new std::unique_ptr<Task<GridData>>[numberOfTasks_] },
     interrupt_flag{ false },
-    indecesToBrokenCells{ }
+    perfCountersEnabled{ false },
+    bandPerfSamples(numberOfTasks_),
+    brokenBatches{ },
+    editedBatches{ },
+    repairedBatches{ },
+    strokeSpans{ },
+    journal{ },
+    isJournalReplaying{ false },
+    hashHistory(hashHistorySize, GenerationHash{ 0, noGeneration }),
+    hashHistoryHead{ 0 },
+    candidatePeriod{ 0 },
+    candidateGeneration{ 0 },
+    candidateCells{ },
+    currentGeneration{ 0 },
+    currentPeriod{ 0 },
+    lastGenerationStats{ emptyStats() },
+    isGenerationFinalized{ true },
+    isSnapshotting{ false },
+    snapshots{},
+    pyramids{},
+    currentPyramid{ 0 },
+    isNextPyramidStale{ false },
+    pyramidBatches{}
 {
     assert(numberOfTasks >= 1);
 
-    //grid update == 50 ms, buffer send == 4 ms.In my case
-    //4 / 50 ~= 1 / 20 
-    const double fraction = .05; // fractionOfWorkTimeToSendData
-    static_assert(true, ""/*
-    find amountOfWorkT1. given fraction, workload (total batches)
-    amountOfWorkT1 - percent of work;
-
-    timeForTask1 = amountOfWorkT1 + amountOfWorkT1 * fraction;
-    timeForTask2 = timeForTask1 + timeForTask1 * fraction;
-    timeForTask3 = timeForTask2 + timeForTask2 * fraction;
-    ...
-
-                                                                v  total time
-    timeForTask1 + timeForTask2 + timeForTask3 + ... = workload * (1.0 + fraction);
-    amountOfWorkT1 * (1.0 + fraction)
-        + (amountOfWorkT1 * (1.0 + fraction)) * (1.0  + fraction)
-        + ...                                                       = workload * (1.0 + fraction);
-    amountOfWorkT1 * (1.0 + fraction) + amountOfWorkT1 * (1.0  + fraction)^2 + ...  + amountOfWorkT1 * (1.0  + fraction)^numberOfTasks = workload * (1.0 + fraction);
-
-    amountOfWorkT1 * ((1.0 + fraction) + (1.0  + fraction)^2 + ... + (1.0  + fraction)^numberOfTasks) = workload * (1.0 + fraction);
-
-    amountOfWorkT1 = workload / ( ( (1.0 + fraction)^numberOfTasks - 1 ) / fraction );
-    amountOfWorkT1 = workload /   ( (1.0 + fraction)^numberOfTasks - 1 ) * fraction  ;
-    */);
-
     const auto createGridTask = [this, &buffer_outputs](const uint32_t index, const uint32_t startBatch, const uint32_t endBatch) -> void {
-        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
-
         gridTasks.get()[index] = std::unique_ptr<Task<GridData>>(
             new Task<GridData>{
                 threadUpdateGrid,
@@ -545,6 +570,7 @@ Field::Field(
                 index,
                 this->gridPimpl,
                 this->interrupt_flag,
+                this->perfCountersEnabled,
                 startBatch,
                 endBatch,
                 buffer_outputs() //getting output    
@@ -552,33 +578,12 @@ Field::Field(
         );
     };
 
-    uint32_t batchesBefore = 0;
-    uint32_t remainingBatches = gridPimpl->gridLength();
-
-    const double amountOfWorkT1 = remainingBatches / (pow((1.0 + fraction), numberOfTasks) - 1) * fraction;
-
-    double currentTaskWork = amountOfWorkT1;
-
-    for (uint32_t i = 0; i < numberOfTasks - 1; i++) {
-        const uint32_t numberOfBatches = misc::min(remainingBatches, static_cast<uint32_t>(ceil(currentTaskWork)));
-        ::std::cout << numberOfBatches << std::endl;
-
-        createGridTask(i, batchesBefore, batchesBefore + numberOfBatches);
-
-        batchesBefore += numberOfBatches;
-        remainingBatches -= numberOfBatches;
-
-        currentTaskWork *= (1.0 + fraction);
-    }
-
-    {//last
-        const uint32_t numberOfBatches = remainingBatches;
-        ::std::cout << numberOfBatches << std::endl;
-
-        createGridTask(numberOfTasks - 1, batchesBefore, batchesBefore + numberOfBatches);
+    uint64_t const gridLength = gridPimpl->gridLength();
+    for(uint32_t i = 0; i < numberOfTasks; i++) {
+        auto const startBatch = bandStart(gridLength, i, numberOfTasks), endBatch = bandStart(gridLength, i + 1, numberOfTasks);
+        ::std::cout << endBatch - startBatch << std::endl;
 
-        batchesBefore += numberOfBatches;
-        remainingBatches -= numberOfBatches;
+        createGridTask(i, startBatch, endBatch);
     }
 }
 
@@ -590,9 +595,20 @@ void Field::fill(const FieldCell cell) {
     waitForGridTasks();
     interrupt_flag.store(false);
 
+    //whole field is one undo entry, only batches that change are recorded
+    auto const filled = ~0u * cell;
+    for(uint32_t i = 0; i < gridPimpl->gridLength(); i++) {
+        auto const before = gridPimpl->maskedCells(gridPimpl->getCellsActual_int(i), i);
+        auto const after = gridPimpl->maskedCells(filled, i);
+        if(before != after) journal.record(i, before, after);
+    }
+    journal.commit();
+
     gridPimpl->fill(cell);
+    if(auto &pyramid = pyramids[currentPyramid]) pyramid->rebuild(&gridPimpl->getCellsActual_int(0));
 
-    indecesToBrokenCells.clear();
+    brokenBatches.clear();
+    resetPeriodDetection();
 
     current_output->write(FieldModification{ 0, static_cast<uint32_t>(gridPimpl->gridLength()), &gridPimpl->getCellsActual_int(0) });
     
@@ -600,6 +616,48 @@ void Field::fill(const FieldCell cell) {
     deployGridTasks();
 }
 
+void Field::resize(uint32_t const width, uint32_t const height, vec2i const offset) {
+    assert(width >= 1 && height >= 1);
+    TraceSpan span{ "resize" };
+    //both buffers of the new field are cleared, as the next buffers of the outputs will be.
+    //Allocated first, so that the field keeps running if it throws
+    std::unique_ptr<FieldPimpl> resized{ new FieldPimpl(int32_t(width), int32_t(height)) };
+
+    interrupt_flag.store(true);
+    waitForGridTasks();
+    interrupt_flag.store(false);
+
+    copyMoved(*gridPimpl, *resized, offset);
+    gridPimpl = std::move(resized); //tasks reference the pointer, not the pimpl
+
+    uint64_t const gridLength = gridPimpl->gridLength();
+    for(uint32_t i = 0; i < numberOfTasks; i++) {
+        auto &data = gridTasks.get()[i]->data;
+        data.startBatch = bandStart(gridLength, i, numberOfTasks);
+        data.endBatch = bandStart(gridLength, i + 1, numberOfTasks);
+        data.columnCells.assign(gridPimpl->rowLength, 0u);
+        data.dirtyRanges.clear();
+        data.isOutputStale = false;
+    }
+
+    brokenBatches.clear();
+    editedBatches.clear();
+    repairedBatches.clear(); //the pyramid of the next generation is updated from them
+    journal.clear(); //batch indices of the entries are of the old size
+    resetPeriodDetection();
+    lastGenerationStats = emptyStats();
+    lastGenerationStats.generation = currentGeneration;
+    if(pyramids[0]) {
+        setDensityPyramidEnabled(false);
+        setDensityPyramidEnabled(true);
+    }
+
+    buffer_output->resized(width, height, uint32_t(gridPimpl->rowLength));
+    current_output->write(FieldModification{ 0, uint32_t(gridLength), &gridPimpl->getCellsActual_int(0) });
+
+    startCurGeneration();
+}
+
 FieldCell Field::cellAtIndex(const uint32_t index) const {
     return gridPimpl->cellAt_grid(normalizeIndex(index));
 }
@@ -610,59 +668,256 @@ void Field::setCellAtIndex(const uint32_t index, FieldCell cell) {
 }
 
 void Field::setCells(Cell const* const cells, size_t const count) {
-    if (isStopped) {
-        for (size_t i = 0; i < count; ++i) {
-            auto const cell = cells[i];
-            gridPimpl->setCellAt(normalizeIndex(cell.index), cell.cell);
+    for (size_t i = 0; i < count; ++i) {
+        auto const cell = cells[i];
+        auto const index = normalizeIndex(cell.index);
+        auto const shift = index % width() % cellsBatchLength;
+        editBatch(gridPimpl->cellI2BatchI(index), 1u << shift, uint32_t(cell.cell) << shift);
+    }
+    finishEdit();
+}
+
+void Field::fillRect(vec2i const start, vec2i const size, FieldCell const cell) {
+    auto const rows = misc::min<int32_t>(size.y, height());
+    for(int32_t i = 0; i < rows; i++) {
+        editSpan(misc::mod(start.y + i, height()), misc::mod(start.x, width()), size.x, cell);
+    }
+    finishEdit();
+}
+
+void Field::fillDisc(vec2i const center, int32_t const radius, FieldCell const cell) {
+    fillStroke(center, center, radius, BrushShape::disc, cell);
+}
+
+void Field::fillStroke(vec2i const from, vec2i const to, int32_t const radius, BrushShape const shape, FieldCell const cell) {
+    if(radius < 0) return;
+
+    //the brush is stamped at every cell of the line and the covered columns
+    //are merged per row, stroke is convex so each row is a single span
+    auto const minRow = misc::min(from.y, to.y) - radius;
+    auto const maxRow = misc::max(from.y, to.y) + radius;
+    auto &spans = strokeSpans;
+    spans.assign(maxRow - minRow + 1, StrokeSpan{ std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::min() });
+
+    auto const diff = to - from;
+    auto const steps = misc::max(std::abs(diff.x), std::abs(diff.y));
+    for(int32_t step = 0; step <= steps; step++) {
+        auto const t = steps == 0 ? 0.0 : double(step) / steps;
+        auto const x = from.x + int32_t(std::lround(diff.x * t));
+        auto const y = from.y + int32_t(std::lround(diff.y * t));
+        for(int32_t yo = -radius; yo <= radius; yo++) {
+            auto const halfWidth = shape == BrushShape::square ? radius
+                : int32_t(std::sqrt(double(radius * radius - yo * yo)));
+            auto& span = spans[y + yo - minRow];
+            span.start = misc::min(span.start, x - halfWidth);
+            span.end = misc::max(span.end, x + halfWidth);
         }
     }
-    else {
-        std::vector<uint32_t> cells_indeces_actual_int{};
-        //std::vector<uint32_t> cells_int{};
 
-        for (size_t i = 0; i < count; ++i) {
-            auto const cell = cells[i];
-            auto const index = normalizeIndex(cell.index);
-            const auto index_actual_int{ gridPimpl->cellI2BatchI(index) };
+    for(int32_t i = 0; i < int32_t(spans.size()); i++) {
+        auto const& span = spans[i];
+        if(span.start > span.end) continue;
+        //rows of long strokes can overlap themselves, they are filled more than once
+        editSpan(misc::mod(minRow + i, height()), misc::mod(span.start, width()), span.end - span.start + 1, cell);
+    }
+    finishEdit();
+}
 
-            if (std::find(
-                cells_indeces_actual_int.begin(), cells_indeces_actual_int.end(),
-                index_actual_int
-            ) == cells_indeces_actual_int.end()) {
-                cells_indeces_actual_int.push_back(index_actual_int);
-            }
+void Field::stampPattern(uint32_t const *const pattern, vec2i const size, vec2i const offset, bool const overwrite) {
+    auto const patternRowLength = int32_t(misc::intDivCeil(size.x, cellsBatchLength));
+    for(int32_t row = 0; row < size.y; row++) {
+        auto const fieldRow = misc::mod(offset.y + row, height());
+        for(int32_t i = 0; i < patternRowLength; i++) {
+            auto const cells = pattern[row * patternRowLength + i];
+            auto const count = misc::min<int32_t>(cellsBatchLength, size.x - i * cellsBatchLength);
+            editCells(fieldRow, misc::mod(offset.x + i * cellsBatchLength, width()), count, overwrite ? ~0u : cells, cells);
+        }
+    }
+    finishEdit();
+}
+
+void Field::beginStroke() {
+    journal.beginStroke();
+}
+
+void Field::endStroke() {
+    journal.endStroke();
+}
+
+bool Field::undo() {
+    auto const entry = journal.undo();
+    if(entry == nullptr) return false;
+    replayJournalEntry(*entry, true);
+    return true;
+}
 
-            gridPimpl->setCellAt(index, cell.cell);
-            indecesToBrokenCells.push_back(index);
+bool Field::redo() {
+    auto const entry = journal.redo();
+    if(entry == nullptr) return false;
+    replayJournalEntry(*entry, false);
+    return true;
+}
+
+void Field::setUndoBudget(size_t const bytes) {
+    journal.setBudget(bytes);
+}
+
+size_t Field::undoBytes() const {
+    return journal.bytes();
+}
+
+void Field::replayJournalEntry(EditJournal::Entry const &entry, bool const isUndo) {
+    //only the cells changed by the edit get their value from before or after it, the rest of the batch
+    //keeps the current generation. Cells outside of the grid are not touched
+    isJournalReplaying = true;
+    for(auto const &delta : entry) {
+        auto const index = delta.index_actual_int;
+        auto const mask = gridPimpl->maskedCells(delta.before ^ delta.after, index);
+        if(mask != 0) editBatch(index, mask, isUndo ? delta.before : delta.after);
+    }
+    finishEdit();
+    isJournalReplaying = false;
+}
+
+PackedPattern Field::copyRegion(vec2i const start, vec2i const size) const {
+    auto const regionWidth = uint32_t(misc::max(size.x, 0)), regionHeight = uint32_t(misc::max(size.y, 0));
+    auto const regionRowLength = regionWidth == 0 ? 0 : misc::intDivCeil(regionWidth, cellsBatchLength);
+    std::vector<uint32_t> cells(regionRowLength * regionHeight);
+
+    for(uint32_t row = 0; row < regionHeight; row++) {
+        auto const fieldRow = misc::mod(start.y + int32_t(row), height());
+        for(uint32_t i = 0; i < regionRowLength; i++) {
+            auto const count = misc::min<int32_t>(cellsBatchLength, regionWidth - i * cellsBatchLength);
+            cells[row * regionRowLength + i] = readCells(fieldRow, misc::mod(start.x + int32_t(i * cellsBatchLength), width()), count);
+        }
+    }
+    return PackedPattern{ regionWidth, regionHeight, std::move(cells) };
+}
+
+void Field::pasteRegion(PackedPattern const &pattern, vec2i const offset, bool const overwrite) {
+    auto const width_grid = int32_t(width());
+    auto const patternWidth = int32_t(pattern.width());
+    auto const column = misc::mod(offset.x, width_grid);
+    if(patternWidth == 0) return;
+    if(column + patternWidth > width_grid) {
+        stampPattern(pattern.data(), vec2i(patternWidth, pattern.height()), vec2i(column, offset.y), overwrite);
+        return;
+    }
+
+    auto const shift = uint32_t(column % cellsBatchLength);
+    auto const shifted = pattern.shifted(shift);
+    auto const shiftedRowLength = pattern.shiftedRowLength(shift);
+    auto const firstBatch = uint32_t(column / cellsBatchLength);
+
+    auto const end = (shift + patternWidth) % cellsBatchLength;
+    auto const firstMask = ~0u << shift;
+    auto const lastMask = end == 0 ? ~0u : ((1u << end) - 1);
+
+    for(uint32_t row = 0; row < pattern.height(); row++) {
+        auto const rowStart = uint32_t(misc::mod(offset.y + int32_t(row), height()) * gridPimpl->rowLength) + firstBatch;
+        auto const cells = shifted + row * shiftedRowLength;
+        for(uint32_t i = 0; i < shiftedRowLength; i++) {
+            auto const mask = !overwrite ? cells[i]
+                : (i == 0 ? firstMask : ~0u) & (i + 1 == shiftedRowLength ? lastMask : ~0u);
+            editBatch(rowStart + i, mask, cells[i]);
         }
+    }
+    finishEdit();
+}
+
+uint32_t Field::readCells(int32_t const row, int32_t column, int32_t count) const {
+    auto const width_grid = int32_t(width());
+    auto const rowStart = uint32_t(row * gridPimpl->rowLength);
+    uint32_t result = 0;
+    int32_t read = 0;
+    while(read < count) {
+        auto const n = misc::min(count - read, width_grid - column);
+        auto const batch = rowStart + column / cellsBatchLength;
+        auto const shift = column % cellsBatchLength;
+
+        uint64_t window = gridPimpl->getCellsActual_int(batch);
+        if(shift + n > cellsBatchLength) window |= uint64_t(gridPimpl->getCellsActual_int(batch + 1)) << cellsBatchLength;
+        auto const nMask = n == cellsBatchLength ? ~0u : ((1u << n) - 1);
+        result |= (uint32_t(window >> shift) & nMask) << read;
+
+        read += n;
+        column = 0;
+    }
+    return result;
+}
 
-        for (uint32_t index_actual_int : cells_indeces_actual_int) {
+void Field::editBatch(uint32_t const index_actual_int, uint32_t const mask, uint32_t const cells) {
+    auto& batch = gridPimpl->getCellsActual_int(index_actual_int);
+    auto const newBatch = (batch & ~mask) | (cells & mask);
+    if(newBatch == batch) return;
+    if(!isJournalReplaying) journal.record(index_actual_int, batch, newBatch);
+    batch = newBatch;
+    editedBatches.push_back(index_actual_int);
+}
 
-            current_output->write(FieldModification{ index_actual_int, 1, &gridPimpl->getCellsActual_int(index_actual_int) });
+void Field::editCells(int32_t const row, int32_t column, int32_t count, uint32_t mask, uint32_t cells) {
+    auto const width_grid = int32_t(width());
+    auto const rowStart = uint32_t(row * gridPimpl->rowLength);
+    while(count > 0) {
+        auto const n = misc::min(count, width_grid - column);
+        auto const nMask = n == cellsBatchLength ? ~0u : ((1u << n) - 1);
+        auto const m = mask & nMask, c = cells & nMask;
+        auto const batch = rowStart + column / cellsBatchLength;
+        auto const shift = column % cellsBatchLength;
+
+        editBatch(batch, m << shift, c << shift);
+        if(shift != 0 && shift + n > cellsBatchLength) {
+            editBatch(batch + 1, m >> (cellsBatchLength - shift), c >> (cellsBatchLength - shift));
         }
+
+        if(n == count) break;
+        mask >>= n;
+        cells >>= n;
+        count -= n;
+        column = 0;
+    }
+}
+
+void Field::editSpan(int32_t const row, int32_t const column, int32_t const length, FieldCell const cell) {
+    auto const width_grid = int32_t(width());
+    auto const cells = cell ? ~0u : 0u;
+    auto remaining = misc::min(length, width_grid);
+    auto col = column;
+    //first chunk aligns the column to a batch, the rest are whole batches
+    while(remaining > 0) {
+        auto const n = misc::min(cellsBatchLength - col % cellsBatchLength, misc::min(remaining, width_grid - col));
+        editCells(row, col, n, ~0u, cells);
+        remaining -= n;
+        col += n;
+        if(col == width_grid) col = 0;
     }
 }
 
-static FieldCell updatedCell(const int32_t index, const std::unique_ptr<Field::FieldPimpl>& cellsGrid) {
-    const auto width_grid = cellsGrid->width;
-    const auto height = cellsGrid->height;
-    uint8_t cell = cellsGrid->cellAt_grid(index);
+void Field::finishEdit() {
+    if(!isJournalReplaying) journal.commit();
+    if(editedBatches.empty()) return;
+    resetPeriodDetection();
 
-    uint32_t aliveNeighbours = 0;
+    std::sort(editedBatches.begin(), editedBatches.end());
+    editedBatches.erase(std::unique(editedBatches.begin(), editedBatches.end()), editedBatches.end());
 
-    for (int yo = -1; yo <= 1; yo++) {
-        for (int xo = -1; xo <= 1; xo++) {
-            if (xo != 0 || yo != 0) {
-                int x = ((index + xo) + width_grid) % width_grid,
-                    y = (((index / width_grid) + yo) + height) % height;
-                int offsetedIndex = x + width_grid * y;
-                if (cellsGrid->cellAt_grid(offsetedIndex))
-                    aliveNeighbours++;
-            }
+    if(auto &pyramid = pyramids[currentPyramid]) {
+        pyramid->update(&gridPimpl->getCellsActual_int(0), editedBatches.data(), editedBatches.size());
+    }
+
+    if(!isStopped) {
+        //consecutive batches are written at once
+        for(size_t i = 0; i < editedBatches.size();) {
+            auto const start = editedBatches[i];
+            size_t end = i + 1;
+            while(end < editedBatches.size() && editedBatches[end] == start + (end - i)) end++;
+            current_output->write(FieldModification{ start, uint32_t(end - i), &gridPimpl->getCellsActual_int(start) });
+            i = end;
         }
+        brokenBatches.insert(brokenBatches.end(), editedBatches.begin(), editedBatches.end());
     }
 
-    return fieldCell::nextGeneration(cell, aliveNeighbours);
+    editedBatches.clear();
 }
 
 bool Field::tryFinishGeneration() {
@@ -670,37 +925,42 @@ bool Field::tryFinishGeneration() {
         if(!gridTasks.get()[i]->resultReady()) return false;
     }
     interrupt_flag.store(false);
+    if(isGenerationFinalized) return true;
 
-    if (indecesToBrokenCells.size() > 0) {
-        std::vector<uint32_t> repairedCells_actual_int{};
-
-        for (auto it = indecesToBrokenCells.begin(); it != indecesToBrokenCells.end(); it++) {
-            const uint32_t index = *it;
-            const vec2i coord = this->indexAsCoord(index);
+    auto stats = emptyStats();
+    for(uint32_t i = 0; i < numberOfTasks; i++) {
+        combineStats(stats, gridTasks.get()[i]->data.stats);
+        bandPerfSamples[i] = gridTasks.get()[i]->data.stats.perf;
+    }
 
+    if (brokenBatches.size() > 0) {
+        TraceSpan repairSpan{ "repair" };
+        //every batch next to a modified one can be affected
+        auto &repairedCells_actual_int = repairedBatches;
+        repairedCells_actual_int.clear();
+        auto const rowLen = gridPimpl->rowLength, height_grid = gridPimpl->height;
+        for (uint32_t const index_actual_int : brokenBatches) {
+            auto const row = int32_t(index_actual_int / rowLen), col = int32_t(index_actual_int % rowLen);
             for (int yo = -1; yo <= 1; yo++) {
                 for (int xo = -1; xo <= 1; xo++) {
-                    //int x = ((index + xo) + width()) % width(),
-                    //    y = (((index / width()) + yo) + height()) % height();
-                    auto offsetedIndex = this->coordAsIndex(coord + vec2i(xo, yo));//this->normalizeIndex(index + xo + gridPimpl->width_grid * yo);//x + width() * y;
-
-                    const auto index_actual_int{ gridPimpl->cellI2BatchI(offsetedIndex) };
-
-                    if (
-                        std::find(
-                            repairedCells_actual_int.begin(), repairedCells_actual_int.end(), 
-                            index_actual_int
-                        ) == repairedCells_actual_int.end()
-                    ) repairedCells_actual_int.push_back(index_actual_int);
+                    repairedCells_actual_int.push_back(misc::mod(row + yo, height_grid) * rowLen + misc::mod(col + xo, rowLen));
                 }
             }
         }
+        std::sort(repairedCells_actual_int.begin(), repairedCells_actual_int.end());
+        repairedCells_actual_int.erase(
+            std::unique(repairedCells_actual_int.begin(), repairedCells_actual_int.end()), 
+            repairedCells_actual_int.end()
+        );
 
-        gridPimpl->fixField();
+        {
+            TraceSpan span{ "fixField" };
+            gridPimpl->fixField();
+        }
 
-        std::unique_ptr<FieldOutput> output = buffer_output->batched();
+        auto &output = repair_output;
         auto& field = *this->gridPimpl.get();
-        auto const rowLen = field.rowLength;
+        auto removed = emptyStats(); //bounds of cells that the repair removed
         int32_t width_actual = field.rowLength * cellsBatchLength;
         int32_t width_grid = field.width;
         auto const buffer = field.getBuffer(Field::FieldPimpl::bufCur) + field.bufferPaddingLength();
@@ -732,32 +992,234 @@ bool Field::tryFinishGeneration() {
 
             auto const startRowCellIndex = index_actual_int / rowLen * width_grid;
             if(specialFirstCell) {
-                newGeneration = (newGeneration & ~uint32_t(1)) | (updatedCell(startRowCellIndex, gridPimpl));
+                newGeneration = (newGeneration & ~uint32_t(1)) | (updatedCell(startRowCellIndex, *gridPimpl));
             }
 
             if(specialLastCell) {
                 const auto lastCellCol = misc::mod(field.width-1, cellsBatchLength);
                 newGeneration = (newGeneration & ~(uint32_t(1) << lastCellCol)) 
-                    | (uint32_t(updatedCell(startRowCellIndex + field.width - 1, gridPimpl)) << lastCellCol);
+                    | (uint32_t(updatedCell(startRowCellIndex + field.width - 1, *gridPimpl)) << lastCellCol);
             }
 
 
-            gridPimpl->getCellsActual_int(index_actual_int, Field::FieldPimpl::bufNext) = newGeneration;
-            output->write(FieldModification{ index_actual_int, 1, &newGeneration });
+            auto& cells = gridPimpl->getCellsActual_int(index_actual_int, Field::FieldPimpl::bufNext);
+            replaceCellsStats(stats, field, cells, newGeneration, index_actual_int);
+            addCellsBounds(stats, field.maskedCells(newGeneration, index_actual_int), colIndex, index_actual_int / rowLen);
+            addCellsBounds(removed, field.maskedCells(cells & ~newGeneration, index_actual_int), colIndex, index_actual_int / rowLen);
+            if(cells != newGeneration) {
+                cells = newGeneration;
+                output->write(FieldModification{ index_actual_int, 1, &newGeneration });
+            }
+        }
+        output->finishBatch();
+        brokenBatches.clear();
+
+        //bounds shrink only if a removed cell was on their edge
+        auto const isRemoved = removed.boundsMin.x <= removed.boundsMax.x;
+        if(isRemoved && (removed.boundsMin.x <= stats.boundsMin.x || removed.boundsMin.y <= stats.boundsMin.y
+            || removed.boundsMax.x >= stats.boundsMax.x || removed.boundsMax.y >= stats.boundsMax.y)) {
+            TraceSpan span{ "rescan bounds" };
+            rescanBounds(stats, field);
+        }
+    }
+
+    if(auto &pyramid = pyramids[currentPyramid ^ 1]) {
+        TraceSpan span{ "density pyramid" };
+        auto const cells = &gridPimpl->getCellsActual_int(0, Field::FieldPimpl::bufNext);
+        if(isNextPyramidStale) pyramid->rebuild(cells);
+        else {
+            //batches that differ from the generation the pyramid was counted for
+            pyramidBatches.clear();
+            for(uint32_t i = 0; i < numberOfTasks; i++) {
+                for(auto const range : gridTasks.get()[i]->data.dirtyRanges.ranges) {
+                    for(auto batch = range.start; batch < range.end; batch++) pyramidBatches.push_back(batch);
+                }
+            }
+            pyramidBatches.insert(pyramidBatches.end(), repairedBatches.begin(), repairedBatches.end());
+            pyramid->update(cells, pyramidBatches.data(), pyramidBatches.size());
+        }
+        isNextPyramidStale = false;
+    }
+
+    stats.generation = currentGeneration + 1;
+    lastGenerationStats = stats;
+    recordGenerationHash(stats.hash, stats.generation);
+    isGenerationFinalized = true;
+
+    if(isSnapshotting) {
+        if(auto *const snapshot = snapshots.beginWrite()) {
+            TraceSpan span{ "snapshot" };
+            auto const &field = *gridPimpl;
+            auto const rowLen = field.rowLength;
+            snapshot->stats = stats;
+            snapshot->width = field.width;
+            snapshot->height = field.height;
+            snapshot->rowLength = rowLen;
+            snapshot->cells.resize(field.gridLength());
+            auto const source = &field.getCellsActual_int(0, Field::FieldPimpl::bufNext);
+            std::memcpy(snapshot->cells.data(), source, field.gridLength() * cellsBatchSize);
+            auto const lastBatchMask = field.lastBatchMask();
+            for(uint32_t row = 0; row < uint32_t(field.height); row++) snapshot->cells[row * rowLen + rowLen - 1] &= lastBatchMask;
+            snapshots.publish();
         }
-        indecesToBrokenCells.clear();
+    }
+
+    return true;
+}
+
+void Field::recordGenerationHash(uint64_t const hash, uint64_t const generation) {
+    auto const newest = (hashHistoryHead + hashHistorySize - 1) % hashHistorySize;
+    if(hashHistory[newest].generation == generation) hashHistoryHead = newest; //generation was recomputed
+
+    uint32_t matchedPeriod = 0;
+    for(uint32_t i = 1; i <= hashHistorySize; i++) {
+        auto const &entry = hashHistory[(hashHistoryHead + hashHistorySize - i) % hashHistorySize];
+        if(entry.generation >= generation) break; //empty
+        if(entry.hash == hash) {
+            matchedPeriod = uint32_t(generation - entry.generation);
+            break;
+        }
+    }
+
+    hashHistory[hashHistoryHead] = GenerationHash{ hash, generation };
+    hashHistoryHead = (hashHistoryHead + 1) % hashHistorySize;
+
+    //the finished generation is in the next buffer
+    auto const &field = *gridPimpl;
+    auto const cells = &field.getCellsActual_int(0, Field::FieldPimpl::bufNext);
+    auto const rowLen = field.rowLength;
+    auto const lastBatchMask = field.lastBatchMask();
+    auto const sameCells = [&]() {
+        for(uint32_t row = 0; row < uint32_t(field.height); row++) {
+            auto const rowCells = cells + row * rowLen, candidateRow = candidateCells.data() + row * rowLen;
+            if(std::memcmp(rowCells, candidateRow, (rowLen - 1) * cellsBatchSize) != 0) return false;
+            if((rowCells[rowLen - 1] & lastBatchMask) != candidateRow[rowLen - 1]) return false;
+        }
+        return true;
+    };
+
+    if(currentPeriod != 0 && matchedPeriod == currentPeriod) return; //still repeating
+    currentPeriod = 0;
+    if(matchedPeriod == 0) {
+        candidatePeriod = 0;
+        return;
+    }
+    if(matchedPeriod == candidatePeriod && generation == candidateGeneration + candidatePeriod && sameCells()) {
+        currentPeriod = matchedPeriod;
+        candidatePeriod = 0;
+        return;
+    }
+    if(matchedPeriod == candidatePeriod && generation > candidateGeneration && generation < candidateGeneration + candidatePeriod) return;
+
+    //hashes of different generations may be the same, so the cells are compared one period later
+    candidatePeriod = matchedPeriod;
+    candidateGeneration = generation;
+    candidateCells.resize(field.gridLength());
+    std::memcpy(candidateCells.data(), cells, field.gridLength() * cellsBatchSize);
+    for(uint32_t row = 0; row < uint32_t(field.height); row++) candidateCells[row * rowLen + rowLen - 1] &= lastBatchMask;
+}
+
+void Field::resetPeriodDetection() {
+    std::fill(hashHistory.begin(), hashHistory.end(), GenerationHash{ 0, noGeneration });
+    hashHistoryHead = 0;
+    currentPeriod = 0;
+    candidatePeriod = 0;
+}
+
+uint64_t Field::generation() const {
+    return currentGeneration;
+}
+
+uint64_t Field::generationHash() const {
+    return lastGenerationStats.hash;
+}
+
+void Field::setPerfCountersEnabled(bool const enabled) {
+    perfCountersEnabled.store(enabled);
+}
+
+std::vector<PerfSample> const &Field::bandPerf() const {
+    return bandPerfSamples;
+}
+
+void Field::setSnapshotsEnabled(bool const enabled) {
+    isSnapshotting = enabled;
+}
+
+TripleBuffer<FieldSnapshot>::ReadHandle Field::latestSnapshot() const {
+    return snapshots.read();
+}
+
+void Field::setDensityPyramidEnabled(bool const enabled) {
+    if(enabled == bool(pyramids[0])) return;
+    if(!enabled) {
+        pyramids[0].reset();
+        pyramids[1].reset();
+        return;
+    }
+
+    auto const &field = *gridPimpl;
+    for(auto &pyramid : pyramids) pyramid.reset(new DensityPyramid(field.width, field.height, field.rowLength));
+    pyramids[currentPyramid]->rebuild(&gridPimpl->getCellsActual_int(0));
+    //the next buffer may be being written by the generation tasks
+    isNextPyramidStale = true;
+}
+
+DensityPyramid const *Field::densityPyramid() const {
+    return pyramids[currentPyramid].get();
+}
+
+uint32_t Field::pendingEditBatches() const {
+    return uint32_t(brokenBatches.size());
+}
+
+GenerationStats const &Field::generationStats() const {
+    return lastGenerationStats;
+}
+
+uint32_t Field::period() const {
+    return currentPeriod;
+}
+
+bool Field::fastForward(uint64_t const generations) {
+    if(currentPeriod == 0) return false;
+    auto const period = currentPeriod;
+
+    waitForGridTasks();
+    tryFinishGeneration();
+
+    //the field has already repeated itself, so whole periods don't change anything
+    auto const skipped = generations - generations % period;
+    currentGeneration += skipped;
+    for(auto &entry : hashHistory) if(entry.generation != noGeneration) entry.generation += skipped;
+
+    for(uint64_t i = skipped; i < generations; i++) {
+        startNewGeneration();
+        waitForGridTasks();
+        tryFinishGeneration();
     }
 
     return true;
 }
 
 void Field::startNewGeneration() {
+    buffer_output->publish();
     gridPimpl->swapBuffers();
+    currentGeneration++;
+    currentPyramid ^= 1;
+    if(isNextPyramidStale && pyramids[currentPyramid]) {
+        //the generation was finished before the pyramid was enabled
+        pyramids[currentPyramid]->rebuild(&gridPimpl->getCellsActual_int(0));
+        isNextPyramidStale = false;
+    }
     startCurGeneration();
 }
 
 void Field::startCurGeneration() {
-    gridPimpl->fixField();
+    {
+        TraceSpan span{ "fixField" };
+        gridPimpl->fixField();
+    }
     isStopped = false;
     deployGridTasks();
 }
@@ -773,6 +1235,7 @@ void Field::deployGridTasks() {
         std::cerr << "trying to start task when `isStopped` is set\n";
         return;
     }
+    isGenerationFinalized = false;
     for(uint32_t i = 0; i < numberOfTasks; i++) {
         gridTasks.get()[i]->start();
     }
@@ -4,12 +4,17 @@
 #include <stdint.h>
 #include<memory>
 #include "Vector.h"
+#include "Misc.h"
 #include <thread>
 #include <atomic>
 #include "Task.h"
 #include <atomic>
 #include <vector>
-#include"MedianCounter.h"
+#include"PackedPattern.h"
+#include"EditJournal.h"
+#include"PerfCounters.h"
+#include"TripleBuffer.h"
+#include"DensityPyramid.h"
 #include<functional>
 
 using FieldCell = bool;
@@ -39,6 +44,14 @@ struct FieldOutput { //TODO: remove
     }
 
     virtual std::unique_ptr<FieldOutput> batched() const = 0;
+    //outputs returned by batched() are reused for every generation, this ends the writes of one
+    virtual void finishBatch() {}
+    //called on the buffer output by Field::startNewGeneration() before the buffers are swapped.
+    //Outputs that stage the writes of generation tasks send the finished generation here
+    virtual void publish() {}
+    //called on the buffer output by Field::resize() before the current buffer of the new size is written.
+    //Both buffers of the output are dead cells afterwards, `rowLength` batches in each of `height` rows
+    virtual void resized(uint32_t const width, uint32_t const height, uint32_t const rowLength) {}
     virtual ~FieldOutput() = default;
 }; //must be used as output only in one thread
 
@@ -48,6 +61,28 @@ struct Cell {
     int32_t index;
 };
 
+enum class BrushShape : uint8_t { square, disc };
+
+struct GenerationStats {
+    uint64_t generation;
+    uint64_t hash;
+    uint64_t population;
+    vec2i boundsMin, boundsMax; //inclusive bounding box of alive cells, boundsMin > boundsMax if there are none
+    PerfSample perf; //hardware counters summed over the generation tasks, if enabled
+};
+
+//copy of a finished generation, see Field::latestSnapshot()
+struct FieldSnapshot {
+    GenerationStats stats; //stats.generation is the generation of the cells
+    uint32_t width, height;
+    uint32_t rowLength; //batches in a row, column `x` is bit `x % 32` of batch `x / 32`, bits past the width are 0
+    std::vector<uint32_t> cells;
+
+    FieldCell cellAt(int32_t const column, int32_t const row) const {
+        return FieldCell((cells[row * rowLength + column / 32] >> (column % 32)) & 1);
+    }
+};
+
 class Field final {
 public:
     struct FieldPimpl;
@@ -57,11 +92,45 @@ private:
     bool isStopped;
     std::unique_ptr<FieldOutput> const current_output;
     std::unique_ptr<FieldOutput> const buffer_output;
+    std::unique_ptr<FieldOutput> const repair_output; //batch of buffer_output
 
     const uint32_t numberOfTasks;
     std::unique_ptr<std::unique_ptr<Task<GridData>>[/*numberOfTasks*/]> gridTasks;
     std::atomic_bool interrupt_flag;
-    std::vector<uint32_t> indecesToBrokenCells;
+    std::atomic_bool perfCountersEnabled;
+    std::vector<PerfSample> bandPerfSamples; //of the last finished generation, one per task
+    std::vector<uint32_t> brokenBatches; //batches modified during current generation, their neighbours must be recalculated
+    std::vector<uint32_t> editedBatches; //batches modified by the current edit
+    std::vector<uint32_t> repairedBatches; //reused by tryFinishGeneration
+    struct StrokeSpan { int32_t start, end; };
+    std::vector<StrokeSpan> strokeSpans; //reused by fillStroke
+    EditJournal journal;
+    bool isJournalReplaying;
+
+    struct GenerationHash {
+        uint64_t hash;
+        uint64_t generation; //noGeneration if the entry is empty
+    };
+    static constexpr uint64_t noGeneration = ~uint64_t(0);
+    static constexpr uint32_t hashHistorySize = 64; //longest detectable period
+    std::vector<GenerationHash> hashHistory; //ring buffer, newest at hashHistoryHead-1
+    uint32_t hashHistoryHead;
+    //a period found by matching hashes is reported only once the generation one period
+    //after the match has the same cells as the matched one
+    uint32_t candidatePeriod; //0 if there is no candidate
+    uint64_t candidateGeneration;
+    std::vector<uint32_t> candidateCells; //of candidateGeneration, bits past the width are 0
+    uint64_t currentGeneration;
+    uint32_t currentPeriod;
+    GenerationStats lastGenerationStats;
+    bool isGenerationFinalized;
+    bool isSnapshotting;
+    TripleBuffer<FieldSnapshot> snapshots;
+    //pyramids of both buffers, pyramids[currentPyramid] is of the current one. Null if disabled
+    std::unique_ptr<DensityPyramid> pyramids[2];
+    uint32_t currentPyramid;
+    bool isNextPyramidStale; //pyramid of the next buffer is rebuilt instead of updated
+    std::vector<uint32_t> pyramidBatches; //reused by tryFinishGeneration
 public:
     Field(
         const uint32_t gridWidth, const uint32_t gridHeight, const size_t numberOfTasks_, 
@@ -77,7 +146,51 @@ public:
     void startCurGeneration();
     void startNewGeneration();
 
+    //generation of the current buffer, incremented by startNewGeneration()
+    uint64_t generation() const;
+    //hash of the generation computed by the last successful tryFinishGeneration()
+    uint64_t generationHash() const;
+    //stats of the generation computed by the last successful tryFinishGeneration().
+    //The bounding box may be larger than needed if cells were modified during that generation
+    GenerationStats const &generationStats() const;
+    //period of the field if its last generations repeat, 0 otherwise. A period is reported once
+    //the cells of two generations one period apart are compared. Detection is reset by any modification of cells
+    uint32_t period() const;
+    //if the field is periodic, skips `generations` generations by simulating only
+    //`generations % period()` of them. Returns false and does nothing if it is not
+    bool fastForward(uint64_t const generations);
+
+    //hardware counters of every generation task, read around each generation.
+    //If they are not permitted, samples stay invalid and everything else works as usual
+    void setPerfCountersEnabled(bool const enabled);
+    //counters of each task's band for the generation computed by the last successful tryFinishGeneration()
+    std::vector<PerfSample> const &bandPerf() const;
+    //batches modified during the current generation that wait for repair in tryFinishGeneration()
+    uint32_t pendingEditBatches() const;
+
+    //copies every generation finished by tryFinishGeneration() for observers,
+    //which read it while the next generations are computed. Costs a copy of the field per generation
+    void setSnapshotsEnabled(bool const enabled);
+    //last published generation, empty if no generation was finished while snapshots were enabled.
+    //Can be called from any thread. The field never waits for readers, if they hold every
+    //other copy for too long, new generations are not published until one is released
+    TripleBuffer<FieldSnapshot>::ReadHandle latestSnapshot() const;
+
+    //counts alive cells of the current generation in blocks of every zoom level, updated
+    //from the batches that change, so zoomed-out views don't have to read every cell
+    void setDensityPyramidEnabled(bool const enabled);
+    //pyramid of the current buffer, nullptr if disabled. Must be used only in the thread that
+    //calls other methods, the pointer changes in startNewGeneration()
+    DensityPyramid const *densityPyramid() const;
+
     void fill(const FieldCell cell);
+    //changes the size of the field, cell (x, y) moves to (x + offset.x, y + offset.y) without wrapping.
+    //Cells that end up outside of the field are dropped and the new ones are dead. Copies rows a batch
+    //at a time and keeps the generation tasks, whose bands are recomputed. Like fill(), restarts the
+    //generation being computed. The outputs are resized and get the whole current buffer, the undo
+    //history and period detection are reset, generationStats() is empty until the next generation.
+    //Throws std::bad_alloc and leaves the field as it was if the new buffers can't be allocated
+    void resize(uint32_t const width, uint32_t const height, vec2i const offset = vec2i(0));
 
     FieldCell cellAtIndex(const uint32_t index) const;
 
@@ -85,6 +198,35 @@ public:
     void setCellAtCoord(const vec2i& coord, FieldCell cell);
     void setCells(Cell const *const cells, size_t const count);
 
+    //fills the rectangle [start; start + size) wrapping around the field edges
+    void fillRect(vec2i const start, vec2i const size, FieldCell const cell);
+    //fills cells not farther than `radius` from `center`
+    void fillDisc(vec2i const center, int32_t const radius, FieldCell const cell);
+    //fills every cell covered by the brush moved from `from` to `to`.
+    //Coordinates are not normalized so that strokes crossing the field edge go the short way
+    void fillStroke(vec2i const from, vec2i const to, int32_t const radius, BrushShape const shape, FieldCell const cell);
+    //`pattern` is `size.y` rows of intDivCeil(size.x, 32) batches, column `x` is bit `x % 32` of batch `x / 32`.
+    //Only alive cells of the pattern are set unless `overwrite` is true
+    void stampPattern(uint32_t const *const pattern, vec2i const size, vec2i const offset, bool const overwrite = false);
+
+    //edits between beginStroke() and endStroke() are undone together
+    void beginStroke();
+    void endStroke();
+    //restore cells modified by the last edit to their state before it,
+    //return false if there is nothing to undo/redo
+    bool undo();
+    bool redo();
+    //limit of memory used by the undo history
+    void setUndoBudget(size_t const bytes);
+    //memory used by the undo history
+    size_t undoBytes() const;
+
+    //cells of the region [start; start + size) wrapping around the field edges
+    PackedPattern copyRegion(vec2i const start, vec2i const size) const;
+    //same as stampPattern but uses pre-shifted copies of the pattern,
+    //so that every row is written as aligned batches if it doesn't cross the field edge
+    void pasteRegion(PackedPattern const &pattern, vec2i const offset, bool const overwrite = false);
+
     FieldCell cellAtCoord(const vec2i& coord) const;
     FieldCell cellAtCoord(const int32_t column, const int32_t row) const;
 
@@ -104,9 +246,24 @@ public:
     //uint32_t size_actual() const;
     uint32_t width_actual() const;
     uint32_t *rawData() const;
+
+    //latencies of the generation tasks, recorded by the tasks themselves
+    void printTaskTimings(std::ostream &out) const;
 private:
     void waitForGridTasks();
     void deployGridTasks();
+    void recordGenerationHash(uint64_t const hash, uint64_t const generation);
+
+    //edits go through editBatch and are published by finishEdit
+    void editBatch(uint32_t const index_actual_int, uint32_t const mask, uint32_t const cells);
+    //`count` <= 32 cells starting at normalized `row` and `column`, wrapping around the row end
+    void editCells(int32_t const row, int32_t column, int32_t count, uint32_t mask, uint32_t cells);
+    void editSpan(int32_t const row, int32_t const column, int32_t const length, FieldCell const cell);
+    //reads `count` <= 32 cells, same as editCells
+    uint32_t readCells(int32_t const row, int32_t column, int32_t count) const;
+    void finishEdit();
+    void replayJournalEntry(EditJournal::Entry const &entry, bool const isUndo);
+    void resetPeriodDetection();
 };
 
 inline void Field::setCellAtCoord(const vec2i& coord, FieldCell cell) {
@@ -0,0 +1,405 @@
+#pragma once
+
+//internals of Field shared by Grid.cpp and the tools that measure or verify them.
+//Not a part of the public interface
+
+#include"Grid.h"
+#include"Misc.h"
+
+#include<nmmintrin.h>
+
+#include<cstdlib>
+#include<cstring>
+#include<algorithm>
+#include<new>
+
+using Cells = uint32_t;
+static constexpr auto cellsBatchSize = 4;
+static constexpr auto cellsBatchLength = 32;
+
+struct Field::FieldPimpl {
+    using index_t = int32_t;
+
+    using BufferType = bool;
+    static constexpr BufferType bufCur = false;
+    static constexpr BufferType bufNext = true;
+
+    Cells* buffer;
+
+    int32_t width;
+    int32_t height;
+    int32_t rowLength;
+    bool edgeCellsOptimization;
+    bool buffersSwapped;
+
+
+public:
+    FieldPimpl(const int32_t gridWidth, const int32_t gridHeight) {
+        width = gridWidth;
+        height = gridHeight;
+        rowLength = misc::intDivCeil(width, cellsBatchLength);
+        edgeCellsOptimization = rowLength * cellsBatchLength - width >= 2; 
+
+        auto const bufferLen = bufferLength();
+        auto const paddingLen = bufferPaddingLength();
+        //large buffers come from the system as zero pages, which calloc doesn't clear again,
+        //so that a resized field doesn't write every batch of both buffers before the copy
+        buffer = static_cast<Cells*>(std::calloc(size_t(bufferLen) * 2, sizeof(Cells)));
+        if(buffer == nullptr) throw std::bad_alloc{};
+        buffersSwapped = false;
+    }
+    ~FieldPimpl() { std::free(buffer); }
+
+    FieldPimpl(FieldPimpl const&) = delete;
+    FieldPimpl& operator=(FieldPimpl const&) = delete;
+
+    void fixField(BufferType const type = bufCur) {
+        auto const paddingLen = bufferPaddingLength();
+        auto const gridLen = gridLength();
+        auto const buffer = getBuffer(type) + paddingLen;
+        auto const rowSize = rowLength * cellsBatchSize;
+
+        auto const firstEmptyRowCellBatch = width / cellsBatchLength;
+        auto const firstEmptyRowCellInBatch = width % cellsBatchLength;
+
+        //order is important as if there can be only one row,
+        //in which case this algorithm *should* still work:
+        //side neightbours algorithm requires one extra row ahead, which 
+        //we get as the end padding IS the next row. then we fix 
+        //the side neightbours for start and end padding and copy 
+        //start padding (not from -1 but from 0, as -1 can be outside the grid)
+
+        auto const startPaddingRow = buffer - rowLength;
+        auto const endPaddingRow = buffer + gridLen;
+
+        //copy end padding row
+        std::memcpy(endPaddingRow, buffer, rowSize);
+
+        //copy left/right neighbours to other side
+        if(edgeCellsOptimization) {
+            for(int32_t row = 0; row != height; row++) {
+                auto const rowOffset = row * rowLength;
+
+                auto &cells = *(buffer + rowOffset + firstEmptyRowCellBatch);
+
+                auto const firstCell = *(buffer + rowOffset) & 1;
+                auto const lastCell = (*(buffer + rowOffset + rowLength + rowLength-1) >> (firstEmptyRowCellInBatch-1)) & 1;
+
+                cells = (cells & ~(~0 << (firstEmptyRowCellInBatch)))
+                    | (firstCell << firstEmptyRowCellInBatch)
+                    | (lastCell << (cellsBatchLength-1));
+            }
+
+            //copy recalculated neighbours to padding.
+            //the batch before the start padding row is the last one of row height-2,
+            //which is the row itself if there is only one
+            *(startPaddingRow-1) = *(buffer + misc::mod(height - 2, height) * rowLength + rowLength - 1);
+            *(endPaddingRow + rowLength - 1) = *(buffer + rowLength - 1);
+        }
+
+        //copy start padding row
+        std::memcpy(startPaddingRow, buffer + gridLen - rowLength, rowSize);
+    }
+
+    void swapBuffers() { buffersSwapped = !buffersSwapped; }
+
+    void fill(FieldCell const cell, BufferType const type = bufCur) {
+        auto grid = getBuffer(type);
+        const auto val = ~0u * cell;
+        std::fill(&grid[0], &grid[0] + bufferLength(), val);
+    }
+
+    uint8_t cellAt_grid(int32_t const index, BufferType const type = bufCur) const {
+        auto grid = getBuffer(type);
+        const auto row = misc::intDivFloor(index, width);
+        const auto col = misc::mod(index, width);
+
+        const auto col_int = col / cellsBatchLength;
+        const auto shift = col % cellsBatchLength;
+
+        return (grid[bufferPaddingLength() + row * rowLength + col_int] >> shift) & 0b1;
+    }
+
+    void setCellAt(int32_t const index, FieldCell const cell, BufferType const type = bufCur) {
+        auto grid = getBuffer(type);
+
+        const auto row = misc::intDivFloor(index, int32_t(width));
+        const auto col = misc::mod(index, width);
+
+        const auto col_int = col / cellsBatchLength;
+        const auto shift = col % cellsBatchLength;
+
+        auto& cur{ grid[bufferPaddingLength() + row * rowLength + col_int] };
+
+        cur = (cur & ~(0b1u << shift)) | (static_cast<uint32_t>(cell) << shift);
+    }
+
+    //cells of the last batch in a row that are inside of the grid
+    uint32_t lastBatchMask() const {
+        auto const lastBatchCells = width - (rowLength - 1) * cellsBatchLength;
+        return lastBatchCells == cellsBatchLength ? ~0u : ((1u << lastBatchCells) - 1);
+    }
+    uint32_t maskedCells(uint32_t const cells, int32_t const index_actual_int) const {
+        return (index_actual_int % rowLength == rowLength - 1) ? (cells & lastBatchMask()) : cells;
+    }
+
+    uint32_t& getCellsActual_int(int32_t const index_actual_int, BufferType const type = bufCur) const {
+        return getBuffer(type)[index_actual_int + bufferPaddingLength()];
+    }
+
+    uint32_t cellI2BatchI(const uint32_t index) const {
+        const auto row = misc::intDivFloor(index, width);
+        const auto col = misc::mod(index, width);
+
+        const auto col_int = col / cellsBatchLength;
+
+        return row * rowLength + col_int;
+    }
+
+    Cells *getBuffer(BufferType const type) const {
+        auto const offset = (type == bufNext) ^ buffersSwapped ? bufferLength() : 0;
+        return buffer + offset;
+    }
+    uint32_t gridLength() const {
+        return height * rowLength;
+    }
+    uint32_t bufferPaddingLength() const {
+        return rowLength + 1/*
+            extra row before/after the grid repeating the opposite row 
+            and 1 cell on each side for the first/last cell's neighbour,
+            padding after can be 1 shorter but not when width % batchSize, 
+            so it is +1 always for consistency
+        */;
+    }
+    uint32_t bufferLength() const {
+        return gridLength() + 2*bufferPaddingLength();
+    }
+};
+
+//scalar reference: next state of the cell at `index` computed from the cells around it
+inline FieldCell updatedCell(const int32_t index, Field::FieldPimpl const &cellsGrid, Field::FieldPimpl::BufferType const type = Field::FieldPimpl::bufCur) {
+    const auto width_grid = cellsGrid.width;
+    const auto height = cellsGrid.height;
+    uint8_t cell = cellsGrid.cellAt_grid(index, type);
+
+    uint32_t aliveNeighbours = 0;
+
+    for (int yo = -1; yo <= 1; yo++) {
+        for (int xo = -1; xo <= 1; xo++) {
+            if (xo != 0 || yo != 0) {
+                int x = ((index + xo) + width_grid) % width_grid,
+                    y = (((index / width_grid) + yo) + height) % height;
+                int offsetedIndex = x + width_grid * y;
+                if (cellsGrid.cellAt_grid(offsetedIndex, type))
+                    aliveNeighbours++;
+            }
+        }
+    }
+
+    return fieldCell::nextGeneration(cell, aliveNeighbours);
+}
+
+struct Remainder {
+    uint16_t cellsCols;
+    uint8_t curCell;
+};
+//computes new generation for 32 cells:
+//one from previous remainder and 31 cells at *base.
+//also computes remainder for next iteration (for the cast cell of *base)
+inline uint32_t newGenerationBatched(
+    Remainder const previousRemainder,
+    Cells *base,
+    int32_t const rowLength,
+    Remainder &currentRemainder_out
+) {
+    // [0, 16] [1, 17] ... [15, 31], where for cells x, y: [x, y] means 0b000y'000x
+    auto const unpackCellsAs4Bits = [](const uint32_t number) -> __m128i {
+        auto const cellPosForByteMask = _mm_setr_epi8(
+            1, 2, 4, 8, 16, 32, 64, 128u,
+            1, 2, 4, 8, 16, 32, 64, 128u
+        );
+
+        auto const numberReg = _mm_cvtsi32_si128(number);
+        auto const numberDupBytes = _mm_unpacklo_epi8(numberReg, numberReg);
+
+        auto const numQuadrupleLowBytes = _mm_shufflelo_epi16(numberDupBytes, 0b01'01'00'00);
+        auto const numberLowHalf = _mm_shuffle_epi32(numQuadrupleLowBytes, 0b01'01'00'00); 
+        auto const isLowCell = _mm_cmpeq_epi8(_mm_and_si128(numberLowHalf, cellPosForByteMask), cellPosForByteMask);
+
+        auto const numQuadrupleHighBytes = _mm_shufflelo_epi16(numberDupBytes, 0b11'11'10'10);
+        auto const numberHighHalf = _mm_shuffle_epi32(numQuadrupleHighBytes, 0b01'01'00'00); 
+        auto const isHighCell = _mm_cmpeq_epi8(_mm_and_si128(numberHighHalf, cellPosForByteMask), cellPosForByteMask);
+
+        return _mm_sub_epi8(_mm_and_si128(isHighCell, _mm_set1_epi8(0b0001'0000)), isLowCell)/*
+            low is either:
+                true (-1), then  high&16 - -1  =>  high&16 | 1
+                false (0), then  high&16 -  0  =>  high&16
+            which is eqivalent of  high&16 | low&1
+        */;
+    };
+
+    auto const topBatch = unpackCellsAs4Bits(*(base - rowLength));
+    auto const curBatch = unpackCellsAs4Bits(*base);
+    auto const botBatch = unpackCellsAs4Bits(*(base + rowLength));
+
+    auto const verticalSum = _mm_add_epi8(topBatch, _mm_add_epi8(curBatch, botBatch));
+
+    currentRemainder_out.curCell = (_mm_extract_epi16(curBatch, 7) >> 12); //_epi8 is sse 4.1
+    currentRemainder_out.cellsCols = (_mm_extract_epi16(verticalSum, 7) >> 4) & 0b1111'00001111;
+
+    auto const first16Mask = _mm_set1_epi8(0b00001111u); //unnecessary if _slli_epi8 existed
+    auto const curRowCentered_carry = _mm_slli_epi16(_mm_and_si128(curBatch, first16Mask), 4);
+    auto const verticalSum_carry = _mm_slli_epi16(_mm_and_si128(verticalSum, first16Mask), 4);
+
+    //using _or instead of _add because .curCell is in lower 4 bits and carry is in higher 4
+    auto const curRowCentered = _mm_or_si128(
+        _mm_alignr_epi8(curBatch, curRowCentered_carry, 15), 
+        _mm_cvtsi32_si128(previousRemainder.curCell)
+    );
+    auto const cells3by3 = _mm_add_epi8(
+        _mm_add_epi8(
+            _mm_add_epi8(
+                _mm_alignr_epi8(verticalSum, verticalSum_carry, 14),
+                _mm_alignr_epi8(verticalSum, verticalSum_carry, 15)
+            ),
+            verticalSum // ~ alignr(..., 16)
+        ),
+        _mm_cvtsi32_si128(previousRemainder.cellsCols + (previousRemainder.cellsCols >> 8))
+    );
+
+    auto const cellsNeighboursAlive = _mm_sub_epi8(cells3by3, curRowCentered);
+    auto const cells = _mm_or_si128(cellsNeighboursAlive, curRowCentered);
+    static_assert(
+        (2 | 1) == 3 && (3 | 1) == 3 && (3 | 0) == 3 && true,
+        R"(must be true:
+            1, 2) (2 or 3 cells) | (alive cell) == 3
+            3) (3 cells) | (dead  cell) == 3
+            4) other combitations != 3
+        )"
+    );
+
+    auto const mask_lower = _mm_set1_epi8(0b1111u);
+    auto const three = _mm_set1_epi8(3u);
+
+    uint32_t const lower16 = _mm_movemask_epi8(_mm_cmpeq_epi8(
+        _mm_and_si128(mask_lower, cells),
+        three
+    ));
+    uint32_t const higher16 = _mm_movemask_epi8(_mm_cmpeq_epi8(
+        _mm_andnot_si128(mask_lower, cells),
+        _mm_slli_epi16(three, 4)
+    ));
+
+    return lower16 | (higher16 << 16);
+}
+
+inline Remainder calcRemainder(Field::FieldPimpl const &grid, int32_t const batchIndex) {
+    auto const buffer = grid.getBuffer(Field::FieldPimpl::bufCur);
+    auto const base = buffer + grid.bufferPaddingLength() + batchIndex -  1;
+    auto const top  = *(base - grid.rowLength);
+    auto const prev = *(base);
+    auto const next = *(base + grid.rowLength);
+    auto const at = [](uint32_t const value, int const offset) {
+        return (value >> offset) & 1;
+    };
+
+    return {
+        uint16_t(
+            (at(top, 30) + at(prev, 30) + at(next, 30))
+            + ((at(top, 31) + at(prev, 31) + at(next, 31)) << 8)
+        ),
+        (bool) at(prev, 31)
+    };
+}
+
+//scalar update of the first and last cells of rows [startRow; endRow) for grids without
+//edge cells optimization, where the batched kernel gets their neighbours wrong.
+//New cells are passed to `setBufferCellAt(rowIndex, isLastCell, cell)`
+template<class SetCell>
+inline void updateEdgeCells(Field::FieldPimpl const &grid, uint32_t const startRow, uint32_t const endRow, SetCell &&setBufferCellAt) {
+    int32_t const width_grid = grid.width;
+    int32_t const lastElement = width_grid - 1;
+
+    const auto isCell = [&grid](int32_t index) -> uint8_t {
+        return grid.cellAt_grid(index);
+    };
+    const auto cellAt = [&grid](int32_t index) -> FieldCell {
+        return grid.cellAt_grid(index);
+    };
+
+    {
+        const int32_t row = startRow * width_grid;
+
+        uint8_t //top/cur/bot + first/second/last
+            tf = isCell(row + -width_grid),
+            ts = isCell(row + -width_grid + 1),
+            tl = isCell(row + -width_grid + lastElement),
+            cf = isCell(row + 0),
+            cs = isCell(row + 1),
+            cl = isCell(row + lastElement);
+
+        for (uint32_t rowIndex = startRow; rowIndex < endRow; rowIndex++) {
+            const int32_t row = rowIndex * width_grid;
+
+            uint8_t
+                bf = isCell(row + width_grid),
+                bs = isCell(row + width_grid + 1),
+                bl = isCell(row + width_grid + lastElement);
+            //first element
+            {
+                const int index = row;
+                const auto curCell = cellAt(index);
+                const unsigned char    topRowNeighbours = tf + ts + tl;
+                const unsigned char bottomRowNeighbours = bf + bs + bl;
+                const unsigned char aliveNeighbours = topRowNeighbours + cl + cs + bottomRowNeighbours;
+
+                setBufferCellAt(rowIndex, false, fieldCell::nextGeneration(curCell, aliveNeighbours));
+            }
+
+            tf = cf;
+            ts = cs;
+            tl = cl;
+            cf = bf;
+            cs = bs;
+            cl = bl;
+        }
+    }
+
+    {
+        const int32_t row = startRow * width_grid;
+
+        uint8_t //top/cur/bot + first/last/pre-last
+            tf = isCell(row + -width_grid),
+            tl = isCell(row + -width_grid + lastElement),
+            tp = isCell(row + -width_grid + lastElement - 1),
+            cf = isCell(row + 0),
+            cl = isCell(row + lastElement),
+            cp = isCell(row + lastElement - 1);
+
+        for (uint32_t rowIndex = startRow; rowIndex < endRow; rowIndex++) {
+            const int32_t row = rowIndex * width_grid;
+
+            uint8_t
+                bf = isCell(row + width_grid),
+                bp = isCell(row + width_grid + lastElement - 1),
+                bl = isCell(row + width_grid + lastElement);
+
+            { //last element
+                const int index = row + lastElement;
+                const auto curCell = cellAt(index);
+                const uint8_t    topRowNeighbours = tp + tl + tf;
+                const uint8_t bottomRowNeighbours = bp + bl + bf;
+                const uint8_t     aliveNeighbours = topRowNeighbours + cp + cf + bottomRowNeighbours;
+
+                setBufferCellAt(rowIndex, true, fieldCell::nextGeneration(curCell, aliveNeighbours));
+            }
+
+            tf = cf;
+            tp = cp;
+            tl = cl;
+            cf = bf;
+            cp = bp;
+            cl = bl;
+        }
+    }
+}
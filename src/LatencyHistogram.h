@@ -0,0 +1,105 @@
+#pragma once
+
+#include<stdint.h>
+#include<atomic>
+#include<limits>
+
+//fixed memory histogram of durations in nanoseconds, HDR-style: every power of two
+//is split into `subBuckets` linear buckets, so quantiles are within 1/subBuckets of the real value.
+//record() is lock-free and can be called from any thread, readers see a slightly
+//outdated state if they race with it
+class LatencyHistogram final {
+public:
+    static constexpr uint32_t subBucketsBits = 5;
+    static constexpr uint32_t subBuckets = 1u << subBucketsBits;
+    static constexpr uint32_t maxMagnitude = 42; //values from 2^42ns (~73 minutes) go to the last bucket
+    static constexpr uint32_t bucketsCount = (maxMagnitude - subBucketsBits + 2) * subBuckets;
+private:
+    std::atomic<uint64_t> buckets[bucketsCount];
+    std::atomic<uint64_t> totalCount;
+    std::atomic<uint64_t> totalSum;
+    std::atomic<uint64_t> minValue;
+    std::atomic<uint64_t> maxValue;
+public:
+    LatencyHistogram() { reset(); }
+
+    LatencyHistogram(LatencyHistogram const&) = delete;
+    LatencyHistogram& operator=(LatencyHistogram const&) = delete;
+
+    static uint32_t bucketIndex(uint64_t const value) {
+        if(value < subBuckets) return uint32_t(value);
+        auto const magnitude = uint32_t(63 - __builtin_clzll(value));
+        if(magnitude > maxMagnitude) return bucketsCount - 1;
+        auto const shift = magnitude - subBucketsBits;
+        return ((shift + 1) << subBucketsBits) | uint32_t((value >> shift) & (subBuckets - 1));
+    }
+    //smallest value that goes to the bucket
+    static uint64_t bucketStart(uint32_t const index) {
+        auto const group = index >> subBucketsBits, sub = index & (subBuckets - 1);
+        if(group == 0) return sub;
+        return uint64_t(subBuckets | sub) << (group - 1);
+    }
+    static uint64_t bucketEnd(uint32_t const index) {
+        return index + 1 == bucketsCount ? std::numeric_limits<uint64_t>::max() : bucketStart(index + 1);
+    }
+
+    void record(uint64_t const nanoseconds) {
+        buckets[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        totalCount.fetch_add(1, std::memory_order_relaxed);
+        totalSum.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+        auto curMin = minValue.load(std::memory_order_relaxed);
+        while(nanoseconds < curMin && !minValue.compare_exchange_weak(curMin, nanoseconds, std::memory_order_relaxed)) {}
+        auto curMax = maxValue.load(std::memory_order_relaxed);
+        while(nanoseconds > curMax && !maxValue.compare_exchange_weak(curMax, nanoseconds, std::memory_order_relaxed)) {}
+    }
+
+    void reset() {
+        for(auto &bucket : buckets) bucket.store(0, std::memory_order_relaxed);
+        totalCount.store(0, std::memory_order_relaxed);
+        totalSum.store(0, std::memory_order_relaxed);
+        minValue.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+        maxValue.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return totalCount.load(std::memory_order_relaxed); }
+    uint64_t bucketCount(uint32_t const index) const { return buckets[index].load(std::memory_order_relaxed); }
+    uint64_t sum() const { return totalSum.load(std::memory_order_relaxed); }
+    uint64_t min() const { return count() == 0 ? 0 : minValue.load(std::memory_order_relaxed); }
+    uint64_t max() const { return maxValue.load(std::memory_order_relaxed); }
+    double mean() const {
+        auto const c = count();
+        return c == 0 ? 0.0 : double(sum()) / c;
+    }
+
+    //value below which `q` (in [0; 1]) of the recorded values are, 0 if there are none.
+    //The middle of the bucket is returned, clamped to the recorded min and max
+    uint64_t quantile(double const q) const {
+        uint64_t total = 0;
+        for(auto const &bucket : buckets) total += bucket.load(std::memory_order_relaxed);
+        if(total == 0) return 0;
+
+        auto const rank = quantileRank(q, total);
+        uint64_t seen = 0;
+        for(uint32_t i = 0; i < bucketsCount; i++) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if(seen >= rank) {
+                auto const start = bucketStart(i);
+                auto const end = i + 1 == bucketsCount ? start : bucketStart(i + 1) - 1;
+                auto const value = start + (end - start) / 2;
+                auto const lo = min(), hi = max();
+                return value < lo ? lo : (value > hi ? hi : value);
+            }
+        }
+        return max();
+    }
+    uint64_t p50() const { return quantile(0.5); }
+    uint64_t p99() const { return quantile(0.99); }
+    uint64_t p999() const { return quantile(0.999); }
+private:
+    //1-based rank of the quantile among `total` values
+    static uint64_t quantileRank(double const q, uint64_t const total) {
+        auto const rank = uint64_t(q * total + 0.5);
+        return rank < 1 ? 1 : (rank > total ? total : rank);
+    }
+};
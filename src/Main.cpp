@@ -17,28 +17,36 @@
 #include"AutoTimer.h"
 
 #include"PerlinNoise.h"
-#include"MedianCounter.h"
+#include"LatencyHistogram.h"
+#include"Trace.h"
+#include"MetricsServer.h"
+#include"FieldRing.h"
+#include"DeltaStream.h"
+#include"FieldOutputs.h"
+#include"TileStreaming.h"
 
 #include"ShaderLoader.h"
 
 #include<atomic>
 #include<mutex>
+#include<fstream>
 
 #include<vector>
+#include<string>
 
 #include<type_traits>
+#include<new>
 
-const uint32_t counterSampleSize = 200;
-UMedianCounter 
-    set{ counterSampleSize }, 
-    bufferSet{ counterSampleSize }, 
-    draw{ counterSampleSize }, 
-    postProcessing{ counterSampleSize },
-    swap{ counterSampleSize }, 
-    update{ counterSampleSize }, 
-    fieldUpdateWait{ counterSampleSize };
+LatencyHistogram 
+    set, 
+    bufferSet, 
+    draw, 
+    postProcessing,
+    swap, 
+    update, 
+    fieldUpdateWait;
 
-UMedianCounter microsecPerFrame{ counterSampleSize };
+LatencyHistogram frameTime;
 
 struct WindowSize {
     vec2i windowSize;
@@ -62,10 +70,15 @@ static double dVpSizeDesired, dVpSize;
 vec2d desiredZoomPoint, zoomPoint; //TODO: init
 bool isZoomChanged;
 
-const uint32_t gridWidth = 60, gridHeight = 30;
-const uint32_t gridSize = gridWidth * gridHeight;
-const uint32_t numberOfTasks = 1;
+//chosen with --width, --height and --threads, the size changes with resizeField()
+static uint32_t gridWidth = 60, gridHeight = 30;
+static uint32_t numberOfTasks = 1;
+std::unique_ptr<FieldStaging> fieldStaging; //must outlive the field
 std::unique_ptr<Field> grid;
+std::unique_ptr<MetricsServer> metricsServer; //only if GOL_METRICS_PORT is set
+std::unique_ptr<FieldRingPublisher> fieldRingPublisher; //only if GOL_SHM_NAME is set
+std::unique_ptr<DeltaStreamServer> deltaStreamServer; //only if GOL_STREAM_PORT is set
+std::unique_ptr<TileStreamer> tileStreamer; //only if the field doesn't fit in a buffer or GOL_TILE_STREAMING is set
 
 static bool gridUpdate = true;
 
@@ -80,6 +93,8 @@ enum class PaintMode : unsigned char {
     DELETE
 };
 PaintMode paintMode = PaintMode::NONE;
+bool isStrokeStarted = false;
+vec2i lastStrokeCell(0); //not normalized, so that strokes across the field edge stay short
 
 
 vec2d mousePos(0), pmousePos(0, 0);
@@ -103,17 +118,20 @@ const double chasingSpeed = 0.4; //.4;
 
 static GLuint packedGrid1 = 0, packedGrid2 = 0;
 static size_t field_size_bytes;
+static GLint64 maxBufferSize_bytes;
 static std::atomic_bool isBufferSecond{ true };
-static std::mutex gpuBufferLock{ };
+static bool isFieldResized = false; //uniforms of the field size must be updated
 
 
 void printMouseCellInfo();
+static void resizeField(double const scale);
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) noexcept {
     
     if (action == GLFW_PRESS && key == GLFW_KEY_TAB) { //debug info
-        const auto printC = [](const std::string label, const UMedianCounter& counter) {
-            std::cout << label << '=' << counter.median()  << ", max=" << counter.max() << std::endl;
+        const auto printC = [](const std::string label, const LatencyHistogram& counter) {
+            std::cout << label << ": p50=" << counter.p50() / 1000.0 << "us, p99=" << counter.p99() / 1000.0
+                << "us, p999=" << counter.p999() / 1000.0 << "us, max=" << counter.max() / 1000.0 << "us" << std::endl;
         };
         std::cout << "r1(w key not pressed)" << '=' << r1 << std::endl;
         std::cout << "r2(normalized mouse x)" << '=' << r2 << std::endl;
@@ -123,14 +141,25 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
         printC("swap", swap);
         printC("update", update);
         printC("field wait", fieldUpdateWait);
+        grid->printTaskTimings(std::cout);
+        for(auto const &band : grid->bandPerf()) {
+            if(!band.valid) continue;
+            std::cout << "band: ipc=" << band.ipc() << ", cache misses=" << band.cacheMisses
+                << ", memory=" << band.memoryBytesPerSecond() / 1e9 << "GB/s" << std::endl;
+        }
 
-        const auto mpf = microsecPerFrame.median();
-        const auto maxfps = microsecPerFrame.max();
-        std::cout << "fps " << float(1'000'000 / (mpf)) << " (" << (mpf / 1'000) << "ms" << ", maximum: " << (maxfps / 1'000) << "ms)" << std::endl;
+        const auto mpf = frameTime.p50() / 1000.0;
+        const auto maxfps = frameTime.p99() / 1000.0;
+        std::cout << "fps " << float(1'000'000 / (mpf)) << " (" << (mpf / 1'000) << "ms" << ", p99: " << (maxfps / 1'000) << "ms)" << std::endl;
     }
     if (key == GLFW_KEY_LEFT_SHIFT && action == GLFW_PRESS) {
         printMouseCellInfo();
     }
+    if (key == GLFW_KEY_F9 && action == GLFW_PRESS) { //timeline of the last spans
+        std::ofstream file{ "trace.json" };
+        trace::writeChromeJson(file);
+        std::cout << "trace written to trace.json" << std::endl;
+    }
     if (key == GLFW_KEY_ESCAPE) {
         exit(0);
     }
@@ -144,6 +173,19 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
         else if (key == GLFW_KEY_SPACE) { //sace
             gridUpdate = !gridUpdate;
         }
+        else if (key == GLFW_KEY_Z && (mods & GLFW_MOD_CONTROL)) {
+            if (mods & GLFW_MOD_SHIFT) grid->redo();
+            else grid->undo();
+        }
+        else if (key == GLFW_KEY_Y && (mods & GLFW_MOD_CONTROL)) {
+            grid->redo();
+        }
+        else if (key == GLFW_KEY_RIGHT_BRACKET && (mods & GLFW_MOD_CONTROL)) {
+            resizeField(2);
+        }
+        else if (key == GLFW_KEY_LEFT_BRACKET && (mods & GLFW_MOD_CONTROL)) {
+            resizeField(0.5);
+        }
     }
 
     if (key == GLFW_KEY_GRAVE_ACCENT) {
@@ -185,7 +227,7 @@ static double vpSizeToZoomLevel(double const size) {
 }
 
 static void updateSpace() {
-    auto const size = std::min(gridWidth, gridHeight);
+    auto const size = double(std::min(gridWidth, gridHeight));
     auto const pos = vec2d{ gridWidth * 0.5, gridHeight * 0.5 };
     zoomLevel = vpSizeToZoomLevel(size);
     space = Space{ pos, pos, size };
@@ -260,140 +302,186 @@ void window_size_callback(GLFWwindow* window, int width, int height) noexcept {
     glBindTexture(GL_TEXTURE_2D, 0);*/
 }
 
-class GLFieldOutput final : public FieldOutput {
-    class GLBufferedFieldOutput final : public FieldOutput {
-        class InnerFieldOutput final : public FieldOutput {
-        public:
-            InnerFieldOutput() = default;
-
-            virtual void write(FieldModification fm) override {
-                glBufferSubData(GL_SHADER_STORAGE_BUFFER,
-                    fm.startIndex_int * sizeOfBatch 
-                    , fm.size_int * sizeOfBatch
-                    , fm.data);
+//staged generations and edits are transferred by the main thread, which owns the context
+class GLFieldSink final : public FieldSink {
+    static constexpr auto sizeOfBatch = sizeof std::remove_pointer<decltype(FieldModification::data)>::type();/*
+        to convert from batches to bytes
+    */
+public:
+    void resized(uint32_t const gridLength) override {
+        std::vector<uint32_t> const cleared(gridLength, 0);
+        for(auto const buffer : { packedGrid1, packedGrid2 }) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, cleared.size() * sizeOfBatch, cleared.data(), GL_DYNAMIC_DRAW);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
 
-            }
+    void transfer(uint32_t const bufferIndex, FieldModification fm) override {
+        //staging buffer 0 is the next one at the start, when packedGrid1 is displayed
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferIndex == 0 ? packedGrid2 : packedGrid1);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+            fm.startIndex_int * sizeOfBatch
+            , fm.size_int * sizeOfBatch
+            , fm.data);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
 
-            virtual std::unique_ptr<FieldOutput> batched() const override
-            {
-                return std::unique_ptr<InnerFieldOutput>(new InnerFieldOutput());
-            }
+    void transferRanges(uint32_t const bufferIndex, FieldModification const *const ranges, size_t const count) override {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferIndex == 0 ? packedGrid2 : packedGrid1);
+        for(size_t i = 0; i < count; i++) {
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                ranges[i].startIndex_int * sizeOfBatch
+                , ranges[i].size_int * sizeOfBatch
+                , ranges[i].data);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+};
 
-            ~InnerFieldOutput() noexcept = default;
-        };
-    private:
-        GLFieldOutput const& parent;
-        std::unique_lock<std::mutex> lock;
-
-        static constexpr auto sizeOfBatch = sizeof std::remove_pointer<decltype(FieldModification::data)>::type();/*
-            to convert from batches to bytes
-        */
-    public:
-        GLBufferedFieldOutput(GLFieldOutput const& parent_) : parent{ parent_ }, lock{ gpuBufferLock } {
-            if (!glfwGetCurrentContext()) glfwMakeContextCurrent(parent.context);
-
-            GLuint fieldBufferHandle;// { !isBufferSecond ^ parent.isBuffer ? packedGrid1 : packedGrid2 };
-            if (parent.isBuffer) {
-                if (isBufferSecond) fieldBufferHandle = packedGrid2;
-                else fieldBufferHandle = packedGrid1;
-            }
-            else
-                if (isBufferSecond) fieldBufferHandle = packedGrid1;
-                else fieldBufferHandle = packedGrid2;
+GLFieldSink fieldSink{};
 
-            glBindBuffer(GL_SHADER_STORAGE_BUFFER, fieldBufferHandle);
-        }
+//tiles and densities streamed by tileStreamer, bound to the tiled part of the main shader
+class GLTileSink final : public TileSink {
+    GLuint tiles = 0, pageTable = 0, densities = 0;
+    size_t densitiesCapacity = 0;
+public:
+    void create(TileLayout const layout, uint32_t const slotsCount) {
+        std::vector<uint32_t> const cleared(misc::max(size_t(layout.tilesCount()), size_t(slotsCount) * layout.tileWords()), 0);
+
+        glGenBuffers(1, &tiles);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tiles);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size_t(slotsCount) * layout.tileWords() * 4, cleared.data(), GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, tiles);
+
+        glGenBuffers(1, &pageTable);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, pageTable);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size_t(layout.tilesCount()) * 4, cleared.data(), GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, pageTable);
+
+        glGenBuffers(1, &densities);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, densities);
+        densitiesCapacity = 1;
+        float const empty = 0;
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(float), &empty, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, densities);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
 
-        GLBufferedFieldOutput(GLBufferedFieldOutput const&) = delete;
-        GLBufferedFieldOutput& operator=(GLBufferedFieldOutput const&) = delete;
+    void uploadTile(uint32_t const slot, uint32_t const *const cells, uint32_t const wordsCount) override {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tiles);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, size_t(slot) * wordsCount * 4, size_t(wordsCount) * 4, cells);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
 
-        virtual std::unique_ptr<FieldOutput> batched() const override
-        {
-            return std::unique_ptr<InnerFieldOutput>(new InnerFieldOutput());
-        }
+    void uploadPageTable(uint32_t const first, uint32_t const count, uint32_t const *const entries) override {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, pageTable);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, size_t(first) * 4, size_t(count) * 4, entries);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
 
-        ~GLBufferedFieldOutput() noexcept {
-            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-            glFinish();
-        }
-    };
-private:
-    GLFWwindow* context;
-    bool isBuffer;
-public:
-    GLFieldOutput(bool isBuffer_, GLFWwindow* window_origin) : isBuffer{ isBuffer_ } {
-        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
-        auto* context_ = glfwCreateWindow(2, 2, "", NULL, window_origin);
-        if (!context_) {
-            ::std::cout << "window for output(current) is null";
-            exit(-1);
+    void uploadDensity(DensityWindow const &window, float const *const densities_) override {
+        auto const count = size_t(window.size.x) * window.size.y;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, densities);
+        if(count > densitiesCapacity) {
+            //the window only grows with the window size, so it is rarely reallocated
+            densitiesCapacity = count;
+            glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(float), densities_, GL_DYNAMIC_DRAW);
         }
-        context = context_;
+        else glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(float), densities_);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
     }
+};
+
+GLTileSink tileSink{};
+
 
-    GLFieldOutput(GLFieldOutput const&) = delete;
-    GLFieldOutput& operator=(GLFieldOutput const&) = delete;
 
-    std::unique_ptr<FieldOutput> batched() const override {
-        return std::unique_ptr<FieldOutput>(new GLBufferedFieldOutput{ *this });
+//scales both sides of the field around its center, the view stays on the same cells
+static void resizeField(double const scale) {
+    if(tileStreamer || fieldRingPublisher || deltaStreamServer) {
+        std::cout << "the field can't be resized while it is streamed or published\n";
+        return;
+    }
+    auto const newWidth = uint32_t(misc::max(1.0, std::round(gridWidth * scale)));
+    auto const newHeight = uint32_t(misc::max(1.0, std::round(gridHeight * scale)));
+    if(GLint64(misc::intDivCeil(newWidth, 32)) * newHeight * 4 > maxBufferSize_bytes) {
+        std::cout << "field of " << newWidth << 'x' << newHeight << " doesn't fit in a buffer\n";
+        return;
     }
 
-    ~GLFieldOutput() override {
-        glfwDestroyWindow(context);
+    auto const offset = vec2i(int32_t(newWidth) - int32_t(gridWidth), int32_t(newHeight) - int32_t(gridHeight)) / 2;
+    Timer<> t{};
+    try {
+        grid->resize(newWidth, newHeight, offset);
     }
-};
+    catch(std::bad_alloc const&) {
+        std::cout << "not enough memory for a field of " << newWidth << 'x' << newHeight << '\n';
+        return;
+    }
+    std::cout << "field resized to " << newWidth << 'x' << newHeight << " in " << t.elapsedNanoseconds() / 1e6 << "ms\n";
 
+    gridWidth = newWidth;
+    gridHeight = newHeight;
+    field_size_bytes = grid->size_bytes();
+    space.vpPos += vec2d(offset.x, offset.y);
+    space.vpPosDesired += vec2d(offset.x, offset.y);
+    isFieldResized = true;
+}
 
+void publishMetrics() {
+    auto const &stats = grid->generationStats();
+    uint64_t activeTiles = 0;
+    if(stats.boundsMin.x <= stats.boundsMax.x && stats.boundsMin.y <= stats.boundsMax.y) {
+        activeTiles = uint64_t(stats.boundsMax.x / 32 - stats.boundsMin.x / 32 + 1)
+            * uint64_t(stats.boundsMax.y / 32 - stats.boundsMin.y / 32 + 1);
+    }
 
+    SimulationMetrics metrics{};
+    metrics.generation = stats.generation;
+    metrics.cells = grid->size();
+    metrics.population = stats.population;
+    metrics.activeTiles = activeTiles;
+    metrics.pendingEditBatches = grid->pendingEditBatches();
+    metrics.undoBytes = grid->undoBytes();
+    metricsServer->publish(metrics);
+}
 
 void updateState() {
     curTime = std::chrono::steady_clock::now();
 
     vec2d global = mouseToGlobal();
-    vec2i cell = globalAsCell(global);
 
     const auto gridUpdateElapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(curTime - lastGridUpdateTime).count();
+    Timer<> fieldWait{};
     if(
         gridUpdate
         && (gridUpdateElapsedTime >= 1000.0 / gridUpdatesPerSecond)
         && grid->tryFinishGeneration()
     ) {
+        fieldUpdateWait.record(fieldWait.elapsedNanoseconds());
+        if(metricsServer) publishMetrics();
         lastGridUpdateTime = curTime;
-        Timer<> t{};
-        fieldUpdateWait.add(t.elapsedTime());
         isBufferSecond = !isBufferSecond;
         grid->startNewGeneration();
+        //the finished generation is only read while the next one is computed
+        if(fieldRingPublisher) fieldRingPublisher->publish(grid->rawData(), grid->generation());
+        if(deltaStreamServer) deltaStreamServer->publish(grid->rawData(), grid->generation());
     }
 
     if (paintMode != PaintMode::NONE) {
-        std::vector<Cell> cells{};
-        auto const side = brushSize+1 - -brushSize;
-        assert(side >= 0);
-        auto const size = size_t(side * side);
-        cells.reserve(size);
-
-        for (int32_t yo = -brushSize; yo <= brushSize; yo++) {
-            for (int32_t xo = -brushSize; xo <= brushSize; xo++) {
-                const vec2i offset{ xo, yo };
-                const auto coord = cell + offset;
-
-                cells.push_back(
-                    Cell{ 
-                        paintMode == PaintMode::PAINT ? fieldCell::cellAlive : fieldCell::cellDead,
-                        grid->coordAsIndex(cell + offset)
-                    }
-                );
-                /*if (paintMode == PaintMode::PAINT) {
-                    grid->setCellAtCoord(cell + offset, FieldCell::ALIVE);
-                }
-                else if (paintMode == PaintMode::DELETE) {
-                    grid->setCellAtCoord(coord + offset, FieldCell::DEAD);
-                }*/
-            }
-        }
-        assert(cells.size() == size);
-
-        grid->setCells(&cells[0], size);
+        if (!isStrokeStarted) grid->beginStroke();
+        auto const strokeCell = vec2i{ int32_t(std::floor(global.x)), int32_t(std::floor(global.y)) };
+        grid->fillStroke(
+            isStrokeStarted ? lastStrokeCell : strokeCell, strokeCell, brushSize, BrushShape::square,
+            paintMode == PaintMode::PAINT ? fieldCell::cellAlive : fieldCell::cellDead
+        );
+        lastStrokeCell = strokeCell;
+        isStrokeStarted = true;
+    }
+    else if (isStrokeStarted) {
+        grid->endStroke();
+        isStrokeStarted = false;
     }
 
     auto const vpSizeDesired = getVpSizeDesired(); 
@@ -459,9 +547,26 @@ void APIENTRY glDebugOutput(GLenum source, GLenum type, unsigned int id, GLenum
     std::cout << message << '\n';
 }
 
-int main() {
+static char const usage[] = "usage: game [--width <n>] [--height <n>] [--threads <n>]\n";
+
+int main(int argc, char **argv) {
+    for(int i = 1; i < argc; i++) {
+        auto const arg = std::string{ argv[i] };
+        auto const hasValue = i + 1 < argc;
+        if(arg == "--width" && hasValue) gridWidth = uint32_t(misc::max(1ll, std::atoll(argv[++i])));
+        else if(arg == "--height" && hasValue) gridHeight = uint32_t(misc::max(1ll, std::atoll(argv[++i])));
+        else if(arg == "--threads" && hasValue) numberOfTasks = uint32_t(misc::max(1ll, std::atoll(argv[++i])));
+        else {
+            std::cerr << usage;
+            return 1;
+        }
+    }
+
     if(!glfwInit()) return -1;
 
+    trace::setEnabled(true);
+    trace::setThreadName("main");
+
     GLFWwindow* window;
     glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
 
@@ -535,22 +640,67 @@ int main() {
         return 2;
     }
 
-    auto const current_outputs = [window]() -> std::unique_ptr<FieldOutput> {
-        return std::unique_ptr<FieldOutput>( new GLFieldOutput{ false, window } );
+    auto const fieldBatches = misc::intDivCeil(gridWidth, 32) * gridHeight;
+    glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBufferSize_bytes);
+    //a field that doesn't fit in a buffer has only the tiles around the view on the GPU
+    if(GLint64(fieldBatches) * 4 > maxBufferSize_bytes || tileStreamingFromEnvironment()) {
+        tileStreamer = std::unique_ptr<TileStreamer>{ new TileStreamer{ gridWidth, gridHeight, tileSink } };
+        std::cout << "streaming tiles of the field, " << tileStreamer->layout().tilesCount() << " tiles\n";
+    }
+
+    fieldStaging = std::unique_ptr<FieldStaging>{ new FieldStaging(
+        tileStreamer ? static_cast<FieldSink&>(*tileStreamer) : fieldSink, fieldBatches
+    ) };
+    auto const current_outputs = []() -> std::unique_ptr<FieldOutput> {
+        return std::unique_ptr<FieldOutput>( new StagedFieldOutput{ *fieldStaging, false } );
     };
-    auto const buffer_outputs = [window]() -> std::unique_ptr<FieldOutput> {
-        return std::unique_ptr<FieldOutput>(new GLFieldOutput{ true, window });
+    auto const buffer_outputs = []() -> std::unique_ptr<FieldOutput> {
+        return std::unique_ptr<FieldOutput>(new StagedFieldOutput{ *fieldStaging, true });
     };
 
-    const auto currrrr = current_outputs();
-    const auto bufffff = buffer_outputs();
-
     grid = std::unique_ptr<Field>{ new Field(
         gridWidth, gridHeight, numberOfTasks, 
         current_outputs, buffer_outputs
     ) };     
 
     field_size_bytes = grid->size_bytes();
+    if(tileStreamer) grid->setDensityPyramidEnabled(true);
+
+    if(auto const metricsPort = metricsPortFromEnvironment()) {
+        metricsServer = std::unique_ptr<MetricsServer>{ new MetricsServer{} };
+        metricsServer->addHistogram("gol_frame", frameTime);
+        metricsServer->addHistogram("gol_field_wait", fieldUpdateWait);
+        metricsServer->addHistogram("gol_update", update);
+        metricsServer->addHistogram("gol_set", set);
+        metricsServer->addHistogram("gol_draw", draw);
+        metricsServer->addHistogram("gol_post_processing", postProcessing);
+        metricsServer->addHistogram("gol_swap", swap);
+        if(metricsServer->start(metricsPort)) std::cout << "metrics on http://127.0.0.1:" << metricsServer->port() << "/metrics\n";
+        else {
+            std::cout << "metrics port " << metricsPort << " is not available\n";
+            metricsServer.reset();
+        }
+    }
+
+    if(auto const ringName = fieldRingNameFromEnvironment(); !ringName.empty()) {
+        fieldRingPublisher = std::unique_ptr<FieldRingPublisher>{ new FieldRingPublisher{ gridWidth, gridHeight, grid->width_actual() / 32 } };
+        auto const result = fieldRingPublisher->start(ringName);
+        if(result == shm::CreateResult::created) std::cout << "publishing generations to shared memory " << ringName << '\n';
+        else {
+            if(result == shm::CreateResult::nameInUse) std::cout << "shared memory " << ringName << " is in use by another process or was left by one that crashed\n";
+            else std::cout << "shared memory " << ringName << " can't be created\n";
+            fieldRingPublisher.reset();
+        }
+    }
+
+    if(auto const streamPort = streamPortFromEnvironment()) {
+        deltaStreamServer = std::unique_ptr<DeltaStreamServer>{ new DeltaStreamServer{ gridWidth, gridHeight, grid->width_actual() / 32 } };
+        if(deltaStreamServer->start(streamPort)) std::cout << "streaming generations on port " << deltaStreamServer->port() << '\n';
+        else {
+            std::cout << "stream port " << streamPort << " is not available\n";
+            deltaStreamServer.reset();
+        }
+    }
     
     //{
     //    AutoTimer<> t{ "set" };
@@ -574,24 +724,30 @@ int main() {
         }
     }
 
-    gridUpdate = false;
-    grid->startCurGeneration();
+    //generation tasks write only batches that differ from the previous contents of the buffer,
+    //so both buffers start the same as the field's buffers: cleared, the current one is written below
+    //(tiled fields are displayed from the tiles, the buffers are only bound for the shader)
+    std::vector<uint8_t> const clearedBuffer(tileStreamer ? 4 : misc::roundUpIntTo(field_size_bytes, 4), 0);
+    if(tileStreamer) tileSink.create(tileStreamer->layout(), TileStreamOptions{}.slotsCount);
 
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, packedGrid1);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, misc::roundUpIntTo(field_size_bytes, 4), NULL, GL_DYNAMIC_DRAW);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, clearedBuffer.size(), clearedBuffer.data(), GL_DYNAMIC_DRAW);
     //glBufferData(GL_SHADER_STORAGE_BUFFER, misc::roundUpIntTo(field_size_bytes * 2, 4), NULL, GL_DYNAMIC_DRAW);
     //if(isWritingSecondBuffer) glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, field_size_bytes, grid->rawData());
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, packedGrid1);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, packedGrid2);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, misc::roundUpIntTo(field_size_bytes, 4), NULL, GL_DYNAMIC_DRAW);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, clearedBuffer.size(), clearedBuffer.data(), GL_DYNAMIC_DRAW);
     //if (!isWritingSecondBuffer) glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, field_size_bytes, grid->rawData());
     //glBufferSubData(GL_SHADER_STORAGE_BUFFER, !isWritingSecondBuffer * field_size_bytes, field_size_bytes, grid->rawData());
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, packedGrid2);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
-    currrrr->write({ 0, misc::intDivCeil(field_size_bytes, 4), grid->rawData() });
+    current_outputs()->write({ 0, misc::intDivCeil(field_size_bytes, 4), grid->rawData() });
+
+    gridUpdate = false;
+    grid->startCurGeneration();
 
     //uniforms set
     glUniform2i(glGetUniformLocation(mainProg, "winSize"), winSize.windowSize.x, winSize.windowSize.y);
@@ -613,6 +769,19 @@ int main() {
 
     GLint mDeltaScaleChangeP = glGetUniformLocation(mainProg, "deltaScaleChange");
 
+    glUniform1ui(glGetUniformLocation(mainProg, "isTiled"), tileStreamer != nullptr);
+    if(tileStreamer) {
+        auto const &layout = tileStreamer->layout();
+        glUniform1ui(glGetUniformLocation(mainProg, "tileBatches"), layout.tileBatches);
+        glUniform1i(glGetUniformLocation(mainProg, "tileRows"), layout.tileRows);
+        glUniform1i(glGetUniformLocation(mainProg, "tilesX"), layout.tilesX);
+    }
+    GLint isDensityP = glGetUniformLocation(mainProg, "isDensity");
+    GLint densityBlockSizeP = glGetUniformLocation(mainProg, "densityBlockSize");
+    GLint densityStartP = glGetUniformLocation(mainProg, "densityStart");
+    GLint densitySizeP = glGetUniformLocation(mainProg, "densitySize");
+    GLint densityLevelSizeP = glGetUniformLocation(mainProg, "densityLevelSize");
+
 
     glActiveTexture(GL_TEXTURE0);
     glGenTextures(1, &frameBufferTexture);
@@ -667,9 +836,11 @@ int main() {
         glUseProgram(mainProg);
 
         Timer<> frame{};
+        TraceSpan frameSpan{ "frame" };
         {
 
             Timer<> t{};
+            TraceSpan span{ "set" };
             glUniform2f(vpPosP, space.vpPos.x, space.vpPos.y); 
             glUniform1f(vpSizeP, space.vpSize);
 
@@ -680,9 +851,34 @@ int main() {
 
             glUniform1f(mDeltaScaleChangeP, dVpSize);
 
+            if(isFieldResized) {
+                glUniform1i(glGetUniformLocation(mainProg, "gridWidth"), gridWidth);
+                glUniform1i(glGetUniformLocation(mainProg, "gridHeight"), gridHeight);
+                glUniform1ui(glGetUniformLocation(mainProg, "gridWidth_actual"), grid->width_actual());
+                glUniform1ui(glGetUniformLocation(mainProg, "bufferOffset_bytes"), grid->size_bytes());
+                isFieldResized = false;
+            }
+
+            if(tileStreamer) {
+                //lens distortion and zooming show more of the field than the viewport
+                auto const overscan = 0.25 + std::abs(dVpSize);
+                tileStreamer->update(
+                    FieldView{ space.vpPos, space.vpSize, winSize.windowSize, overscan },
+                    *fieldStaging, grid->densityPyramid()
+                );
+                glUniform1ui(isDensityP, tileStreamer->isDensityMode());
+                if(tileStreamer->isDensityMode()) {
+                    auto const &window = tileStreamer->density();
+                    glUniform1i(densityBlockSizeP, 1 << window.level);
+                    glUniform2i(densityStartP, window.start.x, window.start.y);
+                    glUniform2i(densitySizeP, window.size.x, window.size.y);
+                    glUniform2i(densityLevelSizeP, window.levelSize.x, window.levelSize.y);
+                }
+            }
+
             glFinish();
 
-            set.add(t.elapsedTime());
+            set.record(t.elapsedNanoseconds());
         }
 
         while ((err = glGetError()) != GL_NO_ERROR)
@@ -692,19 +888,20 @@ int main() {
 
         //glClear(GL_COLOR_BUFFER_BIT);
         {
-            //std::unique_lock<std::mutex> lock{ gpuBufferLock };
             {
                 Timer<> t{};
+                TraceSpan span{ "draw" };
 
                 glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
                 glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, 1);
                 glBindFramebuffer(GL_FRAMEBUFFER, 0);
-                draw.add(t.elapsedTime());
+                draw.record(t.elapsedNanoseconds());
             }
 
             {
                 auto const windowSize = winSize.windowSizeD;
                 Timer<> t{};
+                TraceSpan span{ "post processing" };
                 glUseProgram(postProcessingProg);
                 glBindTexture(GL_TEXTURE_2D, frameBufferTexture);
 
@@ -717,26 +914,28 @@ int main() {
 
                 glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, 1);
                 glBindTexture(GL_TEXTURE_2D, 0);
-                postProcessing.add(t.elapsedTime());
+                postProcessing.record(t.elapsedNanoseconds());
             }
 
             {
                 Timer<> t{};
+                TraceSpan span{ "swap" };
                 glfwSwapBuffers(window);
-                swap.add(t.elapsedTime());
+                swap.record(t.elapsedNanoseconds());
             }
         }
 
         {
             Timer<> t{};
+            TraceSpan span{ "update" };
             glfwPollEvents();
 
             updateState();
-            update.add(t.elapsedTime());
+            update.record(t.elapsedNanoseconds());
         }
 
         //std::cout << frame.elapsedTime() << ::std::endl;
-        microsecPerFrame.add(frame.elapsedTime());
+        frameTime.record(frame.elapsedNanoseconds());
     }
 
     glDeleteTextures(1, &frameBufferTexture);
@@ -0,0 +1,132 @@
+#include"MetricsServer.h"
+
+#include<chrono>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+
+static uint64_t nowNs() {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count());
+}
+
+MetricsServer::MetricsServer() :
+    metrics{},
+    histograms{},
+    isStopped{ true },
+    listener{ net::invalidSocket },
+    thread{},
+    rateGeneration{ 0 },
+    rateStartNs{ nowNs() },
+    lastGenerationsPerSecond{ 0 }
+{}
+
+MetricsServer::~MetricsServer() {
+    isStopped.store(true);
+    if(thread.joinable()) thread.join();
+    net::close(listener);
+}
+
+void MetricsServer::addHistogram(std::string name, LatencyHistogram const &histogram) {
+    histograms.push_back(NamedHistogram{ std::move(name), &histogram });
+}
+
+bool MetricsServer::start(uint16_t const port) {
+    if(thread.joinable()) return false;
+    listener = net::listenLocal(port);
+    if(listener == net::invalidSocket) return false;
+    isStopped.store(false);
+    thread = std::thread{ &MetricsServer::serve, this };
+    return true;
+}
+
+uint16_t MetricsServer::port() const {
+    return listener == net::invalidSocket ? 0 : net::localPort(listener);
+}
+
+void MetricsServer::publish(SimulationMetrics snapshot) {
+    auto const now = nowNs();
+    auto const elapsedNs = now - rateStartNs;
+    if(snapshot.generation < rateGeneration) {
+        rateGeneration = snapshot.generation;
+        rateStartNs = now;
+    }
+    else if(elapsedNs >= 500'000'000) {
+        lastGenerationsPerSecond = double(snapshot.generation - rateGeneration) * 1e9 / elapsedNs;
+        rateGeneration = snapshot.generation;
+        rateStartNs = now;
+    }
+    snapshot.generationsPerSecond = lastGenerationsPerSecond;
+    snapshot.cellsPerSecond = lastGenerationsPerSecond * snapshot.cells;
+    metrics.store(snapshot);
+}
+
+static void appendMetric(std::string &out, char const *const name, char const *const type, char const *const help, double const value) {
+    char line[256];
+    std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n%s %.17g\n", name, help, name, type, name, value);
+    out += line;
+}
+
+std::string MetricsServer::render() const {
+    auto const m = metrics.load();
+    std::string out{};
+    appendMetric(out, "gol_generation", "counter", "Current generation", double(m.generation));
+    appendMetric(out, "gol_generations_per_second", "gauge", "Generations computed per second", m.generationsPerSecond);
+    appendMetric(out, "gol_cells_per_second", "gauge", "Cells updated per second", m.cellsPerSecond);
+    appendMetric(out, "gol_cells", "gauge", "Cells in the field", double(m.cells));
+    appendMetric(out, "gol_population", "gauge", "Alive cells", double(m.population));
+    appendMetric(out, "gol_active_tiles", "gauge", "32x32 tiles inside the bounding box of alive cells", double(m.activeTiles));
+    appendMetric(out, "gol_pending_edit_batches", "gauge", "Edited batches waiting for repair", double(m.pendingEditBatches));
+    appendMetric(out, "gol_undo_bytes", "gauge", "Memory used by the undo history", double(m.undoBytes));
+
+    char line[256];
+    for(auto const &h : histograms) {
+        std::snprintf(line, sizeof(line), "# HELP %s_seconds Latency of %s\n# TYPE %s_seconds summary\n",
+            h.name.c_str(), h.name.c_str(), h.name.c_str());
+        out += line;
+        for(auto const q : { 0.5, 0.99, 0.999 }) {
+            std::snprintf(line, sizeof(line), "%s_seconds{quantile=\"%g\"} %.9f\n",
+                h.name.c_str(), q, h.histogram->quantile(q) / 1e9);
+            out += line;
+        }
+        std::snprintf(line, sizeof(line), "%s_seconds_sum %.9f\n%s_seconds_count %llu\n",
+            h.name.c_str(), h.histogram->sum() / 1e9, h.name.c_str(), (unsigned long long) h.histogram->count());
+        out += line;
+    }
+    return out;
+}
+
+void MetricsServer::serve() {
+    while(!isStopped.load()) {
+        auto const client = net::accept(listener, 100);
+        if(client == net::invalidSocket) continue;
+
+        //only the request line matters, the rest of the request is ignored
+        char request[1024];
+        size_t size = 0;
+        while(size < sizeof(request) - 1 && std::memchr(request, '\n', size) == nullptr) {
+            if(!net::waitReadable(client, 1000)) break;
+            auto const count = net::receive(client, request + size, sizeof(request) - 1 - size);
+            if(count <= 0) break;
+            size += size_t(count);
+        }
+        request[size] = '\0';
+
+        auto const isMetrics = std::strncmp(request, "GET /metrics ", 13) == 0 || std::strncmp(request, "GET / ", 6) == 0;
+        auto const body = isMetrics ? render() : std::string{ "not found\n" };
+        char header[256];
+        std::snprintf(header, sizeof(header),
+            "HTTP/1.1 %s\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+            isMetrics ? "200 OK" : "404 Not Found", body.size());
+        if(net::sendAll(client, header, std::strlen(header))) net::sendAll(client, body.data(), body.size());
+        net::close(client);
+    }
+}
+
+uint16_t metricsPortFromEnvironment() {
+    auto const value = std::getenv("GOL_METRICS_PORT");
+    if(value == nullptr) return 0;
+    auto const port = std::atoi(value);
+    return port > 0 && port < 65536 ? uint16_t(port) : 0;
+}
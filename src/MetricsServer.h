@@ -0,0 +1,66 @@
+#pragma once
+
+#include<stdint.h>
+#include<atomic>
+#include<string>
+#include<thread>
+#include<vector>
+#include"Seqlock.h"
+#include"LatencyHistogram.h"
+#include"Socket.h"
+
+struct SimulationMetrics {
+    uint64_t generation;
+    uint64_t cells;
+    uint64_t population;
+    uint64_t activeTiles; //32x32 tiles inside the bounding box of alive cells
+    uint64_t pendingEditBatches; //batches edited during the current generation, waiting for repair
+    uint64_t undoBytes;
+    double generationsPerSecond; //filled by publish()
+    double cellsPerSecond;
+};
+
+//opt-in HTTP endpoint on 127.0.0.1 serving the published metrics in Prometheus text format.
+//The simulation publishes a snapshot through a seqlock and histograms are read with relaxed
+//atomics, so nothing on the simulation side waits for the server
+class MetricsServer final {
+    struct NamedHistogram {
+        std::string name;
+        LatencyHistogram const *histogram;
+    };
+
+    Seqlock<SimulationMetrics> metrics;
+    std::vector<NamedHistogram> histograms; //not modified after start()
+    std::atomic_bool isStopped;
+    net::SocketHandle listener;
+    std::thread thread;
+
+    //used only by publish()
+    uint64_t rateGeneration;
+    uint64_t rateStartNs;
+    double lastGenerationsPerSecond;
+public:
+    MetricsServer();
+    ~MetricsServer();
+
+    MetricsServer(MetricsServer const&) = delete;
+    MetricsServer& operator=(MetricsServer const&) = delete;
+
+    //latency percentiles of `histogram` are exported as `name`, must be called before start()
+    void addHistogram(std::string name, LatencyHistogram const &histogram);
+
+    //returns false if the port can't be used
+    bool start(uint16_t const port);
+    uint16_t port() const;
+
+    //from one thread only. Rates are computed over windows of at least half a second
+    void publish(SimulationMetrics snapshot);
+
+    //metrics text as served to scrapers
+    std::string render() const;
+private:
+    void serve();
+};
+
+//port of the endpoint from the GOL_METRICS_PORT environment variable, 0 if it is not set
+uint16_t metricsPortFromEnvironment();
@@ -0,0 +1,221 @@
+#include"PackedPattern.h"
+#include"Misc.h"
+
+#include<cassert>
+#include<cstdio>
+#include<algorithm>
+
+#include<nmmintrin.h>
+
+PackedPattern::PackedPattern(uint32_t const width_, uint32_t const height_) :
+    patternWidth{ width_ },
+    patternHeight{ height_ },
+    patternRowLength{ width_ == 0 ? 0 : misc::intDivCeil(width_, batchLength) },
+    cells(patternRowLength * height_, 0),
+    shiftedCopies{}
+{}
+
+PackedPattern::PackedPattern(uint32_t const width_, uint32_t const height_, std::vector<uint32_t> cells_) :
+    patternWidth{ width_ },
+    patternHeight{ height_ },
+    patternRowLength{ width_ == 0 ? 0 : misc::intDivCeil(width_, batchLength) },
+    cells(std::move(cells_)),
+    shiftedCopies{}
+{
+    assert(cells.size() == patternRowLength * patternHeight);
+    auto const lastCells = patternWidth % batchLength;
+    if(lastCells != 0) for(uint32_t row = 0; row < patternHeight; row++) {
+        cells[row * patternRowLength + patternRowLength - 1] &= (1u << lastCells) - 1;
+    }
+}
+
+PackedPattern PackedPattern::fromString(char const *const pattern) {
+    uint32_t width = 0, height = 0, x = 0;
+    for(auto c = pattern; *c != '\0'; c++) {
+        if(*c == '\n') { x = 0; continue; }
+        if(x == 0) height++;
+        x++;
+        width = misc::max(width, x);
+    }
+
+    PackedPattern result{ width, height };
+    uint32_t y = 0;
+    x = 0;
+    for(auto c = pattern; *c != '\0'; c++) {
+        if(*c == '\n') { if(x != 0) y++; x = 0; continue; }
+        if(*c == 'o' || *c == '*') result.setCellAt(x, y, true);
+        x++;
+    }
+    return result;
+}
+
+bool PackedPattern::fromRle(char const *const rle, PackedPattern &result) {
+    auto c = rle;
+    auto const skipLine = [&c]() {
+        while(*c != '\0' && *c != '\n') c++;
+        if(*c == '\n') c++;
+    };
+    while(*c == '#' || *c == '\n' || *c == '\r') skipLine();
+
+    unsigned width, height;
+    if(std::sscanf(c, " x = %u , y = %u", &width, &height) != 2) return false;
+    skipLine();
+
+    PackedPattern pattern{ width, height };
+    uint32_t x = 0, y = 0, count = 0;
+    for(; *c != '\0' && *c != '!'; c++) {
+        if(*c >= '0' && *c <= '9') { count = count * 10 + uint32_t(*c - '0'); continue; }
+        if(*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n') continue;
+
+        auto const run = count == 0 ? 1 : count;
+        count = 0;
+        if(*c == '$') { y += run; x = 0; }
+        else if(*c == 'b' || *c == '.') x += run;
+        else { //'o' and states of other rules are alive
+            if(x + run > width || y >= height) return false;
+            for(uint32_t i = 0; i < run; i++) pattern.setCellAt(x + i, y, true);
+            x += run;
+        }
+    }
+
+    result = std::move(pattern);
+    return true;
+}
+
+bool PackedPattern::cellAt(uint32_t const x, uint32_t const y) const {
+    return (cells[y * patternRowLength + x / batchLength] >> (x % batchLength)) & 1;
+}
+
+void PackedPattern::setCellAt(uint32_t const x, uint32_t const y, bool const cell) {
+    assert(x < patternWidth && y < patternHeight);
+    auto& batch = cells[y * patternRowLength + x / batchLength];
+    auto const shift = x % batchLength;
+    batch = (batch & ~(1u << shift)) | (uint32_t(cell) << shift);
+    clearShiftedCopies();
+}
+
+void PackedPattern::clearShiftedCopies() {
+    shiftedCopies.clear();
+}
+
+uint32_t PackedPattern::shiftedRowLength(uint32_t const shift) const {
+    return misc::intDivCeil(patternWidth + shift, batchLength);
+}
+
+uint32_t const *PackedPattern::shifted(uint32_t const shift) const {
+    assert(shift < batchLength);
+    if(shift == 0) return cells.data();
+    if(shiftedCopies.empty()) shiftedCopies.resize(batchLength);
+
+    auto& copy = shiftedCopies[shift];
+    if(copy.empty() && patternWidth != 0) {
+        auto const rowLen = shiftedRowLength(shift);
+        copy.resize(rowLen * patternHeight);
+        for(uint32_t row = 0; row < patternHeight; row++) {
+            auto const src = cells.data() + row * patternRowLength;
+            auto const dst = copy.data() + row * rowLen;
+            for(uint32_t i = 0; i < rowLen; i++) {
+                auto const cur = i < patternRowLength ? src[i] : 0u;
+                auto const prev = i > 0 ? src[i - 1] : 0u;
+                dst[i] = (cur << shift) | (prev >> (batchLength - shift));
+            }
+        }
+    }
+    return copy.data();
+}
+
+//transposes 32x32 bit matrix, `in[row]` bit `col` becomes `out[col]` bit `row`.
+//Bytes of 16 rows are gathered into one register, so movemask extracts
+//one bit of 16 rows at once
+static void transpose32(uint32_t const *const in, uint32_t *const out) {
+    auto const gatherBytes = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+
+    for(int half = 0; half < 2; half++) {
+        __m128i q[4];
+        for(int i = 0; i < 4; i++) {
+            //dword `k` of q[i] is byte `k` of rows 4i..4i+3
+            q[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(in + half * 16 + i * 4)), gatherBytes);
+        }
+        auto const t0 = _mm_unpacklo_epi32(q[0], q[1]), t1 = _mm_unpacklo_epi32(q[2], q[3]);
+        auto const t2 = _mm_unpackhi_epi32(q[0], q[1]), t3 = _mm_unpackhi_epi32(q[2], q[3]);
+        //bytes[k] is byte `k` of rows 0..15 of this half
+        __m128i bytes[4] = {
+            _mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1),
+            _mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3)
+        };
+
+        for(int k = 0; k < 4; k++) {
+            auto v = bytes[k];
+            for(int bit = 7; bit >= 0; bit--) {
+                auto const rows = uint32_t(uint16_t(_mm_movemask_epi8(v))) << (half * 16);
+                auto& o = out[k * 8 + bit];
+                o = half == 0 ? rows : (o | rows);
+                v = _mm_add_epi8(v, v);
+            }
+        }
+    }
+}
+
+PackedPattern PackedPattern::transposed() const {
+    PackedPattern result{ patternHeight, patternWidth };
+    uint32_t block[32], blockT[32];
+
+    for(uint32_t blockRow = 0; blockRow < patternHeight; blockRow += batchLength) {
+        auto const rows = misc::min(batchLength, patternHeight - blockRow);
+        for(uint32_t blockCol = 0; blockCol < patternRowLength; blockCol++) {
+            for(uint32_t i = 0; i < batchLength; i++) {
+                block[i] = i < rows ? cells[(blockRow + i) * patternRowLength + blockCol] : 0;
+            }
+            transpose32(block, blockT);
+
+            auto const cols = misc::min(batchLength, patternWidth - blockCol * batchLength);
+            for(uint32_t i = 0; i < cols; i++) {
+                result.cells[(blockCol * batchLength + i) * result.patternRowLength + blockRow / batchLength] = blockT[i];
+            }
+        }
+    }
+    return result;
+}
+
+static uint32_t reverseBits(uint32_t v) {
+    v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+    v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+    v = ((v >> 4) & 0x0f0f0f0fu) | ((v & 0x0f0f0f0fu) << 4);
+    return __builtin_bswap32(v);
+}
+
+PackedPattern PackedPattern::flippedHorizontally() const {
+    PackedPattern result{ patternWidth, patternHeight };
+    //reversing whole batches reverses the row padded to rowLength * 32,
+    //it is then shifted by the padding
+    auto const padding = patternRowLength * batchLength - patternWidth;
+    for(uint32_t row = 0; row < patternHeight; row++) {
+        auto const src = cells.data() + row * patternRowLength;
+        auto const dst = result.cells.data() + row * patternRowLength;
+        for(uint32_t i = 0; i < patternRowLength; i++) {
+            auto const cur = reverseBits(src[patternRowLength - 1 - i]);
+            auto const next = i + 1 < patternRowLength ? reverseBits(src[patternRowLength - 2 - i]) : 0u;
+            dst[i] = padding == 0 ? cur : ((cur >> padding) | (next << (batchLength - padding)));
+        }
+    }
+    return result;
+}
+
+PackedPattern PackedPattern::flippedVertically() const {
+    PackedPattern result{ patternWidth, patternHeight };
+    for(uint32_t row = 0; row < patternHeight; row++) {
+        std::copy(
+            cells.begin() + row * patternRowLength, cells.begin() + (row + 1) * patternRowLength,
+            result.cells.begin() + (patternHeight - 1 - row) * patternRowLength
+        );
+    }
+    return result;
+}
+
+PackedPattern PackedPattern::rotatedClockwise() const {
+    return transposed().flippedHorizontally();
+}
+
+PackedPattern PackedPattern::rotatedCounterClockwise() const {
+    return transposed().flippedVertically();
+}
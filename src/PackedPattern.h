@@ -0,0 +1,49 @@
+#pragma once
+
+#include<stdint.h>
+#include<vector>
+
+//rectangle of cells packed the same way as rows of the field:
+//`height` rows of `rowLength` batches, column `x` is bit `x % 32` of batch `x / 32`.
+//Bits past `width` in the last batch of a row are always 0
+class PackedPattern final {
+public:
+    static constexpr uint32_t batchLength = 32;
+private:
+    uint32_t patternWidth;
+    uint32_t patternHeight;
+    uint32_t patternRowLength;
+    std::vector<uint32_t> cells;
+
+    //copies of the pattern with 0..31 empty columns before it, built on first use.
+    //Pasting at any column is then aligned batch writes
+    mutable std::vector<std::vector<uint32_t>> shiftedCopies;
+public:
+    PackedPattern(uint32_t const width_, uint32_t const height_);
+    PackedPattern(uint32_t const width_, uint32_t const height_, std::vector<uint32_t> cells_);
+    //rows of 'o'/'*' (alive) and '.' (dead) separated by '\n'
+    static PackedPattern fromString(char const *const pattern);
+    //run length encoded pattern ("x = 3, y = 3\nbo$2bo$3o!"), '#' lines are comments.
+    //Returns false if the header is missing or the pattern doesn't fit into it
+    static bool fromRle(char const *const rle, PackedPattern &result);
+public:
+    uint32_t width() const { return patternWidth; }
+    uint32_t height() const { return patternHeight; }
+    uint32_t rowLength() const { return patternRowLength; }
+    uint32_t const *data() const { return cells.data(); }
+
+    bool cellAt(uint32_t const x, uint32_t const y) const;
+    void setCellAt(uint32_t const x, uint32_t const y, bool const cell);
+
+    //`shiftedRowLength(shift)` batches per row, column `x` of the pattern is column `x + shift`
+    uint32_t const *shifted(uint32_t const shift) const;
+    uint32_t shiftedRowLength(uint32_t const shift) const;
+
+    PackedPattern transposed() const;
+    PackedPattern flippedHorizontally() const;
+    PackedPattern flippedVertically() const;
+    PackedPattern rotatedClockwise() const;
+    PackedPattern rotatedCounterClockwise() const;
+private:
+    void clearShiftedCopies();
+};
@@ -0,0 +1,82 @@
+#include"PerfCounters.h"
+
+#include<chrono>
+
+#ifdef __linux__
+    #include<linux/perf_event.h>
+    #include<sys/syscall.h>
+    #include<sys/ioctl.h>
+    #include<unistd.h>
+#endif
+
+static uint64_t nowNs() {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count());
+}
+
+#ifdef __linux__
+static int openCounter(uint64_t const config, int const groupFd) {
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = groupFd == -1; //members follow the leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return int(syscall(SYS_perf_event_open, &attr, 0 /*this thread*/, -1 /*any cpu*/, groupFd, 0));
+}
+#endif
+
+PerfCounters::PerfCounters() : fds{ -1, -1, -1, -1 }, startNs{ 0 } {
+#ifdef __linux__
+    uint64_t const configs[countersCount] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES
+    };
+    fds[0] = openCounter(configs[0], -1);
+    if(fds[0] == -1) return;
+    for(uint32_t i = 1; i < countersCount; i++) fds[i] = openCounter(configs[i], fds[0]);
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for(auto const fd : fds) if(fd != -1) close(fd);
+#endif
+}
+
+void PerfCounters::start() {
+    if(!isAvailable()) return;
+#ifdef __linux__
+    ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    startNs = nowNs();
+}
+
+PerfSample PerfCounters::stop() {
+    PerfSample sample{};
+    if(!isAvailable()) return sample;
+#ifdef __linux__
+    ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    sample.nanoseconds = nowNs() - startNs;
+
+    //group read: number of counters, then their values in the order they were opened
+    uint64_t values[1 + countersCount]{};
+    if(read(fds[0], values, sizeof(values)) < ssize_t(2 * sizeof(uint64_t))) return sample;
+    uint64_t counters[countersCount]{};
+    for(uint32_t i = 0, value = 0; i < countersCount && value < values[0]; i++) {
+        if(fds[i] != -1) counters[i] = values[1 + value++];
+    }
+
+    sample.valid = true;
+    sample.hasCacheCounters = fds[2] != -1 && fds[3] != -1;
+    sample.cycles = counters[0];
+    sample.instructions = counters[1];
+    sample.cacheReferences = counters[2];
+    sample.cacheMisses = counters[3];
+#endif
+    return sample;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include<stdint.h>
+
+//hardware counters of one thread over a span of work
+struct PerfSample {
+    bool valid; //false if counters are disabled or not permitted
+    bool hasCacheCounters; //cache events are not supported everywhere
+    uint64_t nanoseconds;
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t cacheReferences;
+    uint64_t cacheMisses; //last level cache
+
+    void add(PerfSample const &other) {
+        if(!other.valid) return;
+        hasCacheCounters = valid ? (hasCacheCounters && other.hasCacheCounters) : other.hasCacheCounters;
+        valid = true;
+        nanoseconds += other.nanoseconds;
+        cycles += other.cycles;
+        instructions += other.instructions;
+        cacheReferences += other.cacheReferences;
+        cacheMisses += other.cacheMisses;
+    }
+
+    double ipc() const { return cycles == 0 ? 0.0 : double(instructions) / cycles; }
+    //every miss is counted as one 64 byte line read from memory
+    double memoryBytesPerSecond() const {
+        return nanoseconds == 0 ? 0.0 : double(cacheMisses) * 64 * 1e9 / nanoseconds;
+    }
+};
+
+//cycles, instructions and cache counters of the thread that created the object, read with perf_event_open.
+//Counters are unavailable on other systems, in containers without the permission,
+//or with kernel.perf_event_paranoid too high; every call is a no-op then
+class PerfCounters final {
+    static constexpr uint32_t countersCount = 4;
+    int fds[countersCount]; //cycles (group leader), instructions, cache references, cache misses; -1 if not opened
+    uint64_t startNs;
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(PerfCounters const&) = delete;
+    PerfCounters& operator=(PerfCounters const&) = delete;
+
+    bool isAvailable() const { return fds[0] != -1 && fds[1] != -1; }
+
+    void start();
+    PerfSample stop();
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include<stdint.h>
+#include<atomic>
+#include<cstring>
+#include<type_traits>
+
+//value with one writer and any number of readers. The writer never waits,
+//readers retry until they copy the value without a write in between
+template<class T>
+class Seqlock final {
+    static_assert(std::is_trivially_copyable<T>::value, "value is copied as raw words");
+    static constexpr size_t wordsCount = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint64_t> sequence; //odd while a write is in progress
+    std::atomic<uint64_t> words[wordsCount];
+public:
+    Seqlock() : sequence{ 0 } {
+        for(auto &word : words) word.store(0, std::memory_order_relaxed);
+    }
+
+    Seqlock(Seqlock const&) = delete;
+    Seqlock& operator=(Seqlock const&) = delete;
+
+    void store(T const &value) {
+        uint64_t raw[wordsCount]{};
+        std::memcpy(raw, &value, sizeof(T));
+
+        auto const seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for(size_t i = 0; i < wordsCount; i++) words[i].store(raw[i], std::memory_order_relaxed);
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        uint64_t raw[wordsCount];
+        while(true) {
+            auto const before = sequence.load(std::memory_order_acquire);
+            if(before & 1) continue;
+            for(size_t i = 0; i < wordsCount; i++) raw[i] = words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(sequence.load(std::memory_order_relaxed) == before) break;
+        }
+        T value;
+        std::memcpy(&value, raw, sizeof(T));
+        return value;
+    }
+
+    //number of stores so far
+    uint64_t version() const { return sequence.load(std::memory_order_acquire) / 2; }
+};
@@ -0,0 +1,108 @@
+#include"SharedMemory.h"
+
+#include<string>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include<windows.h>
+#else
+    #include<sys/mman.h>
+    #include<sys/stat.h>
+    #include<fcntl.h>
+    #include<unistd.h>
+    #include<cerrno>
+#endif
+
+namespace shm {
+#ifdef _WIN32
+    static std::string nativeName(char const *const name) { return std::string{ "Local\\" } + name; }
+
+    CreateResult create(char const *const name, size_t const size, Mapping &mapping) {
+        auto const handle = CreateFileMappingA(
+            INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+            DWORD(uint64_t(size) >> 32), DWORD(size & 0xffffffffu), nativeName(name).c_str()
+        );
+        if(handle == nullptr) return CreateResult::failed;
+        //the handle is of the existing mapping, which may be of another size
+        if(GetLastError() == ERROR_ALREADY_EXISTS) {
+            CloseHandle(handle);
+            return CreateResult::nameInUse;
+        }
+        auto const data = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+        if(data == nullptr) {
+            CloseHandle(handle);
+            return CreateResult::failed;
+        }
+        mapping = Mapping{ data, size, intptr_t(handle) };
+        return CreateResult::created;
+    }
+
+    bool open(char const *const name, Mapping &mapping) {
+        auto const handle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, nativeName(name).c_str());
+        if(handle == nullptr) return false;
+        auto const data = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+        MEMORY_BASIC_INFORMATION info{};
+        if(data == nullptr || VirtualQuery(data, &info, sizeof(info)) == 0) {
+            if(data != nullptr) UnmapViewOfFile(data);
+            CloseHandle(handle);
+            return false;
+        }
+        mapping = Mapping{ data, size_t(info.RegionSize), intptr_t(handle) };
+        return true;
+    }
+
+    void close(Mapping &mapping) {
+        if(mapping.data != nullptr) UnmapViewOfFile(mapping.data);
+        if(mapping.handle != -1) CloseHandle(HANDLE(mapping.handle));
+        mapping = Mapping{};
+    }
+
+    void remove(char const *const name) {}
+#else
+    static std::string nativeName(char const *const name) { return std::string{ "/" } + name; }
+
+    CreateResult create(char const *const name, size_t const size, Mapping &mapping) {
+        auto const path = nativeName(name);
+        auto const fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if(fd < 0) return errno == EEXIST ? CreateResult::nameInUse : CreateResult::failed;
+        if(ftruncate(fd, off_t(size)) != 0) {
+            ::close(fd);
+            shm_unlink(path.c_str());
+            return CreateResult::failed;
+        }
+        auto const data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(data == MAP_FAILED) {
+            shm_unlink(path.c_str());
+            return CreateResult::failed;
+        }
+        mapping = Mapping{ data, size, -1 };
+        return CreateResult::created;
+    }
+
+    bool open(char const *const name, Mapping &mapping) {
+        auto const fd = shm_open(nativeName(name).c_str(), O_RDWR, 0);
+        if(fd < 0) return false;
+        struct stat info{};
+        if(fstat(fd, &info) != 0 || info.st_size <= 0) {
+            ::close(fd);
+            return false;
+        }
+        auto const size = size_t(info.st_size);
+        auto const data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(data == MAP_FAILED) return false;
+        mapping = Mapping{ data, size, -1 };
+        return true;
+    }
+
+    void close(Mapping &mapping) {
+        if(mapping.data != nullptr) munmap(mapping.data, mapping.size);
+        mapping = Mapping{};
+    }
+
+    void remove(char const *const name) {
+        shm_unlink(nativeName(name).c_str());
+    }
+#endif
+}
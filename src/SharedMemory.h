@@ -0,0 +1,25 @@
+#pragma once
+
+#include<stdint.h>
+#include<stddef.h>
+
+//named shared memory that other processes on the machine can map, POSIX shm or a Windows file mapping
+namespace shm {
+    struct Mapping {
+        void *data = nullptr;
+        size_t size = 0;
+        intptr_t handle = -1;
+    };
+
+    enum class CreateResult : uint8_t { created, nameInUse, failed };
+
+    //creates `name` with `size` zeroed bytes. An existing one is left as it is and nameInUse is returned,
+    //it may belong to another process or be left by one that crashed, see remove()
+    CreateResult create(char const *const name, size_t const size, Mapping &mapping);
+    //maps existing `name` for reading and writing. False if it doesn't exist
+    bool open(char const *const name, Mapping &mapping);
+    void close(Mapping &mapping);
+    //removes the name so that new opens fail, processes that map it keep their mapping.
+    //On Windows the mapping is removed with its last handle instead
+    void remove(char const *const name);
+}
@@ -0,0 +1,138 @@
+#include"Socket.h"
+
+#ifdef _WIN32
+    #include<winsock2.h>
+    #include<ws2tcpip.h>
+    #include<mutex>
+    using socklen_t = int;
+#else
+    #include<sys/socket.h>
+    #include<netinet/in.h>
+    #include<netinet/tcp.h>
+    #include<arpa/inet.h>
+    #include<poll.h>
+    #include<unistd.h>
+    #include<cerrno>
+#endif
+
+namespace net {
+#ifdef _WIN32
+    static bool initialize() {
+        static std::once_flag once{};
+        static bool isInitialized = false;
+        std::call_once(once, []() {
+            WSADATA data{};
+            isInitialized = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+        });
+        return isInitialized;
+    }
+    static SOCKET native(SocketHandle const socket) { return SOCKET(socket); }
+    static bool isValid(SOCKET const socket) { return socket != INVALID_SOCKET; }
+    static int pollSockets(WSAPOLLFD *const fds, ULONG const count, int const timeoutMs) { return WSAPoll(fds, count, timeoutMs); }
+    using PollFd = WSAPOLLFD;
+    static int sendFlags() { return 0; }
+#else
+    static bool initialize() { return true; }
+    static int native(SocketHandle const socket) { return int(socket); }
+    static bool isValid(int const socket) { return socket >= 0; }
+    static int pollSockets(pollfd *const fds, nfds_t const count, int const timeoutMs) { return ::poll(fds, count, timeoutMs); }
+    using PollFd = pollfd;
+    static int sendFlags() { return MSG_NOSIGNAL; }
+#endif
+
+    static sockaddr_in loopback(uint16_t const port) {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return address;
+    }
+
+    static bool waitFor(SocketHandle const socket, short const events, int32_t const timeoutMs) {
+        PollFd fd{};
+        fd.fd = native(socket);
+        fd.events = events;
+        return pollSockets(&fd, 1, timeoutMs) > 0;
+    }
+
+    SocketHandle listenLocal(uint16_t const port) {
+        if(!initialize()) return invalidSocket;
+        auto const socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if(!isValid(socket)) return invalidSocket;
+
+        int const reuse = 1;
+        setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<char const*>(&reuse), sizeof(reuse));
+        auto const address = loopback(port);
+        if(bind(socket, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0 || listen(socket, 8) != 0) {
+            close(SocketHandle(socket));
+            return invalidSocket;
+        }
+        return SocketHandle(socket);
+    }
+
+    uint16_t localPort(SocketHandle const socket) {
+        sockaddr_in address{};
+        socklen_t length = sizeof(address);
+        if(getsockname(native(socket), reinterpret_cast<sockaddr*>(&address), &length) != 0) return 0;
+        return ntohs(address.sin_port);
+    }
+
+    SocketHandle accept(SocketHandle const listener, int32_t const timeoutMs) {
+        if(!waitFor(listener, POLLIN, timeoutMs)) return invalidSocket;
+        auto const socket = ::accept(native(listener), nullptr, nullptr);
+        return isValid(socket) ? SocketHandle(socket) : invalidSocket;
+    }
+
+    SocketHandle connectLocal(uint16_t const port) {
+        if(!initialize()) return invalidSocket;
+        auto const socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if(!isValid(socket)) return invalidSocket;
+
+        auto const address = loopback(port);
+        if(connect(socket, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0) {
+            close(SocketHandle(socket));
+            return invalidSocket;
+        }
+        int const noDelay = 1;
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char const*>(&noDelay), sizeof(noDelay));
+        return SocketHandle(socket);
+    }
+
+    bool waitReadable(SocketHandle const socket, int32_t const timeoutMs) {
+        return waitFor(socket, POLLIN, timeoutMs);
+    }
+
+    int64_t receive(SocketHandle const socket, void *const data, size_t const size) {
+        auto const count = ::recv(native(socket), reinterpret_cast<char*>(data), int(size), 0);
+        return count < 0 ? -1 : int64_t(count);
+    }
+
+    bool sendAll(SocketHandle const socket, void const *const data, size_t const size) {
+        auto const bytes = reinterpret_cast<char const*>(data);
+        size_t sent = 0;
+        while(sent < size) {
+            auto const count = ::send(native(socket), bytes + sent, int(size - sent), sendFlags());
+            if(count <= 0) return false;
+            sent += size_t(count);
+        }
+        return true;
+    }
+
+    void shutdown(SocketHandle const socket) {
+        if(socket == invalidSocket) return;
+    #ifdef _WIN32
+        ::shutdown(native(socket), SD_BOTH);
+    #else
+        ::shutdown(native(socket), SHUT_RDWR);
+    #endif
+    }
+
+    void close(SocketHandle const socket) {
+        if(socket == invalidSocket) return;
+    #ifdef _WIN32
+        closesocket(native(socket));
+    #else
+        ::close(native(socket));
+    #endif
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include<stdint.h>
+#include<stddef.h>
+
+//minimal blocking TCP sockets on the loopback interface, for local tools and endpoints
+namespace net {
+    using SocketHandle = intptr_t;
+    static constexpr SocketHandle invalidSocket = -1;
+
+    //listening socket on 127.0.0.1:`port`, port 0 picks a free one. invalidSocket on failure
+    SocketHandle listenLocal(uint16_t const port);
+    uint16_t localPort(SocketHandle const socket);
+    //waits up to `timeoutMs` for a connection, invalidSocket if there is none
+    SocketHandle accept(SocketHandle const listener, int32_t const timeoutMs);
+    //connection to 127.0.0.1:`port`, invalidSocket on failure
+    SocketHandle connectLocal(uint16_t const port);
+
+    //true if receive() won't block, waits up to `timeoutMs`
+    bool waitReadable(SocketHandle const socket, int32_t const timeoutMs);
+    //returns bytes read, 0 if the connection is closed, -1 on error
+    int64_t receive(SocketHandle const socket, void *const data, size_t const size);
+    //sends everything, false if the connection is broken
+    bool sendAll(SocketHandle const socket, void const *const data, size_t const size);
+    //makes send and receive calls blocked on `socket` in other threads return
+    void shutdown(SocketHandle const socket);
+    void close(SocketHandle const socket);
+}
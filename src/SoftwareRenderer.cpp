@@ -0,0 +1,199 @@
+#include"SoftwareRenderer.h"
+#include"Grid.h"
+#include"Misc.h"
+#include"Timer.h"
+
+#include<cassert>
+#include<cmath>
+
+#include<smmintrin.h>
+
+struct SoftwareRenderer::RenderData {
+    SoftwareRenderer const &renderer;
+    uint32_t index;
+
+    RenderData(SoftwareRenderer const &renderer_, uint32_t const index_) :
+        renderer{ renderer_ }, index{ index_ }
+    {}
+
+    void run() {
+        auto const rows = uint64_t(renderer.frameSize.y), tasks = uint64_t(renderer.numberOfTasks);
+        renderer.renderRows(uint32_t(rows * index / tasks), uint32_t(rows * (index + 1) / tasks));
+    }
+};
+
+//colors of fs.shader, every one of them is grey so only one channel is computed
+static constexpr float cellColor = 30.0f / 255.0f;
+static constexpr float backgroundColor = 225.0f / 255.0f;
+static constexpr float edgeColor = 0.5f; //mixed with cells at the field edges and used for padding
+static constexpr float cellPadding = 1 / 15.0f;
+
+//integer hash of pixel coordinates in [0; 1), used to jitter samples the way rand() does in the shader
+static __m128 pixelNoise(__m128i const x, __m128i const y) {
+    auto h = _mm_add_epi32(_mm_mullo_epi32(x, _mm_set1_epi32(int32_t(0x9e3779b1u))), _mm_mullo_epi32(y, _mm_set1_epi32(int32_t(0x85ebca77u))));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+    h = _mm_mullo_epi32(h, _mm_set1_epi32(int32_t(0x2c1b3c6du)));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 12));
+    h = _mm_mullo_epi32(h, _mm_set1_epi32(int32_t(0x297a2d39u)));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(h, 8)), _mm_set1_ps(1.0f / (1 << 24)));
+}
+
+//applyLensDistortion() of the shader
+static void applyLensDistortion(__m128 &x, __m128 &y, __m128 const centerX, __m128 const centerY, __m128 const invMaxSize, __m128 const intensity) {
+    auto const cx = _mm_sub_ps(x, centerX), cy = _mm_sub_ps(y, centerY);
+    auto const size = _mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy));
+    auto const coeff = _mm_mul_ps(_mm_sqrt_ps(_mm_mul_ps(size, invMaxSize)), intensity);
+    x = _mm_sub_ps(x, _mm_mul_ps(cx, coeff));
+    y = _mm_sub_ps(y, _mm_mul_ps(cy, coeff));
+}
+
+//mod() of the shader
+static __m128 floorMod(__m128 const x, __m128 const y, __m128 const invY) {
+    return _mm_sub_ps(x, _mm_mul_ps(y, _mm_floor_ps(_mm_mul_ps(x, invY))));
+}
+
+SoftwareRenderer::SoftwareRenderer(uint32_t const numberOfTasks_) :
+    cells{ nullptr },
+    width{ 0 }, height{ 0 }, rowLength{ 0 },
+    view{},
+    frameSize{ 0 },
+    pixels{ nullptr },
+    numberOfTasks{ misc::max<uint32_t>(1, numberOfTasks_) },
+    tasks{ new std::unique_ptr<Task<RenderData>>[numberOfTasks] },
+    lastMilliseconds{ 0 }
+{
+    for(uint32_t i = 0; i < numberOfTasks; i++) {
+        tasks.get()[i] = std::unique_ptr<Task<RenderData>>(new Task<RenderData>{
+            [](RenderData& data) { data.run(); },
+            *this, i
+        });
+    }
+}
+
+SoftwareRenderer::~SoftwareRenderer() = default;
+
+void SoftwareRenderer::render(
+    uint32_t const *const cells_, uint32_t const width_, uint32_t const height_, uint32_t const rowLength_,
+    RenderView const &view_, vec2i const frameSize_, uint32_t *const pixels_
+) {
+    assert(width_ > 0 && height_ > 0 && rowLength_ * 32 >= width_);
+    Timer<> t{};
+    cells = cells_;
+    width = width_;
+    height = height_;
+    rowLength = rowLength_;
+    view = view_;
+    frameSize = frameSize_;
+    pixels = pixels_;
+
+    if(frameSize.x > 0 && frameSize.y > 0) {
+        for(uint32_t i = 0; i < numberOfTasks; i++) tasks.get()[i]->start();
+        for(uint32_t i = 0; i < numberOfTasks; i++) tasks.get()[i]->waitForResult();
+    }
+    lastMilliseconds = t.elapsedTime() / 1000.0;
+}
+
+void SoftwareRenderer::render(Field const &field, RenderView const &view_, vec2i const frameSize_, uint32_t *const pixels_) {
+    render(field.rawData(), field.width(), field.height(), field.width_actual() / 32, view_, frameSize_, pixels_);
+}
+
+void SoftwareRenderer::render(FieldSnapshot const &snapshot, RenderView const &view_, vec2i const frameSize_, uint32_t *const pixels_) {
+    render(snapshot.cells.data(), snapshot.width, snapshot.height, snapshot.rowLength, view_, frameSize_, pixels_);
+}
+
+void SoftwareRenderer::renderRows(uint32_t const startRow, uint32_t const endRow) const {
+    auto const samples = misc::max<uint32_t>(1, view.samples);
+    auto const fn = float(samples);
+    auto const invSamplesSquared = _mm_set1_ps(1.0f / (fn * fn));
+
+    auto const winHalfX = float(frameSize.x) * 0.5f, winHalfY = float(frameSize.y) * 0.5f;
+    auto const centerX = _mm_set1_ps(winHalfX), centerY = _mm_set1_ps(winHalfY);
+    auto const invMaxSize = _mm_set1_ps(1.0f / (winHalfX * winHalfX + winHalfY * winHalfY));
+    auto const isLens = view.lensDistortion != 0;
+    auto const lens = _mm_set1_ps(float(view.lensDistortion));
+    auto const isZoomDistortion = view.deltaScaleChange != 0;
+    auto const zoomIntensity = _mm_set1_ps(float(-view.deltaScaleChange / 3));
+    auto const zoomShiftX = _mm_set1_ps(float(view.zoomPoint.x) - winHalfX), zoomShiftY = _mm_set1_ps(float(view.zoomPoint.y) - winHalfY);
+
+    auto const invWinHeight = _mm_set1_ps(1.0f / float(frameSize.y));
+    auto const half = _mm_set1_ps(0.5f);
+    auto const vpSize = _mm_set1_ps(float(view.vpSize));
+    auto const vpPosX = _mm_set1_ps(float(view.vpPos.x)), vpPosY = _mm_set1_ps(float(view.vpPos.y));
+
+    auto const gridWidth = _mm_set1_ps(float(width)), gridHeight = _mm_set1_ps(float(height));
+    auto const invGridWidth = _mm_set1_ps(1.0f / float(width)), invGridHeight = _mm_set1_ps(1.0f / float(height));
+    auto const lastColumn = _mm_set1_epi32(int32_t(width) - 1), lastRow = _mm_set1_epi32(int32_t(height) - 1);
+    auto const zero = _mm_setzero_si128();
+    auto const padding = _mm_set1_ps(cellPadding), paddingEnd = _mm_set1_ps(1 - cellPadding);
+    auto const cell = _mm_set1_ps(cellColor), background = _mm_set1_ps(backgroundColor), edge = _mm_set1_ps(edgeColor);
+    auto const laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+
+    alignas(16) int32_t columns[4], rows[4];
+    for(uint32_t y = startRow; y < endRow; y++) {
+        auto const pixelY = _mm_set1_epi32(int32_t(y));
+        auto const row = pixels + size_t(y) * frameSize.x;
+        for(int32_t x = 0; x < frameSize.x; x += 4) {
+            auto const pixelX = _mm_add_epi32(_mm_set1_epi32(x), laneOffsets);
+            auto const jitterX = _mm_mul_ps(pixelNoise(pixelX, pixelY), _mm_set1_ps(1 / fn));
+            auto const jitterY = _mm_mul_ps(pixelNoise(pixelX, _mm_xor_si128(pixelY, _mm_set1_epi32(0x68e31da4))), _mm_set1_ps(1 / fn));
+            auto const cornerX = _mm_cvtepi32_ps(pixelX), cornerY = _mm_cvtepi32_ps(pixelY);
+
+            auto sum = _mm_setzero_ps();
+            for(uint32_t i = 0; i < samples; i++) for(uint32_t j = 0; j < samples; j++) {
+                auto sx = _mm_add_ps(_mm_add_ps(cornerX, _mm_set1_ps(float(i) / fn)), jitterX);
+                auto sy = _mm_add_ps(_mm_add_ps(cornerY, _mm_set1_ps(float(j) / fn)), jitterY);
+
+                if(isLens) applyLensDistortion(sx, sy, centerX, centerY, invMaxSize, lens);
+                if(isZoomDistortion) {
+                    sx = _mm_sub_ps(sx, zoomShiftX);
+                    sy = _mm_sub_ps(sy, zoomShiftY);
+                    applyLensDistortion(sx, sy, centerX, centerY, invMaxSize, zoomIntensity);
+                    sx = _mm_add_ps(sx, zoomShiftX);
+                    sy = _mm_add_ps(sy, zoomShiftY);
+                }
+
+                auto const globalX = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(sx, invWinHeight), half), vpSize), vpPosX);
+                auto const globalY = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(sy, invWinHeight), half), vpSize), vpPosY);
+
+                //rounding of the wrapped coordinate can give exactly the field size
+                auto const column = _mm_max_epi32(_mm_min_epi32(_mm_cvttps_epi32(floorMod(globalX, gridWidth, invGridWidth)), lastColumn), zero);
+                auto const cellRow = _mm_max_epi32(_mm_min_epi32(_mm_cvttps_epi32(floorMod(globalY, gridHeight, invGridHeight)), lastRow), zero);
+                _mm_store_si128(reinterpret_cast<__m128i*>(columns), column);
+                _mm_store_si128(reinterpret_cast<__m128i*>(rows), cellRow);
+                uint32_t alive[4];
+                for(int k = 0; k < 4; k++) {
+                    alive[k] = 0u - ((cells[uint32_t(rows[k]) * rowLength + uint32_t(columns[k]) / 32] >> (columns[k] % 32)) & 1);
+                }
+                auto const isAlive = _mm_castsi128_ps(_mm_setr_epi32(int32_t(alive[0]), int32_t(alive[1]), int32_t(alive[2]), int32_t(alive[3])));
+
+                auto const isEdge = _mm_castsi128_ps(_mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi32(column, zero), _mm_cmpeq_epi32(column, lastColumn)),
+                    _mm_or_si128(_mm_cmpeq_epi32(cellRow, zero), _mm_cmpeq_epi32(cellRow, lastRow))
+                ));
+                auto const dx = _mm_sub_ps(globalX, _mm_floor_ps(globalX)), dy = _mm_sub_ps(globalY, _mm_floor_ps(globalY));
+                auto const isPadding = _mm_or_ps(
+                    _mm_or_ps(_mm_cmplt_ps(dx, padding), _mm_cmpgt_ps(dx, paddingEnd)),
+                    _mm_or_ps(_mm_cmplt_ps(dy, padding), _mm_cmpgt_ps(dy, paddingEnd))
+                );
+
+                auto color = _mm_blendv_ps(background, cell, isAlive);
+                color = _mm_blendv_ps(color, _mm_mul_ps(_mm_add_ps(color, edge), half), isEdge);
+                color = _mm_blendv_ps(color, edge, isPadding);
+                sum = _mm_add_ps(sum, color);
+            }
+
+            auto const value = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(sum, invSamplesSquared), _mm_set1_ps(255.0f)), half));
+            auto const rgba = _mm_or_si128(
+                _mm_or_si128(value, _mm_slli_epi32(value, 8)),
+                _mm_or_si128(_mm_slli_epi32(value, 16), _mm_set1_epi32(int32_t(0xff000000u)))
+            );
+            if(x + 4 <= frameSize.x) _mm_storeu_si128(reinterpret_cast<__m128i*>(row + x), rgba);
+            else {
+                alignas(16) uint32_t last[4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(last), rgba);
+                for(int32_t k = 0; x + k < frameSize.x; k++) row[x + k] = last[k];
+            }
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include<stdint.h>
+#include<memory>
+#include"Task.h"
+#include"Vector.h"
+
+class Field;
+struct FieldSnapshot;
+
+//view of the field, same as the uniforms of fs.shader
+struct RenderView {
+    vec2d vpPos; //center of the viewport in cells
+    double vpSize; //vertical size of the viewport in cells
+    double lensDistortion; //0 for none
+    //distortion around `zoomPoint` (in pixels) while the view zooms, 0 for none
+    double deltaScaleChange;
+    vec2d zoomPoint;
+    uint32_t samples; //per pixel along each axis, fs.shader takes 3
+};
+
+//draws the field on the CPU the way fs.shader does: cells with padding, grey field edges,
+//toroidal wrap and lens distortion. Pixels are computed 4 at a time with SSE, rows are split between tasks.
+//Post-processing (chromatic aberration and vignette) is not applied.
+//Sample jitter uses an integer hash instead of the shader's sin hash, so pixels at cell borders
+//may differ slightly from the GPU but every frame of the same view is the same
+class SoftwareRenderer final {
+public:
+    struct RenderData;
+private:
+    //current frame, read by the tasks
+    uint32_t const *cells;
+    uint32_t width, height, rowLength;
+    RenderView view;
+    vec2i frameSize;
+    uint32_t *pixels;
+
+    const uint32_t numberOfTasks;
+    std::unique_ptr<std::unique_ptr<Task<RenderData>>[/*numberOfTasks*/]> tasks;
+
+    double lastMilliseconds;
+public:
+    SoftwareRenderer(uint32_t const numberOfTasks_ = 1);
+    ~SoftwareRenderer();
+
+    SoftwareRenderer(SoftwareRenderer const&) = delete;
+    SoftwareRenderer& operator=(SoftwareRenderer const&) = delete;
+public:
+    //`pixels` is `frameSize.y` rows from the top of `frameSize.x` pixels, each is RGBA with R in the lowest byte.
+    //`cells` is `height` rows of `rowLength` batches, bits past `width` in each row are ignored
+    void render(
+        uint32_t const *const cells_, uint32_t const width_, uint32_t const height_, uint32_t const rowLength_,
+        RenderView const &view_, vec2i const frameSize_, uint32_t *const pixels_
+    );
+    //current buffer of the field, it can be computing the next generation during the call
+    void render(Field const &field, RenderView const &view_, vec2i const frameSize_, uint32_t *const pixels_);
+    void render(FieldSnapshot const &snapshot, RenderView const &view_, vec2i const frameSize_, uint32_t *const pixels_);
+
+    //duration of the last render() call
+    double milliseconds() const { return lastMilliseconds; }
+private:
+    void renderRows(uint32_t const startRow, uint32_t const endRow) const;
+};
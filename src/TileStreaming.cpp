@@ -0,0 +1,283 @@
+#include"TileStreaming.h"
+#include"Misc.h"
+
+#include<algorithm>
+#include<cassert>
+#include<cmath>
+#include<cstdlib>
+#include<cstring>
+
+//tiles `margin` around the ones with cells in [`min`; `max`], in a field of `size` cells
+//that wraps around, with tiles of `tileSize` cells and `tilesCount` of them
+static void visibleTiles(
+    double const min, double const max, uint32_t const size, uint32_t const tileSize, uint32_t const tilesCount,
+    uint32_t const margin, std::vector<uint32_t> &out
+) {
+    out.clear();
+    auto const first = std::floor(min), last = std::floor(max);
+    if(!(last - first + 1 < size)) {
+        for(uint32_t i = 0; i < tilesCount; i++) out.push_back(i);
+        return;
+    }
+    auto const wrap = [&](double const cell) { return uint32_t(misc::max(0.0, cell - size * std::floor(cell / size))) % size; };
+    auto const firstCell = wrap(first);
+    auto const firstTile = firstCell / tileSize;
+    //tiles are counted along the cells, a view that wraps back into its first tile doesn't cover just that one
+    uint64_t spanned = 0;
+    for(auto cell = firstCell, remaining = uint32_t(last - first + 1); remaining > 0 && spanned < tilesCount; spanned++) {
+        auto const step = misc::min(remaining, misc::min(tileSize - cell % tileSize, size - cell));
+        remaining -= step;
+        cell = (cell + step) % size;
+    }
+    auto const count = spanned + 2 * uint64_t(margin);
+    if(count >= tilesCount) {
+        for(uint32_t i = 0; i < tilesCount; i++) out.push_back(i);
+        return;
+    }
+    auto const start = firstTile + tilesCount - margin % tilesCount;
+    for(uint32_t i = 0; i < count; i++) out.push_back((start + i) % tilesCount);
+}
+
+TileStreamer::TileStreamer(uint32_t const width_, uint32_t const height_, TileSink &sink_, TileStreamOptions const options_) :
+    width{ width_ }, height{ height_ }, rowLength{ misc::intDivCeil(width_, 32) },
+    tileLayout{},
+    options{ options_ },
+    sink{ sink_ },
+    currentIndex{ 1 }, //buffer 0 is the next one before the first publish()
+    pageTable{},
+    slotTiles{}, slotUses{}, isSlotStale{},
+    freeSlots{}, staleSlots{},
+    pageTableStart{ ~0u }, pageTableEnd{ 0 },
+    updates{ 0 },
+    isDensity{ false }, isDensityStale{ true },
+    densityWindow{},
+    columns{}, rows{}, missing{}, evictable{},
+    tileCells{},
+    densities{},
+    uploadedTiles{ 0 }, uploadedDensities{ 0 }
+{
+    options.tileBatches = misc::max<uint32_t>(1, options.tileBatches);
+    options.tileRows = misc::max<uint32_t>(1, options.tileRows);
+    options.slotsCount = misc::max<uint32_t>(1, options.slotsCount);
+    tileLayout = TileLayout{
+        options.tileBatches, options.tileRows,
+        misc::intDivCeil(rowLength, options.tileBatches), misc::intDivCeil(height, options.tileRows)
+    };
+
+    pageTable.assign(tileLayout.tilesCount(), 0);
+    slotTiles.assign(options.slotsCount, noTile);
+    slotUses.assign(options.slotsCount, 0);
+    isSlotStale.assign(options.slotsCount, 0);
+    for(uint32_t slot = options.slotsCount; slot != 0; slot--) freeSlots.push_back(slot - 1);
+    tileCells.resize(tileLayout.tileWords());
+}
+
+void TileStreamer::transfer(uint32_t const bufferIndex, FieldModification fm) {
+    //the next buffer is compared with the current one when it is published
+    if(bufferIndex != currentIndex) return;
+    isDensityStale = true;
+    markTiles(fm.startIndex_int, fm.startIndex_int + fm.size_int);
+}
+
+void TileStreamer::published(uint32_t const currentIndex_, std::vector<uint32_t> const &current, std::vector<uint32_t> const &previous) {
+    currentIndex = currentIndex_;
+    isDensityStale = true;
+    //the pool has tiles of the previous buffer, only the ones that differ are streamed again
+    for(uint32_t slot = 0; slot < slotTiles.size(); slot++) {
+        auto const tile = slotTiles[slot];
+        if(tile == noTile || isSlotStale[slot]) continue;
+        auto const firstBatch = (tile % tileLayout.tilesX) * tileLayout.tileBatches;
+        auto const batches = misc::min(tileLayout.tileBatches, rowLength - firstBatch);
+        auto const firstRow = (tile / tileLayout.tilesX) * tileLayout.tileRows;
+        auto const endRow = misc::min(firstRow + tileLayout.tileRows, height);
+        for(auto row = firstRow; row < endRow; row++) {
+            auto const start = size_t(row) * rowLength + firstBatch;
+            if(std::memcmp(current.data() + start, previous.data() + start, batches * sizeof(uint32_t)) != 0) {
+                markStale(slot);
+                break;
+            }
+        }
+    }
+}
+
+void TileStreamer::markTiles(uint32_t const startBatch, uint32_t const endBatch) {
+    if(startBatch >= endBatch) return;
+    auto const firstRow = startBatch / rowLength, lastRow = (endBatch - 1) / rowLength;
+    auto const isOneRow = firstRow == lastRow;
+    auto const firstTileX = isOneRow ? (startBatch % rowLength) / tileLayout.tileBatches : 0;
+    auto const lastTileX = isOneRow ? ((endBatch - 1) % rowLength) / tileLayout.tileBatches : tileLayout.tilesX - 1;
+    for(auto tileY = firstRow / tileLayout.tileRows; tileY <= lastRow / tileLayout.tileRows; tileY++) {
+        for(auto tileX = firstTileX; tileX <= lastTileX; tileX++) {
+            auto const entry = pageTable[tileY * tileLayout.tilesX + tileX];
+            if(entry != 0) markStale(entry - 1);
+        }
+    }
+}
+
+void TileStreamer::markStale(uint32_t const slot) {
+    if(isSlotStale[slot]) return;
+    isSlotStale[slot] = 1;
+    staleSlots.push_back(slot);
+}
+
+void TileStreamer::uploadTile(uint32_t const slot, std::vector<uint32_t> const &cells) {
+    auto const tile = slotTiles[slot];
+    auto const firstBatch = (tile % tileLayout.tilesX) * tileLayout.tileBatches;
+    auto const batches = misc::min(tileLayout.tileBatches, rowLength - firstBatch);
+    auto const firstRow = (tile / tileLayout.tilesX) * tileLayout.tileRows;
+    auto const rowsCount = misc::min(tileLayout.tileRows, height - firstRow);
+
+    std::fill(tileCells.begin(), tileCells.end(), 0);
+    for(uint32_t row = 0; row < rowsCount; row++) {
+        std::memcpy(
+            tileCells.data() + size_t(row) * tileLayout.tileBatches,
+            cells.data() + size_t(firstRow + row) * rowLength + firstBatch,
+            batches * sizeof(uint32_t)
+        );
+    }
+    sink.uploadTile(slot, tileCells.data(), uint32_t(tileCells.size()));
+    isSlotStale[slot] = 0;
+    uploadedTiles++;
+}
+
+void TileStreamer::assignSlot(uint32_t const slot, uint32_t const tile) {
+    auto const oldTile = slotTiles[slot];
+    if(oldTile != noTile) {
+        pageTable[oldTile] = 0;
+        pageTableStart = misc::min(pageTableStart, oldTile);
+        pageTableEnd = misc::max(pageTableEnd, oldTile + 1);
+    }
+    slotTiles[slot] = tile;
+    pageTable[tile] = slot + 1;
+    pageTableStart = misc::min(pageTableStart, tile);
+    pageTableEnd = misc::max(pageTableEnd, tile + 1);
+}
+
+void TileStreamer::update(FieldView const &view, FieldStaging const &staging, DensityPyramid const *const pyramid) {
+    assert(staging.currentIndex() == currentIndex);
+    auto const &cells = staging.buffer(currentIndex);
+    updates++;
+
+    auto const windowHeight = double(misc::max(1, view.windowSize.y));
+    auto const aspect = misc::max(1, view.windowSize.x) / windowHeight;
+    auto const overscan = vec2d(aspect * view.vpSize, view.vpSize) * misc::max(0.0, view.overscan);
+    auto const min = vec2d(view.vpPos.x - 0.5 * view.vpSize, view.vpPos.y - 0.5 * view.vpSize) - overscan;
+    auto const max = vec2d(view.vpPos.x + (aspect - 0.5) * view.vpSize, view.vpPos.y + 0.5 * view.vpSize) + overscan;
+    visibleTiles(min.x, max.x, width, tileLayout.tileBatches * 32, tileLayout.tilesX, options.margin, columns);
+    visibleTiles(min.y, max.y, height, tileLayout.tileRows, tileLayout.tilesY, options.margin, rows);
+
+    auto const wasDensity = isDensity;
+    auto const neededTiles = uint64_t(columns.size()) * rows.size();
+    isDensity = pyramid != nullptr
+        && (view.vpSize / windowHeight >= options.densityCellsPerPixel || neededTiles > slotTiles.size());
+    if(isDensity) {
+        if(!wasDensity) isDensityStale = true;
+        updateDensity(view, *pyramid, min, max);
+        return;
+    }
+
+    missing.clear();
+    for(auto const row : rows) for(auto const column : columns) {
+        auto const tile = row * tileLayout.tilesX + column;
+        auto const entry = pageTable[tile];
+        if(entry != 0) slotUses[entry - 1] = updates;
+        else missing.push_back(tile);
+    }
+
+    //least recently needed tiles are replaced first
+    evictable.clear();
+    if(missing.size() > freeSlots.size()) {
+        for(uint32_t slot = 0; slot < slotTiles.size(); slot++) {
+            if(slotTiles[slot] != noTile && slotUses[slot] != updates) evictable.push_back(slot);
+        }
+        std::sort(evictable.begin(), evictable.end(), [&](uint32_t const a, uint32_t const b) { return slotUses[a] < slotUses[b]; });
+    }
+    size_t evicted = 0;
+    for(auto const tile : missing) {
+        uint32_t slot;
+        if(!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else if(evicted < evictable.size()) slot = evictable[evicted++];
+        else break; //the pool is full of needed tiles
+        assignSlot(slot, tile);
+        slotUses[slot] = updates;
+        uploadTile(slot, cells);
+    }
+
+    for(auto const slot : staleSlots) {
+        if(isSlotStale[slot] && slotTiles[slot] != noTile) uploadTile(slot, cells);
+        isSlotStale[slot] = 0;
+    }
+    staleSlots.clear();
+
+    if(pageTableStart < pageTableEnd) {
+        sink.uploadPageTable(pageTableStart, pageTableEnd - pageTableStart, pageTable.data() + pageTableStart);
+        pageTableStart = ~0u;
+        pageTableEnd = 0;
+    }
+}
+
+void TileStreamer::updateDensity(FieldView const &view, DensityPyramid const &pyramid, vec2d const min, vec2d const max) {
+    auto const cellsPerPixel = view.vpSize / double(misc::max(1, view.windowSize.y));
+    auto const level = pyramid.levelFor(cellsPerPixel);
+    auto const blockSize = double(1u << level);
+    auto const levelSize = pyramid.levelSize(level);
+    auto const wrap = [](double const cell, uint32_t const size) {
+        return misc::min(uint32_t(misc::max(0.0, cell - size * std::floor(cell / size))), size - 1);
+    };
+
+    DensityWindow window{};
+    window.level = level;
+    window.levelSize = levelSize;
+    window.start = vec2i(int32_t(wrap(std::floor(min.x), width) >> level), int32_t(wrap(std::floor(min.y), height) >> level));
+    //a block more for the cut block at the field edge
+    window.size = vec2i(
+        misc::min(levelSize.x, int32_t(std::ceil((max.x - min.x) / blockSize)) + 2),
+        misc::min(levelSize.y, int32_t(std::ceil((max.y - min.y) / blockSize)) + 2)
+    );
+    auto const isSameWindow = window.level == densityWindow.level
+        && window.start.x == densityWindow.start.x && window.start.y == densityWindow.start.y
+        && window.size.x == densityWindow.size.x && window.size.y == densityWindow.size.y;
+    if(isSameWindow && !isDensityStale) return;
+
+    densities.resize(size_t(window.size.x) * window.size.y);
+    pyramid.readDensity(level, window.start, window.size, densities.data());
+    sink.uploadDensity(window, densities.data());
+    densityWindow = window;
+    isDensityStale = false;
+    uploadedDensities++;
+}
+
+void MemoryTileSink::uploadTile(uint32_t const slot, uint32_t const *const cells, uint32_t const wordsCount) {
+    auto const start = size_t(slot) * wordsCount;
+    if(pool.size() < start + wordsCount) pool.resize(start + wordsCount, 0);
+    std::copy(cells, cells + wordsCount, pool.begin() + start);
+    uploads++;
+}
+
+void MemoryTileSink::uploadPageTable(uint32_t const first, uint32_t const count, uint32_t const *const entries) {
+    if(pageTable.size() < size_t(first) + count) pageTable.resize(size_t(first) + count, 0);
+    std::copy(entries, entries + count, pageTable.begin() + first);
+    uploads++;
+}
+
+void MemoryTileSink::uploadDensity(DensityWindow const &window_, float const *const densities_) {
+    window = window_;
+    densities.assign(densities_, densities_ + size_t(window.size.x) * window.size.y);
+    uploads++;
+}
+
+int32_t MemoryTileSink::cellAt(TileLayout const &layout, uint32_t const x, uint32_t const y) const {
+    auto const tile = size_t(y / layout.tileRows) * layout.tilesX + (x / 32) / layout.tileBatches;
+    if(tile >= pageTable.size() || pageTable[tile] == 0) return -1;
+    auto const word = size_t(pageTable[tile] - 1) * layout.tileWords()
+        + (y % layout.tileRows) * layout.tileBatches + (x / 32) % layout.tileBatches;
+    return int32_t((pool[word] >> (x % 32)) & 1);
+}
+
+bool tileStreamingFromEnvironment() {
+    auto const value = std::getenv("GOL_TILE_STREAMING");
+    return value != nullptr && *value != '\0' && std::strcmp(value, "0") != 0;
+}
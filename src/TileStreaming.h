@@ -0,0 +1,129 @@
+#pragma once
+
+#include<stdint.h>
+#include<vector>
+#include"FieldOutputs.h"
+#include"DensityPyramid.h"
+#include"Vector.h"
+
+//region of the field on screen, mapped to cells the same way as in fs.shader
+struct FieldView {
+    vec2d vpPos;
+    double vpSize; //cells across the window height
+    vec2i windowSize;
+    double overscan; //part of the view size added on every side, for distortions that show more of the field
+};
+
+//tile geometry of the streamed field. Tile (x, y) has batches [x * tileBatches; (x + 1) * tileBatches)
+//of rows [y * tileRows; (y + 1) * tileRows), the parts outside of the field are 0
+struct TileLayout {
+    uint32_t tileBatches, tileRows;
+    uint32_t tilesX, tilesY;
+
+    uint32_t tileWords() const { return tileBatches * tileRows; }
+    uint32_t tilesCount() const { return tilesX * tilesY; }
+};
+
+//blocks of the density pyramid level sent instead of tiles. Blocks are `size.x` x `size.y` starting at block `start`,
+//wrapping around the `levelSize` blocks of the level
+struct DensityWindow {
+    uint32_t level;
+    vec2i start, size;
+    vec2i levelSize;
+};
+
+//where tiles and densities are streamed to, GPU buffers in the game
+struct TileSink {
+    //cells of a tile to slot `slot` of the pool, rows of TileLayout::tileBatches batches
+    virtual void uploadTile(uint32_t const slot, uint32_t const *const cells, uint32_t const wordsCount) = 0;
+    //entries [`first`; `first + count`) of the page table, slot + 1 of every tile, 0 if it is not in the pool
+    virtual void uploadPageTable(uint32_t const first, uint32_t const count, uint32_t const *const entries) = 0;
+    //densities in [0; 1] of the blocks of `window`, row by row
+    virtual void uploadDensity(DensityWindow const &window, float const *const densities) = 0;
+    virtual ~TileSink() = default;
+};
+
+struct TileStreamOptions {
+    uint32_t tileBatches = 4, tileRows = 128;
+    uint32_t margin = 1; //tiles around the visible ones that are streamed too
+    uint32_t slotsCount = 4096; //tiles in the pool
+    double densityCellsPerPixel = 8; //zoomed out further, densities are streamed instead of tiles
+};
+
+//sink of a FieldStaging for fields larger than the display buffers. Keeps a pool of the tiles
+//around the view and a page table to find them, streaming only tiles that come into view or change.
+//When the view is zoomed out or needs more tiles than the pool has, the densities of the view are
+//streamed from the density pyramid instead. Everything is called from the thread that owns the staging
+class TileStreamer final : public FieldSink {
+    static constexpr uint32_t noTile = ~0u;
+
+    uint32_t width, height, rowLength;
+    TileLayout tileLayout;
+    TileStreamOptions options;
+    TileSink &sink;
+
+    uint32_t currentIndex; //staged buffer on screen
+    std::vector<uint32_t> pageTable; //slot + 1 of every tile, 0 if it is not in the pool
+    std::vector<uint32_t> slotTiles; //tile in every slot or noTile
+    std::vector<uint64_t> slotUses; //last update() that needed the tile in every slot
+    std::vector<uint8_t> isSlotStale; //the pool has an older version of the tile
+    std::vector<uint32_t> freeSlots, staleSlots;
+    uint32_t pageTableStart, pageTableEnd; //entries changed since the last upload
+    uint64_t updates;
+
+    bool isDensity;
+    bool isDensityStale; //cells changed since the last upload
+    DensityWindow densityWindow;
+
+    //reused by update()
+    std::vector<uint32_t> columns, rows, missing, evictable;
+    std::vector<uint32_t> tileCells;
+    std::vector<float> densities;
+
+    uint64_t uploadedTiles, uploadedDensities;
+public:
+    TileStreamer(uint32_t const width_, uint32_t const height_, TileSink &sink_, TileStreamOptions const options_ = {});
+
+    TileStreamer(TileStreamer const&) = delete;
+    TileStreamer& operator=(TileStreamer const&) = delete;
+
+    void transfer(uint32_t const bufferIndex, FieldModification fm) override;
+    void published(uint32_t const currentIndex_, std::vector<uint32_t> const &current, std::vector<uint32_t> const &previous) override;
+
+    //streams what `view` needs of the current buffer of `staging`.
+    //Without `pyramid` only tiles are streamed, as many as the pool has
+    void update(FieldView const &view, FieldStaging const &staging, DensityPyramid const *const pyramid);
+
+    TileLayout const &layout() const { return tileLayout; }
+    //the last update() streamed densities instead of tiles
+    bool isDensityMode() const { return isDensity; }
+    DensityWindow const &density() const { return densityWindow; }
+
+    uint32_t residentTiles() const { return uint32_t(slotTiles.size() - freeSlots.size()); }
+    uint64_t uploadedTilesCount() const { return uploadedTiles; }
+    uint64_t uploadedDensitiesCount() const { return uploadedDensities; }
+private:
+    void markTiles(uint32_t const startBatch, uint32_t const endBatch);
+    void markStale(uint32_t const slot);
+    void uploadTile(uint32_t const slot, std::vector<uint32_t> const &cells);
+    void assignSlot(uint32_t const slot, uint32_t const tile);
+    void updateDensity(FieldView const &view, DensityPyramid const &pyramid, vec2d const min, vec2d const max);
+};
+
+//keeps the pool, page table and densities in memory, for tools and checks
+struct MemoryTileSink final : public TileSink {
+    std::vector<uint32_t> pool, pageTable;
+    std::vector<float> densities;
+    DensityWindow window{};
+    uint64_t uploads = 0;
+
+    void uploadTile(uint32_t const slot, uint32_t const *const cells, uint32_t const wordsCount) override;
+    void uploadPageTable(uint32_t const first, uint32_t const count, uint32_t const *const entries) override;
+    void uploadDensity(DensityWindow const &window_, float const *const densities_) override;
+
+    //cell (`x`, `y`) as the shader reads it: 0 or 1, -1 if its tile is not in the pool
+    int32_t cellAt(TileLayout const &layout, uint32_t const x, uint32_t const y) const;
+};
+
+//true if the GOL_TILE_STREAMING environment variable is set and not 0, to stream fields that fit in the display buffers too
+bool tileStreamingFromEnvironment();
@@ -1,5 +1,6 @@
 #pragma once
 #include <chrono>
+#include <stdint.h>
 
 template<class Units = std::chrono::microseconds>
 class Timer {
@@ -8,8 +9,12 @@ private:
 public:
     Timer() = default;
 
-    uint32_t elapsedTime() const {
+    uint64_t elapsedTime() const {
         auto elapsedTime = std::chrono::duration_cast<Units>(std::chrono::steady_clock::now() - startTime).count();
         return elapsedTime;
     }
+
+    uint64_t elapsedNanoseconds() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+    }
 };
@@ -0,0 +1,170 @@
+#include"Trace.h"
+#include"Misc.h"
+
+#include<atomic>
+#include<chrono>
+#include<memory>
+#include<mutex>
+#include<string>
+#include<vector>
+#include<cstdio>
+
+namespace trace {
+    struct Event {
+        std::atomic<char const*> name;
+        std::atomic<uint64_t> startNs, endNs;
+    };
+
+    //written only by the thread that owns it, read by writeChromeJson()
+    struct ThreadBuffer {
+        uint32_t tid;
+        std::string name; //guarded by Registry::lock
+        std::unique_ptr<Event[]> events;
+        std::atomic<uint64_t> head; //number of events recorded
+        std::atomic<uint64_t> firstVisible; //events before it were cleared
+        std::atomic_bool isOwned; //buffers of finished threads are kept until a new thread takes them
+
+        ThreadBuffer(uint32_t const tid_) :
+            tid{ tid_ }, name{}, events{ new Event[threadBufferCapacity]{} }, head{ 0 }, firstVisible{ 0 }, isOwned{ true }
+        {}
+    };
+
+    struct EventCopy {
+        char const *name;
+        uint64_t startNs, endNs;
+    };
+
+    struct Registry {
+        std::mutex lock;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        std::atomic_bool enabled{ false };
+        std::chrono::steady_clock::time_point const epoch = std::chrono::steady_clock::now();
+    };
+
+    static Registry &registry() {
+        static Registry instance{};
+        return instance;
+    }
+
+    static ThreadBuffer *acquireBuffer() {
+        auto &r = registry();
+        std::lock_guard<std::mutex> lk{ r.lock };
+        for(auto &buffer : r.buffers) {
+            if(!buffer->isOwned.load()) {
+                buffer->isOwned.store(true);
+                buffer->head.store(0);
+                buffer->firstVisible.store(0);
+                buffer->name.clear();
+                return buffer.get();
+            }
+        }
+        r.buffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer(uint32_t(r.buffers.size() + 1))));
+        return r.buffers.back().get();
+    }
+
+    struct BufferLease {
+        ThreadBuffer *buffer = nullptr;
+        ~BufferLease() { if(buffer != nullptr) buffer->isOwned.store(false); }
+    };
+
+    static ThreadBuffer &threadBuffer() {
+        thread_local BufferLease lease{};
+        if(lease.buffer == nullptr) lease.buffer = acquireBuffer();
+        return *lease.buffer;
+    }
+
+    void setEnabled(bool const enabled) {
+        registry().enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool isEnabled() {
+        return registry().enabled.load(std::memory_order_relaxed);
+    }
+
+    void setThreadName(char const *const name) {
+        auto &buffer = threadBuffer();
+        std::lock_guard<std::mutex> lk{ registry().lock };
+        buffer.name = name;
+    }
+
+    uint64_t now() {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - registry().epoch
+        ).count());
+    }
+
+    void record(char const *const name, uint64_t const startNs, uint64_t const endNs) {
+        auto &buffer = threadBuffer();
+        auto const head = buffer.head.load(std::memory_order_relaxed);
+        auto &event = buffer.events[head % threadBufferCapacity];
+        event.name.store(name, std::memory_order_relaxed);
+        event.startNs.store(startNs, std::memory_order_relaxed);
+        event.endNs.store(endNs, std::memory_order_relaxed);
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    static void writeJsonString(std::ostream &out, char const *str) {
+        out << '"';
+        for(; *str != '\0'; str++) {
+            if(*str == '"' || *str == '\\') out << '\\' << *str;
+            else if(uint8_t(*str) < 0x20) out << ' ';
+            else out << *str;
+        }
+        out << '"';
+    }
+
+    void writeChromeJson(std::ostream &out) {
+        auto &r = registry();
+        std::lock_guard<std::mutex> lk{ r.lock };
+
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+        bool first = true;
+        auto const separator = [&]() { if(!first) out << ",\n"; first = false; };
+
+        std::vector<EventCopy> events{};
+        for(auto const &buffer : r.buffers) {
+            auto const tid = buffer->tid;
+            if(!buffer->name.empty()) {
+                separator();
+                out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":";
+                writeJsonString(out, buffer->name.c_str());
+                out << "}}";
+            }
+
+            auto const head = buffer->head.load(std::memory_order_acquire);
+            auto const begin = misc::max(buffer->firstVisible.load(), head > threadBufferCapacity ? head - threadBufferCapacity : 0);
+            events.clear();
+            for(auto i = begin; i < head; i++) {
+                auto const &event = buffer->events[i % threadBufferCapacity];
+                events.push_back(EventCopy{
+                    event.name.load(std::memory_order_relaxed),
+                    event.startNs.load(std::memory_order_relaxed), event.endNs.load(std::memory_order_relaxed)
+                });
+            }
+            //events the owning thread could have overwritten while they were copied
+            auto const newHead = buffer->head.load(std::memory_order_acquire);
+            auto const validBegin = newHead >= threadBufferCapacity ? newHead - threadBufferCapacity + 1 : 0;
+            auto const skip = validBegin > begin ? misc::min<uint64_t>(validBegin - begin, events.size()) : 0;
+
+            char number[64];
+            for(auto i = skip; i < events.size(); i++) {
+                auto const &event = events[i];
+                separator();
+                out << "{\"name\":";
+                writeJsonString(out, event.name);
+                std::snprintf(number, sizeof(number), "%.3f", event.startNs / 1000.0);
+                out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << number;
+                std::snprintf(number, sizeof(number), "%.3f", (event.endNs - event.startNs) / 1000.0);
+                out << ",\"dur\":" << number << '}';
+            }
+        }
+        out << "\n]}\n";
+    }
+
+    void clear() {
+        auto &r = registry();
+        std::lock_guard<std::mutex> lk{ r.lock };
+        //only the owning threads write heads, so recorded events are hidden instead
+        for(auto &buffer : r.buffers) buffer->firstVisible.store(buffer->head.load(std::memory_order_acquire));
+    }
+}
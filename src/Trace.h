@@ -0,0 +1,48 @@
+#pragma once
+
+#include<stdint.h>
+#include<ostream>
+
+//spans of work recorded into per-thread ring buffers, written on demand
+//as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+//Recording is disabled by default, a disabled span costs one relaxed load.
+//Span names must be string literals, only the pointer is stored
+namespace trace {
+    //events per thread, older ones are overwritten
+    static constexpr uint32_t threadBufferCapacity = 1u << 14;
+
+    void setEnabled(bool const enabled);
+    bool isEnabled();
+
+    //name of the calling thread in the trace
+    void setThreadName(char const *const name);
+
+    //nanoseconds since the first call
+    uint64_t now();
+    void record(char const *const name, uint64_t const startNs, uint64_t const endNs);
+
+    //writes recorded spans of all threads, including finished ones
+    void writeChromeJson(std::ostream &out);
+    void clear();
+}
+
+class TraceSpan final {
+    char const *name;
+    uint64_t startNs;
+public:
+    TraceSpan(char const *const name_) :
+        name{ trace::isEnabled() ? name_ : nullptr },
+        startNs{ name == nullptr ? 0 : trace::now() }
+    {}
+    ~TraceSpan() { end(); }
+
+    TraceSpan(TraceSpan const&) = delete;
+    TraceSpan& operator=(TraceSpan const&) = delete;
+
+    //records the span now instead of at the end of the scope
+    void end() {
+        if(name == nullptr) return;
+        trace::record(name, startNs, trace::now());
+        name = nullptr;
+    }
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include<stdint.h>
+#include<stddef.h>
+#include<atomic>
+#include<memory>
+
+//latest value published by one writer, read by any number of readers without locks.
+//A reader keeps the slot it reads until its handle is released, so the writer never overwrites
+//a value that is being read. With 3 slots and one reader the writer always finds a free one,
+//with more readers holding old values at once publish may be skipped, the writer never waits
+template<class T>
+class TripleBuffer final {
+    static constexpr uint32_t slotWriting = ~0u; //in readers count of the slot being written
+    static constexpr uint32_t noSlot = ~0u;
+
+    struct Slot {
+        T value;
+        std::atomic<uint32_t> readers;
+    };
+
+    uint32_t const slotsCount;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<uint32_t> latest; //noSlot until the first publish
+    uint32_t writing; //used only by the writer
+public:
+    class ReadHandle final {
+        Slot *slot;
+    public:
+        ReadHandle() : slot{ nullptr } {}
+        explicit ReadHandle(Slot *const slot_) : slot{ slot_ } {}
+        ReadHandle(ReadHandle &&other) noexcept : slot{ other.slot } { other.slot = nullptr; }
+        ReadHandle& operator=(ReadHandle &&other) noexcept {
+            release();
+            slot = other.slot;
+            other.slot = nullptr;
+            return *this;
+        }
+        ReadHandle(ReadHandle const&) = delete;
+        ReadHandle& operator=(ReadHandle const&) = delete;
+        ~ReadHandle() { release(); }
+
+        void release() {
+            if(slot != nullptr) slot->readers.fetch_sub(1, std::memory_order_release);
+            slot = nullptr;
+        }
+
+        //nullptr if nothing was published
+        T const *get() const { return slot == nullptr ? nullptr : &slot->value; }
+        T const *operator->() const { return get(); }
+        T const &operator*() const { return *get(); }
+        explicit operator bool() const { return slot != nullptr; }
+    };
+
+    explicit TripleBuffer(uint32_t const slotsCount_ = 3) :
+        slotsCount{ slotsCount_ < 3 ? 3 : slotsCount_ },
+        slots{ new Slot[slotsCount] },
+        latest{ noSlot },
+        writing{ noSlot }
+    {
+        for(uint32_t i = 0; i < slotsCount; i++) slots[i].readers.store(0, std::memory_order_relaxed);
+    }
+
+    TripleBuffer(TripleBuffer const&) = delete;
+    TripleBuffer& operator=(TripleBuffer const&) = delete;
+
+    //slot to fill before publish(), nullptr if every other slot is being read.
+    //The slot keeps the value it had when it was last published, if any
+    T *beginWrite() {
+        if(writing != noSlot) return &slots[writing].value;
+        auto const latestSlot = latest.load(std::memory_order_relaxed);
+        for(uint32_t i = 0; i < slotsCount; i++) {
+            if(i == latestSlot) continue;
+            uint32_t expected = 0;
+            if(slots[i].readers.compare_exchange_strong(expected, slotWriting, std::memory_order_acquire)) {
+                writing = i;
+                return &slots[i].value;
+            }
+        }
+        return nullptr;
+    }
+
+    void publish() {
+        if(writing == noSlot) return;
+        slots[writing].readers.store(0, std::memory_order_release);
+        latest.store(writing, std::memory_order_release);
+        writing = noSlot;
+    }
+
+    ReadHandle read() const {
+        while(true) {
+            auto const i = latest.load(std::memory_order_acquire);
+            if(i == noSlot) return ReadHandle{};
+            auto &slot = slots[i];
+            auto readers = slot.readers.load(std::memory_order_relaxed);
+            //the slot was taken by the writer after `latest` was read, there is a newer one
+            if(readers == slotWriting) continue;
+            if(slot.readers.compare_exchange_weak(readers, readers + 1, std::memory_order_acquire)) {
+                return ReadHandle{ &slot };
+            }
+        }
+    }
+};
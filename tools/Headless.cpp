@@ -0,0 +1,230 @@
+//runs the field without a window and optionally exports its generations as images or a video stream.
+//Generations can also be published to a shared-memory ring for other processes (see gol_ring_consumer)
+//and served as a delta stream on a local port (see gol_stream_client), `--stream-wait` waits for subscribers first.
+//Prints generations/s of the run and the export counters, `--census` also prints the most common objects of the last generation.
+//usage: gol_headless [--width <n>] [--height <n>] [--threads <n>] [--generations <n>] [--density <d>] [--seed <n>]
+//                    [--pattern <file.rle>] [--export ppm|png|y4m] [--out <path>] [--every <n>]
+//                    [--scale <pixels per cell>] [--shrink <cells per pixel>] [--export-threads <n>] [--queue <n>] [--drop]
+//                    [--shm <name>] [--shm-slots <n>] [--shm-keyframes <n>] [--shm-full]
+//                    [--stream-port <n>] [--stream-wait <subscribers>] [--census <shapes>]
+
+#include"Grid.h"
+#include"FieldOutputs.h"
+#include"FrameExport.h"
+#include"FieldRing.h"
+#include"DeltaStream.h"
+#include"Census.h"
+#include"PackedPattern.h"
+#include"Timer.h"
+
+#include<vector>
+#include<string>
+#include<fstream>
+#include<sstream>
+#include<iostream>
+#include<random>
+#include<thread>
+
+struct HeadlessOptions {
+    uint32_t width = 1024, height = 1024;
+    uint32_t threads = misc::max(1u, std::thread::hardware_concurrency());
+    uint64_t generations = 1000;
+    double density = 0.3;
+    uint32_t seed = 1;
+    std::string pattern{};
+    bool isExporting = false;
+    ExportOptions exportOptions{};
+    uint32_t every = 1; //export every n-th generation
+    std::string ringName{};
+    FieldRingOptions ringOptions{};
+    bool isStreaming = false;
+    uint16_t streamPort = 0; //0 picks a free one
+    uint32_t streamWait = 0; //subscribers to wait for before the first generation
+    uint32_t censusShapes = 0; //most common shapes of the last generation to print, 0 skips the census
+};
+
+static char const usage[] =
+    "usage: gol_headless [--width <n>] [--height <n>] [--threads <n>] [--generations <n>] [--density <d>] [--seed <n>]\n"
+    "                    [--pattern <file.rle>] [--export ppm|png|y4m] [--out <path>] [--every <n>]\n"
+    "                    [--scale <pixels per cell>] [--shrink <cells per pixel>] [--export-threads <n>] [--queue <n>] [--drop]\n"
+    "                    [--shm <name>] [--shm-slots <n>] [--shm-keyframes <n>] [--shm-full]\n"
+    "                    [--stream-port <n>] [--stream-wait <subscribers>] [--census <shapes>]\n";
+
+static bool parseFormat(std::string const &name, ExportFormat &format) {
+    if(name == "ppm") format = ExportFormat::ppm;
+    else if(name == "png") format = ExportFormat::png;
+    else if(name == "y4m") format = ExportFormat::y4m;
+    else return false;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    HeadlessOptions options{};
+    for(int i = 1; i < argc; i++) {
+        auto const arg = std::string{ argv[i] };
+        auto const hasValue = i + 1 < argc;
+        auto &exportOptions = options.exportOptions;
+        if(arg == "--width" && hasValue) options.width = uint32_t(misc::max(1ll, std::atoll(argv[++i])));
+        else if(arg == "--height" && hasValue) options.height = uint32_t(misc::max(1ll, std::atoll(argv[++i])));
+        else if(arg == "--threads" && hasValue) options.threads = uint32_t(misc::max(1ll, std::atoll(argv[++i])));
+        else if(arg == "--generations" && hasValue) options.generations = misc::max(0ll, std::atoll(argv[++i]));
+        else if(arg == "--density" && hasValue) options.density = std::atof(argv[++i]);
+        else if(arg == "--seed" && hasValue) options.seed = uint32_t(std::atoll(argv[++i]));
+        else if(arg == "--pattern" && hasValue) options.pattern = argv[++i];
+        else if(arg == "--export" && hasValue && parseFormat(argv[i + 1], exportOptions.format)) {
+            options.isExporting = true;
+            i++;
+        }
+        else if(arg == "--out" && hasValue) exportOptions.path = argv[++i];
+        else if(arg == "--every" && hasValue) options.every = uint32_t(misc::max(1ll, std::atoll(argv[++i])));
+        else if(arg == "--scale" && hasValue) exportOptions.pixelsPerCell = uint32_t(misc::max(1ll, std::atoll(argv[++i])));
+        else if(arg == "--shrink" && hasValue) exportOptions.cellsPerPixel = uint32_t(misc::max(1ll, std::atoll(argv[++i])));
+        else if(arg == "--export-threads" && hasValue) exportOptions.threads = uint32_t(misc::max(1ll, std::atoll(argv[++i])));
+        else if(arg == "--queue" && hasValue) exportOptions.queueLength = uint32_t(misc::max(1ll, std::atoll(argv[++i])));
+        else if(arg == "--drop") exportOptions.dropWhenFull = true;
+        else if(arg == "--shm" && hasValue) options.ringName = argv[++i];
+        else if(arg == "--shm-slots" && hasValue) options.ringOptions.slotsCount = uint32_t(misc::max(2ll, std::atoll(argv[++i])));
+        else if(arg == "--shm-keyframes" && hasValue) options.ringOptions.keyframeInterval = uint32_t(misc::max(1ll, std::atoll(argv[++i])));
+        else if(arg == "--shm-full") options.ringOptions.isRanges = false;
+        else if(arg == "--stream-port" && hasValue) {
+            options.isStreaming = true;
+            options.streamPort = uint16_t(misc::max(0ll, misc::min(65535ll, std::atoll(argv[++i]))));
+        }
+        else if(arg == "--stream-wait" && hasValue) options.streamWait = uint32_t(misc::max(0ll, std::atoll(argv[++i])));
+        else if(arg == "--census" && hasValue) options.censusShapes = uint32_t(misc::max(0ll, std::atoll(argv[++i])));
+        else {
+            std::cerr << usage;
+            return 1;
+        }
+    }
+    if(options.isExporting && options.exportOptions.path.empty()) {
+        std::cerr << "--out is required with --export\n" << usage;
+        return 1;
+    }
+    if(options.exportOptions.pixelsPerCell > 1 && options.exportOptions.cellsPerPixel > 1) {
+        std::cerr << "--scale and --shrink can't be used together\n";
+        return 1;
+    }
+
+    //Field reports its own timings to std::cout
+    auto const stdoutBuffer = std::cout.rdbuf(nullptr);
+    std::ostream out{ stdoutBuffer };
+
+    PackedPattern pattern{ 1, 1 };
+    if(!options.pattern.empty()) {
+        std::ifstream file{ options.pattern };
+        std::stringstream contents{};
+        contents << file.rdbuf();
+        if(!file || !PackedPattern::fromRle(contents.str().c_str(), pattern)) {
+            std::cerr << "can't read pattern " << options.pattern << '\n';
+            return 1;
+        }
+        options.width = misc::max(options.width, pattern.width());
+        options.height = misc::max(options.height, pattern.height());
+    }
+
+    Field field{
+        options.width, options.height, options.threads,
+        []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); },
+        []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); }
+    };
+    field.setUndoBudget(0);
+    if(!options.pattern.empty()) {
+        auto const offset = vec2i(int32_t(options.width - pattern.width()) / 2, int32_t(options.height - pattern.height()) / 2);
+        field.pasteRegion(pattern, offset, true);
+    }
+    else {
+        std::mt19937 rng{ options.seed };
+        std::bernoulli_distribution alive{ options.density };
+        PackedPattern soup{ options.width, options.height };
+        for(uint32_t y = 0; y < options.height; y++) for(uint32_t x = 0; x < options.width; x++) soup.setCellAt(x, y, alive(rng));
+        field.pasteRegion(soup, vec2i(0), true);
+    }
+
+    std::unique_ptr<FrameExporter> exporter{};
+    if(options.isExporting) {
+        exporter.reset(new FrameExporter(options.width, options.height, options.exportOptions));
+        if(!exporter->start()) {
+            std::cerr << "can't open " << options.exportOptions.path << '\n';
+            return 1;
+        }
+    }
+    auto const rowLength = field.width_actual() / 32;
+    std::unique_ptr<FieldRingPublisher> ring{};
+    if(!options.ringName.empty()) {
+        ring.reset(new FieldRingPublisher(options.width, options.height, rowLength, options.ringOptions));
+        auto const result = ring->start(options.ringName);
+        if(result == shm::CreateResult::nameInUse) {
+            std::cerr << "shared memory " << options.ringName << " is in use by another process or was left by one that crashed\n";
+            return 1;
+        }
+        if(result != shm::CreateResult::created) {
+            std::cerr << "can't create shared memory " << options.ringName << '\n';
+            return 1;
+        }
+    }
+    std::unique_ptr<DeltaStreamServer> stream{};
+    if(options.isStreaming) {
+        stream.reset(new DeltaStreamServer(options.width, options.height, rowLength));
+        if(!stream->start(options.streamPort)) {
+            std::cerr << "port " << options.streamPort << " is not available\n";
+            return 1;
+        }
+        std::cerr << "streaming on port " << stream->port() << '\n';
+        while(stream->subscribersCount() < options.streamWait) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    auto const exportGeneration = [&]() {
+        //the current buffer is only read while the next generation is computed
+        if(exporter && field.generation() % options.every == 0) exporter->submit(field.rawData(), rowLength, field.generation());
+        if(ring) ring->publish(field.rawData(), field.generation());
+        if(stream) stream->publish(field.rawData(), field.generation());
+    };
+
+    Timer<std::chrono::nanoseconds> t{};
+    field.startCurGeneration();
+    exportGeneration();
+    for(uint64_t i = 0; i < options.generations; i++) {
+        while(!field.tryFinishGeneration()) {}
+        field.startNewGeneration();
+        exportGeneration();
+    }
+    while(!field.tryFinishGeneration()) {}
+    auto const simulationNs = t.elapsedTime();
+    if(exporter) exporter->finish();
+    auto const totalNs = t.elapsedTime();
+
+    out << options.generations << " generations of " << options.width << 'x' << options.height
+        << " in " << simulationNs / 1e6 << " ms, " << options.generations * 1e9 / misc::max<uint64_t>(simulationNs, 1) << " generations/s\n"
+        << "population " << field.generationStats().population << '\n';
+    if(exporter) {
+        auto const size = exporter->frameSize();
+        out << exporter->framesWritten() << " frames of " << size.x << 'x' << size.y << " written, "
+            << exporter->framesDropped() << " dropped, export finished " << (totalNs - simulationNs) / 1e6 << " ms after the simulation\n";
+        if(!exporter->ok()) {
+            std::cerr << "writing " << options.exportOptions.path << " failed\n";
+            std::cout.rdbuf(stdoutBuffer);
+            return 1;
+        }
+    }
+    if(ring) {
+        out << ring->publications() << " generations published to " << options.ringName << ", "
+            << ring->keyframesCount() << " keyframes, " << ring->publishedBytes() / 1e6 << " MB\n";
+    }
+    if(stream) {
+        out << stream->messagesCount() << " stream messages, " << stream->bytesCount() / 1e6 << " MB, "
+            << stream->skippedCount() << " generations skipped for slow subscribers\n";
+    }
+    if(options.censusShapes != 0) {
+        Census census{ options.threads };
+        census.run(field);
+        auto const &entries = census.entries();
+        out << census.objectsCount() << " objects of " << entries.size() << " shapes, census took " << census.milliseconds() << " ms\n";
+        for(size_t i = 0; i < misc::min<size_t>(entries.size(), options.censusShapes); i++) {
+            auto const &e = entries[i];
+            out << "  " << e.count << ' ' << (e.name != nullptr ? e.name : "unnamed") << " (" << e.population << " cells, "
+                << e.size.x << 'x' << e.size.y << ")\n";
+        }
+    }
+    std::cout.rdbuf(stdoutBuffer);
+    return 0;
+}
@@ -0,0 +1,73 @@
+//follows the shared-memory ring of a running field (gol_headless --shm, or the game with GOL_SHM_NAME)
+//and prints the generation and population it sees. Stops after `--updates` updates that applied
+//publications, or when nothing was published for `--timeout` ms.
+//usage: gol_ring_consumer <name> [--updates <n>] [--interval <ms>] [--timeout <ms>]
+
+#include"FieldRing.h"
+#include"Misc.h"
+
+#include<string>
+#include<iostream>
+#include<chrono>
+#include<thread>
+#include<nmmintrin.h>
+
+static char const usage[] = "usage: gol_ring_consumer <name> [--updates <n>] [--interval <ms>] [--timeout <ms>]\n";
+
+static uint64_t population(std::vector<uint32_t> const &cells) {
+    uint64_t count = 0;
+    for(auto const batch : cells) count += _mm_popcnt_u32(batch);
+    return count;
+}
+
+int main(int argc, char **argv) {
+    std::string name{};
+    uint64_t updates = ~uint64_t(0);
+    uint32_t intervalMs = 10, timeoutMs = 2000;
+    for(int i = 1; i < argc; i++) {
+        auto const arg = std::string{ argv[i] };
+        auto const hasValue = i + 1 < argc;
+        if(arg == "--updates" && hasValue) updates = misc::max(1ll, std::atoll(argv[++i]));
+        else if(arg == "--interval" && hasValue) intervalMs = uint32_t(misc::max(0ll, std::atoll(argv[++i])));
+        else if(arg == "--timeout" && hasValue) timeoutMs = uint32_t(misc::max(1ll, std::atoll(argv[++i])));
+        else if(name.empty() && arg.rfind("--", 0) != 0) name = arg;
+        else {
+            std::cerr << usage;
+            return 1;
+        }
+    }
+    if(name.empty()) {
+        std::cerr << usage;
+        return 1;
+    }
+
+    FieldRingReader reader{};
+    auto idle = std::chrono::steady_clock::now();
+    while(!reader.open(name)) {
+        if(std::chrono::steady_clock::now() - idle > std::chrono::milliseconds(timeoutMs)) {
+            std::cerr << "no ring " << name << '\n';
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+    }
+    std::cout << "ring " << name << ": " << reader.width() << 'x' << reader.height() << '\n';
+
+    uint64_t updated = 0, applied = 0;
+    idle = std::chrono::steady_clock::now();
+    while(updated < updates) {
+        auto const count = reader.update();
+        if(count == 0) {
+            if(std::chrono::steady_clock::now() - idle > std::chrono::milliseconds(timeoutMs)) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+            continue;
+        }
+        idle = std::chrono::steady_clock::now();
+        updated++;
+        applied += count;
+        std::cout << "generation " << reader.generation() << ", population " << population(reader.cells())
+            << ", applied " << count << '\n';
+    }
+    std::cout << applied << " publications applied in " << updated << " updates, "
+        << reader.missedCount() << " missed, " << reader.overwrittenCount() << " overwritten while read\n";
+    return 0;
+}
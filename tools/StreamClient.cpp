@@ -0,0 +1,68 @@
+//subscribes to the delta stream of a running field (gol_headless --stream-port, or the game with GOL_STREAM_PORT)
+//and prints the generation and population of its viewport for every message. `--delay` makes it a slow
+//subscriber that the server skips generations for. Stops after `--messages` messages with cells,
+//or when none arrives for `--timeout` ms.
+//usage: gol_stream_client --port <n> [--viewport <x> <y> <width> <height>] [--messages <n>] [--delay <ms>] [--timeout <ms>]
+
+#include"DeltaStream.h"
+#include"Misc.h"
+
+#include<string>
+#include<iostream>
+#include<chrono>
+#include<thread>
+#include<nmmintrin.h>
+
+static char const usage[] =
+    "usage: gol_stream_client --port <n> [--viewport <x> <y> <width> <height>] [--messages <n>] [--delay <ms>] [--timeout <ms>]\n";
+
+int main(int argc, char **argv) {
+    uint16_t port = 0;
+    deltaStream::Viewport viewport{ 0, 0, 0, 0 };
+    uint64_t messages = ~uint64_t(0);
+    uint32_t delayMs = 0, timeoutMs = 2000;
+    for(int i = 1; i < argc; i++) {
+        auto const arg = std::string{ argv[i] };
+        auto const hasValue = i + 1 < argc;
+        if(arg == "--port" && hasValue) port = uint16_t(misc::max(0ll, misc::min(65535ll, std::atoll(argv[++i]))));
+        else if(arg == "--viewport" && i + 4 < argc) {
+            viewport.x = uint32_t(misc::max(0ll, std::atoll(argv[++i])));
+            viewport.y = uint32_t(misc::max(0ll, std::atoll(argv[++i])));
+            viewport.width = uint32_t(misc::max(0ll, std::atoll(argv[++i])));
+            viewport.height = uint32_t(misc::max(0ll, std::atoll(argv[++i])));
+        }
+        else if(arg == "--messages" && hasValue) messages = misc::max(1ll, std::atoll(argv[++i]));
+        else if(arg == "--delay" && hasValue) delayMs = uint32_t(misc::max(0ll, std::atoll(argv[++i])));
+        else if(arg == "--timeout" && hasValue) timeoutMs = uint32_t(misc::max(1ll, std::atoll(argv[++i])));
+        else {
+            std::cerr << usage;
+            return 1;
+        }
+    }
+    if(port == 0) {
+        std::cerr << usage;
+        return 1;
+    }
+
+    DeltaStreamClient client{};
+    if(!client.connect(port, viewport)) {
+        std::cerr << "no stream on port " << port << '\n';
+        return 1;
+    }
+
+    uint64_t cellMessages = 0;
+    while(cellMessages < messages && client.receive(int32_t(timeoutMs))) {
+        if(!client.isSynchronized()) continue;
+        cellMessages++;
+        uint64_t population = 0;
+        for(auto const batch : client.cells()) population += _mm_popcnt_u32(batch);
+        auto const &info = client.viewport();
+        std::cout << "generation " << client.generation() << ", population " << population
+            << " in batches " << info.firstBatch << ".." << info.firstBatch + info.batchesCount
+            << " of rows " << info.firstRow << ".." << info.firstRow + info.rowsCount << '\n';
+        if(delayMs != 0) std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+    }
+    std::cout << client.messagesCount() << " messages, " << client.bytesCount() / 1e3 << " kB, "
+        << client.skippedCount() << " generations skipped\n";
+    return 0;
+}
@@ -0,0 +1,1759 @@
+//differential correctness harness: runs engines on random grids with random edits made
+//while generations are computed, and compares every generation with the scalar updatedCell reference.
+//Also checks that generations with edits don't allocate once warmed up (engine name "allocations")
+//and that SoftwareRenderer draws the same pixels as a scalar port of fs.shader (engine name "render").
+//Engine "field-ring" reads every generation back from a shared-memory FieldRing,
+//"stream" checks the cells that DeltaStreamClient subscribers get over a local socket,
+//"tiles" checks the tiles and densities that TileStreamer streams for random views into a MemoryTileSink,
+//"resize" resizes a field to random sizes and offsets while it runs,
+//"undo" undoes and redoes edits and strokes of a field with generations computed in between,
+//"patterns" checks the transforms of PackedPattern and copying and pasting field regions,
+//"census" compares the objects that Census counts with a flood fill,
+//"period" checks the periods that the field reports and fast forwards by them,
+//"histogram" checks the quantiles of LatencyHistogram on known distributions,
+//"metrics" reads a Seqlock under a concurrent writer and MetricsServer over a local socket.
+//usage: gol_verify [--quick] [--engine <name>] [--generations <n>] [--seed <n>]
+
+#include"Grid.h"
+#include"GridInternal.h"
+#include"Ensemble.h"
+#include"FieldOutputs.h"
+#include"PackedPattern.h"
+#include"DensityPyramid.h"
+#include"SoftwareRenderer.h"
+#include"FieldRing.h"
+#include"DeltaStream.h"
+#include"TileStreaming.h"
+#include"Census.h"
+#include"LatencyHistogram.h"
+#include"MetricsServer.h"
+#include"Seqlock.h"
+#include"Socket.h"
+
+#include<vector>
+#include<string>
+#include<iostream>
+#include<memory>
+#include<random>
+#include<atomic>
+#include<thread>
+#include<cstdlib>
+#include<new>
+#include<cmath>
+#include<chrono>
+#include<algorithm>
+#include<functional>
+#include<map>
+#include<deque>
+#include<iterator>
+
+//every allocation of the program is counted
+static std::atomic<uint64_t> allocationsCount{ 0 };
+
+void *operator new(size_t const size) {
+    allocationsCount.fetch_add(1, std::memory_order_relaxed);
+    auto const memory = std::malloc(size == 0 ? 1 : size);
+    if(memory == nullptr) std::abort();
+    return memory;
+}
+void operator delete(void *const memory) noexcept { std::free(memory); }
+void operator delete(void *const memory, size_t) noexcept { std::free(memory); }
+
+struct Edit {
+    enum class Kind : uint8_t { cells, rect, pattern, disc, stroke } kind;
+    std::vector<Cell> cells;
+    vec2i start, size; //rect and pattern offset, disc center and stroke start
+    FieldCell cell;
+    PackedPattern pattern;
+    bool overwrite;
+    vec2i end; //of stroke
+    int32_t radius; //of disc and stroke brush
+    BrushShape shape; //of stroke brush
+};
+
+//calls `write(x, y, cell)` for every cell written by `edit`, in order
+template<class Write>
+static void forEachWrite(Edit const &edit, int32_t const width, int32_t const height, Write &&write) {
+    switch(edit.kind) {
+        case Edit::Kind::cells:
+            for(auto const &c : edit.cells) write(c.index % width, c.index / width, c.cell);
+        break; case Edit::Kind::rect:
+            for(int32_t y = 0; y < edit.size.y; y++) for(int32_t x = 0; x < edit.size.x; x++) {
+                write(misc::mod(edit.start.x + x, width), misc::mod(edit.start.y + y, height), edit.cell);
+            }
+        break; case Edit::Kind::pattern:
+            for(uint32_t y = 0; y < edit.pattern.height(); y++) for(uint32_t x = 0; x < edit.pattern.width(); x++) {
+                auto const cell = edit.pattern.cellAt(x, y);
+                if(cell || edit.overwrite) {
+                    write(misc::mod(edit.start.x + int32_t(x), width), misc::mod(edit.start.y + int32_t(y), height), cell);
+                }
+            }
+        break; case Edit::Kind::disc: case Edit::Kind::stroke: {
+            //the brush is stamped at every point of the line, a disc is a brush that doesn't move
+            auto const isDisc = edit.kind == Edit::Kind::disc || edit.shape == BrushShape::disc;
+            auto const diff = edit.kind == Edit::Kind::disc ? vec2i(0) : edit.end - edit.start;
+            auto const steps = misc::max(std::abs(diff.x), std::abs(diff.y));
+            for(int32_t step = 0; step <= steps; step++) {
+                auto const t = steps == 0 ? 0.0 : double(step) / steps;
+                auto const x = edit.start.x + int32_t(std::lround(diff.x * t));
+                auto const y = edit.start.y + int32_t(std::lround(diff.y * t));
+                for(int32_t yo = -edit.radius; yo <= edit.radius; yo++) for(int32_t xo = -edit.radius; xo <= edit.radius; xo++) {
+                    if(!isDisc || xo * xo + yo * yo <= edit.radius * edit.radius) {
+                        write(misc::mod(x + xo, width), misc::mod(y + yo, height), edit.cell);
+                    }
+                }
+            }
+        } break;
+    }
+}
+
+//makes `edit` with the field's own edit functions
+static void applyEdit(Field &field, Edit const &edit) {
+    switch(edit.kind) {
+        case Edit::Kind::cells: field.setCells(edit.cells.data(), edit.cells.size());
+        break; case Edit::Kind::rect: field.fillRect(edit.start, edit.size, edit.cell);
+        break; case Edit::Kind::pattern: field.pasteRegion(edit.pattern, edit.start, edit.overwrite);
+        break; case Edit::Kind::disc: field.fillDisc(edit.start, edit.radius, edit.cell);
+        break; case Edit::Kind::stroke: field.fillStroke(edit.start, edit.end, edit.radius, edit.shape, edit.cell);
+        break;
+    }
+}
+
+//engine checked against the reference. Edits are made to the current generation,
+//engines that compute generations in background get them while the next generation is computed
+class VerifiedEngine {
+public:
+    virtual ~VerifiedEngine() = default;
+
+    virtual void edit(Edit const &edit) = 0;
+    //makes the next generation current
+    virtual void step() = 0;
+    virtual FieldCell cellAt(int32_t const x, int32_t const y) const = 0;
+    //population of the current generation reported by the engine
+    virtual uint64_t population() const = 0;
+    //bounding box of the current generation reported by the engine, false if it doesn't report one
+    virtual bool bounds(vec2i &boundsMin, vec2i &boundsMax) const { return false; }
+};
+
+struct EngineFactory {
+    char const *name;
+    bool (*supports)(uint32_t const width, uint32_t const height);
+    std::unique_ptr<VerifiedEngine> (*create)(Field::FieldPimpl const &initial, uint32_t const threads);
+};
+
+//where FieldEngine reads cells from. Reading them through the outputs or snapshots
+//makes batches that don't reach them show up as wrong cells.
+//With `pyramid` cells are read from the field and its density pyramid is compared with a recounted one,
+//with `ring` they are read from a FieldRingReader that sometimes falls behind the ring
+enum class CellsSource : uint8_t { field, outputs, snapshots, pyramid, ring };
+
+class FieldEngine final : public VerifiedEngine {
+    std::unique_ptr<MemoryFieldSink> sink;
+    std::unique_ptr<FieldStaging> staging;
+    Field field;
+    CellsSource source;
+    uint64_t lastPopulation;
+    vec2i lastBoundsMin, lastBoundsMax;
+
+    TripleBuffer<FieldSnapshot>::ReadHandle snapshot; //of the current generation
+    //reads snapshots all the time to check that they are never changed while read
+    std::thread observer;
+    std::atomic_bool isObserverStopped, isObserverFailed;
+
+    std::unique_ptr<DensityPyramid> recounted; //reused for every comparison
+    bool isPyramidFailed;
+
+    std::unique_ptr<FieldRingPublisher> ringPublisher;
+    std::unique_ptr<FieldRingReader> ringReader;
+    uint64_t steps;
+public:
+    FieldEngine(Field::FieldPimpl const &initial, uint32_t const threads, CellsSource const source_) :
+        sink{ new MemoryFieldSink(initial.gridLength()) },
+        staging{ new FieldStaging(*sink, initial.gridLength()) },
+        field{
+            uint32_t(initial.width), uint32_t(initial.height), threads,
+            [this]() { return std::unique_ptr<FieldOutput>(new StagedFieldOutput(*staging, false)); },
+            [this]() { return std::unique_ptr<FieldOutput>(new StagedFieldOutput(*staging, true)); }
+        },
+        source{ source_ },
+        lastPopulation{ 0 },
+        lastBoundsMin{ 0 }, lastBoundsMax{ -1 },
+        snapshot{},
+        observer{},
+        isObserverStopped{ false },
+        isObserverFailed{ false },
+        recounted{},
+        isPyramidFailed{ false },
+        ringPublisher{},
+        ringReader{},
+        steps{ 0 }
+    {
+        field.setUndoBudget(0);
+        PackedPattern cells{ uint32_t(initial.width), uint32_t(initial.height) };
+        for(int32_t i = 0; i < initial.width * initial.height; i++) {
+            if(initial.cellAt_grid(i)) cells.setCellAt(i % initial.width, i / initial.width, true);
+        }
+        field.pasteRegion(cells, vec2i(0), true);
+        for(int32_t i = 0; i < initial.width * initial.height; i++) lastPopulation += initial.cellAt_grid(i);
+
+        if(source == CellsSource::snapshots) {
+            field.setSnapshotsEnabled(true);
+            observer = std::thread{ [this]() {
+                while(!isObserverStopped.load()) {
+                    auto const observed = field.latestSnapshot();
+                    if(observed && snapshotPopulation(*observed) != observed->stats.population) isObserverFailed.store(true);
+                }
+            } };
+        }
+        if(source == CellsSource::pyramid) {
+            field.setDensityPyramidEnabled(true);
+            recounted.reset(new DensityPyramid(initial.width, initial.height, initial.rowLength));
+        }
+        if(source == CellsSource::ring) {
+            static uint32_t ringsCount = 0;
+            auto const name = "gol_verify_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count())
+                + '_' + std::to_string(ringsCount++);
+            FieldRingOptions options{};
+            options.slotsCount = 8;
+            options.keyframeInterval = 4; //a keyframe is always in the ring
+            ringPublisher.reset(new FieldRingPublisher(initial.width, initial.height, initial.rowLength, options));
+            ringReader.reset(new FieldRingReader());
+            if(ringPublisher->start(name) != shm::CreateResult::created || !ringReader->open(name)) ringReader.reset();
+        }
+        field.startCurGeneration();
+    }
+
+    ~FieldEngine() override {
+        isObserverStopped.store(true);
+        if(observer.joinable()) observer.join();
+    }
+
+    static uint64_t snapshotPopulation(FieldSnapshot const &snapshot) {
+        uint64_t population = 0;
+        for(auto const cells : snapshot.cells) population += __builtin_popcount(cells);
+        return population;
+    }
+
+    //compares every block of the field's pyramid with the current cells counted again
+    void checkPyramid() {
+        auto const pyramid = field.densityPyramid();
+        recounted->rebuild(field.rawData());
+        for(auto level = DensityPyramid::minLevel; level <= recounted->maxLevel(); level++) {
+            auto const size = recounted->levelSize(level);
+            for(int32_t y = 0; y < size.y; y++) for(int32_t x = 0; x < size.x; x++) {
+                if(pyramid->aliveCells(level, x, y) != recounted->aliveCells(level, x, y)) isPyramidFailed = true;
+            }
+        }
+    }
+
+    //publishes the current generation, sometimes more times than the ring holds so that the reader
+    //continues from a keyframe, and checks the reader's copy of it
+    void publishToRing() {
+        uint32_t const publications = steps % 5 == 4 ? 9 : 1;
+        for(uint32_t i = 0; i < publications; i++) ringPublisher->publish(field.rawData(), field.generation());
+        ringReader->update();
+        if(!ringReader->isSynchronized() || ringReader->generation() != field.generation()) lastPopulation = ~uint64_t(0);
+        if(steps % 5 == 4 && ringReader->missedCount() == 0) lastPopulation = ~uint64_t(0);
+
+        auto const width = ringReader->width(), rowLength = ringReader->rowLength();
+        auto const paddingMask = width % 32 == 0 ? 0 : ~((1u << (width % 32)) - 1);
+        for(uint32_t row = 0; row < ringReader->height(); row++) {
+            if(ringReader->cells()[size_t(row) * rowLength + rowLength - 1] & paddingMask) lastPopulation = ~uint64_t(0);
+        }
+    }
+
+    void edit(Edit const &edit) override { applyEdit(field, edit); }
+    void step() override {
+        snapshot.release(); //so that the field has a free copy with the observer holding another one
+        if(source == CellsSource::pyramid) checkPyramid(); //after edits
+        while(!field.tryFinishGeneration()) {}
+        lastPopulation = field.generationStats().population;
+        lastBoundsMin = field.generationStats().boundsMin;
+        lastBoundsMax = field.generationStats().boundsMax;
+        if(source == CellsSource::snapshots) {
+            snapshot = field.latestSnapshot();
+            auto const isCurrent = snapshot && snapshot->stats.generation == field.generation() + 1;
+            lastPopulation = !isCurrent || isObserverFailed.load() ? ~uint64_t(0) : snapshotPopulation(*snapshot);
+            if(isCurrent) {
+                lastBoundsMin = snapshot->stats.boundsMin;
+                lastBoundsMax = snapshot->stats.boundsMax;
+            }
+        }
+        field.startNewGeneration();
+        if(source == CellsSource::pyramid) {
+            checkPyramid();
+            if(isPyramidFailed) lastPopulation = ~uint64_t(0);
+        }
+        if(source == CellsSource::ring) {
+            if(ringReader) publishToRing();
+            else lastPopulation = ~uint64_t(0);
+        }
+        steps++;
+    }
+    FieldCell cellAt(int32_t const x, int32_t const y) const override {
+        switch(source) {
+            case CellsSource::field: case CellsSource::pyramid: return field.cellAtCoord(x, y);
+            case CellsSource::outputs: {
+                auto const rowLength = misc::intDivCeil(field.width(), cellsBatchLength);
+                auto const cells = sink->buffers[staging->currentIndex()][y * rowLength + x / cellsBatchLength];
+                return FieldCell((cells >> (x % cellsBatchLength)) & 1);
+            }
+            case CellsSource::snapshots: return snapshot->cellAt(x, y);
+            case CellsSource::ring: {
+                if(!ringReader) return fieldCell::cellDead;
+                auto const cells = ringReader->cells()[y * ringReader->rowLength() + x / cellsBatchLength];
+                return FieldCell((cells >> (x % cellsBatchLength)) & 1);
+            }
+        }
+        return fieldCell::cellDead;
+    }
+    uint64_t population() const override { return lastPopulation; }
+    bool bounds(vec2i &boundsMin, vec2i &boundsMax) const override {
+        boundsMin = lastBoundsMin;
+        boundsMax = lastBoundsMax;
+        return true;
+    }
+};
+
+//every soup of the ensemble gets the same cells, the last one is compared
+class EnsembleEngine final : public VerifiedEngine {
+    static constexpr uint32_t soupsCount = Ensemble::soupsPerGroup + 2; //last group is not full
+    Ensemble ensemble;
+    std::vector<uint32_t> rows;
+public:
+    EnsembleEngine(Field::FieldPimpl const &initial, uint32_t const threads) :
+        ensemble{ uint32_t(initial.width), uint32_t(initial.height), soupsCount, threads },
+        rows(initial.height, 0)
+    {
+        for(int32_t i = 0; i < initial.width * initial.height; i++) {
+            rows[i / initial.width] |= uint32_t(initial.cellAt_grid(i)) << (i % initial.width);
+        }
+        for(uint32_t soup = 0; soup < soupsCount; soup++) ensemble.setSoup(soup, rows.data());
+    }
+
+    void edit(Edit const &edit) override {
+        ensemble.getSoup(soupsCount - 1, rows.data());
+        forEachWrite(edit, ensemble.width(), ensemble.height(), [&](int32_t const x, int32_t const y, FieldCell const cell) {
+            rows[y] = (rows[y] & ~(1u << x)) | (uint32_t(cell) << x);
+        });
+        for(uint32_t soup = 0; soup < soupsCount; soup++) ensemble.setSoup(soup, rows.data());
+    }
+    void step() override { ensemble.step(1); }
+    FieldCell cellAt(int32_t const x, int32_t const y) const override {
+        return ensemble.cellAt(soupsCount - 1, x, y);
+    }
+    uint64_t population() const override { return ensemble.population(soupsCount - 1); }
+};
+
+static EngineFactory const engines[] = {
+    EngineFactory{
+        "field",
+        [](uint32_t, uint32_t) { return true; },
+        [](Field::FieldPimpl const &initial, uint32_t const threads) -> std::unique_ptr<VerifiedEngine> {
+            return std::unique_ptr<VerifiedEngine>(new FieldEngine(initial, threads, CellsSource::field));
+        }
+    },
+    EngineFactory{
+        "field-outputs",
+        [](uint32_t, uint32_t) { return true; },
+        [](Field::FieldPimpl const &initial, uint32_t const threads) -> std::unique_ptr<VerifiedEngine> {
+            return std::unique_ptr<VerifiedEngine>(new FieldEngine(initial, threads, CellsSource::outputs));
+        }
+    },
+    EngineFactory{
+        "field-snapshots",
+        [](uint32_t, uint32_t) { return true; },
+        [](Field::FieldPimpl const &initial, uint32_t const threads) -> std::unique_ptr<VerifiedEngine> {
+            return std::unique_ptr<VerifiedEngine>(new FieldEngine(initial, threads, CellsSource::snapshots));
+        }
+    },
+    EngineFactory{
+        "field-pyramid",
+        [](uint32_t, uint32_t) { return true; },
+        [](Field::FieldPimpl const &initial, uint32_t const threads) -> std::unique_ptr<VerifiedEngine> {
+            return std::unique_ptr<VerifiedEngine>(new FieldEngine(initial, threads, CellsSource::pyramid));
+        }
+    },
+    EngineFactory{
+        "field-ring",
+        [](uint32_t, uint32_t) { return true; },
+        [](Field::FieldPimpl const &initial, uint32_t const threads) -> std::unique_ptr<VerifiedEngine> {
+            return std::unique_ptr<VerifiedEngine>(new FieldEngine(initial, threads, CellsSource::ring));
+        }
+    },
+    EngineFactory{
+        "ensemble",
+        [](uint32_t const width, uint32_t) { return width <= Ensemble::maxWidth; },
+        [](Field::FieldPimpl const &initial, uint32_t const threads) -> std::unique_ptr<VerifiedEngine> {
+            return std::unique_ptr<VerifiedEngine>(new EnsembleEngine(initial, threads));
+        }
+    },
+};
+
+//scalar reference, computes every cell with updatedCell
+class Reference final {
+    Field::FieldPimpl grid;
+public:
+    Reference(int32_t const width, int32_t const height) : grid{ width, height } {}
+
+    Field::FieldPimpl const &cells() const { return grid; }
+    FieldCell cellAt(int32_t const x, int32_t const y) const { return grid.cellAt_grid(y * grid.width + x); }
+    void setCellAt(int32_t const x, int32_t const y, FieldCell const cell) { grid.setCellAt(y * grid.width + x, cell); }
+
+    void edit(Edit const &edit) {
+        forEachWrite(edit, grid.width, grid.height, [&](int32_t const x, int32_t const y, FieldCell const cell) {
+            setCellAt(x, y, cell);
+        });
+    }
+    void step() {
+        for(int32_t i = 0; i < grid.width * grid.height; i++) {
+            grid.setCellAt(i, updatedCell(i, grid), Field::FieldPimpl::bufNext);
+        }
+        grid.swapBuffers();
+    }
+    uint64_t population() const {
+        uint64_t population = 0;
+        for(int32_t i = 0; i < grid.width * grid.height; i++) population += grid.cellAt_grid(i);
+        return population;
+    }
+    //inclusive bounding box of alive cells, false if there are none
+    bool bounds(vec2i &boundsMin, vec2i &boundsMax) const {
+        boundsMin = vec2i(grid.width, grid.height);
+        boundsMax = vec2i(-1);
+        for(int32_t y = 0; y < grid.height; y++) for(int32_t x = 0; x < grid.width; x++) {
+            if(!cellAt(x, y)) continue;
+            boundsMin = vec2i(misc::min(boundsMin.x, x), misc::min(boundsMin.y, y));
+            boundsMax = vec2i(misc::max(boundsMax.x, x), misc::max(boundsMax.y, y));
+        }
+        return boundsMax.x >= 0;
+    }
+};
+
+struct VerifyConfig {
+    uint32_t width, height, threads;
+    uint64_t generations;
+    uint32_t seed;
+};
+
+static Edit randomEdit(std::mt19937 &rng, int32_t const width, int32_t const height) {
+    auto const coord = [&]() { return vec2i(int32_t(rng() % width), int32_t(rng() % height)); };
+    auto const size = [&]() { return vec2i(1 + int32_t(rng() % width), 1 + int32_t(rng() % misc::min(height, 8))); };
+
+    Edit edit{
+        Edit::Kind(rng() % 5), {}, vec2i(0), vec2i(0), FieldCell(rng() & 1), PackedPattern{ 0, 0 }, bool(rng() & 1),
+        vec2i(0), 0, BrushShape::square
+    };
+    switch(edit.kind) {
+        case Edit::Kind::cells:
+            edit.cells.resize(1 + rng() % 16);
+            for(auto &c : edit.cells) c = Cell{ FieldCell(rng() & 1), int32_t(rng() % uint32_t(width * height)) };
+        break; case Edit::Kind::rect:
+            edit.start = coord();
+            edit.size = size();
+        break; case Edit::Kind::pattern: {
+            edit.start = coord();
+            auto const patternSize = size();
+            edit.pattern = PackedPattern{ uint32_t(patternSize.x), uint32_t(patternSize.y) };
+            for(int32_t y = 0; y < patternSize.y; y++) for(int32_t x = 0; x < patternSize.x; x++) {
+                if(rng() % 3 == 0) edit.pattern.setCellAt(x, y, true);
+            }
+        } break; case Edit::Kind::disc:
+            //radius can be larger than the field, the disc then wraps onto itself
+            edit.start = coord();
+            edit.radius = int32_t(rng() % 12);
+        break; case Edit::Kind::stroke:
+            //strokes can cross the field edge and be longer than the field
+            edit.start = coord();
+            edit.end = edit.start + vec2i(int32_t(rng() % (2 * width + 1)) - width, int32_t(rng() % (2 * height + 1)) - height);
+            edit.radius = int32_t(rng() % 6);
+            edit.shape = BrushShape(rng() % 2);
+        break;
+    }
+    return edit;
+}
+
+//returns false and prints the first mismatch
+static bool verify(EngineFactory const &engine, VerifyConfig const &config) {
+    auto const width = int32_t(config.width), height = int32_t(config.height);
+    std::mt19937 rng{ config.seed };
+
+    Reference reference{ width, height };
+    auto const density = 0.1 + 0.4 * (rng() % 5) / 4.0;
+    std::bernoulli_distribution alive{ density };
+    for(int32_t y = 0; y < height; y++) for(int32_t x = 0; x < width; x++) reference.setCellAt(x, y, alive(rng));
+
+    auto const tested = engine.create(reference.cells(), config.threads);
+    auto const fail = [&](uint64_t const generation) -> std::ostream& {
+        return std::cerr << "MISMATCH engine=" << engine.name << " size=" << width << 'x' << height
+            << " threads=" << config.threads << " seed=" << config.seed << " generation=" << generation << ": ";
+    };
+
+    for(uint64_t generation = 1; generation <= config.generations; generation++) {
+        auto const editsCount = rng() % 4 == 0 ? rng() % 4 : 0;
+        for(uint32_t i = 0; i < editsCount; i++) {
+            auto const edit = randomEdit(rng, width, height);
+            reference.edit(edit);
+            tested->edit(edit);
+        }
+        if(config.seed % 3 == 0 && (generation == 2 || generation == 3)) {
+            //some runs get an empty field and then a block across the corner, so that the bounds wrap around
+            auto const isEmpty = generation == 2;
+            Edit const edit{
+                Edit::Kind::rect, {}, isEmpty ? vec2i(0) : vec2i(width - 1, height - 1), isEmpty ? vec2i(width, height) : vec2i(2),
+                FieldCell(!isEmpty), PackedPattern{ 0, 0 }, false, vec2i(0), 0, BrushShape::square
+            };
+            reference.edit(edit);
+            tested->edit(edit);
+        }
+        reference.step();
+        tested->step();
+
+        for(int32_t y = 0; y < height; y++) for(int32_t x = 0; x < width; x++) {
+            auto const expected = reference.cellAt(x, y), actual = tested->cellAt(x, y);
+            if(expected != actual) {
+                fail(generation) << "first mismatching cell (" << x << ", " << y << ") is "
+                    << fieldCell::asString(actual) << ", expected " << fieldCell::asString(expected) << '\n';
+                return false;
+            }
+        }
+        auto const expectedPopulation = reference.population();
+        if(tested->population() != expectedPopulation) {
+            fail(generation) << "population is " << tested->population() << ", expected " << expectedPopulation << '\n';
+            return false;
+        }
+        vec2i boundsMin, boundsMax, expectedMin, expectedMax;
+        if(tested->bounds(boundsMin, boundsMax)) {
+            auto const isMatching = reference.bounds(expectedMin, expectedMax)
+                ? boundsMin.x == expectedMin.x && boundsMin.y == expectedMin.y && boundsMax.x == expectedMax.x && boundsMax.y == expectedMax.y
+                : boundsMin.x > boundsMax.x && boundsMin.y > boundsMax.y;
+            if(!isMatching) {
+                fail(generation) << "bounds are " << boundsMin << ".." << boundsMax << ", expected " << expectedMin << ".." << expectedMax << '\n';
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//generations with edits made while they are computed must not allocate
+//once every reused buffer has grown. Returns false and prints the count if they do
+static bool verifyNoAllocations(uint32_t const width, uint32_t const height, uint32_t const threads, uint32_t const seed) {
+    auto const gridLength = misc::intDivCeil(width, cellsBatchLength) * height;
+    MemoryFieldSink sink{ gridLength };
+    FieldStaging staging{ sink, gridLength };
+    Field field{
+        width, height, threads,
+        [&]() { return std::unique_ptr<FieldOutput>(new StagedFieldOutput(staging, false)); },
+        [&]() { return std::unique_ptr<FieldOutput>(new StagedFieldOutput(staging, true)); }
+    };
+    field.setUndoBudget(0);
+
+    std::mt19937 rng{ seed };
+    PackedPattern soup{ width, height };
+    for(uint32_t y = 0; y < height; y++) for(uint32_t x = 0; x < width; x++) soup.setCellAt(x, y, rng() % 3 == 0);
+    field.pasteRegion(soup, vec2i(0), true);
+    std::vector<Cell> cells(32);
+    for(auto &c : cells) c = Cell{ FieldCell(rng() & 1), int32_t(rng() % (width * height)) };
+    auto const center = vec2i(int32_t(rng() % width), int32_t(rng() % height));
+    field.startCurGeneration();
+
+    auto const generation = [&]() {
+        field.setCells(cells.data(), cells.size());
+        field.fillDisc(center, 3, fieldCell::cellAlive);
+        while(!field.tryFinishGeneration()) {}
+        field.startNewGeneration();
+    };
+    for(uint32_t i = 0; i < 16; i++) generation();
+
+    uint32_t const generations = 64;
+    auto const before = allocationsCount.load();
+    for(uint32_t i = 0; i < generations; i++) generation();
+    auto const allocations = allocationsCount.load() - before;
+
+    while(!field.tryFinishGeneration()) {}
+    if(allocations != 0) {
+        std::cerr << "ALLOCATIONS size=" << width << 'x' << height << " threads=" << threads
+            << ": " << allocations << " in " << generations << " generations\n";
+        return false;
+    }
+    return true;
+}
+
+//fs.shader for one pixel with the same sample positions as SoftwareRenderer, returns the grey level
+static uint32_t referencePixel(Field const &field, RenderView const &view, vec2i const frameSize, int32_t const x, int32_t const y) {
+    auto const noise = [](uint32_t const a, uint32_t const b) {
+        auto h = a * 0x9e3779b1u + b * 0x85ebca77u;
+        h ^= h >> 15; h *= 0x2c1b3c6du;
+        h ^= h >> 12; h *= 0x297a2d39u;
+        h ^= h >> 15;
+        return float(h >> 8) * (1.0f / (1 << 24));
+    };
+    auto const winHalfX = float(frameSize.x) * 0.5f, winHalfY = float(frameSize.y) * 0.5f;
+    auto const invMaxSize = 1.0f / (winHalfX * winHalfX + winHalfY * winHalfY);
+    auto const distort = [&](float &px, float &py, float const intensity) {
+        auto const cx = px - winHalfX, cy = py - winHalfY;
+        auto const coeff = std::sqrt((cx * cx + cy * cy) * invMaxSize) * intensity;
+        px = px - cx * coeff;
+        py = py - cy * coeff;
+    };
+    auto const wrap = [](float const c, float const size) { return c - size * std::floor(c * (1.0f / size)); };
+
+    auto const samples = misc::max<uint32_t>(1, view.samples);
+    auto const fn = float(samples);
+    auto const jitterX = noise(uint32_t(x), uint32_t(y)) * (1 / fn), jitterY = noise(uint32_t(x), uint32_t(y) ^ 0x68e31da4u) * (1 / fn);
+    auto const zoomShiftX = float(view.zoomPoint.x) - winHalfX, zoomShiftY = float(view.zoomPoint.y) - winHalfY;
+    auto const width = int32_t(field.width()), height = int32_t(field.height());
+
+    float sum = 0;
+    for(uint32_t i = 0; i < samples; i++) for(uint32_t j = 0; j < samples; j++) {
+        auto sx = float(x) + float(i) / fn + jitterX, sy = float(y) + float(j) / fn + jitterY;
+        if(view.lensDistortion != 0) distort(sx, sy, float(view.lensDistortion));
+        if(view.deltaScaleChange != 0) {
+            sx -= zoomShiftX; sy -= zoomShiftY;
+            distort(sx, sy, float(-view.deltaScaleChange / 3));
+            sx += zoomShiftX; sy += zoomShiftY;
+        }
+        auto const invHeight = 1.0f / float(frameSize.y);
+        auto const globalX = (sx * invHeight - 0.5f) * float(view.vpSize) + float(view.vpPos.x);
+        auto const globalY = (sy * invHeight - 0.5f) * float(view.vpSize) + float(view.vpPos.y);
+        auto const column = misc::max(misc::min(int32_t(wrap(globalX, float(width))), width - 1), 0);
+        auto const row = misc::max(misc::min(int32_t(wrap(globalY, float(height))), height - 1), 0);
+
+        auto const isEdge = column == 0 || column == width - 1 || row == 0 || row == height - 1;
+        auto const dx = globalX - std::floor(globalX), dy = globalY - std::floor(globalY);
+        auto const padding = 1 / 15.0f;
+        auto const isPadding = dx < padding || dx > 1 - padding || dy < padding || dy > 1 - padding;
+
+        auto color = field.cellAtCoord(column, row) ? 30.0f / 255.0f : 225.0f / 255.0f;
+        if(isEdge) color = (color + 0.5f) * 0.5f;
+        if(isPadding) color = 0.5f;
+        sum += color;
+    }
+    return uint32_t(sum * (1.0f / (fn * fn)) * 255.0f + 0.5f);
+}
+
+//renders random views of a random field and compares them with referencePixel.
+//Returns false and prints the first mismatch
+static bool verifyRender(uint32_t const width, uint32_t const height, uint32_t const threads, uint32_t const seed) {
+    Field field{
+        width, height, 1,
+        []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); },
+        []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); }
+    };
+    field.setUndoBudget(0);
+    std::mt19937 rng{ seed };
+    PackedPattern soup{ width, height };
+    for(uint32_t y = 0; y < height; y++) for(uint32_t x = 0; x < width; x++) soup.setCellAt(x, y, rng() % 3 == 0);
+    field.pasteRegion(soup, vec2i(0), true);
+
+    SoftwareRenderer renderer{ threads };
+    std::uniform_real_distribution<double> unit{ 0, 1 };
+    for(uint32_t i = 0; i < 8; i++) {
+        auto const frameSize = vec2i(int32_t(1 + rng() % 70), int32_t(1 + rng() % 40));
+        RenderView view{};
+        view.vpPos = vec2d((unit(rng) - 0.5) * 4 * width, (unit(rng) - 0.5) * 4 * height);
+        view.vpSize = 0.5 + unit(rng) * 3 * height;
+        view.lensDistortion = i % 2 == 0 ? 0 : 0.17;
+        view.deltaScaleChange = i % 4 < 2 ? 0 : unit(rng) - 0.5;
+        view.zoomPoint = vec2d(unit(rng) * frameSize.x, unit(rng) * frameSize.y);
+        view.samples = i % 3 == 0 ? 1 : 3;
+
+        std::vector<uint32_t> pixels(size_t(frameSize.x) * frameSize.y);
+        renderer.render(field, view, frameSize, pixels.data());
+        for(int32_t y = 0; y < frameSize.y; y++) for(int32_t x = 0; x < frameSize.x; x++) {
+            auto const expectedGrey = referencePixel(field, view, frameSize, x, y);
+            auto const expected = expectedGrey | (expectedGrey << 8) | (expectedGrey << 16) | 0xff000000u;
+            auto const actual = pixels[size_t(y) * frameSize.x + x];
+            if(actual != expected) {
+                std::cerr << "MISMATCH engine=render size=" << width << 'x' << height << " threads=" << threads
+                    << " seed=" << seed << " view=" << i << ": pixel (" << x << ", " << y << ") is " << std::hex << actual
+                    << ", expected " << expected << std::dec << '\n';
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//runs a field served by DeltaStreamServer and compares it with what subscribers receive:
+//one with the whole field, one with a viewport that changes, and a slow one that reads
+//only every few generations. Returns false and prints the first mismatch
+static bool verifyStream(uint32_t const width, uint32_t const height, uint32_t const threads, uint32_t const seed) {
+    Field field{
+        width, height, threads,
+        []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); },
+        []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); }
+    };
+    field.setUndoBudget(0);
+    std::mt19937 rng{ seed };
+    PackedPattern soup{ width, height };
+    for(uint32_t y = 0; y < height; y++) for(uint32_t x = 0; x < width; x++) soup.setCellAt(x, y, rng() % 3 == 0);
+    field.pasteRegion(soup, vec2i(0), true);
+
+    auto const fail = [&](char const *const client, uint64_t const generation) -> std::ostream& {
+        return std::cerr << "MISMATCH engine=stream size=" << width << 'x' << height << " threads=" << threads
+            << " seed=" << seed << " client=" << client << " generation=" << generation << ": ";
+    };
+    DeltaStreamServer server{ width, height, field.width_actual() / 32 };
+    DeltaStreamClient whole{}, moving{}, slow{};
+    auto const randomViewport = [&]() {
+        return deltaStream::Viewport{
+            uint32_t(rng() % width), uint32_t(rng() % height), uint32_t(1 + rng() % width), uint32_t(1 + rng() % height)
+        };
+    };
+    if(!server.start(0) || !whole.connect(server.port(), { 0, 0, 0, 0 })
+        || !moving.connect(server.port(), randomViewport()) || !slow.connect(server.port(), { 0, 0, 0, 0 })
+    ) {
+        fail("all", 0) << "can't connect\n";
+        return false;
+    }
+
+    //reads until the client has the current generation and compares every cell it has
+    auto const check = [&](DeltaStreamClient &client, char const *const name) {
+        while(!client.isSynchronized() || client.generation() != field.generation()) {
+            if(!client.receive(2000)) {
+                fail(name, field.generation()) << "no message with the generation\n";
+                return false;
+            }
+        }
+        auto const &info = client.viewport();
+        auto const endX = misc::min((info.firstBatch + info.batchesCount) * 32, width);
+        for(auto y = info.firstRow; y < info.firstRow + info.rowsCount; y++) for(auto x = info.firstBatch * 32; x < endX; x++) {
+            if(client.cellAt(x, y) != bool(field.cellAtCoord(int32_t(x), int32_t(y)))) {
+                fail(name, field.generation()) << "first mismatching cell (" << x << ", " << y << ")\n";
+                return false;
+            }
+        }
+        for(uint32_t row = 0; row < info.rowsCount; row++) {
+            auto const last = client.cells()[size_t(row) * info.batchesCount + info.batchesCount - 1];
+            if(info.firstBatch + info.batchesCount == field.width_actual() / 32 && width % 32 != 0 && (last >> (width % 32)) != 0) {
+                fail(name, field.generation()) << "bits past the width are set\n";
+                return false;
+            }
+        }
+        return true;
+    };
+
+    field.startCurGeneration();
+    server.publish(field.rawData(), field.generation());
+    for(uint32_t i = 0; i < 24; i++) {
+        if(!check(whole, "whole") || !check(moving, "moving")) return false;
+        if(i % 6 == 5 && !check(slow, "slow")) return false;
+        if(i % 4 == 3) moving.subscribe(randomViewport());
+        if(i % 5 == 0) field.fillRect(vec2i(int32_t(rng() % width), int32_t(rng() % height)), vec2i(3, 2), fieldCell::cellAlive);
+        while(!field.tryFinishGeneration()) {}
+        field.startNewGeneration();
+        server.publish(field.rawData(), field.generation());
+    }
+    while(!field.tryFinishGeneration()) {}
+    return true;
+}
+
+//runs a field staged into a TileStreamer with a small pool and random views, and compares
+//what a MemoryTileSink has with the field: every visible cell when tiles are streamed,
+//the densities of the pyramid when zoomed out. Returns false and prints the first mismatch
+static bool verifyTiles(uint32_t const width, uint32_t const height, uint32_t const threads, uint32_t const seed) {
+    MemoryTileSink sink{};
+    TileStreamOptions options{};
+    options.tileBatches = 1 + seed % 2;
+    options.tileRows = 8;
+    options.slotsCount = 24;
+    options.densityCellsPerPixel = 2;
+    TileStreamer streamer{ width, height, sink, options };
+    FieldStaging staging{ streamer, misc::intDivCeil(width, cellsBatchLength) * height };
+    Field field{
+        width, height, threads,
+        [&]() { return std::unique_ptr<FieldOutput>(new StagedFieldOutput(staging, false)); },
+        [&]() { return std::unique_ptr<FieldOutput>(new StagedFieldOutput(staging, true)); }
+    };
+    field.setUndoBudget(0);
+    field.setDensityPyramidEnabled(true);
+    std::mt19937 rng{ seed };
+    PackedPattern soup{ width, height };
+    for(uint32_t y = 0; y < height; y++) for(uint32_t x = 0; x < width; x++) soup.setCellAt(x, y, rng() % 3 == 0);
+    field.pasteRegion(soup, vec2i(0), true);
+
+    std::uniform_real_distribution<double> unit{ 0, 1 };
+    FieldView view{ vec2d(0), 1, vec2i(40, 30), 0 };
+    auto const fail = [&](uint32_t const step) -> std::ostream& {
+        return std::cerr << "MISMATCH engine=tiles size=" << width << 'x' << height << " threads=" << threads
+            << " seed=" << seed << " step=" << step << " view=(" << view.vpPos.x << ", " << view.vpPos.y << ") x" << view.vpSize << ": ";
+    };
+    std::vector<float> expected{};
+    auto const check = [&](uint32_t const step) {
+        streamer.update(view, staging, field.densityPyramid());
+        if(streamer.isDensityMode()) {
+            auto const &window = streamer.density();
+            expected.resize(size_t(window.size.x) * window.size.y);
+            field.densityPyramid()->readDensity(window.level, window.start, window.size, expected.data());
+            if(sink.window.level != window.level || sink.densities != expected) {
+                fail(step) << "densities of level " << window.level << " differ\n";
+                return false;
+            }
+            return true;
+        }
+        auto const aspect = double(view.windowSize.x) / view.windowSize.y;
+        auto const minX = int32_t(std::floor(view.vpPos.x - 0.5 * view.vpSize)), maxX = int32_t(std::floor(view.vpPos.x + (aspect - 0.5) * view.vpSize));
+        auto const minY = int32_t(std::floor(view.vpPos.y - 0.5 * view.vpSize)), maxY = int32_t(std::floor(view.vpPos.y + 0.5 * view.vpSize));
+        for(auto y = minY; y <= maxY; y++) for(auto x = minX; x <= maxX; x++) {
+            auto const cellX = uint32_t(misc::mod(x, int32_t(width))), cellY = uint32_t(misc::mod(y, int32_t(height)));
+            auto const actual = sink.cellAt(streamer.layout(), cellX, cellY);
+            if(actual != int32_t(field.cellAtCoord(int32_t(cellX), int32_t(cellY)))) {
+                fail(step) << "cell (" << cellX << ", " << cellY << ") is " << actual << ", expected " << int32_t(field.cellAtCoord(int32_t(cellX), int32_t(cellY))) << '\n';
+                return false;
+            }
+        }
+        return true;
+    };
+
+    field.startCurGeneration();
+    for(uint32_t step = 0; step < 32; step++) {
+        if(step % 3 == 0) {
+            //mostly views that fit into the pool, sometimes zoomed out or wrapping around
+            view.vpSize = step % 9 == 0 ? 0.5 + unit(rng) * 4 * height : 0.5 + unit(rng) * 12;
+            view.vpPos = vec2d((unit(rng) - 0.25) * 2 * width, (unit(rng) - 0.25) * 2 * height);
+        }
+        else view.vpPos += vec2d(unit(rng) - 0.5, unit(rng) - 0.5) * 6.0;
+        if(step % 4 == 1) field.fillRect(vec2i(int32_t(rng() % width), int32_t(rng() % height)), vec2i(3, 2), FieldCell(rng() & 1));
+        if(!check(step)) return false;
+        while(!field.tryFinishGeneration()) {}
+        field.startNewGeneration();
+        if(!check(step)) return false;
+    }
+
+    //a view one cell narrower than the field that starts and ends in the same tile, in a window large
+    //enough for tiles to be streamed. It needs every tile of its rows, not just the first one
+    view.windowSize = vec2i(4000, 3000);
+    view.vpSize = misc::max(width - 1.5, 0.5) * 0.75;
+    view.vpPos = vec2d(10 + 0.5 * view.vpSize, height * 0.5);
+    if(!check(32)) return false;
+    while(!field.tryFinishGeneration()) {}
+    return true;
+}
+
+//runs a field staged into a MemoryFieldSink with random edits and resizes it every few generations,
+//sometimes before the generation being computed is finished. Compares the cells of the field and the outputs,
+//the population and the density pyramid with a reference resized the same way. Returns false and prints the first mismatch
+static bool verifyResize(uint32_t const width, uint32_t const height, uint32_t const threads, uint32_t const seed) {
+    MemoryFieldSink sink{ misc::intDivCeil(width, cellsBatchLength) * height };
+    FieldStaging staging{ sink, misc::intDivCeil(width, cellsBatchLength) * height };
+    Field field{
+        width, height, threads,
+        [&]() { return std::unique_ptr<FieldOutput>(new StagedFieldOutput(staging, false)); },
+        [&]() { return std::unique_ptr<FieldOutput>(new StagedFieldOutput(staging, true)); }
+    };
+    field.setDensityPyramidEnabled(true);
+    std::mt19937 rng{ seed };
+    std::unique_ptr<Reference> reference{ new Reference(int32_t(width), int32_t(height)) };
+    PackedPattern soup{ width, height };
+    for(uint32_t y = 0; y < height; y++) for(uint32_t x = 0; x < width; x++) {
+        auto const cell = FieldCell(rng() % 3 == 0);
+        soup.setCellAt(x, y, cell);
+        reference->setCellAt(int32_t(x), int32_t(y), cell);
+    }
+    field.pasteRegion(soup, vec2i(0), true);
+
+    vec2i offset{ 0 };
+    auto const fail = [&](uint32_t const step) -> std::ostream& {
+        return std::cerr << "MISMATCH engine=resize size=" << width << 'x' << height << " threads=" << threads << " seed=" << seed
+            << " step=" << step << " resized to " << field.width() << 'x' << field.height() << " with offset " << offset << ": ";
+    };
+    auto const check = [&](uint32_t const step) {
+        auto const &cells = reference->cells();
+        auto const rowLength = misc::intDivCeil(cells.width, cellsBatchLength);
+        auto const &outputs = sink.buffers[staging.currentIndex()];
+        if(int32_t(field.width()) != cells.width || int32_t(field.height()) != cells.height || outputs.size() != rowLength * cells.height) {
+            fail(step) << "size of the field or its outputs is wrong\n";
+            return false;
+        }
+        for(int32_t y = 0; y < cells.height; y++) for(int32_t x = 0; x < cells.width; x++) {
+            auto const expected = reference->cellAt(x, y);
+            auto const output = FieldCell((outputs[y * rowLength + x / cellsBatchLength] >> (x % cellsBatchLength)) & 1);
+            if(field.cellAtCoord(x, y) != expected || output != expected) {
+                fail(step) << "cell (" << x << ", " << y << ") is " << fieldCell::asString(field.cellAtCoord(x, y))
+                    << ", in the outputs " << fieldCell::asString(output) << ", expected " << fieldCell::asString(expected) << '\n';
+                return false;
+            }
+        }
+        DensityPyramid recounted{ uint32_t(cells.width), uint32_t(cells.height), rowLength };
+        recounted.rebuild(field.rawData());
+        auto const pyramid = field.densityPyramid();
+        for(auto level = DensityPyramid::minLevel; level <= recounted.maxLevel(); level++) {
+            auto const size = recounted.levelSize(level);
+            for(int32_t y = 0; y < size.y; y++) for(int32_t x = 0; x < size.x; x++) {
+                if(pyramid->aliveCells(level, x, y) != recounted.aliveCells(level, x, y)) {
+                    fail(step) << "density pyramid block (" << x << ", " << y << ") of level " << level << " is wrong\n";
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    field.startCurGeneration();
+    for(uint32_t step = 0; step < 24; step++) {
+        if(step % 3 == 1) {
+            //sizes around the original one, shrinking and growing, with the cells moved both ways
+            auto const newWidth = 1 + int32_t(rng() % (2 * width + 40)), newHeight = 1 + int32_t(rng() % (2 * height + 4));
+            offset = vec2i(int32_t(rng() % (2 * newWidth + 1)) - newWidth, int32_t(rng() % (2 * newHeight + 1)) - newHeight);
+            if(rng() % 2 == 0) while(!field.tryFinishGeneration()) {}
+            field.resize(uint32_t(newWidth), uint32_t(newHeight), offset);
+
+            std::unique_ptr<Reference> resized{ new Reference(newWidth, newHeight) };
+            auto const &cells = reference->cells();
+            for(int32_t y = 0; y < cells.height; y++) for(int32_t x = 0; x < cells.width; x++) {
+                auto const to = vec2i(x, y) + offset;
+                if(to.x >= 0 && to.x < newWidth && to.y >= 0 && to.y < newHeight) resized->setCellAt(to.x, to.y, reference->cellAt(x, y));
+            }
+            reference = std::move(resized);
+            if(!check(step)) return false;
+            if(field.undo()) {
+                fail(step) << "edits before the resize can be undone\n";
+                return false;
+            }
+        }
+        if(rng() % 2 == 0) {
+            auto const edit = randomEdit(rng, int32_t(field.width()), int32_t(field.height()));
+            reference->edit(edit);
+            applyEdit(field, edit);
+        }
+        reference->step();
+        while(!field.tryFinishGeneration()) {}
+        if(field.generationStats().population != reference->population()) {
+            fail(step) << "population is " << field.generationStats().population << ", expected " << reference->population() << '\n';
+            return false;
+        }
+        field.startNewGeneration();
+        if(!check(step)) return false;
+    }
+    while(!field.tryFinishGeneration()) {}
+    return true;
+}
+
+//edits a field with its undo history on and undoes and redoes the edits while generations are computed between them,
+//with strokes of several edits made over several generations and budgets small enough to drop entries.
+//The reference keeps its own history of the cells that every entry changed. Returns false and prints the first mismatch
+static bool verifyUndo(uint32_t const width, uint32_t const height, uint32_t const threads, uint32_t const seed) {
+    Field field{
+        width, height, threads,
+        []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); },
+        []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); }
+    };
+    std::mt19937 rng{ seed };
+    Reference reference{ int32_t(width), int32_t(height) };
+    PackedPattern soup{ width, height };
+    for(uint32_t y = 0; y < height; y++) for(uint32_t x = 0; x < width; x++) {
+        auto const cell = FieldCell(rng() % 3 == 0);
+        soup.setCellAt(x, y, cell);
+        reference.setCellAt(int32_t(x), int32_t(y), cell);
+    }
+    field.setUndoBudget(0); //the soup is not undone
+    field.pasteRegion(soup, vec2i(0), true);
+
+    //an entry has the cells that differ after it, with their value before the first edit that changed them.
+    //It takes a delta for every batch that has one of them, as EditJournal does
+    struct CellDelta { FieldCell before, after; };
+    struct Entry { std::map<int32_t, CellDelta> cells; size_t bytes; };
+    auto const rowLength = int32_t(misc::intDivCeil(width, cellsBatchLength));
+    auto const budgetBytes = [&]() -> size_t { return rng() % 3 == 0 ? 1u << 20 : sizeof(BatchDelta) * (1 + rng() % 48); };
+    std::deque<Entry> entries{};
+    size_t applied = 0, bytes = 0, budget = budgetBytes();
+    Entry pending{};
+    bool isStroke = false;
+    field.setUndoBudget(budget);
+
+    auto const trim = [&]() {
+        while(bytes > budget && !entries.empty()) {
+            if(applied != 0) {
+                bytes -= entries.front().bytes;
+                entries.pop_front();
+                applied--;
+            }
+            else {
+                bytes -= entries.back().bytes;
+                entries.pop_back();
+            }
+        }
+    };
+    auto const commit = [&]() {
+        for(auto it = pending.cells.begin(); it != pending.cells.end();) {
+            if(it->second.before == it->second.after) it = pending.cells.erase(it);
+            else ++it;
+        }
+        std::vector<int32_t> batches{};
+        for(auto const &c : pending.cells) batches.push_back(c.first / int32_t(width) * rowLength + c.first % int32_t(width) / cellsBatchLength);
+        batches.erase(std::unique(batches.begin(), batches.end()), batches.end());
+        pending.bytes = batches.size() * sizeof(BatchDelta);
+        if(!pending.cells.empty()) {
+            while(entries.size() > applied) {
+                bytes -= entries.back().bytes;
+                entries.pop_back();
+            }
+            bytes += pending.bytes;
+            entries.push_back(std::move(pending));
+            applied = entries.size();
+            trim();
+        }
+        pending = Entry{};
+    };
+    auto const edit = [&]() {
+        auto const e = randomEdit(rng, int32_t(width), int32_t(height));
+        forEachWrite(e, int32_t(width), int32_t(height), [&](int32_t const x, int32_t const y, FieldCell const cell) {
+            auto const current = reference.cellAt(x, y);
+            if(current == cell) return;
+            auto const delta = pending.cells.emplace(y * int32_t(width) + x, CellDelta{ current, cell });
+            delta.first->second.after = cell;
+            reference.setCellAt(x, y, cell);
+        });
+        applyEdit(field, e);
+        if(!isStroke) commit();
+    };
+    auto const replay = [&](Entry const &entry, bool const isUndo) {
+        for(auto const &c : entry.cells) {
+            reference.setCellAt(c.first % int32_t(width), c.first / int32_t(width), isUndo ? c.second.before : c.second.after);
+        }
+    };
+
+    auto const fail = [&](uint32_t const step) -> std::ostream& {
+        return std::cerr << "MISMATCH engine=undo size=" << width << 'x' << height << " threads=" << threads << " seed=" << seed
+            << " step=" << step << ": ";
+    };
+    auto const advance = [&](uint32_t const step) {
+        reference.step();
+        while(!field.tryFinishGeneration()) {}
+        if(field.generationStats().population != reference.population()) {
+            fail(step) << "population is " << field.generationStats().population << ", expected " << reference.population() << '\n';
+            return false;
+        }
+        field.startNewGeneration();
+        for(int32_t y = 0; y < int32_t(height); y++) for(int32_t x = 0; x < int32_t(width); x++) {
+            auto const expected = reference.cellAt(x, y);
+            if(field.cellAtCoord(x, y) != expected) {
+                fail(step) << "cell (" << x << ", " << y << ") is " << fieldCell::asString(field.cellAtCoord(x, y))
+                    << ", expected " << fieldCell::asString(expected) << '\n';
+                return false;
+            }
+        }
+        return true;
+    };
+
+    field.startCurGeneration();
+    for(uint32_t step = 0; step < 64; step++) {
+        auto const action = rng() % 8;
+        if(action <= 2) edit();
+        else if(action == 3) {
+            //a stroke over several generations is one entry
+            field.beginStroke();
+            isStroke = true;
+            auto const count = 2 + rng() % 3;
+            for(uint32_t i = 0; i < count; i++) {
+                edit();
+                if(i + 1 != count && !advance(step)) return false;
+            }
+            isStroke = false;
+            field.endStroke();
+            commit();
+        }
+        else if(action == 4 || action == 5) {
+            auto const isUndo = action == 4;
+            for(auto count = 1 + rng() % 3; count != 0; count--) {
+                auto const expected = isUndo ? applied != 0 : applied != entries.size();
+                if((isUndo ? field.undo() : field.redo()) != expected) {
+                    fail(step) << (isUndo ? "undo" : "redo") << " returned " << !expected << '\n';
+                    return false;
+                }
+                if(!expected) break;
+                if(isUndo) replay(entries[--applied], true);
+                else replay(entries[applied++], false);
+            }
+        }
+        else if(action == 6) {
+            budget = budgetBytes();
+            field.setUndoBudget(budget);
+            trim();
+        }
+
+        if(field.undoBytes() != bytes) {
+            fail(step) << "undo history takes " << field.undoBytes() << " bytes, expected " << bytes << '\n';
+            return false;
+        }
+        if(!advance(step)) return false;
+    }
+    while(!field.tryFinishGeneration()) {}
+    return true;
+}
+
+//compares the transforms of PackedPattern with per-cell ones for sizes that are not multiples of 32,
+//copies regions of a field across its wrap seam and pastes them back transformed, and pastes one pattern
+//at every column shift so that all its shifted copies are used. Returns false and prints the first mismatch
+static bool verifyPatterns(uint32_t const width, uint32_t const height, uint32_t const seed) {
+    std::mt19937 rng{ seed };
+    auto const fail = [&]() -> std::ostream& {
+        return std::cerr << "MISMATCH engine=patterns size=" << width << 'x' << height << " seed=" << seed << ": ";
+    };
+    auto const randomPattern = [&](uint32_t const w, uint32_t const h) {
+        PackedPattern pattern{ w, h };
+        for(uint32_t y = 0; y < h; y++) for(uint32_t x = 0; x < w; x++) pattern.setCellAt(x, y, rng() % 3 == 0);
+        return pattern;
+    };
+
+    struct Transform {
+        char const *name;
+        PackedPattern (PackedPattern::*apply)() const;
+        bool isTransposing;
+    };
+    static Transform const transforms[] = {
+        { "transposed", &PackedPattern::transposed, true },
+        { "flippedHorizontally", &PackedPattern::flippedHorizontally, false },
+        { "flippedVertically", &PackedPattern::flippedVertically, false },
+        { "rotatedClockwise", &PackedPattern::rotatedClockwise, true },
+        { "rotatedCounterClockwise", &PackedPattern::rotatedCounterClockwise, true },
+    };
+    //cell of the original pattern that `transforms[transform]` moves to (x, y)
+    auto const sourceCell = [](size_t const transform, PackedPattern const &p, uint32_t const x, uint32_t const y) {
+        switch(transform) {
+            case 0: return p.cellAt(y, x);
+            case 1: return p.cellAt(p.width() - 1 - x, y);
+            case 2: return p.cellAt(x, p.height() - 1 - y);
+            case 3: return p.cellAt(y, p.height() - 1 - x);
+            default: return p.cellAt(p.width() - 1 - y, x);
+        }
+    };
+    auto const checkTransforms = [&](PackedPattern const &pattern) {
+        for(size_t t = 0; t < std::size(transforms); t++) {
+            auto const &transform = transforms[t];
+            auto const result = (pattern.*transform.apply)();
+            auto const expectedWidth = transform.isTransposing ? pattern.height() : pattern.width();
+            auto const expectedHeight = transform.isTransposing ? pattern.width() : pattern.height();
+            if(result.width() != expectedWidth || result.height() != expectedHeight) {
+                fail() << transform.name << " of " << pattern.width() << 'x' << pattern.height() << " pattern is "
+                    << result.width() << 'x' << result.height() << '\n';
+                return false;
+            }
+            for(uint32_t y = 0; y < result.height(); y++) {
+                for(uint32_t x = 0; x < result.width(); x++) {
+                    if(result.cellAt(x, y) != sourceCell(t, pattern, x, y)) {
+                        fail() << transform.name << " of " << pattern.width() << 'x' << pattern.height()
+                            << " pattern has wrong cell (" << x << ", " << y << ")\n";
+                        return false;
+                    }
+                }
+                auto const lastCells = result.width() % PackedPattern::batchLength;
+                if(lastCells != 0 && (result.data()[(y + 1) * result.rowLength() - 1] >> lastCells) != 0) {
+                    fail() << transform.name << " of " << pattern.width() << 'x' << pattern.height()
+                        << " pattern has cells past its width in row " << y << '\n';
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    for(auto const size : { vec2i(1, 1), vec2i(1, 33), vec2i(31, 1), vec2i(5, 33), vec2i(33, 17), vec2i(63, 65), vec2i(32, 32), vec2i(100, 3) }) {
+        if(!checkTransforms(randomPattern(uint32_t(size.x), uint32_t(size.y)))) return false;
+    }
+    for(uint32_t i = 0; i < 8; i++) {
+        if(!checkTransforms(randomPattern(1 + rng() % 100, 1 + rng() % 70))) return false;
+    }
+
+    Field field{
+        width, height, 1,
+        []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); },
+        []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); }
+    };
+    field.setUndoBudget(0);
+    Reference reference{ int32_t(width), int32_t(height) };
+    auto const soup = randomPattern(width, height);
+    for(uint32_t y = 0; y < height; y++) for(uint32_t x = 0; x < width; x++) reference.setCellAt(int32_t(x), int32_t(y), soup.cellAt(x, y));
+    field.pasteRegion(soup, vec2i(0), true);
+
+    auto const paste = [&](PackedPattern const &pattern, vec2i const offset, bool const overwrite, char const *const what) {
+        Edit const edit{ Edit::Kind::pattern, {}, offset, vec2i(0), FieldCell(false), pattern, overwrite, vec2i(0), 0, BrushShape::square };
+        reference.edit(edit);
+        field.pasteRegion(pattern, offset, overwrite);
+        for(int32_t y = 0; y < int32_t(height); y++) for(int32_t x = 0; x < int32_t(width); x++) {
+            if(field.cellAtCoord(x, y) != reference.cellAt(x, y)) {
+                fail() << what << ' ' << pattern.width() << 'x' << pattern.height() << " pattern pasted at " << offset
+                    << (overwrite ? " with" : " without") << " overwrite, cell (" << x << ", " << y << ") is wrong\n";
+                return false;
+            }
+        }
+        return true;
+    };
+
+    //regions that start before the seam and wrap around it
+    for(uint32_t i = 0; i < 8; i++) {
+        auto const size = vec2i(1 + int32_t(rng() % width), 1 + int32_t(rng() % height));
+        auto const start = vec2i(int32_t(width) - 1 - int32_t(rng() % uint32_t(size.x)), int32_t(height) - 1 - int32_t(rng() % uint32_t(size.y)));
+        auto const region = field.copyRegion(start, size);
+        for(int32_t y = 0; y < size.y; y++) for(int32_t x = 0; x < size.x; x++) {
+            auto const expected = reference.cellAt(misc::mod(start.x + x, int32_t(width)), misc::mod(start.y + y, int32_t(height)));
+            if(region.cellAt(uint32_t(x), uint32_t(y)) != bool(expected)) {
+                fail() << "region " << size.x << 'x' << size.y << " copied from " << start << " has wrong cell (" << x << ", " << y << ")\n";
+                return false;
+            }
+        }
+        auto const transform = rng() % (std::size(transforms) + 1);
+        auto const pasted = transform == 0 ? region : (region.*transforms[transform - 1].apply)();
+        auto const offset = vec2i(int32_t(rng() % (3 * width)) - int32_t(width), int32_t(rng() % (3 * height)) - int32_t(height));
+        if(!paste(pasted, offset, rng() % 2 == 0, transform == 0 ? "copied" : transforms[transform - 1].name)) return false;
+    }
+
+    //every shift of the same pattern, then again after it is changed
+    auto pattern = randomPattern(1 + rng() % misc::min(width, 70u), 1 + rng() % height);
+    for(uint32_t round = 0; round < 2; round++) {
+        for(uint32_t shift = 0; shift < PackedPattern::batchLength; shift++) {
+            auto const batches = (width - pattern.width()) / PackedPattern::batchLength;
+            auto const column = (rng() % (batches + 1)) * PackedPattern::batchLength + shift;
+            auto const offset = vec2i(int32_t(column), int32_t(rng() % height));
+            if(!paste(pattern, offset, rng() % 2 == 0, "shifted")) return false;
+        }
+        pattern.setCellAt(rng() % pattern.width(), rng() % pattern.height(), true);
+    }
+    return true;
+}
+
+//runs a random soup, or a glider if `isGlider`, until the field reports a period, checks with the reference
+//that the generation one period later has the same cells, then fast forwards the field by a random number of generations
+//and compares it with the reference stepped by the remainder. Returns false and prints the first mismatch
+static bool verifyPeriod(uint32_t const width, uint32_t const height, uint32_t const threads, uint32_t const seed, bool const isGlider) {
+    Field field{
+        width, height, threads,
+        []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); },
+        []() { return std::unique_ptr<FieldOutput>(new NullFieldOutput()); }
+    };
+    std::mt19937 rng{ seed };
+    std::unique_ptr<Reference> reference{ new Reference(int32_t(width), int32_t(height)) };
+    PackedPattern start{ width, height };
+    for(uint32_t y = 0; y < height; y++) for(uint32_t x = 0; x < width; x++) {
+        auto const cell = isGlider
+            ? FieldCell((x == 1 && y == 0) || (x == 2 && y == 1) || (x < 3 && y == 2))
+            : FieldCell(rng() % 3 == 0);
+        start.setCellAt(x, y, cell);
+        reference->setCellAt(int32_t(x), int32_t(y), cell);
+    }
+    field.pasteRegion(start, vec2i(0), true);
+
+    auto const fail = [&]() -> std::ostream& {
+        return std::cerr << "MISMATCH engine=period size=" << width << 'x' << height << " threads=" << threads << " seed=" << seed
+            << " glider=" << isGlider << " generation=" << field.generation() << " period=" << field.period() << ": ";
+    };
+    auto const referenceCells = [&]() {
+        std::vector<FieldCell> cells(size_t(width) * height);
+        for(uint32_t y = 0; y < height; y++) for(uint32_t x = 0; x < width; x++) cells[y * width + x] = reference->cellAt(int32_t(x), int32_t(y));
+        return cells;
+    };
+    auto const sameAsReference = [&]() {
+        for(uint32_t y = 0; y < height; y++) for(uint32_t x = 0; x < width; x++) {
+            if(field.cellAtCoord(int32_t(x), int32_t(y)) != reference->cellAt(int32_t(x), int32_t(y))) return false;
+        }
+        return true;
+    };
+
+    field.startCurGeneration();
+    for(uint32_t i = 0; i < 4000 && field.period() == 0; i++) {
+        while(!field.tryFinishGeneration()) {}
+        field.startNewGeneration();
+        reference->step();
+    }
+    if(field.period() == 0) {
+        while(!field.tryFinishGeneration()) {}
+        if(!isGlider) return true; //some soups are still changing
+        fail() << "the period is not found\n";
+        return false;
+    }
+
+    auto const period = field.period();
+    auto const cells = referenceCells();
+    for(uint32_t i = 0; i < period; i++) reference->step();
+    if(referenceCells() != cells || !sameAsReference()) {
+        fail() << "cells are different one period later\n";
+        while(!field.tryFinishGeneration()) {}
+        return false;
+    }
+    if(isGlider && period != 4 * misc::min(width, height) && width == height) {
+        fail() << "expected period " << 4 * width << '\n';
+        while(!field.tryFinishGeneration()) {}
+        return false;
+    }
+
+    auto const generations = uint64_t(rng() % 100000);
+    auto const generation = field.generation();
+    field.fastForward(generations);
+    for(uint64_t i = 0; i < generations % period; i++) reference->step();
+    while(!field.tryFinishGeneration()) {}
+    if(field.generation() != generation + generations || !sameAsReference()) {
+        fail() << "fast forward by " << generations << " is wrong\n";
+        return false;
+    }
+    return true;
+}
+
+//shapes placed by verifyCensus, in the orientation of their names
+static std::vector<vec2i> shapeCells(char const *const pattern) {
+    std::vector<vec2i> cells{};
+    int32_t x = 0, y = 0;
+    for(auto c = pattern; *c != '\0'; c++) {
+        if(*c == '\n') { x = 0; y++; continue; }
+        if(*c == 'o') cells.push_back(vec2i(x, y));
+        x++;
+    }
+    return cells;
+}
+
+//places blocks, blinkers and gliders (one across a batch edge and one across the wrap in both directions)
+//and random other small objects into a packed torus with garbage bits past the width, runs Census on it
+//and compares the entries with objects found by a flood fill. Returns false and prints the first mismatch
+static bool verifyCensus(uint32_t const width, uint32_t const height, uint32_t const threads, uint32_t const seed) {
+    auto const w = int32_t(width), h = int32_t(height);
+    auto const rowLength = misc::intDivCeil(width, 32) + 1;
+    std::vector<uint32_t> cells(size_t(rowLength) * height, 0);
+    std::mt19937 rng{ seed };
+    for(uint32_t y = 0; y < height; y++) for(uint32_t i = width / 32; i < rowLength; i++) {
+        auto const garbage = uint32_t(rng());
+        cells[y * rowLength + i] |= i == width / 32 ? garbage & ~((1u << (width % 32)) - 1) : garbage;
+    }
+    auto const wrapped = [&](int32_t const x, int32_t const y) { return vec2i(((x % w) + w) % w, ((y % h) + h) % h); };
+    auto const cellAt = [&](int32_t const x, int32_t const y) {
+        auto const c = wrapped(x, y);
+        return (cells[c.y * rowLength + c.x / 32] >> (c.x % 32)) & 1;
+    };
+
+    //a shape is only placed if the cells around it are empty, so that it stays a separate object
+    auto const place = [&](std::vector<vec2i> const &shape, vec2i const at) {
+        for(auto const c : shape) for(int32_t dy = -1; dy <= 1; dy++) for(int32_t dx = -1; dx <= 1; dx++) {
+            if(cellAt(at.x + c.x + dx, at.y + c.y + dy)) return false;
+        }
+        for(auto const c : shape) {
+            auto const p = wrapped(at.x + c.x, at.y + c.y);
+            cells[p.y * rowLength + p.x / 32] |= 1u << (p.x % 32);
+        }
+        return true;
+    };
+    auto const glider = shapeCells(".o.\n..o\nooo");
+    place(shapeCells("oo\noo"), vec2i(2, 2));
+    place(shapeCells("ooo"), vec2i(2, 6));
+    place(glider, vec2i(30, 2));
+    place(glider, vec2i(w - 1, h - 1));
+
+    std::vector<char const*> const others{ "oo\noo", "ooo", ".o.\n..o\nooo", ".oo.\no..o\n.oo.", "oo.\no.o\n.o.", "oo.\no.o\n.oo", "o\n.o\n..oo", "oooo" };
+    for(uint32_t i = 0; i < width * height / 40; i++) {
+        auto shape = shapeCells(others[rng() % others.size()]);
+        auto const orientation = rng() % 8;
+        for(auto &c : shape) {
+            if(orientation & 1) c.x = -c.x;
+            if(orientation & 2) c.y = -c.y;
+            if(orientation & 4) std::swap(c.x, c.y);
+        }
+        place(shape, vec2i(int32_t(rng() % width), int32_t(rng() % height)));
+    }
+
+    //flood fill of every object with unwrapped coordinates, each shape is hashed from its pattern
+    struct Expected { uint64_t count; uint32_t population; vec2i size; };
+    std::vector<std::pair<uint64_t, Expected>> expected{};
+    std::vector<bool> visited(size_t(width) * height, false);
+    uint64_t expectedObjects = 0;
+    std::vector<vec2i> object{}, stack{};
+    for(int32_t y = 0; y < h; y++) for(int32_t x = 0; x < w; x++) {
+        if(!cellAt(x, y) || visited[y * width + x]) continue;
+        object.clear();
+        stack.assign(1, vec2i(x, y));
+        visited[y * width + x] = true;
+        while(!stack.empty()) {
+            auto const c = stack.back();
+            stack.pop_back();
+            object.push_back(c);
+            for(int32_t dy = -1; dy <= 1; dy++) for(int32_t dx = -1; dx <= 1; dx++) {
+                auto const n = vec2i(c.x + dx, c.y + dy);
+                auto const p = wrapped(n.x, n.y);
+                if(!cellAt(n.x, n.y) || visited[p.y * width + p.x]) continue;
+                visited[p.y * width + p.x] = true;
+                stack.push_back(n);
+            }
+        }
+
+        vec2i min{ object[0] }, max{ object[0] };
+        for(auto const c : object) {
+            min = vec2i(misc::min(min.x, c.x), misc::min(min.y, c.y));
+            max = vec2i(misc::max(max.x, c.x), misc::max(max.y, c.y));
+        }
+        auto const size = max - min + 1;
+        std::string pattern(size_t(size.x + 1) * size.y, '.');
+        for(int32_t row = 0; row < size.y; row++) pattern[row * (size.x + 1) + size.x] = '\n';
+        for(auto const c : object) pattern[(c.y - min.y) * (size.x + 1) + (c.x - min.x)] = 'o';
+
+        auto const hash = Census::shapeHashOf(pattern.c_str());
+        expectedObjects++;
+        auto const entry = std::find_if(expected.begin(), expected.end(), [&](auto const &e) { return e.first == hash; });
+        if(entry != expected.end()) entry->second.count++;
+        else expected.push_back({ hash, Expected{ 1, uint32_t(object.size()), vec2i(misc::min(size.x, size.y), misc::max(size.x, size.y)) } });
+    }
+
+    auto const fail = [&]() -> std::ostream& {
+        return std::cerr << "MISMATCH engine=census size=" << width << 'x' << height << " threads=" << threads << " seed=" << seed << ": ";
+    };
+    Census census{ threads };
+    census.run(cells.data(), width, height, rowLength);
+    auto const &entries = census.entries();
+    if(census.objectsCount() != expectedObjects || entries.size() != expected.size()) {
+        fail() << census.objectsCount() << " objects of " << entries.size() << " shapes, expected "
+            << expectedObjects << " objects of " << expected.size() << " shapes\n";
+        return false;
+    }
+    for(size_t i = 0; i < entries.size(); i++) {
+        auto const &entry = entries[i];
+        auto const e = std::find_if(expected.begin(), expected.end(), [&](auto const &e) { return e.first == entry.shapeHash; });
+        if(e == expected.end() || e->second.count != entry.count || e->second.population != entry.population || e->second.size.x != entry.size.x || e->second.size.y != entry.size.y) {
+            fail() << "shape " << (entry.name ? entry.name : "?") << " of population " << entry.population
+                << " is counted " << entry.count << " times or is not expected\n";
+            return false;
+        }
+        if(i != 0 && entries[i - 1].count < entry.count) {
+            fail() << "entries are not sorted by count\n";
+            return false;
+        }
+    }
+    for(auto const &known : { std::make_pair("block", "oo\noo"), std::make_pair("blinker", "ooo"), std::make_pair("glider", ".o.\n..o\nooo") }) {
+        auto const hash = Census::shapeHashOf(known.second);
+        auto const entry = std::find_if(entries.begin(), entries.end(), [&](CensusEntry const &e) { return e.shapeHash == hash; });
+        if(entry == entries.end() || entry->name == nullptr || std::string{ entry->name } != known.first) {
+            fail() << known.first << " is missing or not named\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+//records known distributions, from several threads at once for one of them, and compares the quantiles
+//of LatencyHistogram with the exact ones. They must be within 1/subBuckets of them, count, sum, min and max exact.
+//Returns false and prints the first mismatch
+static bool verifyHistogram(uint32_t const threads, uint32_t const seed) {
+    std::mt19937_64 rng{ seed };
+    std::uniform_real_distribution<double> unit{ 0, 1 };
+    struct Distribution { char const *name; std::function<uint64_t()> next; };
+    Distribution const distributions[] = {
+        { "small", [&]() { return uint64_t(rng() % LatencyHistogram::subBuckets); } },
+        { "uniform", [&]() { return uint64_t(rng() % 1000); } },
+        { "constant", [&]() { return uint64_t(12345); } },
+        { "log-uniform", [&]() { return uint64_t(std::exp(unit(rng) * std::log(1e12))); } },
+        { "bimodal", [&]() { return rng() % 10 == 0 ? 1'000'000 + rng() % 100'000 : 900 + rng() % 200; } },
+    };
+
+    LatencyHistogram histogram{};
+    std::vector<uint64_t> values{};
+    for(auto const &distribution : distributions) {
+        auto const fail = [&]() -> std::ostream& {
+            return std::cerr << "MISMATCH engine=histogram threads=" << threads << " seed=" << seed << " distribution=" << distribution.name << ": ";
+        };
+
+        histogram.reset();
+        values.resize(100'000);
+        for(auto &value : values) value = distribution.next();
+        //every thread records its part of the values
+        std::vector<std::thread> recorders{};
+        for(uint32_t i = 0; i < threads; i++) {
+            recorders.emplace_back([&, i]() {
+                for(size_t j = i; j < values.size(); j += threads) histogram.record(values[j]);
+            });
+        }
+        for(auto &recorder : recorders) recorder.join();
+        std::sort(values.begin(), values.end());
+
+        uint64_t sum = 0;
+        for(auto const value : values) sum += value;
+        if(histogram.count() != values.size() || histogram.sum() != sum || histogram.min() != values.front() || histogram.max() != values.back()) {
+            fail() << "count " << histogram.count() << ", sum " << histogram.sum() << ", min " << histogram.min() << ", max " << histogram.max()
+                << ", expected " << values.size() << ", " << sum << ", " << values.front() << ", " << values.back() << '\n';
+            return false;
+        }
+        for(auto const q : { 0.0, 0.001, 0.25, 0.5, 0.9, 0.99, 0.999, 1.0 }) {
+            auto const rank = misc::min(misc::max<uint64_t>(uint64_t(q * values.size() + 0.5), 1), values.size());
+            auto const expected = values[rank - 1];
+            auto const quantile = histogram.quantile(q);
+            auto const error = quantile > expected ? quantile - expected : expected - quantile;
+            if(error * LatencyHistogram::subBuckets > expected) {
+                fail() << "quantile " << q << " is " << quantile << ", expected " << expected << '\n';
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//one store of the seqlock, all words are the same so that a torn read shows up
+struct SeqlockValue { uint64_t words[9]; };
+
+//response of MetricsServer to `GET <path>` over a local socket, empty on failure
+static std::string fetchMetrics(uint16_t const port, char const *const path) {
+    auto const socket = net::connectLocal(port);
+    if(socket == net::invalidSocket) return {};
+    auto const request = std::string{ "GET " } + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+    std::string response{};
+    if(net::sendAll(socket, request.data(), request.size())) {
+        char buffer[4096];
+        while(net::waitReadable(socket, 2000)) {
+            auto const count = net::receive(socket, buffer, sizeof(buffer));
+            if(count <= 0) break;
+            response.append(buffer, size_t(count));
+        }
+    }
+    net::close(socket);
+    return response;
+}
+
+//value of the sample line `name value` in a metrics text, NaN if there is none
+static double metricValue(std::string const &text, std::string const &name) {
+    auto const key = '\n' + name + ' ';
+    auto const at = text.find(key);
+    if(at == std::string::npos) return std::nan("");
+    return std::strtod(text.c_str() + at + key.size(), nullptr);
+}
+
+//reads a Seqlock while another thread stores into it, then publishes metrics and a histogram to a MetricsServer
+//and reads them back over a local socket, also while a thread keeps publishing.
+//Returns false and prints the first mismatch
+static bool verifyMetrics(uint32_t const threads, uint32_t const seed) {
+    auto const fail = [&]() -> std::ostream& {
+        return std::cerr << "MISMATCH engine=metrics threads=" << threads << " seed=" << seed << ": ";
+    };
+
+    {
+        Seqlock<SeqlockValue> seqlock{};
+        std::atomic_bool isWriterDone{ false };
+        std::thread writer{ [&]() {
+            for(uint64_t i = 1; i <= 200'000; i++) {
+                SeqlockValue value;
+                for(auto &word : value.words) word = i;
+                seqlock.store(value);
+            }
+            isWriterDone.store(true);
+        } };
+        std::atomic<uint64_t> tornReads{ 0 }, backwardReads{ 0 };
+        std::vector<std::thread> readers{};
+        for(uint32_t t = 0; t < threads; t++) {
+            readers.emplace_back([&]() {
+                uint64_t last = 0;
+                while(!isWriterDone.load()) {
+                    auto const value = seqlock.load();
+                    for(auto const word : value.words) if(word != value.words[0]) tornReads++;
+                    if(value.words[0] < last) backwardReads++;
+                    last = value.words[0];
+                }
+            });
+        }
+        writer.join();
+        for(auto &reader : readers) reader.join();
+        if(tornReads != 0 || backwardReads != 0 || seqlock.load().words[0] != 200'000 || seqlock.version() != 200'000) {
+            fail() << "seqlock had " << tornReads << " torn and " << backwardReads << " backward reads, last value "
+                << seqlock.load().words[0] << ", version " << seqlock.version() << '\n';
+            return false;
+        }
+    }
+
+    LatencyHistogram latency{};
+    std::mt19937_64 rng{ seed };
+    for(uint32_t i = 0; i < 10'000; i++) latency.record(1000 + rng() % 1'000'000);
+    MetricsServer server{};
+    server.addHistogram("gol_verify_latency", latency);
+    if(!server.start(0)) {
+        fail() << "the server can't be started\n";
+        return false;
+    }
+
+    SimulationMetrics metrics{};
+    metrics.generation = 123;
+    metrics.cells = 1'000'000;
+    metrics.population = 4567;
+    metrics.activeTiles = 89;
+    metrics.pendingEditBatches = 3;
+    metrics.undoBytes = 1 << 20;
+    server.publish(metrics);
+    auto const response = fetchMetrics(server.port(), "/metrics");
+    if(response.compare(0, 15, "HTTP/1.1 200 OK") != 0) {
+        fail() << "/metrics response is '" << response.substr(0, 40) << "'\n";
+        return false;
+    }
+    std::pair<char const*, double> const expected[] = {
+        { "gol_generation", 123 }, { "gol_cells", 1'000'000 }, { "gol_population", 4567 }, { "gol_active_tiles", 89 },
+        { "gol_pending_edit_batches", 3 }, { "gol_undo_bytes", 1 << 20 },
+        { "gol_verify_latency_seconds{quantile=\"0.5\"}", latency.p50() / 1e9 },
+        { "gol_verify_latency_seconds{quantile=\"0.99\"}", latency.p99() / 1e9 },
+        { "gol_verify_latency_seconds_count", 10'000 },
+        { "gol_verify_latency_seconds_sum", latency.sum() / 1e9 },
+    };
+    for(auto const &e : expected) {
+        auto const value = metricValue(response, e.first);
+        if(!(std::abs(value - e.second) <= 1e-9 * misc::max(1.0, std::abs(e.second)))) {
+            fail() << e.first << " is " << value << ", expected " << e.second << '\n';
+            return false;
+        }
+    }
+    if(fetchMetrics(server.port(), "/other").compare(0, 22, "HTTP/1.1 404 Not Found") != 0) {
+        fail() << "unknown paths are served\n";
+        return false;
+    }
+
+    //every published snapshot has population = 2 * generation, a torn one wouldn't
+    std::atomic_bool isPublisherStopped{ false };
+    std::thread publisher{ [&]() {
+        for(uint64_t generation = 1; !isPublisherStopped.load(); generation++) {
+            metrics.generation = generation;
+            metrics.population = generation * 2;
+            server.publish(metrics);
+        }
+    } };
+    auto isConsistent = true;
+    double lastGeneration = 0;
+    for(uint32_t i = 0; i < 20 && isConsistent; i++) {
+        auto const text = fetchMetrics(server.port(), "/metrics");
+        auto const generation = metricValue(text, "gol_generation"), population = metricValue(text, "gol_population");
+        if(!(population == generation * 2) || generation < lastGeneration) {
+            fail() << "read generation " << generation << " with population " << population << " while publishing\n";
+            isConsistent = false;
+        }
+        lastGeneration = generation;
+    }
+    isPublisherStopped.store(true);
+    publisher.join();
+    return isConsistent;
+}
+
+int main(int argc, char **argv) {
+    bool quick = false;
+    std::string engineFilter{};
+    uint64_t generations = 0;
+    uint32_t seed = 1;
+    for(int i = 1; i < argc; i++) {
+        auto const arg = std::string{ argv[i] };
+        auto const hasValue = i + 1 < argc;
+        if(arg == "--quick") quick = true;
+        else if(arg == "--engine" && hasValue) engineFilter = argv[++i];
+        else if(arg == "--generations" && hasValue) generations = misc::max(1ll, std::atoll(argv[++i]));
+        else if(arg == "--seed" && hasValue) seed = uint32_t(std::atoll(argv[++i]));
+        else {
+            std::cerr << "usage: gol_verify [--quick] [--engine <name>] [--generations <n>] [--seed <n>]\n";
+            return 1;
+        }
+    }
+    if(generations == 0) generations = quick ? 8 : 40;
+
+    //every width class: edge cells optimization on (width % 32 <= 30) and off (width % 32 == 31 or 0),
+    //single batch rows, and widths just above multiples of 32
+    std::vector<uint32_t> const widths = quick
+        ? std::vector<uint32_t>{ 1, 3, 31, 32, 33, 64, 65, 100 }
+        : std::vector<uint32_t>{ 1, 2, 3, 17, 30, 31, 32, 33, 34, 62, 63, 64, 65, 95, 96, 97, 100, 127, 128, 129, 200 };
+    std::vector<uint32_t> const heights = quick
+        ? std::vector<uint32_t>{ 1, 2, 3, 17 }
+        : std::vector<uint32_t>{ 1, 2, 3, 4, 17, 64 };
+    std::vector<uint32_t> const threads{ 1, 2, 3 };
+
+    //Field reports its own timings to std::cout
+    auto const stdoutBuffer = std::cout.rdbuf(nullptr);
+    std::ostream out{ stdoutBuffer };
+
+    uint32_t runs = 0, failures = 0;
+    for(auto const &engine : engines) {
+        if(!engineFilter.empty() && engineFilter != engine.name) continue;
+        for(auto const width : widths) for(auto const height : heights) {
+            if(!engine.supports(width, height)) continue;
+            for(auto const t : threads) {
+                runs++;
+                auto const configSeed = seed * 1000003u + width * 131u + height * 7u + t;
+                if(!verify(engine, VerifyConfig{ width, height, t, generations, configSeed })) failures++;
+            }
+        }
+    }
+
+    if(engineFilter.empty() || engineFilter == "allocations") {
+        for(auto const size : { vec2i(100, 17), vec2i(64, 64), vec2i(1000, 100) }) for(auto const t : threads) {
+            runs++;
+            if(!verifyNoAllocations(uint32_t(size.x), uint32_t(size.y), t, seed + t)) failures++;
+        }
+    }
+
+    if(engineFilter.empty() || engineFilter == "render") {
+        for(auto const size : { vec2i(1, 1), vec2i(33, 17), vec2i(100, 64) }) for(auto const t : threads) {
+            runs++;
+            if(!verifyRender(uint32_t(size.x), uint32_t(size.y), t, seed + t)) failures++;
+        }
+    }
+
+    if(engineFilter.empty() || engineFilter == "stream") {
+        for(auto const size : { vec2i(1, 1), vec2i(33, 17), vec2i(100, 64), vec2i(300, 40) }) for(auto const t : threads) {
+            runs++;
+            if(!verifyStream(uint32_t(size.x), uint32_t(size.y), t, seed + t)) failures++;
+        }
+    }
+
+    if(engineFilter.empty() || engineFilter == "tiles") {
+        for(auto const size : { vec2i(1, 1), vec2i(33, 17), vec2i(100, 64), vec2i(300, 40), vec2i(320, 8) }) for(auto const t : threads) {
+            for(uint32_t i = 0; i < 2; i++) {
+                runs++;
+                if(!verifyTiles(uint32_t(size.x), uint32_t(size.y), t, seed * 7 + t * 2 + i)) failures++;
+            }
+        }
+    }
+
+    if(engineFilter.empty() || engineFilter == "resize") {
+        for(auto const size : { vec2i(1, 1), vec2i(31, 3), vec2i(33, 17), vec2i(100, 64), vec2i(300, 40) }) for(auto const t : threads) {
+            for(uint32_t i = 0; i < 2; i++) {
+                runs++;
+                if(!verifyResize(uint32_t(size.x), uint32_t(size.y), t, seed * 11 + t * 2 + i)) failures++;
+            }
+        }
+    }
+
+    if(engineFilter.empty() || engineFilter == "undo") {
+        for(auto const size : { vec2i(1, 1), vec2i(31, 3), vec2i(33, 17), vec2i(100, 64) }) for(auto const t : threads) {
+            for(uint32_t i = 0; i < 3; i++) {
+                runs++;
+                if(!verifyUndo(uint32_t(size.x), uint32_t(size.y), t, seed * 29 + t * 3 + i)) failures++;
+            }
+        }
+    }
+
+    if(engineFilter.empty() || engineFilter == "patterns") {
+        for(auto const size : { vec2i(1, 1), vec2i(31, 3), vec2i(33, 17), vec2i(100, 64), vec2i(200, 40) }) for(uint32_t i = 0; i < 3; i++) {
+            runs++;
+            if(!verifyPatterns(uint32_t(size.x), uint32_t(size.y), seed * 31 + i)) failures++;
+        }
+    }
+
+    if(engineFilter.empty() || engineFilter == "census") {
+        for(auto const size : { vec2i(40, 12), vec2i(100, 17), vec2i(64, 64), vec2i(200, 40) }) for(auto const t : threads) {
+            runs++;
+            if(!verifyCensus(uint32_t(size.x), uint32_t(size.y), t, seed * 13 + t)) failures++;
+        }
+    }
+
+    if(engineFilter.empty() || engineFilter == "period") {
+        for(auto const size : { vec2i(8, 8), vec2i(10, 10), vec2i(16, 16) }) for(auto const t : threads) {
+            runs++;
+            if(!verifyPeriod(uint32_t(size.x), uint32_t(size.y), t, seed + t, true)) failures++;
+        }
+        for(auto const size : { vec2i(5, 5), vec2i(16, 16), vec2i(33, 12), vec2i(40, 40) }) for(auto const t : threads) {
+            for(uint32_t i = 0; i < 4; i++) {
+                runs++;
+                if(!verifyPeriod(uint32_t(size.x), uint32_t(size.y), t, seed * 17 + t * 4 + i, false)) failures++;
+            }
+        }
+    }
+
+    if(engineFilter.empty() || engineFilter == "histogram") {
+        for(auto const t : threads) {
+            runs++;
+            if(!verifyHistogram(t, seed * 19 + t)) failures++;
+        }
+    }
+
+    if(engineFilter.empty() || engineFilter == "metrics") {
+        for(auto const t : threads) {
+            runs++;
+            if(!verifyMetrics(t, seed * 23 + t)) failures++;
+        }
+    }
+
+    out << runs << " runs, " << failures << " failed\n";
+    std::cout.rdbuf(stdoutBuffer);
+    return failures == 0 ? 0 : 1;
+}